@@ -5,9 +5,11 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../Src/ADCStream.c \
 ../Src/Audio.c \
 ../Src/BmpDecoder.c \
 ../Src/CFunctions.c \
+../Src/CanQueue.c \
 ../Src/Commands.c \
 ../Src/Custom.c \
 ../Src/Draw.c \
@@ -19,7 +21,9 @@ C_SRCS += \
 ../Src/GPS.c \
 ../Src/GUI.c \
 ../Src/I2C.c \
+../Src/KV.c \
 ../Src/Keyboard.c \
+../Src/KvLog.c \
 ../Src/MATHS.c \
 ../Src/MMBasic.c \
 ../Src/MM_Custom.c \
@@ -55,9 +59,11 @@ C_SRCS += \
 ../Src/usbd_desc.c 
 
 OBJS += \
+./Src/ADCStream.o \
 ./Src/Audio.o \
 ./Src/BmpDecoder.o \
 ./Src/CFunctions.o \
+./Src/CanQueue.o \
 ./Src/Commands.o \
 ./Src/Custom.o \
 ./Src/Draw.o \
@@ -69,7 +75,9 @@ OBJS += \
 ./Src/GPS.o \
 ./Src/GUI.o \
 ./Src/I2C.o \
+./Src/KV.o \
 ./Src/Keyboard.o \
+./Src/KvLog.o \
 ./Src/MATHS.o \
 ./Src/MMBasic.o \
 ./Src/MM_Custom.o \
@@ -105,9 +113,11 @@ OBJS += \
 ./Src/usbd_desc.o 
 
 C_DEPS += \
+./Src/ADCStream.d \
 ./Src/Audio.d \
 ./Src/BmpDecoder.d \
 ./Src/CFunctions.d \
+./Src/CanQueue.d \
 ./Src/Commands.d \
 ./Src/Custom.d \
 ./Src/Draw.d \
@@ -119,7 +129,9 @@ C_DEPS += \
 ./Src/GPS.d \
 ./Src/GUI.d \
 ./Src/I2C.d \
+./Src/KV.d \
 ./Src/Keyboard.d \
+./Src/KvLog.d \
 ./Src/MATHS.d \
 ./Src/MMBasic.d \
 ./Src/MM_Custom.d \
@@ -172,7 +184,7 @@ Src/Timers.o: ../Src/Timers.c Src/subdir.mk
 clean: clean-Src
 
 clean-Src:
-	-$(RM) ./Src/Audio.d ./Src/Audio.o ./Src/Audio.su ./Src/BmpDecoder.d ./Src/BmpDecoder.o ./Src/BmpDecoder.su ./Src/CFunctions.d ./Src/CFunctions.o ./Src/CFunctions.su ./Src/Commands.d ./Src/Commands.o ./Src/Commands.su ./Src/Custom.d ./Src/Custom.o ./Src/Custom.su ./Src/Draw.d ./Src/Draw.o ./Src/Draw.su ./Src/Editor.d ./Src/Editor.o ./Src/Editor.su ./Src/External.d ./Src/External.o ./Src/External.su ./Src/FileIO.d ./Src/FileIO.o ./Src/FileIO.su ./Src/Flash.d ./Src/Flash.o ./Src/Flash.su ./Src/Functions.d ./Src/Functions.o ./Src/Functions.su ./Src/GPS.d ./Src/GPS.o ./Src/GPS.su ./Src/GUI.d ./Src/GUI.o ./Src/GUI.su ./Src/I2C.d ./Src/I2C.o ./Src/I2C.su ./Src/Keyboard.d ./Src/Keyboard.o ./Src/Keyboard.su ./Src/MATHS.d ./Src/MATHS.o ./Src/MATHS.su ./Src/MMBasic.d ./Src/MMBasic.o ./Src/MMBasic.su ./Src/MM_Custom.d ./Src/MM_Custom.o ./Src/MM_Custom.su ./Src/MM_Misc.d ./Src/MM_Misc.o ./Src/MM_Misc.su ./Src/Memory.d ./Src/Memory.o ./Src/Memory.su ./Src/MiscSTM32.d ./Src/MiscSTM32.o ./Src/MiscSTM32.su ./Src/Onewire.d ./Src/Onewire.o ./Src/Onewire.su ./Src/Operators.d ./Src/Operators.o ./Src/Operators.su ./Src/PWM.d ./Src/PWM.o ./Src/PWM.su ./Src/SPI-LCD.d ./Src/SPI-LCD.o ./Src/SPI-LCD.su ./Src/SPI.d ./Src/SPI.o ./Src/SPI.su ./Src/SSD1963.d ./Src/SSD1963.o ./Src/SSD1963.su ./Src/Serial.d ./Src/Serial.o ./Src/Serial.su ./Src/SerialFileIO.d ./Src/SerialFileIO.o ./Src/SerialFileIO.su ./Src/Timers.d ./Src/Timers.o ./Src/Timers.su ./Src/Touch.d ./Src/Touch.o ./Src/Touch.su ./Src/XModem.d ./Src/XModem.o ./Src/XModem.su ./Src/bsp_driver_sd.d ./Src/bsp_driver_sd.o ./Src/bsp_driver_sd.su ./Src/cJSON.d ./Src/cJSON.o ./Src/cJSON.su ./Src/fatfs.d ./Src/fatfs.o ./Src/fatfs.su ./Src/fatfs_platform.d ./Src/fatfs_platform.o ./Src/fatfs_platform.su ./Src/main.d ./Src/main.o ./Src/main.su ./Src/sd_diskio.d ./Src/sd_diskio.o ./Src/sd_diskio.su ./Src/stm32f4xx_hal_msp.d ./Src/stm32f4xx_hal_msp.o ./Src/stm32f4xx_hal_msp.su ./Src/stm32f4xx_it.d ./Src/stm32f4xx_it.o ./Src/stm32f4xx_it.su ./Src/stm32f4xx_ll_gpio.d ./Src/stm32f4xx_ll_gpio.o ./Src/stm32f4xx_ll_gpio.su ./Src/stm32f4xx_ll_spi.d ./Src/stm32f4xx_ll_spi.o ./Src/stm32f4xx_ll_spi.su ./Src/syscalls.d ./Src/syscalls.o ./Src/syscalls.su ./Src/system_stm32f4xx.d ./Src/system_stm32f4xx.o ./Src/system_stm32f4xx.su ./Src/usb_device.d ./Src/usb_device.o ./Src/usb_device.su ./Src/usbd_cdc_if.d ./Src/usbd_cdc_if.o ./Src/usbd_cdc_if.su ./Src/usbd_conf.d ./Src/usbd_conf.o ./Src/usbd_conf.su ./Src/usbd_desc.d ./Src/usbd_desc.o ./Src/usbd_desc.su
+	-$(RM) ./Src/ADCStream.d ./Src/ADCStream.o ./Src/ADCStream.su ./Src/Audio.d ./Src/Audio.o ./Src/Audio.su ./Src/BmpDecoder.d ./Src/BmpDecoder.o ./Src/BmpDecoder.su ./Src/CFunctions.d ./Src/CFunctions.o ./Src/CFunctions.su ./Src/CanQueue.d ./Src/CanQueue.o ./Src/CanQueue.su ./Src/Commands.d ./Src/Commands.o ./Src/Commands.su ./Src/Custom.d ./Src/Custom.o ./Src/Custom.su ./Src/Draw.d ./Src/Draw.o ./Src/Draw.su ./Src/Editor.d ./Src/Editor.o ./Src/Editor.su ./Src/External.d ./Src/External.o ./Src/External.su ./Src/FileIO.d ./Src/FileIO.o ./Src/FileIO.su ./Src/Flash.d ./Src/Flash.o ./Src/Flash.su ./Src/Functions.d ./Src/Functions.o ./Src/Functions.su ./Src/GPS.d ./Src/GPS.o ./Src/GPS.su ./Src/GUI.d ./Src/GUI.o ./Src/GUI.su ./Src/I2C.d ./Src/I2C.o ./Src/I2C.su ./Src/KV.d ./Src/KV.o ./Src/KV.su ./Src/Keyboard.d ./Src/Keyboard.o ./Src/Keyboard.su ./Src/KvLog.d ./Src/KvLog.o ./Src/KvLog.su ./Src/MATHS.d ./Src/MATHS.o ./Src/MATHS.su ./Src/MMBasic.d ./Src/MMBasic.o ./Src/MMBasic.su ./Src/MM_Custom.d ./Src/MM_Custom.o ./Src/MM_Custom.su ./Src/MM_Misc.d ./Src/MM_Misc.o ./Src/MM_Misc.su ./Src/Memory.d ./Src/Memory.o ./Src/Memory.su ./Src/MiscSTM32.d ./Src/MiscSTM32.o ./Src/MiscSTM32.su ./Src/Onewire.d ./Src/Onewire.o ./Src/Onewire.su ./Src/Operators.d ./Src/Operators.o ./Src/Operators.su ./Src/PWM.d ./Src/PWM.o ./Src/PWM.su ./Src/SPI-LCD.d ./Src/SPI-LCD.o ./Src/SPI-LCD.su ./Src/SPI.d ./Src/SPI.o ./Src/SPI.su ./Src/SSD1963.d ./Src/SSD1963.o ./Src/SSD1963.su ./Src/Serial.d ./Src/Serial.o ./Src/Serial.su ./Src/SerialFileIO.d ./Src/SerialFileIO.o ./Src/SerialFileIO.su ./Src/Timers.d ./Src/Timers.o ./Src/Timers.su ./Src/Touch.d ./Src/Touch.o ./Src/Touch.su ./Src/XModem.d ./Src/XModem.o ./Src/XModem.su ./Src/bsp_driver_sd.d ./Src/bsp_driver_sd.o ./Src/bsp_driver_sd.su ./Src/cJSON.d ./Src/cJSON.o ./Src/cJSON.su ./Src/fatfs.d ./Src/fatfs.o ./Src/fatfs.su ./Src/fatfs_platform.d ./Src/fatfs_platform.o ./Src/fatfs_platform.su ./Src/main.d ./Src/main.o ./Src/main.su ./Src/sd_diskio.d ./Src/sd_diskio.o ./Src/sd_diskio.su ./Src/stm32f4xx_hal_msp.d ./Src/stm32f4xx_hal_msp.o ./Src/stm32f4xx_hal_msp.su ./Src/stm32f4xx_it.d ./Src/stm32f4xx_it.o ./Src/stm32f4xx_it.su ./Src/stm32f4xx_ll_gpio.d ./Src/stm32f4xx_ll_gpio.o ./Src/stm32f4xx_ll_gpio.su ./Src/stm32f4xx_ll_spi.d ./Src/stm32f4xx_ll_spi.o ./Src/stm32f4xx_ll_spi.su ./Src/syscalls.d ./Src/syscalls.o ./Src/syscalls.su ./Src/system_stm32f4xx.d ./Src/system_stm32f4xx.o ./Src/system_stm32f4xx.su ./Src/usb_device.d ./Src/usb_device.o ./Src/usb_device.su ./Src/usbd_cdc_if.d ./Src/usbd_cdc_if.o ./Src/usbd_cdc_if.su ./Src/usbd_conf.d ./Src/usbd_conf.o ./Src/usbd_conf.su ./Src/usbd_desc.d ./Src/usbd_desc.o ./Src/usbd_desc.su
 
 .PHONY: clean-Src
 
@@ -0,0 +1,68 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+ADCStream.h
+
+The double buffer used by the ADC STREAM command.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024      Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+#ifndef ADCSTREAM_H
+#define ADCSTREAM_H
+
+// a circular buffer of packed samples filled by ADC STREAM, each half is passed on as soon as it is full
+// the interrupt only writes filled[], started[], last, overrun and count and the reader only writes used[] and taken
+// so neither needs to lock out the other
+struct s_adcstream {
+    uint16_t *buf;                                  // the samples, interleaved when more than one channel is open
+    int size;                                       // nbr of samples in buf[], a multiple of twice the nbr of channels
+    int pos;                                        // where the next sample will be stored
+    volatile int last;                              // the half that was filled last (0 or 1)
+    volatile unsigned int started[2];               // nbr of times the interrupt has started to fill each half
+    volatile unsigned int filled[2];                // nbr of times each half has been filled
+    volatile unsigned int used[2];                  // filled[] for each half when it was last released
+    unsigned int taken;                             // filled[] for the half returned by ADCStreamTake()
+    volatile unsigned int overrun;                  // halves that were filled again before they were used
+    volatile unsigned int count;                    // total nbr of halves filled
+};
+extern int ADCStreamPut(struct s_adcstream *s, uint16_t *sample, int n);
+extern uint16_t *ADCStreamTake(struct s_adcstream *s, int *half);
+extern int ADCStreamRelease(struct s_adcstream *s, int half);
+
+#endif /* ADCSTREAM_H */
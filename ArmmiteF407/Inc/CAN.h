@@ -84,6 +84,11 @@ void cmd_can(void);
 
 void CanInit(void);
 
+#include "CanQueue.h"
+extern void CanReceive(int fifo);
+extern void CanClear(void);
+extern char *CanInterrupt;
+
 #endif /* CAN_H */
 //#endif /* INCLUDE_FUNCTION_DEFINES */
 
@@ -0,0 +1,69 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+CanQueue.h
+
+The software receive queues used by the CAN command.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024      Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+#ifndef CANQUEUE_H
+#define CANQUEUE_H
+
+// a received frame as held in the software receive queue
+struct s_canframe {
+    uint32_t id;                                    // standard or extended id
+    uint16_t timestamp;                             // the bit time counter captured by the hardware when it was received
+    uint8_t eid, rtr, dlc, fmi;                     // extended id flag, remote request flag, data length and filter matched
+    uint8_t data[8];
+};
+// a ring buffer filled by the receive ISR and emptied by CAN READ
+// head is only written by the ISR and tail only by CAN READ so no locking is needed
+struct s_canqueue {
+    volatile int head, tail;
+    int size;                                       // nbr of entries in frame[], one is always left empty
+    volatile unsigned int overflow;                 // frames lost because the queue was full
+    volatile unsigned int overrun;                  // frames lost by the hardware FIFO before the ISR could empty it
+    struct s_canframe frame[];
+};
+extern int CanQueuePut(struct s_canqueue *q, struct s_canframe *f);
+extern int CanQueueGet(struct s_canqueue *q, struct s_canframe *f);
+extern int CanQueueCount(struct s_canqueue *q);
+
+#endif /* CANQUEUE_H */
@@ -93,6 +93,7 @@ void cmd_trace(void);
 void MIPS16 cmd_const(void);
 void cmd_select(void);
 void cmd_case(void);
+void SelectMapClear(void);
 void cmd_mid(void);
 void cmd_call(void);
 void cmd_execute(void);
@@ -92,8 +92,42 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MAXGOSUB            50                      // maximum nbr of nested gosubs and defined subs/functs, each entry uses 8 bytes
 #define MAX_MULTILINE_IF    10                      // maximum nbr of nested multiline IFs, each entry uses 8 bytes
 #define MAXTEMPSTRINGS      256                    // maximum nbr of temporary strings allowed, each entry takes up 4 bytes
+#define TEMPPOOLSIZE        8                       // nbr of freed temporary strings kept for reuse, each entry takes up 4 bytes
 #define MAXSUBFUN           256                     // maximum nbr of defined subroutines or functions in a program. each entry takes up 4 bytes
+#define MAXJUMPCACHE        1024                    // maximum nbr of cached FOR/NEXT, DO/LOOP, etc targets. each entry takes up 8 bytes of heap
+#define MAXNUMCACHE         512                     // maximum nbr of cached numeric constants. each entry takes up 16 bytes of heap
+#define MAXVARCACHE         512                     // maximum nbr of cached variable references. each entry takes up 16 bytes of heap
+#define MAXEXPRCACHE        256                     // maximum nbr of compiled expressions. each entry takes up 12 bytes of heap
+#define EXPRCODESIZE        4096                    // maximum size in bytes of the heap used to hold the code for compiled expressions
+#define EXPRMAXOPS          64                      // maximum nbr of codes in a single compiled expression (longer ones are not compiled)
+#define EXPRSTACKSIZE       8                       // maximum nesting of values in a compiled expression (more complex ones are not compiled)
+#define MAXCALLFRAMES       4                       // nbr of sub/fun argument frames in the call frame arena, each takes up about 1.7K of heap
+#define MAXFUNARGBUFS       8                       // nbr of built-in function argument buffers (nesting depth), each takes up STRINGSIZE bytes of heap
+#define MAXJSONHANDLES      4                       // nbr of JSON documents that can be open at the same time
+#define CANRXQUEUE          64                      // default nbr of frames in each CAN receive queue, each takes up 20 bytes of heap
+#define KVMAXKEYS           256                     // nbr of keys the KV store can index, each takes up 8 bytes of RAM
+#define EDITINDEXSTEP       16                      // the editor records the start of every 16th line in its line index
+#define EDITINDEXSIZE       256                     // nbr of entries in the editor's line index (covers 4096 lines)
 #define NBRSETTICKS         4                       // the number of SETTICK interrupts available
+// the MMBasic interrupt sources, each is a bit in IntPending (see check_interrupt() in MM_Misc.c)
+#define INT_ONKEY           0                       // ON KEY location
+#define INT_KEY             1                       // ON KEY key, location
+#define INT_COM1            2                       // COM1 to COM4 receive level reached
+#define INT_GUIDOWN         6                       // touch pen down
+#define INT_GUIUP           7                       // touch pen up
+#define INT_WAV             8                       // PLAY finished
+#define INT_ADC             9                       // ADC conversion finished
+#define INT_IR              10                      // IR message received
+#define INT_KEYPAD          11                      // KEYPAD key pressed
+#define INT_CSUB            12                      // INTERRUPT command or CSub
+#define INT_PIN             13                      // I/O pin interrupts
+#define INT_I2CRX           14                      // I2C slave receive
+#define INT_I2CTX           15                      // I2C slave send
+#define INT_CAN             16                      // CAN receive queue reached the CAN INTERRUPT level
+#define INT_TICK            17                      // SETTICK 1 to NBRSETTICKS
+#define INT_NBRSOURCES      (INT_TICK + NBRSETTICKS)
+#define INT_HOUSEKEEP       31                      // set every mSec to run the touch, SD card and GPS checks
+#define INT_DEFPRIORITY     5                       // the default priority of an interrupt source (1 is the highest, 9 the lowest)
 #define MAXBLITBUF          64                      // the maximum number of BLIT buffers
 #define MAXLAYER            10                      // maximum number of sprite layers
 #define BREAK_KEY           3                       // the default value (CTRL-C) for the break key.  Reset at the command prompt.
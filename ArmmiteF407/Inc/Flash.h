@@ -162,9 +162,16 @@ void WBReadSector(int pageno,char *p);
 void WBWritePage(int pageno,char *p);
 void WBWriteSector(int pageno,char *p);
 void WBEraseArea(int erasemode,int pageno);
+void WBRead(int addr,char *p,int n);
+void WBProgram(int addr,char *p,int n);
+void WBEraseStart(int pageno);
+int WBBusy(void);
 void SPIOpen(void);
+int SPIOpenFlash(int wait);
 #define WBLibAddr 7936   //First page of the Library 64K
 #define WBVarAddr 7920   //First page of the Var Save 4K
+#define WBKvAddr 7680    //First page of the KV store 60K
+#define WBKvSectors 15   //Nbr of 4K sectors in the KV store
 //#define WBLibAddr 0   //First page of the Library 64K
 //#define WBVarAddr 256   //First page of the Var Save 4K
 //#define WBUserEndAddr 272   //Last page of the User Area
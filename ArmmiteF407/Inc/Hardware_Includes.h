@@ -214,6 +214,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "SPI.h"
 #include "CAN.h"
 #include "Flash.h"
+#include "KV.h"
 #include "Xmodem.h"
 #include "Draw.h"
 #include "editor.h"
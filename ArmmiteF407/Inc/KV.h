@@ -0,0 +1,125 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+KV.h
+
+Include file that contains the globals and defines for the key/value store in MMBasic.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024  Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+
+
+/**********************************************************************************
+ the C language function associated with commands, functions or operators should be
+ declared here
+**********************************************************************************/
+#if !defined(INCLUDE_COMMAND_TABLE) && !defined(INCLUDE_TOKEN_TABLE)
+void cmd_kv(void);
+void fun_kv(void);
+#endif
+
+
+/**********************************************************************************
+ All command tokens tokens (eg, PRINT, FOR, etc) should be inserted in this table
+**********************************************************************************/
+#ifdef INCLUDE_COMMAND_TABLE
+	{ "KV",			T_CMD,				0, cmd_kv	},
+#endif
+
+
+/**********************************************************************************
+ All other tokens (keywords, functions, operators) should be inserted in this table
+**********************************************************************************/
+#ifdef INCLUDE_TOKEN_TABLE
+	{ "KV(",		T_FUN | T_NBR | T_INT | T_STR,	0, fun_kv	},
+#endif
+
+
+#if !defined(INCLUDE_COMMAND_TABLE) && !defined(INCLUDE_TOKEN_TABLE)
+#ifndef KV_H
+#define KV_H
+
+#define KV_SECTOR       4096                        // the unit of erase
+#define KV_PAGE         256                         // a program must not cross a page boundary
+#define KV_MAXSECTORS   64                          // the most sectors that the store can span
+#define KV_MAXKEY       64                          // the longest key
+#define KV_MAXVALUE     255                         // the longest value (a string)
+
+// the type of a record, an unprogrammed record reads as 0xFF
+#define KV_STR          1
+#define KV_NBR          2
+#define KV_INT          3
+#define KV_DEL          4                           // the key has been deleted
+
+// the values returned by the Kv functions
+#define KV_OK           0
+#define KV_NOTFOUND     1
+#define KV_FULL         2                           // the flash is full of live records
+#define KV_NOKEYS       3                           // the RAM index is full
+
+// every record starts with this and is padded to a multiple of four bytes
+struct s_kvrec {
+    uint8_t type;
+    uint8_t keylen;
+    uint16_t vallen;
+    uint32_t crc;                                   // CRC32 of type, keylen and vallen then the key and value
+};
+
+// the flash primitives used by the store, these point to the W25Q routines but can be
+// pointed to anything that behaves like NOR flash (eg, a file) to test the store on its own
+extern void (*KvRead)(uint32_t addr, void *p, int n);
+extern void (*KvProgram)(uint32_t addr, const void *p, int n);    // never crosses a KV_PAGE boundary
+extern void (*KvErase)(uint32_t addr);              // start erasing the sector at addr and return
+extern int (*KvBusy)(void);                         // true while an erase is in progress
+
+extern int KvOpen(uint32_t base, int sectors);
+extern int KvPut(const char *key, int keylen, int type, const void *val, int vallen);
+extern int KvGet(const char *key, int keylen, int *type, void *val, int *vallen);
+extern int KvDelete(const char *key, int keylen);
+extern int KvEntry(int slot, char *key, int *keylen, int *type, void *val, int *vallen);
+extern int KvCompactStep(void);
+extern int KvPending(void);
+extern int KvErasing(void);
+extern int KvCompact(void);
+extern int KvFormat(void);
+extern void KvStatus(int *keys, int *blank, int *used, int *live);
+extern void KvService(void);
+
+#endif /* KV_H */
+#endif
@@ -93,6 +93,8 @@ extern int parsenumberarray( char *tp, MMFLOAT **a1float, int64_t **a1int, int a
 extern int parsefloatrarray( char *tp, MMFLOAT **a1float, int argno, int dimensions, short *dims, bool ConstantNotAllowed);
 extern int parseintegerarray(char *tp, int64_t **a1int, int argno, int dimensions, short *dims, bool ConstantNotAllowed);
 extern int parseany( char *tp, MMFLOAT **a1float, int64_t **a1int, unsigned char ** a1str, int *length, bool stringarray);
+extern void FftPlanClear(void);
+extern uint32_t crc32(const uint8_t *array, uint16_t length, const uint32_t polynome, const uint32_t startmask, const uint32_t endmask, const uint8_t reverseIn, const uint8_t reverseOut);
 //void MahonyQuaternionUpdate(MMFLOAT ax, MMFLOAT ay, MMFLOAT az, MMFLOAT gx, MMFLOAT gy, MMFLOAT gz, MMFLOAT mx, MMFLOAT my, MMFLOAT mz, MMFLOAT Ki, MMFLOAT Kp, MMFLOAT deltat, MMFLOAT *yaw, MMFLOAT *pitch, MMFLOAT *roll);
 //void MadgwickQuaternionUpdate(MMFLOAT ax, MMFLOAT ay, MMFLOAT az, MMFLOAT gx, MMFLOAT gy, MMFLOAT gz, MMFLOAT mx, MMFLOAT my, MMFLOAT mz, MMFLOAT beta, MMFLOAT deltat, MMFLOAT *pitch, MMFLOAT *yaw, MMFLOAT *roll);
 //extern volatile unsigned int AHRSTimer;
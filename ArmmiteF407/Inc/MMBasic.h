@@ -233,6 +233,82 @@ extern int MMerrno;
 extern char MMErrMsg[MAXERRMSG];                // array holding the error msg
 
 extern char *subfun[];                          // Table of subroutines and functions built when the program starts running
+
+union u_argval {
+    MMFLOAT f;                                  // the value if it is a float
+    long long int i;                            // the value if it is an integer
+    MMFLOAT *fa;                                // pointer to the allocated memory if it is an array of floats
+    long long int *ia;                          // pointer to the allocated memory if it is an array of integers
+    char *s;                                    // pointer to the allocated memory if it is a string
+};
+
+struct s_callframe {                            // workspace used by DefinedSubFun() for processing the arguments
+    union u_argval argval[MAX_ARG_COUNT];
+    int argtype[MAX_ARG_COUNT];
+    int argVarIndex[MAX_ARG_COUNT];
+    char *argv1[MAX_ARG_COUNT];                 // these are for the caller
+    char *argv2[MAX_ARG_COUNT];                 // and these for the definition of the sub or function
+    char argbuf1[STRINGSIZE];
+    char argbuf2[STRINGSIZE];
+};
+extern short subfunhash[];                      // Hash index into subfun[]
+
+struct s_jumptbl {                              // structure of the jump cache
+    char *from;                                 // key identifying the command in program memory
+    char *to;                                   // the matching target (eg, the NEXT for a FOR command)
+};
+extern struct s_jumptbl *jumptbl;               // Cache of resolved FOR/NEXT, DO/LOOP, etc targets built as the program runs
+extern int jumptblsize, jumptblcnt;
+
+struct s_numtbl {                               // structure of the numeric constant cache
+    union {
+        MMFLOAT f;                              // the value if it is a float
+        long long int i;                        // the value if it is an integer
+    } v;
+    char *p;                                    // the location of the constant in program memory
+    unsigned char len;                          // the number of characters in the constant
+    unsigned char type;                         // T_INT or T_NBR
+};
+extern struct s_numtbl *numtbl;                 // Cache of numeric constants built as the program runs
+
+struct s_varcache {                             // structure of the inline cache for variable references
+    char *p;                                    // the location of the reference in program memory
+    unsigned int ggen, lgen;                    // VarGenGlobal and VarGenLocal when the entry was saved
+    short index;                                // the index into vartbl[]
+    short level;                                // the LocalIndex when the entry was saved
+};
+extern struct s_varcache *varcache;             // Inline cache of variable references built as the program runs
+extern unsigned int VarGenGlobal, VarGenLocal;
+
+union u_exprop {                                // one slot of a compiled expression
+    struct {
+        unsigned char op;                       // the E_xxx code
+        unsigned char arg;                      // the operator (index into tokentbl[]) or the type of a constant
+        unsigned char kind;                     // the type of comparison for a compare operator
+        char *p;                                // the location in program memory of a variable or value left to getvalue()
+    } c;
+    MMFLOAT f;                                  // the value of a constant is in the slot following the op
+    long long int i;
+};
+struct s_exprtbl {                              // structure of the index of compiled expressions
+    char *p;                                    // the location of the expression in program memory
+    char *end;                                  // where evaluate() finished
+    union u_exprop *code;                       // the compiled code or NULL if the expression could not be compiled
+};
+extern struct s_exprtbl *exprtbl;               // Compiled expressions built as the program runs
+extern int ExprBusy;
+extern unsigned int ExprFlushes;
+
+struct s_labeltbl {                             // structure of the label index
+    char *label;                                // points to the length byte of the label in program memory
+    char *line;                                 // the start of the line containing the label
+};
+extern struct s_labeltbl *labeltbl;             // Index of labels and line numbers built when the program starts running
+extern int labeltblsize;
+extern char **lineidx;
+extern int lineidxcnt;
+extern unsigned int StatementCount;             // nbr of statements executed since RUN
+
 extern char CurrentSubFunName[MAXVARLEN + 1];   // the name of the current sub or fun
 extern char CurrentInterruptName[MAXVARLEN + 1];// the name of the current interrupt function
 
@@ -305,7 +381,18 @@ void InsertLastcmd(char *s);
 int MIPS16 CountLines(char *target);
 void DefinedSubFun(int iscmd, char *cmd, int index, MMFLOAT *fa, long long int *i64, char **sa, int *t);
 int FindSubFun(char *p, int type);
+int FindSubFunCached(char *p, int type);
+void AddSubFunHash(int i, int ErrAbort);
 void MIPS16 PrepareProgram(int);
+char *FindJumpTarget(char *from);
+void SaveJumpTarget(char *from, char *to);
+void ClearJumpCache(void);
+int FindVarCache(char *p);
+void SaveVarCache(char *p, int index);
+struct s_numtbl *FindNumber(char *p);
+void SaveNumber(char *p, int len, int type, MMFLOAT f, long long int i64);
+void BuildLabelIndex(void);
+void ClearLabelIndex(void);
 void MMPrintString(char* s);
 void MMfputs(char *p, int filenbr);
 void IntToStrPad(char *p, long long int nbr, signed char padch, int maxch, int radix);
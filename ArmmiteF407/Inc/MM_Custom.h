@@ -97,3 +97,17 @@ void cmd_ADC(void);
 
 #endif
 
+/***********************************************************************************
+ Function prototypes
+***********************************************************************************/
+#if !defined(INCLUDE_COMMAND_TABLE) && !defined(INCLUDE_TOKEN_TABLE)
+#ifndef MM_CUSTOM_H
+#define MM_CUSTOM_H
+#include "ADCStream.h"
+extern struct s_adcstream ADCstream;
+extern volatile int ADCstreaming;
+extern void ADCStreamISR(void);
+extern void ADCStreamService(void);
+extern void ADCStreamVarFreed(void *p);
+#endif
+#endif
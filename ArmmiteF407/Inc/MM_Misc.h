@@ -72,6 +72,7 @@ void cmd_cpu(void);
 void cmd_cfunction(void);
 void cmd_longString(void);
 void cmd_sort(void);
+void cmd_profile(void);
 void cmd_csubinterrupt(void);
 void fun_timer(void);
 void fun_date(void);
@@ -87,9 +88,11 @@ void fun_LGetByte(void);
 void fun_LGetStr(void);
 void fun_LCompare(void);
 void fun_LInstr(void);
+void fun_LCount(void);
 void fun_epoch(void);
 void fun_datetime(void);
 void fun_json(void);
+void cmd_json(void);
 void cmd_JumpToBootloader(void);
 void fun_format(void);
 //void fun_backup(void);
@@ -116,6 +119,8 @@ void fun_format(void);
 	{ "WatchDog",		T_CMD,				0, cmd_watchdog	},
 	{ "CPU",			T_CMD,				0, cmd_cpu 	},
 	{ "Sort",			T_CMD,				0, cmd_sort 	},
+	{ "Profile",		T_CMD,				0, cmd_profile	},
+	{ "JSON",			T_CMD,				0, cmd_json		},
     { "DefineFont",     T_CMD,				0, cmd_cfunction},
     { "End DefineFont", T_CMD,				0, cmd_null 	},
 	{ "LongString",		T_CMD,				0, cmd_longString	},
@@ -137,6 +142,7 @@ void fun_format(void);
 	{ "Timer",	T_FNA | T_NBR,		0, fun_timer	},
 	{ "LInStr(",		T_FUN | T_INT,		0, fun_LInstr		},
 	{ "LCompare(",		T_FUN | T_INT,		0, fun_LCompare		},
+	{ "LCount(",		T_FUN | T_INT,		0, fun_LCount		},
 	{ "LLen(",		T_FUN | T_INT,		0, fun_LLen		},
 	{ "LGetStr$(",		T_FUN | T_STR,		0, fun_LGetStr		},
 	{ "As",		T_NA,			0, op_invalid	},
@@ -170,6 +176,10 @@ void fun_format(void);
 
     extern char *InterruptReturn;
     extern int check_interrupt(void);
+    extern volatile unsigned int IntPending;
+    extern unsigned char IntPriority[INT_NBRSOURCES];
+    extern void IntPost(int src);
+    extern void InterruptClear(void);
     extern char *GetIntAddress(char *p);
     extern void MIPS16 CrunchData(char **p, int c);
 
@@ -198,5 +208,10 @@ void fun_format(void);
 	extern char EchoOption;
 	extern unsigned int GetPeekAddr(char *p);
 	extern unsigned int GetPokeAddr(char *p);
+	extern int ProfileOn;
+	extern void ProfileLine(char *p);
+	extern void ProfileClear(void);
+	extern void ProfileStop(void);
+	extern void JsonClear(void);
 #endif
 #endif
@@ -106,10 +106,15 @@ extern void *GetTempMemory(int NbrBytes);
 extern void *GetTempStrMemory(void);
 extern void ClearTempMemory(void);
 extern void ClearSpecificTempMemory(void *addr);
+extern struct s_callframe *GetCallFrame(void);
+extern void FreeCallFrame(struct s_callframe *frame);
+extern char *GetFunArgBuf(void);
+extern void FreeFunArgBuf(char *buf);
 extern void FreeMemory(void *addr);
 extern void InitHeap(void);
 extern char *HeapBottom(void);
 extern int FreeSpaceOnHeap(void);
+extern unsigned int HeapPagesHigh;
 
 extern unsigned int _stack;
 extern unsigned int _splim;
@@ -114,6 +114,8 @@ void fun_dir(void);
     extern char FilePutChar(char c, int fnbr);
     extern void FilePutStr(int count, char *c, int fnbr);
     extern int  FileEOF(int fnbr);
+    extern void FileFlush(int fnbr);
+    extern int FileGetLine(int fnbr, char *p);
     extern char *ChangeToDir(char *p);
     extern int InitSDCard(void);
     extern void ErrorCheck(int fnbr);
@@ -0,0 +1,94 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+ADCStream.c
+
+The double buffer used by the ADC STREAM command.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024      Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+/* The double buffer used by ADC STREAM
+ * The TIM7 interrupt stores the samples for each tick with ADCStreamPut() and each time half of the buffer is full
+ * that half is handed on (to ADC STREAM READ or to the file writer in ADCStreamService()) while the other half is
+ * filled.  These functions do not use the HAL or the rest of MMBasic so that they can be tested on their own with
+ * synthetic samples (see test/adc).
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include "ADCStream.h"
+
+// store one sample for each channel, returns 1 or 2 if this filled the first or second half, otherwise zero
+int ADCStreamPut(struct s_adcstream *s, uint16_t *sample, int n) {
+    int h = (s->pos >= s->size / 2);
+    if(s->pos == h * (s->size / 2)) {               // starting to fill a half
+        if(s->used[h] != s->filled[h]) s->overrun++;    // the samples in it were not used
+        s->started[h]++;
+    }
+    while(n--) s->buf[s->pos++] = *sample++;
+    if(s->pos != (h + 1) * (s->size / 2)) return 0;
+    if(h) s->pos = 0;
+    s->filled[h]++;
+    s->last = h;
+    s->count++;
+    return h + 1;
+}
+
+// get the oldest half that is full and has not been used, returns NULL if there is none
+// a half that the interrupt has started to fill again is lost (it was counted as an overrun)
+uint16_t *ADCStreamTake(struct s_adcstream *s, int *half) {
+    unsigned int f;
+    int i, h;
+    for(i = 1; i >= 0; i--) {
+        h = s->last ^ i;
+        f = s->filled[h];
+        if(f != s->used[h] && s->started[h] == f) {
+            s->taken = f;
+            *half = h;
+            return s->buf + h * (s->size / 2);
+        }
+    }
+    return NULL;
+}
+
+// mark the half returned by ADCStreamTake() as used, returns true if the interrupt started to fill it again before
+// it was released (so the samples read from it may be a mix of the old and new)
+int ADCStreamRelease(struct s_adcstream *s, int half) {
+    s->used[half] = s->taken;
+    return s->started[half] != s->taken;
+}
@@ -304,6 +304,7 @@ void CloseAudio(void){
         FreeMemory(sbuff2); 
         FreeMemory(buffer);
         WAVcomplete = true;
+        IntPost(INT_WAV);
         FreeMemory(mywav);
         FSerror = 0;
     }
@@ -592,6 +593,7 @@ void __attribute__ ((optimize("-O2"))) audio_checks(void){
             FreeMemory(sbuff2);
             FileClose(WAV_fnbr);
             WAVcomplete = true;
+            IntPost(INT_WAV);
             playreadcomplete = 0;
             mywav = NULL;
         }
@@ -54,11 +54,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * Commands to interface the CAN
  * CAN OPEN index,speed,mode[,prescaler,seg1,seg2,sjw]
  * CAN CLOSE
- * CAN START
+ * CAN START [depth]
  * CAN STOP
  * CAN FILTER index,eid,type,config,id1,id2
  * CAN SEND id,eid,rtr,dlc,msg,ret
  * CAN READ fifo,id,eid,rtr,dlc,msg,fmi,ret
+ * CAN READ ARRAY fifo,n,id%(),dlc%(),data%(),count%[,timestamp%()]
+ * CAN INTERRUPT level,sub  or  CAN INTERRUPT 0
+ * CAN STATUS fifo,queued%,overflow%,overrun%
 
  * **************************************************************
  * canopen   HAS_100PINS Pin allocations  CANx     Shares pins with
@@ -117,6 +120,96 @@ CAN_RxHeaderTypeDef RxHeader;
 
 */
 char canmode=0;	  //CAN mode not set.
+
+/* Receive queues
+ * The bxCAN hardware FIFOs only hold three frames so CAN START creates a software queue of depth frames
+ * (default CANRXQUEUE) for each FIFO.  The receive ISR moves each frame into the queue as soon as it arrives
+ * and CAN READ takes them from there.  The queue itself is in CanQueue.c.  CAN START 0 reads the hardware
+ * FIFOs directly as before.
+ * The queues are lost when a program is run (CanClear() is called before the heap is cleared).
+ */
+struct s_canqueue *CanQueue[2];                     // the queues for FIFO0 and FIFO1, NULL if not used
+char *CanInterrupt;                                 // the routine to call when a queue holds CanIntLevel frames
+int CanIntLevel;
+
+// copy the next frame from a hardware FIFO, returns false if it is empty
+static int CanHwGet(int fifo, struct s_canframe *f) {
+    CAN_RxHeaderTypeDef h;
+    if(HAL_CAN_GetRxFifoFillLevel(&hcan, fifo) == 0) return false;
+    if(HAL_CAN_GetRxMessage(&hcan, fifo, &h, f->data) != HAL_OK) return false;
+    f->eid = (h.IDE != CAN_ID_STD);
+    f->id = f->eid ? h.ExtId : h.StdId;
+    f->rtr = (h.RTR == CAN_RTR_REMOTE);
+    f->dlc = f->rtr ? 0 : h.DLC;
+    f->fmi = h.FilterMatchIndex;
+    f->timestamp = h.Timestamp;
+    return true;
+}
+
+// called by CAN1_RX0_IRQHandler() and CAN1_RX1_IRQHandler() to move the frames in a hardware FIFO to its queue
+void CanReceive(int fifo) {
+    struct s_canqueue *q = CanQueue[fifo];
+    struct s_canframe f;
+    uint32_t fov = fifo ? CAN_FLAG_FOV1 : CAN_FLAG_FOV0;
+    if(q == NULL) {                                 // should not happen, but do not leave the interrupt stuck on
+        HAL_CAN_DeactivateNotification(&hcan, fifo ? CAN_IT_RX_FIFO1_MSG_PENDING : CAN_IT_RX_FIFO0_MSG_PENDING);
+        return;
+    }
+    if(__HAL_CAN_GET_FLAG(&hcan, fov)) {
+        __HAL_CAN_CLEAR_FLAG(&hcan, fov);
+        q->overrun++;
+    }
+    while(CanHwGet(fifo, &f)) CanQueuePut(q, &f);
+    if(CanInterrupt != NULL && CanQueueCount(q) >= CanIntLevel) IntPost(INT_CAN);
+}
+
+// the nbr of frames waiting to be read from a FIFO
+static int CanPending(int fifo) {
+    if(CanQueue[fifo]) return CanQueueCount(CanQueue[fifo]);
+    return HAL_CAN_GetRxFifoFillLevel(&hcan, fifo);
+}
+
+// read the next frame from a FIFO, returns false if there is none
+static int CanGet(int fifo, struct s_canframe *f) {
+    if(CanQueue[fifo]) return CanQueueGet(CanQueue[fifo], f);
+    return CanHwGet(fifo, f);
+}
+
+// turn off the receive interrupts and free the queues
+static void CanQueueClose(void) {
+    int fifo;
+    HAL_CAN_DeactivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING);
+    HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_DisableIRQ(CAN1_RX1_IRQn);
+    for(fifo = 0; fifo < 2; fifo++) FreeMemorySafe((void **)&CanQueue[fifo]);
+}
+
+// create the queues and turn on the receive interrupts
+static void CanQueueOpen(int depth) {
+    int fifo;
+    CanQueueClose();
+    if(depth == 0) return;
+    for(fifo = 0; fifo < 2; fifo++) {
+        CanQueue[fifo] = GetMemory(sizeof(struct s_canqueue) + (depth + 1) * sizeof(struct s_canframe));
+        CanQueue[fifo]->size = depth + 1;
+    }
+    HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 2, 0);
+    HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 2, 0);      // the same priority so the two ISRs cannot interrupt each other
+    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING);
+}
+
+// called before the heap is cleared when a program is run
+void CanClear(void) {
+    HAL_CAN_DeactivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING);
+    HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_DisableIRQ(CAN1_RX1_IRQn);
+    CanQueue[0] = CanQueue[1] = NULL;               // InitHeap() will recover the memory
+    CanInterrupt = NULL;
+    CanIntLevel = 0;
+}
+
 void cmd_can(void) {
 	int speed,i,cansave;
     char *p;
@@ -124,6 +217,8 @@ void cmd_can(void) {
     if(checkstring(cmdline, "CLOSE")) {
 
         /* Stop the CAN module */
+        CanQueueClose();
+        CanInterrupt = NULL;
         HAL_CAN_Stop(&hcan);
     	HAL_CAN_DeInit(&hcan);
 
@@ -142,13 +237,57 @@ void cmd_can(void) {
         return;
     }
 
-    if(checkstring(cmdline, "START")) {
+    /* CAN START [depth]
+     * Creates the receive queues (depth frames each, 0 to read the hardware FIFOs directly) and starts the module
+     */
+    if((p = checkstring(cmdline, "START")) != NULL) {
     	if (!canopen) error("CAN not open");
+    	CanQueueOpen(*p ? getint(p, 0, 4096) : CANRXQUEUE);
         /* Start the CAN module */
         HAL_CAN_Start(&hcan);
         return;
     }
 
+    /* CAN INTERRUPT level,sub  or  CAN INTERRUPT 0
+     * Calls sub when a receive queue holds level or more frames
+     */
+    if((p = checkstring(cmdline, "INTERRUPT")) != NULL) {
+    	if (!canopen) error("CAN not open");
+        getargs(&p, 3, ",");
+        if(argc == 1 && getinteger(argv[0]) == 0) {
+            CanInterrupt = NULL;
+            return;
+        }
+        if(argc != 3) error("Incorrect number of arguments");
+        if(CanQueue[0] == NULL) error("No receive queue");
+        CanIntLevel = getint(argv[0], 1, CanQueue[0]->size - 1);
+        CanInterrupt = GetIntAddress(argv[2]);
+        InterruptUsed = true;
+        return;
+    }
+
+    /* CAN STATUS fifo,queued%,overflow%,overrun%
+     * Returns the nbr of frames waiting, the nbr lost because the queue was full and the nbr lost by the hardware FIFO
+     */
+    if((p = checkstring(cmdline, "STATUS")) != NULL) {
+    	if (!canopen) error("CAN not open");
+    	int fifo;
+    	long long int *queued, *overflow, *overrun;
+        getargs(&p, 7, ",");
+        if(argc != 7) error("Incorrect number of arguments");
+        fifo = getint(argv[0], 0, 1);
+        queued = findvar(argv[2], V_FIND);
+        if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable for queued");
+        overflow = findvar(argv[4], V_FIND);
+        if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable for overflow");
+        overrun = findvar(argv[6], V_FIND);
+        if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable for overrun");
+        *queued = CanPending(fifo);
+        *overflow = CanQueue[fifo] ? CanQueue[fifo]->overflow : 0;
+        *overrun = CanQueue[fifo] ? CanQueue[fifo]->overrun : 0;
+        return;
+    }
+
     if(checkstring(cmdline, "STOP")) {
     	if (!canopen) error("CAN not open");
         /* Stop the CAN module */
@@ -228,16 +367,49 @@ void cmd_can(void) {
     }
 
 
+    /* CAN READ ARRAY fifo,n,id%(),dlc%(),data%(),count%[,timestamp%()]
+     * Reads up to n frames from the nominated Fifo in one go, count% is set to the number read.
+     * Extended ids have &H80000000 added to the id and remote frames have &H40000000 added.
+     * The data bytes are packed into each element of data%() in the same order as CAN READ.
+     */
+    if((p = checkstring(cmdline, "READ")) != NULL && (p = checkstring(p, "ARRAY")) != NULL) {
+    	 if (!canopen) error("CAN not open");
+    	 struct s_canframe f;
+    	 int i,j,n,fifo;
+    	 int64_t *id,*dlc,*data,*ts=NULL;
+    	 long long int *count;
+
+         getargs(&p, 13, ",");
+    	 if(!(argc == 11 || argc == 13)) error("Incorrect number of arguments");
+    	 fifo=getint(argv[0],0,1);
+    	 n=getint(argv[2],1,0x7FFFFFFF);
+    	 if(parseintegerarray(argv[4],&id,3,1,NULL,true) < n) error("Array too small");
+    	 if(parseintegerarray(argv[6],&dlc,4,1,NULL,true) < n) error("Array too small");
+    	 if(parseintegerarray(argv[8],&data,5,1,NULL,true) < n) error("Array too small");
+    	 count = findvar(argv[10], V_FIND);
+    	 if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable for count");
+    	 if(argc == 13 && parseintegerarray(argv[12],&ts,7,1,NULL,true) < n) error("Array too small");
+
+    	 for(i = 0; i < n && CanGet(fifo, &f); i++) {
+    		 id[i] = f.id | (f.eid ? 0x80000000 : 0) | (f.rtr ? 0x40000000 : 0);
+    		 dlc[i] = f.dlc;
+    		 data[i] = 0;
+    		 for(j = 0; j < f.dlc; j++) data[i] |= (int64_t)f.data[j] << (56 - j * 8);
+    		 if(ts) ts[i] = f.timestamp;
+    	 }
+    	 *count = i;
+    	 return;
+    }
+
     /* CAN READ fifo,id,eid,rtr,dlc,msg,fmi,ret
      * Reads one message from the nominated Fifo RXBuffer.
      * Returns 0 if no message is available, else returns the number of messages.
      */
     if((p = checkstring(cmdline, "READ")) != NULL) {
     	 if (!canopen) error("CAN not open");
-    	 uint8_t RxData[8];
+    	 struct s_canframe f;
     	 int i,fifo;
-    	 int *ret,*eid,*dlc,*rtr,*fmi;
-    	 uint32_t *id;
+    	 long long int *ret,*eid,*dlc,*rtr,*fmi,*id;
     	 uint8_t *msg;
 
          getargs(&p, 15, ",");
@@ -259,63 +431,14 @@ void cmd_can(void) {
     	 ret = findvar(argv[14], V_FIND);
     	 if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable for ret");
 
-    	 if (fifo==0){
-    	     *ret = HAL_CAN_GetRxFifoFillLevel(&hcan, CAN_RX_FIFO0);
-    	     if (*ret) {
-    	         HAL_CAN_GetRxMessage(&hcan, CAN_RX_FIFO0, &RxHeader, RxData);
-    	         // PIntH(RxHeader.Identifier);
-    	         if (RxHeader.IDE == CAN_ID_STD) {
-    	        	 *eid=0;
-    	        	 *id=RxHeader.StdId;
-    	         }else{
-    	        	 *eid=1;
-    	        	 *id=RxHeader.ExtId;
-    	         }
-    	         *dlc=(RxHeader.DLC);
-    	         if (RxHeader.RTR==CAN_RTR_REMOTE){
-    	        	 *rtr=1;
-    	        	 *dlc=0;
-    	         }else{
-    	        	 *rtr=0;
-    	         }
-
-    	         *fmi=RxHeader.FilterMatchIndex;
-    	        // PInt(*filterno);
-    	       	 // for (i=0;i<8;i++){PIntH(RxData[i]);};PRet();
-    	    	 for (i=0;i<8;i++){msg[7-i]=RxData[i];}
-    	        // *dlc=(RxHeader.DLC>>16);
-
-    	         for (i=*dlc;i<8;i++){msg[7-i]=0;}
-    	        // PInt(*ret);MMPrintString("rec0 \r\n");
-    	     }
-
-    	  }else{
-    		  /* Retrieve next message from Rx FIFO 1 */
-     	     *ret = HAL_CAN_GetRxFifoFillLevel(&hcan, CAN_RX_FIFO1);
-     	     if (*ret) {
-     	         HAL_CAN_GetRxMessage(&hcan, CAN_RX_FIFO1, &RxHeader, RxData);
-     	         // PIntH(RxHeader.Identifier);
-    	         if (RxHeader.IDE == CAN_ID_STD) {
-    	        	 *eid=0;
-    	        	 *id=RxHeader.StdId;
-    	         }else{
-    	        	 *eid=1;
-    	        	 *id=RxHeader.ExtId;
-    	         }
-    	         *dlc=(RxHeader.DLC);
-       	         if (RxHeader.RTR==CAN_RTR_REMOTE){
-        	     	*rtr=1;
-        	     	*dlc=0;
-        	     }else{
-        	       *rtr=0;
-        	     }
-    	         *fmi=RxHeader.FilterMatchIndex;
-    	         //PInt(*filterno);
-     	    	 // for (i=0;i<8;i++){PIntH(RxData[i]);};PRet();
-     	    	 for (i=0;i<8;i++){msg[7-i]=RxData[i];}
-     	         for (i=*dlc;i<8;i++){msg[7-i]=0;}
-     	        // PInt(*ret);MMPrintString("rec1 \r\n");
-     	     }
+    	 *ret = CanPending(fifo);
+    	 if (*ret && CanGet(fifo, &f)) {
+    		 *eid=f.eid;
+    		 *id=f.id;
+    		 *rtr=f.rtr;
+    		 *dlc=f.dlc;
+    		 *fmi=f.fmi;
+    		 for (i=0;i<8;i++){msg[7-i]=(i < f.dlc) ? f.data[i] : 0;}
     	 }
         return;
     }
@@ -473,7 +596,7 @@ void cmd_can(void) {
             hcan.Init.Mode = CAN_MODE_NORMAL;
         }
 
-         hcan.Init.TimeTriggeredMode = DISABLE;
+         hcan.Init.TimeTriggeredMode = ENABLE;                  // only used to timestamp the received frames
          hcan.Init.AutoBusOff = DISABLE;
          hcan.Init.AutoWakeUp = DISABLE;
          hcan.Init.AutoRetransmission = ENABLE;
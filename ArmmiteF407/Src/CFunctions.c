@@ -53,7 +53,7 @@ int CFuncRam[CFUNCRAM_SIZE/sizeof(int)];
 //extern volatile uint64_t FastTimer;
 //extern TIM_HandleTypeDef htim2;
 
-extern uint64_t TIM12count;
+extern volatile uint64_t TIM12count;
 extern TIM_HandleTypeDef htim12;
 
 extern uint32_t ticks_per_microsecond;
@@ -0,0 +1,83 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+CanQueue.c
+
+The software receive queues used by the CAN command.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024      Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+/* Receive queues
+ * A ring buffer of CAN frames filled by the receive ISR in CAN.c and emptied by CAN READ.  This file does not use
+ * the HAL or the rest of MMBasic so that the queue can be built and tested on its own with a simulated frame
+ * source (see test/can).
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "CanQueue.h"
+
+// add a frame to a queue, returns false (and counts the overflow) if the queue is full
+int CanQueuePut(struct s_canqueue *q, struct s_canframe *f) {
+    int head = q->head, next = head + 1;
+    if(next == q->size) next = 0;
+    if(next == q->tail) {
+        q->overflow++;
+        return false;
+    }
+    q->frame[head] = *f;
+    __sync_synchronize();                           // the frame must be complete before the head moves past it
+    q->head = next;
+    return true;
+}
+
+// take the oldest frame from a queue, returns false if it is empty
+int CanQueueGet(struct s_canqueue *q, struct s_canframe *f) {
+    int tail = q->tail;
+    if(tail == q->head) return false;
+    *f = q->frame[tail];
+    __sync_synchronize();                           // and it must be copied before the ISR can reuse the entry
+    q->tail = (tail + 1 == q->size) ? 0 : tail + 1;
+    return true;
+}
+
+// the nbr of frames waiting in a queue
+int CanQueueCount(struct s_canqueue *q) {
+    int n = q->head - q->tail;
+    return n < 0 ? n + q->size : n;
+}
@@ -581,10 +581,45 @@ void cmd_goto(void) {
 }
 
 
+// find the next ELSE, ELSEIF or ENDIF at the same level as the IF, ELSEIF or ELSE command that ends at from (ie, its nextstmt)
+// returns a pointer to the command token and line points to the line that it is on (used for error reporting)
+// the result is remembered in the jump cache, for an ELSEIF the line is saved too (keyed on the ELSEIF token)
+static char *FindIfTarget(char *from, char **line) {
+	int i;
+	char *p, *tp, *rp = CurrentLinePtr;
+
+	if((p = FindJumpTarget(from)) != NULL && (*p != cmdELSEIF || (*line = FindJumpTarget(p)) != NULL)) return p;
+	i = 1; p = from;
+	while(1) {
+        p = GetNextCommand(p, &rp, "No matching ENDIF");
+		if(*p == cmdIF) {
+			// found a nested IF command, we now need to determine if it is a single or multiline IF
+			// search for a THEN, then check if only white space follows.  If so, it is multiline.
+			tp = p + 1;
+			while(*tp && *tp != tokenTHEN) tp++;
+			if(*tp) tp++;											// step over the THEN
+			skipspace(tp);
+			if(*tp == 0 || *tp == '\'')								// yes, only whitespace follows
+				i++;												// count it as a nested IF
+			else													// no, it is a single line IF
+				skipelement(p);										// skip to the end so that we avoid an ELSE
+			continue;
+		}
+		if((*p == cmdELSE || *p == cmdELSEIF) && i == 1) break;	// found an ELSE or ELSEIF at the same level as our IF
+		if(*p == cmdENDIF) i--;										// found an ENDIF so decrement our nested counter
+		if(i == 0) break;											// found our matching ENDIF stmt
+	}
+	SaveJumpTarget(from, p);
+	if(*p == cmdELSEIF) SaveJumpTarget(p, rp);
+	*line = rp;
+	return p;
+}
+
+
 void cmd_if(void) {
-	int r, i, testgoto, testelseif;
+	int r, testgoto, testelseif;
 	char ss[3];														// this will be used to split up the argument line
-	char *p, *tp;
+	char *p;
 	char *rp = NULL;
 
 	ss[0] = tokenTHEN;
@@ -649,56 +684,29 @@ retest_an_if:
 			// the test returned FALSE so we are just interested in the ELSE stage (if present)
 			// first check if it is a multiline IF (ie, only 2 args)
 			if(argc == 2) {
-				// search for the next ELSE, or ENDIF and pass control to the following line
+				// jump to the next ELSE, or ENDIF and pass control to the following line
 				// if an ELSEIF is found re execute this function to evaluate the condition following the ELSEIF
-				i = 1; p = nextstmt;
-				while(1) {
-                    p = GetNextCommand(p, &rp, "No matching ENDIF");
-					if(*p == cmdtoken) {
-						// found a nested IF command, we now need to determine if it is a single or multiline IF
-						// search for a THEN, then check if only white space follows.  If so, it is multiline.
-						tp = p + 1;
-						while(*tp && *tp != ss[0]) tp++;
-						if(*tp) tp++;								// step over the THEN
-						skipspace(tp);
-						if(*tp == 0 || *tp == '\'')					// yes, only whitespace follows
-							i++;									// count it as a nested IF
-						else										// no, it is a single line IF
-							skipelement(p);							// skip to the end so that we avoid an ELSE
-						continue;
-					}
-
-					if(*p == cmdELSE && i == 1) {
-						// found an ELSE at the same level as this IF.  Step over it and continue with the statement after it
-						skipelement(p);
-						nextstmt = p;
-						break;
-					}
-
-					if((*p == cmdELSEIF/* || *p == cmdELSE_IF*/) && i == 1) {
-						// we have found an ELSEIF statement at the same level as our IF statement
-						// setup the environment to make this function evaluate the test following ELSEIF and jump back
-						// to the start of the function.  This is not very clean (it uses the dreaded goto for a start) but it works
-						p++;                                        // step over the token
-						skipspace(p);
-						CurrentLinePtr = rp;
-						if(*p == 0) error("Syntax");                // there must be a test after the elseif
-						cmdline = p;
-						skipelement(p);
-						nextstmt = p;
-						testgoto = false;
-						testelseif = true;
-						goto retest_an_if;
-					}
-
-					if(*p == cmdENDIF/* || *p == cmdEND_IF*/) i--;						// found an ENDIF so decrement our nested counter
-					if(i == 0) {
-						// found our matching ENDIF stmt.  Step over it and continue with the statement after it
-						skipelement(p);
-						nextstmt = p;
-						break;
-					}
+				// the target is found by scanning the program the first time, after that it comes from the jump cache
+				p = FindIfTarget(nextstmt, &rp);
+				if(*p == cmdELSEIF/* || *p == cmdELSE_IF*/) {
+					// we have found an ELSEIF statement at the same level as our IF statement
+					// setup the environment to make this function evaluate the test following ELSEIF and jump back
+					// to the start of the function.  This is not very clean (it uses the dreaded goto for a start) but it works
+					p++;                                        // step over the token
+					skipspace(p);
+					CurrentLinePtr = rp;
+					if(*p == 0) error("Syntax");                // there must be a test after the elseif
+					cmdline = p;
+					skipelement(p);
+					nextstmt = p;
+					testgoto = false;
+					testelseif = true;
+					goto retest_an_if;
 				}
+				// found an ELSE at the same level as this IF or our matching ENDIF stmt
+				// step over it and continue with the statement after it
+				skipelement(p);
+				nextstmt = p;
 			}
 			else {
 				// this must be a single line IF statement
@@ -726,29 +734,14 @@ retest_an_if:
 
 
 void cmd_else(void) {
-	int i;
-	char *p, *tp;
-
-	// search for the next ENDIF and pass control to the following line
-	i = 1; p = nextstmt;
+	char *p, *rp;
 
 	if(cmdtoken ==  cmdELSE) checkend(cmdline);
 
-	while(1) {
-        p = GetNextCommand(p, NULL, "No matching ENDIF");
-		if(*p == cmdIF) {
-			// found a nested IF command, we now need to determine if it is a single or multiline IF
-			// search for a THEN, then check if only white space follows.  If so, it is multiline.
-			tp = p + 1;
-			while(*tp && *tp != tokenTHEN) tp++;
-			if(*tp) tp++;											// step over the THEN
-			skipspace(tp);
-			if(*tp == 0 || *tp == '\'')								// yes, only whitespace follows
-				i++;												// count it as a nested IF
-		}
-		if(*p == cmdENDIF) i--;				    // found an ENDIF so decrement our nested counter
-		if(i == 0) break;											// found our matching ENDIF stmt
-	}
+	// jump to the next ENDIF and pass control to the following line
+	// this hops from one ELSEIF or ELSE to the next at the same level using the same targets as cmd_if()
+	for(p = FindIfTarget(nextstmt, &rp); *p != cmdENDIF; p = FindIfTarget(p, &rp))
+		skipelement(p);
 	// found a matching ENDIF.  Step over it and continue with the statement after it
 	skipelement(p);
 	nextstmt = p;
@@ -763,13 +756,283 @@ void cmd_end(void) {
 }
 
 
+// The SELECT CASE map is built the first time a SELECT CASE in program memory is executed and is saved in the jump cache
+// (keyed on the SELECT CASE's nextstmt).  It lists the CASE commands at this level so that the program does not need to
+// be scanned again, and CASE elements which are simple constants are held in a sorted table so that they can be matched
+// with a binary search rather than being evaluated one after the other.  Any CASE that is not a list of constants (eg,
+// it uses IS or TO) is flagged as dynamic and is evaluated in the normal way, but only if it comes before the CASE found
+// in the table.
+struct s_casemap {
+    char *p;                                                        // the CASE token
+    char *line;                                                     // the line it is on (for error reporting)
+    char dynamic;                                                   // true if this CASE must be evaluated
+};
+
+struct s_caseconst {
+    union {
+        long long int i;                                            // the value of an integer constant
+        MMFLOAT f;                                                  // the value of a float constant
+        unsigned int h;                                             // hash of a string constant
+    } v;
+    char *s;                                                        // for a string the text in program memory (after the quote)
+    short len;                                                      // and its length
+    short k;                                                        // the index of the CASE that it belongs to
+};
+
+struct s_selectmap {
+    struct s_selectmap *next;                                       // list of all maps so that they can be freed
+    char *caseelse;                                                 // the CASE ELSE token (or NULL if there is none)
+    char *endselect;                                                // the END SELECT token
+    int type;                                                       // type of the SELECT CASE expression used to build the table
+    int ncase, nconst;
+    struct s_casemap *cases;
+    struct s_caseconst *consts;
+};
+
+static struct s_selectmap *selectmaps = NULL;
+
+
+// free all SELECT CASE maps, this is called by ClearJumpCache() whenever the jump cache is discarded
+void SelectMapClear(void) {
+    struct s_selectmap *m;
+    while(selectmaps != NULL) {
+        m = selectmaps->next;
+        FreeMemory((void *)selectmaps);
+        selectmaps = m;
+    }
+}
+
+
+// check if the CASE element at p is a simple constant suitable for the SELECT CASE type
+// returns a pointer to the end of the element or NULL if it is not (eg, it is an expression, a range or uses IS)
+// a string containing a backslash is not treated as a constant as its value depends on OPTION ESCAPE (which can be
+// turned on after the table is built) and a number must only use the digits valid for its radix so that &B102 or &O9
+// are left to evaluate() to report
+static char *CaseConstant(char *p, int type) {
+    char *q;
+    skipspace(p);
+    if(type & T_STR) {
+        if(*p++ != '"') return NULL;
+        while(*p && *p != '"' && *p != '\\') p++;
+        if(*p++ != '"') return NULL;
+    } else {
+        if(*p == GetTokenValue("-") || *p == GetTokenValue("+")) p++;
+        if(*p == '&') {
+            p++;
+            switch(toupper(*p)) {
+                case 'H':   for(q = ++p; IsxDigit(*p); p++); break;
+                case 'O':   for(q = ++p; *p >= '0' && *p <= '7'; p++); break;
+                case 'B':   for(q = ++p; *p == '0' || *p == '1'; p++); break;
+                default:    return NULL;
+            }
+        } else
+            for(q = p; IsDigit(*p) || *p == '.'; p++);
+        if(p == q) return NULL;
+    }
+    skipspace(p);
+    if(*p != ',' && *p != 0 && *p != '\'') return NULL;
+    return p;
+}
+
+
+static unsigned int CaseHash(char *p, int len) {
+    unsigned int hash = FNV_offset_basis;
+    while(len--) {
+        hash ^= (unsigned char)*p++;
+        hash *= FNV_prime;
+    }
+    return hash;
+}
+
+
+// compare two entries in the constant table, returns <0, 0 or >0
+static int CaseCompare(struct s_caseconst *a, struct s_caseconst *b, int type) {
+    if(type & T_INT) return (a->v.i > b->v.i) - (a->v.i < b->v.i);
+    if(type & T_NBR) return (a->v.f > b->v.f) - (a->v.f < b->v.f);
+    return (a->v.h > b->v.h) - (a->v.h < b->v.h);
+}
+
+
+// build the map for the SELECT CASE command that ends at from (ie, its nextstmt)
+// returns NULL if the map cannot be built (not in program memory or not enough memory)
+static struct s_selectmap *SelectMapBuild(char *from, int type) {
+    struct s_selectmap *m;
+    struct s_caseconst c, *cp;
+    int i, j, ncase, nelem, t;
+    char *p, *q, *st, *sp, *rp = CurrentLinePtr;
+    MMFLOAT ft;
+    long long int i64t;
+
+    if(from < ProgMemory || from >= ProgMemory + PROG_FLASH_SIZE) return NULL;
+
+    // first count the CASE commands at this level and the maximum number of elements on them
+    i = 1; p = from; ncase = nelem = 0;
+    while(1) {
+        p = GetNextCommand(p, NULL, "No matching END SELECT");
+        if(*p == cmdSELECT_CASE) i++;                               // found a nested SELECT CASE command
+        if(*p == cmdCASE && i == 1) {
+            ncase++;
+            for(q = p, j = false; *q; q++) {
+                if(*q == '"') j = !j;
+                if(*q == ',' && !j) nelem++;
+            }
+            nelem++;
+        }
+        if(*p == cmdEND_SELECT) i--;
+        if(i == 0) break;
+    }
+    i = sizeof(struct s_selectmap) + ncase * sizeof(struct s_casemap) + nelem * sizeof(struct s_caseconst);
+    if(FreeSpaceOnHeap() < i * 2) return NULL;                      // do not run the program out of memory for the sake of speed
+    m = GetMemory(i);
+    m->consts = (struct s_caseconst *)(m + 1);
+    m->cases = (struct s_casemap *)(m->consts + nelem);
+    m->type = type;
+
+    // now fill in the list of CASE commands and build the table of constants
+    i = 1; p = from;
+    while(1) {
+        p = GetNextCommand(p, &rp, "No matching END SELECT");
+        if(*p == cmdSELECT_CASE) i++;
+        if(*p == cmdCASE && i == 1) {
+            m->cases[m->ncase].p = p;
+            m->cases[m->ncase].line = rp;
+            // check if the CASE is just a list of constants
+            for(q = p + 1; (q = CaseConstant(q, type)) != NULL && *q == ','; q++);
+            if(q == NULL || (*q && *q != '\'')) {
+                m->cases[m->ncase].dynamic = true;                  // no, it must be evaluated
+            } else {
+                for(q = p + 1; ; q++) {
+                    skipspace(q);
+                    st = CaseConstant(q, type);
+                    c.k = m->ncase;
+                    c.s = NULL;
+                    if(type & T_STR) {
+                        c.s = q + 1;
+                        for(c.len = 0; c.s[c.len] != '"'; c.len++);
+                        c.v.h = CaseHash(c.s, c.len);
+                    } else {
+                        t = type;
+                        evaluate(q, &ft, &i64t, &sp, &t, true);
+                        if(type & T_INT) c.v.i = i64t; else c.v.f = ft;
+                    }
+                    // insert it into the table keeping it sorted
+                    for(cp = &m->consts[m->nconst]; cp > m->consts && CaseCompare(cp - 1, &c, type) > 0; cp--) *cp = cp[-1];
+                    *cp = c;
+                    m->nconst++;
+                    q = st;
+                    if(*q != ',') break;
+                }
+            }
+            m->ncase++;
+        }
+        if(*p == cmdCASE_ELSE && i == 1) m->caseelse = p;
+        if(*p == cmdEND_SELECT) i--;
+        if(i == 0) break;
+    }
+    m->endselect = p;
+    m->next = selectmaps;
+    selectmaps = m;
+    return m;
+}
+
+
+// find the first CASE (in program order) with a constant in the table that matches the SELECT CASE value
+// returns the index of the CASE or m->ncase if there is no match
+static int SelectMapFind(struct s_selectmap *m, MMFLOAT f, long long int i64, char *s) {
+    struct s_caseconst c;
+    int lo = 0, hi = m->nconst, mid, k = m->ncase;
+    if(m->type & T_INT) c.v.i = i64;
+    else if(m->type & T_NBR) c.v.f = f;
+    else c.v.h = CaseHash(s + 1, (unsigned char)*s);
+    while(lo < hi) {
+        mid = (lo + hi) / 2;
+        if(CaseCompare(&m->consts[mid], &c, m->type) < 0) lo = mid + 1; else hi = mid;
+    }
+    // equal values are next to each other, use the earliest CASE
+    for( ; lo < m->nconst && CaseCompare(&m->consts[lo], &c, m->type) == 0; lo++)
+        if(m->consts[lo].k < k && (!(m->type & T_STR) || (m->consts[lo].len == (unsigned char)*s && memcmp(m->consts[lo].s, s + 1, m->consts[lo].len) == 0)))
+            k = m->consts[lo].k;
+    return k;
+}
+
+
+// evaluate the elements of the CASE command at p (pointing to the token) against the SELECT CASE value
+// returns true if one matches, nextstmt is then set to the end of the CASE command
+static int CaseMatch(char *p, int type, MMFLOAT f, long long int i64, char *s) {
+    int t;
+    MMFLOAT ft, ftt;
+    long long int i64t, i64tt;
+    char *st, *stt, *is;
+
+    // loop through the comparison elements on the CASE line.  Each element is separated by a comma
+    do {
+        p++;
+        skipspace(p);
+        t = type;
+        // check for CASE IS,  eg  CASE IS > 5  -or-  CASE > 5  and process it if it is
+        // an operator can be >, <>, etc but it can also be a prefix + or - so we must not catch them
+        if((is = checkstring(p, "IS")) || ((tokentype(*p) & T_OPER) && !(*p == GetTokenValue("+") || *p == GetTokenValue("-")))) {
+            int o;
+            if(is) p += 2;
+            skipspace(p);
+            if(tokentype(*p) & T_OPER)
+                o = *p++ - C_BASETOKEN;                             // get the operator
+            else
+                error("Syntax");
+            if(type & T_NBR) ft = f;
+            if(type & T_INT) i64t = i64;
+            if(type & T_STR) st = s;
+            while(o != E_END) p = doexpr(p, &ft, &i64t, &st, &o, &t); // get the right hand side of the expression and evaluate the operator in o
+            if(!(t & T_INT)) error("Syntax");     			        // comparisons must always return an integer
+            if(i64t) {                                              // evaluates to true
+                skipelement(p);
+                nextstmt = p;
+                return true;                                        // if we have a match just return to the interpreter and let it execute the code
+            } else {                                                // evaluates to false
+                skipspace(p);
+                continue;
+            }
+        }
+
+        // it must be either a single value (eg, "foo") or a range (eg, "foo" TO "zoo")
+        // evaluate the first value
+        p = evaluate(p, &ft, &i64t, &st, &t, true);
+        skipspace(p);
+        if(*p == tokenTO) {                      			        // is there is a TO keyword?
+            p++;
+            t = type;
+            p = evaluate(p, &ftt, &i64tt, &stt, &t, false);         // evaluate the right hand side of the TO expression
+            if(((type & T_NBR) && f >= ft && f <= ftt) || ((type & T_INT) && i64 >= i64t && i64 <= i64tt) || (((type & T_STR) && Mstrcmp(s, st) >= 0) && (Mstrcmp(s, stt) <= 0))) {
+                skipelement(p);
+                nextstmt = p;
+                return true;                                        // if we have a match just return to the interpreter and let it execute the code
+            } else {
+                skipspace(p);
+                continue;                                           // otherwise continue searching
+            }
+        }
+
+        // if we got to here the element must be just a single match.  So make the test
+        if(((type & T_NBR) && f == ft) ||  ((type & T_INT) && i64 == i64t) ||  ((type & T_STR) && Mstrcmp(s, st) == 0)) {
+            skipelement(p);
+            nextstmt = p;
+            return true;                                            // if we have a match just return to the interpreter and let it execute the code
+        }
+        skipspace(p);
+    } while(*p == ',');                                             // keep looping through the elements on the CASE line
+    checkend(p);
+    return false;
+}
+
+
 void cmd_select(void) {
-    int i, type;
+    int i, k, type;
     char *p, *rp = NULL, *SaveCurrentLinePtr;
     void *v;
     MMFLOAT f = 0;
     long long int i64 = 0;
     char s[STRINGSIZE];
+    struct s_selectmap *m;
 
     // these are the tokens that we will be searching for
     // they are cached the first time this command is called
@@ -780,10 +1043,45 @@ void cmd_select(void) {
     if(type & T_NBR) f = *(MMFLOAT *)v;
     if(type & T_INT) i64 = *(long long int *)v;
     if(type & T_STR) Mstrcpy(s, (char *)v);
+    SaveCurrentLinePtr = CurrentLinePtr;                            // save where we are because we will have to fake CurrentLinePtr to get errors reported correctly
 
-    // now search through the program looking for a matching CASE statement
+    // use the map of this SELECT CASE, it is built on the first execution
+    if((m = (struct s_selectmap *)FindJumpTarget(nextstmt)) == NULL && (m = SelectMapBuild(nextstmt, type)) != NULL) {
+        SaveJumpTarget(nextstmt, (char *)m);
+        if(FindJumpTarget(nextstmt) == NULL) {                      // the jump cache is full so it cannot be reused
+            selectmaps = m->next;
+            FreeMemory((void *)m);
+            m = NULL;
+        }
+    }
+    if(m != NULL) {
+        // look up the constants first then evaluate any other CASE commands that come before the one found
+        // if the type of the SELECT CASE value has changed the table cannot be used so evaluate everything
+        k = (m->type == type) ? SelectMapFind(m, f, i64, s) : m->ncase;
+        for(i = 0; i < k; i++) {
+            if(m->cases[i].dynamic || m->type != type) {
+                CurrentLinePtr = m->cases[i].line;                  // and report errors at the line we are on
+                if(CaseMatch(m->cases[i].p, type, f, i64, s)) {
+                    CurrentLinePtr = SaveCurrentLinePtr;
+                    return;                                         // if we have a match just return to the interpreter and let it execute the code
+                }
+            }
+        }
+        CurrentLinePtr = SaveCurrentLinePtr;
+        if(k < m->ncase)
+            p = m->cases[k].p;                                      // matched a constant
+        else if(m->caseelse != NULL) {
+            p = m->caseelse + 1;                                    // no match so execute the CASE ELSE
+            checkend(p);
+        } else
+            p = m->endselect;                                       // or continue after the END SELECT
+        skipelement(p);
+        nextstmt = p;
+        return;
+    }
+
+    // there is no map (eg, this is at the command prompt) so search through the program looking for a matching CASE statement
     // i tracks the nesting level of any nested SELECT CASE commands
-    SaveCurrentLinePtr = CurrentLinePtr;                            // save where we are because we will have to fake CurrentLinePtr to get errors reported correctly
     i = 1; p = nextstmt;
     while(1) {
         p = GetNextCommand(p, &rp, "No matching END SELECT");
@@ -792,74 +1090,13 @@ void cmd_select(void) {
 
         // is this a CASE stmt at the same level as this SELECT CASE.
         if(*p == cmdCASE && i == 1) {
-            int t;
-            MMFLOAT ft, ftt;
-            long long int i64t, i64tt;
-            char *st, *stt;
-
             CurrentLinePtr = rp;                                    // and report errors at the line we are on
-
-            // loop through the comparison elements on the CASE line.  Each element is separated by a comma
-            do {
-                p++;
-                skipspace(p);
-                t = type;
-                // check for CASE IS,  eg  CASE IS > 5  -or-  CASE > 5  and process it if it is
-                // an operator can be >, <>, etc but it can also be a prefix + or - so we must not catch them
-                if((SaveCurrentLinePtr = checkstring(p, "IS")) || ((tokentype(*p) & T_OPER) && !(*p == GetTokenValue("+") || *p == GetTokenValue("-")))) {
-                    int o;
-                    if(SaveCurrentLinePtr) p += 2;
-                    skipspace(p);
-                    if(tokentype(*p) & T_OPER)
-                        o = *p++ - C_BASETOKEN;                     // get the operator
-                    else
-                        error("Syntax");
-                    if(type & T_NBR) ft = f;
-                    if(type & T_INT) i64t = i64;
-                    if(type & T_STR) st = s;
-                    while(o != E_END) p = doexpr(p, &ft, &i64t, &st, &o, &t); // get the right hand side of the expression and evaluate the operator in o
-                    if(!(t & T_INT)) error("Syntax");     			// comparisons must always return an integer
-                    if(i64t) {                                      // evaluates to true
-                        skipelement(p);
-                        nextstmt = p;
-                        CurrentLinePtr = SaveCurrentLinePtr;
-                        return;                                     // if we have a match just return to the interpreter and let it execute the code
-                    } else {                                        // evaluates to false
-                        skipspace(p);
-                        continue;
-                    }
-                }
-
-                // it must be either a single value (eg, "foo") or a range (eg, "foo" TO "zoo")
-                // evaluate the first value
-                p = evaluate(p, &ft, &i64t, &st, &t, true);
-                skipspace(p);
-                if(*p == tokenTO) {                      			// is there is a TO keyword?
-                    p++;
-                    t = type;
-                    p = evaluate(p, &ftt, &i64tt, &stt, &t, false); // evaluate the right hand side of the TO expression
-                    if(((type & T_NBR) && f >= ft && f <= ftt) || ((type & T_INT) && i64 >= i64t && i64 <= i64tt) || (((type & T_STR) && Mstrcmp(s, st) >= 0) && (Mstrcmp(s, stt) <= 0))) {
-                        skipelement(p);
-                        nextstmt = p;
-                        CurrentLinePtr = SaveCurrentLinePtr;
-                        return;                                     // if we have a match just return to the interpreter and let it execute the code
-                    } else {
-                        skipspace(p);
-                        continue;                                   // otherwise continue searching
-                    }
-                }
-
-                // if we got to here the element must be just a single match.  So make the test
-                if(((type & T_NBR) && f == ft) ||  ((type & T_INT) && i64 == i64t) ||  ((type & T_STR) && Mstrcmp(s, st) == 0)) {
-                    skipelement(p);
-                    nextstmt = p;
-                    CurrentLinePtr = SaveCurrentLinePtr;
-                    return;                                         // if we have a match just return to the interpreter and let it execute the code
-                }
-                skipspace(p);
-            } while(*p == ',');                                     // keep looping through the elements on the CASE line
-            checkend(p);
+            if(CaseMatch(p, type, f, i64, s)) {
+                CurrentLinePtr = SaveCurrentLinePtr;
+                return;                                             // if we have a match just return to the interpreter and let it execute the code
+            }
             CurrentLinePtr = SaveCurrentLinePtr;
+            continue;
         }
 
         // test if we have found a CASE ELSE statement at the same level as this SELECT CASE
@@ -887,26 +1124,28 @@ void cmd_select(void) {
 
 
 // if we have hit a CASE or CASE ELSE we must search for a END SELECT at this level and resume at that point
+// this is only done the first time, after that the location is remembered in the jump cache
 void cmd_case(void) {
     int i;
     char *p;
 
-    // search through the program looking for a END SELECT statement
-    // i tracks the nesting level of any nested SELECT CASE commands
-    i = 1; p = nextstmt;
-    while(1) {
-        p = GetNextCommand(p, NULL, "No matching END SELECT");
+    if((p = FindJumpTarget(nextstmt)) == NULL) {
+        // search through the program looking for a END SELECT statement
+        // i tracks the nesting level of any nested SELECT CASE commands
+        i = 1; p = nextstmt;
+        while(1) {
+            p = GetNextCommand(p, NULL, "No matching END SELECT");
 
-        if(*p == cmdSELECT_CASE) i++;                               // found a nested SELECT CASE command, we now need to search for its END CASE
+            if(*p == cmdSELECT_CASE) i++;                           // found a nested SELECT CASE command, we now need to search for its END CASE
 
-        if(*p == cmdEND_SELECT) i--;                                // found an END SELECT so decrement our nested counter
-        if(i == 0) {
-            // found our matching END SELECT stmt.  Step over it and continue with the statement after it
-            skipelement(p);
-            nextstmt = p;
-            break;
+            if(*p == cmdEND_SELECT) i--;                            // found an END SELECT so decrement our nested counter
+            if(i == 0) break;                                       // found our matching END SELECT stmt
         }
+        SaveJumpTarget(nextstmt, p);
     }
+    // step over it and continue with the statement after it
+    skipelement(p);
+    nextstmt = p;
 }
 
 
@@ -1084,25 +1323,27 @@ void cmd_for(void) {
         forstack[forindex].forptr = nextstmt + 1;                   // return to here when looping
 
         // now find the matching NEXT command
-        t = 1; p = nextstmt;
-        while(1) {
-              p = GetNextCommand(p, &tp, "No matching NEXT");
-//            if(*p == fortoken) t++;                                 // count the FOR
-//            if(*p == nexttoken) {                                   // is it NEXT
-            if(*p == cmdFOR) t++;                                 // count the FOR
-            if(*p == cmdNEXT) {                                   // is it NEXT
-                xp = p + 1;                                         // point to after the NEXT token
-                while(*xp && strncasecmp(xp, vname, vlen)) xp++;    // step through looking for our variable
-                if(*xp && !isnamechar((uint8_t)xp[vlen]))                    // is it terminated correctly?
-                    t = 0;                                          // yes, found the matching NEXT
-                else
-                    t--;                                            // no luck, just decrement our stack counter
-            }
-            if(t == 0) {                                            // found the matching NEXT
-                forstack[forindex].nextptr = p;                     // pointer to the start of the NEXT command
-                break;
+        // this is only done the first time, after that the location is remembered in the jump cache
+        if((p = FindJumpTarget(nextstmt)) == NULL) {
+            t = 1; p = nextstmt;
+            while(1) {
+                  p = GetNextCommand(p, &tp, "No matching NEXT");
+//                if(*p == fortoken) t++;                             // count the FOR
+//                if(*p == nexttoken) {                               // is it NEXT
+                if(*p == cmdFOR) t++;                               // count the FOR
+                if(*p == cmdNEXT) {                                 // is it NEXT
+                    xp = p + 1;                                     // point to after the NEXT token
+                    while(*xp && strncasecmp(xp, vname, vlen)) xp++;// step through looking for our variable
+                    if(*xp && !isnamechar((uint8_t)xp[vlen]))       // is it terminated correctly?
+                        t = 0;                                      // yes, found the matching NEXT
+                    else
+                        t--;                                        // no luck, just decrement our stack counter
+                }
+                if(t == 0) break;                                   // found the matching NEXT
             }
+            SaveJumpTarget(nextstmt, p);
         }
+        forstack[forindex].nextptr = p;                             // pointer to the start of the NEXT command
 
           // test the loop value at the start
           if(forstack[forindex].vartype & T_INT)
@@ -1148,7 +1389,8 @@ void cmd_next(void) {
     } else {
         // if no variables specified search the for stack looking for an entry with the same program position as
         // this NEXT statement. This cheats by using the cmdline as an identifier and may not work inside an IF THEN ELSE
-        for(i = 0; i < forindex; i++) {
+        // the search starts at the top of the stack as the innermost loop is the most likely match
+        for(i = forindex - 1; i >= 0; i--) {
             p = forstack[i].nextptr + 1;
             skipspace(p);
             if(p == cmdline) goto breakout;
@@ -1237,17 +1479,18 @@ void cmd_do(void) {
     dostack[doindex].level = LocalIndex;
 
     // now find the matching LOOP command
-    i = 1; p = nextstmt;
-    while(1) {
-        p = GetNextCommand(p, &tp, "No matching LOOP");
-        if(*p == cmdtoken) i++;                                     // entered a nested DO or WHILE loop
-        if(*p == cmdLOOP) i--;                                    // exited a nested loop
-
-        if(i == 0) {                                                // found our matching LOOP or WEND stmt
-            dostack[doindex].loopptr = p;
-            break;
+    // this is only done the first time, after that the location is remembered in the jump cache
+    if((p = FindJumpTarget(nextstmt)) == NULL) {
+        i = 1; p = nextstmt;
+        while(1) {
+            p = GetNextCommand(p, &tp, "No matching LOOP");
+            if(*p == cmdtoken) i++;                                 // entered a nested DO or WHILE loop
+            if(*p == cmdLOOP) i--;                                  // exited a nested loop
+            if(i == 0) break;                                       // found our matching LOOP or WEND stmt
         }
+        SaveJumpTarget(nextstmt, p);
     }
+    dostack[doindex].loopptr = p;
 
     if(dostack[doindex].evalptr != NULL) {
         // if this is a DO WHILE ... LOOP statement
@@ -1278,7 +1521,8 @@ void cmd_loop(void) {
     int i;
 
     // search the do table looking for an entry with the same program position as this LOOP statement
-    for(i = 0; i < doindex ;i++) {
+    // the search starts at the top of the stack as the innermost loop is the most likely match
+    for(i = doindex - 1; i >= 0; i--) {
         p = dostack[i].loopptr + 1;
         skipspace(p);
         if(p == cmdline) {
@@ -2068,6 +2312,7 @@ void MIPS16 cmd_erase(void) {
             if(!(len == 0 && (*x == 0 || strlen(p) == MAXVARLEN))) continue;
     		// found the variable
 			if(((vartbl[j].type & T_STR) || vartbl[j].dims[0] != 0) && !(vartbl[j].type & T_PTR)) {
+				ADCStreamVarFreed(vartbl[j].val.s);                 // stop ADC STREAM if this is its buffer
 				FreeMemory(vartbl[j].val.s);                        // free any memory (if allocated)
 				vartbl[j].val.s=NULL;
 			}
@@ -2083,6 +2328,7 @@ void MIPS16 cmd_erase(void) {
 			vartbl[j].dims[0] = 0;                                    // and again
 			vartbl[j].level = 0;
 			Globalvarcnt--;
+			VarGenGlobal++;                                           // invalidate the variable cache
 			break;
 		}
 		if(j == MAXVARS) error("Cannot find $", p);
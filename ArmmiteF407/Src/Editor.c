@@ -181,6 +181,22 @@ int insert;							// true if the editor is in insert text mode
 int tempx;							// used to track the prefered x position when up/down arrowing
 int TextChanged;                    // true if the program has been modified and therefor a save might be required
 
+// the line index and screen row cache live at the top of the edit buffer
+// EdIndex[n] is the offset of the start of line n * EDITINDEXSTEP and EdIndexMulti[n] is the multi-line comment state at that point
+// only the first EdIndexValid entries are correct, an edit invalidates the entries from the edited line onwards
+// and they are rebuilt on demand by findLine()
+struct s_edrow {
+    unsigned int hash;                                              // hash of the text and colour state that was drawn on this screen row
+    char valid;                                                     // true if the hash reflects what is on the screen
+    char before, after;                                             // the value of multilinecomment before and after the row was drawn
+};
+static char *EdBuffEnd;                                             // end of the space available for text in EdBuff
+static int *EdIndex;
+static char *EdIndexMulti;
+static int EdIndexValid;
+static struct s_edrow *EdRow;                                       // one entry for each row in the editing area
+static int multilinecomment = false;                                // colour coding state carried from one line to the next by SetColour()
+
 #define EDIT	1					// used to select the status line string
 #define MARK	2
 
@@ -201,6 +217,8 @@ void Scroll(void);
 void ScrollDown(void);
 void MarkMode(char *cb, char *buf);
 void PositionCursor(char *curp);
+static void EdIndexChanged(char *p);
+static void EdRowsClear(void);
 
 
 // edit command:
@@ -222,6 +240,14 @@ void cmd_edit(void) {
     EdBuff = GetTempMemory(EDIT_BUFFER_SIZE);
     *EdBuff = 0;
     VHeight = Option.Height - 2;
+    // carve the line index and row cache from the top of the buffer
+    EdIndex = (int *)(((unsigned int)EdBuff + EDIT_BUFFER_SIZE - EDITINDEXSIZE * (sizeof(int) + 1) - VHeight * sizeof(struct s_edrow)) & ~3);
+    EdRow = (struct s_edrow *)(EdIndex + EDITINDEXSIZE);
+    EdIndexMulti = (char *)(EdRow + VHeight);
+    EdBuffEnd = (char *)EdIndex;
+    EdIndexValid = 0;
+    multilinecomment = false;
+    EdRowsClear();
 	VWidth = Option.Width;
 	edx = edy = curx = cury = y = x = tempx = 0;
 	txtp = EdBuff;
@@ -246,6 +272,7 @@ void cmd_edit(void) {
                 }
             }
             nbrlines++;
+            if(p + STRINGSIZE + 2 >= EdBuffEnd) error("Not enough memory");  // the line index and row cache are above EdBuffEnd
             fromp = llist(p, fromp);                                // otherwise expand the line
             p += strlen(p);
             *p++ = '\n'; *p = 0;
@@ -446,7 +473,7 @@ void FullScreenEditor(void) {
 							p = txtp;
 							c = *p;
 	                          currdel=*p;
-	                          if(p!=EdBuff+EDIT_BUFFER_SIZE-1)nextdel=p[1];
+	                          if(p!=EdBuffEnd-1)nextdel=p[1];
 	                          else nextdel=0;
 	                          if(p!=EdBuff){
 	                          lastdel=*(--p);
@@ -456,6 +483,7 @@ void FullScreenEditor(void) {
 								p[0] = p[1];
 								p++;
 							}
+							EdIndexChanged(txtp);
 							if(c == '\n') {
 								printScreen();
 								nbrlines--;
@@ -481,6 +509,7 @@ void FullScreenEditor(void) {
 								txtp = EdBuff;
 								MMPrintString("\033[2J\033[H");						// vt100 clear screen and home cursor
                                 MX470Display(DISPLAY_CLS);                          // clear screen on the MX470 display only
+								EdRowsClear();
 								printScreen();
 								PrintFunctKeys(EDIT);
     							PositionCursor(txtp);
@@ -663,6 +692,7 @@ void FullScreenEditor(void) {
 				// Mark
                 case CTRLKEY('T'):
 				case F4:  	MarkMode(clipboard, &buf[1]);
+							EdRowsClear();									// mark mode has drawn over the screen
 							printScreen();
 							PrintFunctKeys(EDIT);
 							PositionCursor(txtp);
@@ -681,6 +711,7 @@ void FullScreenEditor(void) {
 				// F6 to F12 - Normal function keys
 				//case CTRLKEY('B'):
 				case F6:
+                    EdRowsClear();                                          // force everything to be redrawn
                     printScreen();
                     break;
 
@@ -703,8 +734,10 @@ void FullScreenEditor(void) {
 							if(insert || *txtp == '\n' || *txtp == 0) {
 								//if(!editInsertChar(c)) break;						// insert it
 								if(!editInsertChar(c, &multi)) break;               // insert it
-							} else
+							} else {
+								EdIndexChanged(txtp);
 								*txtp++ = c;										// or just overtype
+							}
                                 printLine(edy + cury);                              // redraw the whole line so that colour coding will occur
 							PositionCursor(txtp);
 							// SCursor(x, cury);
@@ -729,10 +762,17 @@ void FullScreenEditor(void) {
 
 
 void PositionCursor(char *curp) {
-	int ln, col;
+	int ln, col, k;
 	char *p;
 
-	for(p = EdBuff, ln = col = 0; p < curp; p++) {
+	// start counting from the closest line in the index that is before the cursor
+	for(k = EdIndexValid - 1; k > 0 && EdBuff + EdIndex[k] > curp; k--);
+	p = EdBuff; ln = col = 0;
+	if(k > 0) {
+		p += EdIndex[k];
+		ln = k * EDITINDEXSTEP;
+	}
+	for( ; p < curp; p++) {
 		if(*p == '\n') {
 			ln++;
 			col = 0;
@@ -866,6 +906,7 @@ void MarkMode(char *cb, char *buf) {
 						for(p = txtp; p < mark; p++) if(*p == '\n') nbrlines--;
 						for(p = txtp; *mark; ) *p++ = *mark++;
 						*p++ = 0; *p++ = 0;
+						EdIndexChanged(txtp);
 						TextChanged = true;
 						PositionCursor(txtp);
 						return;
@@ -934,24 +975,61 @@ void MarkMode(char *cb, char *buf) {
 
 
 
+// work out the multi-line comment state at the start of the line at p
+// multi is the state at the start of the previous line and first is true if this is the first line in the buffer
+static int EdLineMulti(char *p, int multi, int first) {
+    if(multi == 2) multi = false;
+    skipspace(p);
+    if(p[0]=='/' && p[1]=='*') multi = true;
+    if(p[0]=='*' && p[1]=='/') multi = first ? false : 2;
+    return multi;
+}
+
+
+// called whenever the text at p has been changed
+// this discards the index entries from the start of the edited line onwards so that they will be rebuilt
+static void EdIndexChanged(char *p) {
+    while(p > EdBuff && p[-1] != '\n') p--;
+    while(EdIndexValid > 0 && EdBuff + EdIndex[EdIndexValid - 1] >= p) EdIndexValid--;
+}
+
+
 // search through the text in the editing buffer looking for a specific line
 // enters with ln = the line required
 // exits pointing to the start of the line or pointing to a zero char if not that many lines in the buffer
+// the search starts from the nearest entry in the line index which is extended as far as necessary
 char *findLine(int ln, int *inmulti) {
-    char *p, *q;
-    *inmulti=false;
-    p = q = EdBuff;
-    skipspace(q);
-    if(q[0]=='/' && q[1]=='*') *inmulti=true;
-    if(q[0]=='*' && q[1]=='/') *inmulti=false;
+    char *p;
+    int k, n, multi;
+
+    k = ln / EDITINDEXSTEP;
+    if(k >= EDITINDEXSIZE) k = EDITINDEXSIZE - 1;
+    while(EdIndexValid <= k) {
+        if(EdIndexValid == 0) {
+            EdIndex[0] = 0;
+            EdIndexMulti[0] = EdLineMulti(EdBuff, false, true);
+        } else {
+            p = EdBuff + EdIndex[EdIndexValid - 1];
+            multi = EdIndexMulti[EdIndexValid - 1];
+            for(n = EDITINDEXSTEP; n && *p; p++)
+                if(*p == '\n') {
+                    n--;
+                    multi = EdLineMulti(p + 1, multi, false);
+                }
+            if(n) break;                                            // there are no more lines to index
+            EdIndex[EdIndexValid] = p - EdBuff;
+            EdIndexMulti[EdIndexValid] = multi;
+        }
+        EdIndexValid++;
+    }
+    if(k >= EdIndexValid) k = EdIndexValid - 1;
+    p = EdBuff + EdIndex[k];
+    *inmulti = EdIndexMulti[k];
+    ln -= k * EDITINDEXSTEP;
 	while(ln && *p) {
 		if(*p == '\n') {
-		    if(*inmulti==2)*inmulti=false;
 		    ln--;
-		    q=&p[1];
-		    skipspace(q);
-		    if(q[0]=='/' && q[1]=='*') *inmulti=true;
-		    if(q[0]=='*' && q[1]=='/') *inmulti=2;
+		    *inmulti = EdLineMulti(p + 1, *inmulti, false);
 		}
 		p++;
 	}
@@ -959,6 +1037,24 @@ char *findLine(int ln, int *inmulti) {
 }
 
 
+// hash everything that affects how a line is drawn, this is used by printScreen() to skip rows that have not changed
+static unsigned int EdRowHash(char *p, int inmulti) {
+    unsigned int h = 2166136261u;
+    h = (h ^ inmulti) * 16777619u;
+    h = (h ^ multilinecomment) * 16777619u;
+    h = (h ^ edx) * 16777619u;
+    while(*p && *p != '\n') h = (h ^ (unsigned char)*p++) * 16777619u;
+    return h;
+}
+
+
+// mark every row on the screen as needing to be redrawn
+static void EdRowsClear(void) {
+    int i;
+    for(i = 0; i < VHeight; i++) EdRow[i].valid = false;
+}
+
+
 int EditCompStr(char *p, char *tkn) {
     while(*tkn && (toupper(*tkn) == toupper(*p))) {
         if(*tkn == '(' && *p == '(') return true;
@@ -982,7 +1078,6 @@ void SetColour(char *p, int DoVT100) {
     char **pp;
     static int intext = false;
     static int incomment = false;
-    static int multilinecomment = false;
     static int inkeyword = false;
     static char *twokeyword = NULL;
     static int inquote = false;
@@ -1175,6 +1270,15 @@ void printLine(int ln) {
 	char *p;
 	int i;
 	int inmulti=false;
+	int row = ln - edy;
+
+    // record what is being drawn on this row so that printScreen() can tell if it needs redrawing
+    if(row >= 0 && row < VHeight) {
+        p = findLine(ln, &inmulti);
+        EdRow[row].hash = EdRowHash(p, inmulti);
+        EdRow[row].before = multilinecomment;
+        EdRow[row].valid = false;
+    }
 
     // we always colour code the output to the LCD panel on the MX470 (when used as the console)
     if(Option.DISPLAY_CONSOLE) {
@@ -1221,23 +1325,37 @@ void printLine(int ln) {
 	MMPrintString("\033[K");                                        // all done, clear to the end of the line on a vt100 emulator
     if(Option.ColourCode) SetColour(NULL, true);
 	curx = VWidth - 1;
+    if(row >= 0 && row < VHeight) {
+        EdRow[row].after = multilinecomment;
+        EdRow[row].valid = true;
+    }
 }
 
 
 
 // print a full screen starting with the top left corner specified by edx, edy
 // this draws the full screen including blank areas so there is no need to clear the screen first
+// rows that already show the correct text in the correct colours are skipped
 // it then returns the cursor to its original position
 void printScreen(void) {
-	int i;
-	SCursor(0, 0);
+	int i, inmulti, skipped = true;
+	char *p;
 	for(i = 0; i <VHeight; i++) {
+		p = findLine(i + edy, &inmulti);
+		if(EdRow[i].valid && EdRow[i].before == multilinecomment && EdRow[i].hash == EdRowHash(p, inmulti)) {
+			multilinecomment = EdRow[i].after;						// carry on as if we had drawn it
+			skipped = true;
+			continue;
+		}
+		if(skipped) SCursor(0, i);									// jump over the unchanged rows
+		skipped = false;
 		printLine(i + edy);
         PRet();
         //MX470PutS("\r\n", gui_fcolour, gui_bcolour);   //Fix for double spacing in edit mode.   Gerry 27/08/2023
 		curx = 0;
 		cury = i + 1;
 	}
+	if(skipped) SCursor(0, VHeight);								// leave the cursor where a full redraw would
 	while(MMInkey() != -1);											// consume any keystrokes accumulated while redrawing the screen
 }
 
@@ -1262,11 +1380,12 @@ int editInsertChar( char c, char *multi) {
 	char *p;
 
 	for(p = EdBuff; *p; p++);										// find the end of the text in memory
-	if(p >= EdBuff + EDIT_BUFFER_SIZE - 10) {                       // and check that we have the space (allow 10 bytes for slack)
+	if(p >= EdBuffEnd - 10) {                                       // and check that we have the space (allow 10 bytes for slack)
 		editDisplayMsg(" OUT OF MEMORY ");
 		return false;
 	}
 	for(; p >= txtp; p--) *(p + 1) = *p;							// shift everything down
+	EdIndexChanged(txtp);
     *multi=0;
     p=txtp-1;
     if((c=='/' && *p=='*') || (c=='*' && *p=='/') )*multi=1;
@@ -1414,6 +1533,7 @@ void GetInputString(char *prompt) {
 // scroll up the video screen
 void Scroll(void) {
 	edy++;
+	memmove(EdRow, EdRow + 1, (VHeight - 1) * sizeof(struct s_edrow));   // the rows move up with the text
     SCursor(0, VHeight);
     MMPrintString("\033[J\033[99B\n");                              // clear to end of screen, move to the end of the screen and force a scroll of one line
     MX470Cursor(0, VHeight * gui_font_height);
@@ -1433,6 +1553,7 @@ void ScrollDown(void) {
     SCursor(0, VHeight);                                            // go to the end of the editing area
     MMPrintString("\033[J");                                        // clear to end of screen
 	edy--;
+	memmove(EdRow + 1, EdRow, (VHeight - 1) * sizeof(struct s_edrow));   // the rows move down with the text
 	SCursor(0, 0);
     MMPrintString("\033M");                                         //scroll window down one line
     MX470Scroll(-gui_font_height);
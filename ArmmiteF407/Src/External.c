@@ -1578,6 +1578,7 @@ void ClearExternalIO(void) {
 	}
 	InterruptReturn = NULL;
 	InterruptUsed = false;
+	InterruptClear();                                               // reset the interrupt priorities and statistics
     OnKeyGOSUB = NULL;
     KeyInterrupt=NULL;
     keyselect=0;
@@ -65,6 +65,7 @@ FILINFO fno;
 char FileGetChar(int fnbr);
 char FilePutChar(char c, int fnbr);
 int FileEOF(int fnbr);
+static int FileWriteBuffer(int fnbr);
 char *GetCWD(void);
 void File_CloseAll(void);
 int InitSDCard(void);
@@ -85,6 +86,13 @@ int buffpointer[MAXOPENFILES+1]={0};
 static uint32_t lastfptr[MAXOPENFILES+1]={[0 ... MAXOPENFILES ] = -1};
 uint32_t fmode[MAXOPENFILES+1]={0};
 static unsigned int bw[MAXOPENFILES+1]={[0 ... MAXOPENFILES ] = -1};
+// files opened for writing use SDbuffer[] as a write-behind buffer, wbcount[] is the nbr of chars waiting to be written
+// the buffer is flushed when it is full, on CLOSE, SEEK, LOC(), LOF(), EOF() and any read from the file, and by
+// CheckSDCard() once FileFlushTimer (incremented every mSec) has reached FileFlushTime
+#define FileFlushTime 1000
+static int wbcount[MAXOPENFILES+1]={0};
+static int wberror[MAXOPENFILES+1]={0};                             // an error from a timed flush, reported by the next write, flush or close
+volatile unsigned int FileFlushTimer=0;
 
 extern RTC_HandleTypeDef hrtc;
 #define overlap (VRes % (FontTable[gui_font >> 4][1] * (gui_font & 0b1111)) ? 0 : 1)
@@ -457,6 +465,7 @@ void cmd_seek(void) {
     idx = getinteger(argv[2]) - 1;
     if(idx < 0) idx = 0;
     if(fmode[fnbr] & FA_WRITE){
+        FileFlush(fnbr);
         FSerror = f_lseek(FileTable[fnbr].fptr,idx);
         ErrorCheck(fnbr);
     } else {
@@ -721,6 +730,8 @@ int BasicFileOpen(char *fname, int fnbr, int mode) {
 	buffpointer[fnbr]=0;
 	lastfptr[fnbr]=-1;
 	bw[fnbr]=-1;
+	wbcount[fnbr]=0;
+	wberror[fnbr]=0;
 	fmode[fnbr]=mode;
 
     if(FSerror) {
@@ -743,24 +754,78 @@ void FileClose(int fnbr) {
 // it will NOT generate an error
 void ForceFileClose(int fnbr) {
     if(fnbr && FileTable[fnbr].fptr != NULL){
+        int e = FileWriteBuffer(fnbr);
+        if(e == 0) e = wberror[fnbr];                               // or from an earlier timed flush
+        wberror[fnbr] = 0;
         FSerror = f_close(FileTable[fnbr].fptr);
+        if(e) FSerror = e;                                          // report the error from writing the buffer
         FreeMemory(FileTable[fnbr].fptr);
         FreeMemory(SDbuffer[fnbr]);
         FileTable[fnbr].fptr = NULL;
         buffpointer[fnbr]=0;
         lastfptr[fnbr]=-1;
         bw[fnbr]=-1;
+        wbcount[fnbr]=0;
         fmode[fnbr]=0;
     }
 }
 
 
+// write out anything waiting in the write-behind buffer
+// this will NOT generate an error, it returns the error code from the file system
+static int FileWriteBuffer(int fnbr) {
+    unsigned int nbr;
+    int e = 0;
+    if(wbcount[fnbr]) {
+        e = f_write(FileTable[fnbr].fptr, SDbuffer[fnbr], wbcount[fnbr], &nbr);
+        if(e == FR_OK && nbr != wbcount[fnbr]) e = FR_DENIED;       // the disk is full
+        wbcount[fnbr] = 0;
+        SDtimer=1000;
+    }
+    return e;
+}
+
+
+// report an error saved by FileFlushAll()
+static void FileWriteError(int fnbr) {
+    if(wberror[fnbr] == 0) return;
+    FSerror = wberror[fnbr];
+    wberror[fnbr] = 0;
+    ErrorCheck(fnbr);
+}
+
+
+// flush the write-behind buffer of a file
+// it will generate an error if needed
+void FileFlush(int fnbr) {
+    FileWriteError(fnbr);
+    if(wbcount[fnbr] == 0) return;
+    FSerror = FileWriteBuffer(fnbr);
+    ErrorCheck(fnbr);
+}
+
+
+// flush the write-behind buffers of all open files, called by CheckSDCard() when FileFlushTimer has expired
+// an error cannot be reported here so it is saved in wberror[] and raised by the next write, flush or close of the file
+static void FileFlushAll(void) {
+    int i, e;
+    FileFlushTimer = 0;
+    for(i = 1; i <= MAXOPENFILES; i++) {
+        if(FileTable[i].com > MAXCOMPORTS && FileTable[i].fptr != NULL && wbcount[i]) {
+            e = FileWriteBuffer(i);
+            if(e && wberror[i] == 0) wberror[i] = e;
+        }
+    }
+}
+
+
 char FileGetChar(int fnbr) {
     char ch;
     char *buff=SDbuffer[fnbr];
 ;
     if(!InitSDCard()) return 0;
     if(fmode[fnbr] & FA_WRITE){
+        FileFlush(fnbr);
         FSerror = f_read(FileTable[fnbr].fptr, &ch,1, &bw[fnbr]);
         ErrorCheck(fnbr);
         SDtimer=1000;
@@ -782,6 +847,16 @@ char FileGetChar(int fnbr) {
 void FilePutStr(int count, char *c, int fnbr){
     unsigned int bw;
     InitSDCard();
+    if(fmode[fnbr] & FA_WRITE) {
+        FileWriteError(fnbr);
+        if(wbcount[fnbr] + count <= SDbufferSize) {                 // it will fit in the write-behind buffer
+            memcpy(SDbuffer[fnbr] + wbcount[fnbr], c, count);
+            wbcount[fnbr] += count;
+            if(wbcount[fnbr] == SDbufferSize) FileFlush(fnbr);
+            return;
+        }
+        FileFlush(fnbr);
+    }
     FSerror = f_write(FileTable[fnbr].fptr, c, count, &bw);
     SDtimer=1000;
     ErrorCheck(fnbr);
@@ -793,6 +868,12 @@ char FilePutChar(char c, int fnbr) {
     unsigned int bw;
     t = c;
     if(!InitSDCard()) return 0;
+    if(fmode[fnbr] & FA_WRITE) {                                    // save the char in the write-behind buffer
+        FileWriteError(fnbr);
+        SDbuffer[fnbr][wbcount[fnbr]++] = t;
+        if(wbcount[fnbr] == SDbufferSize) FileFlush(fnbr);
+        return t;
+    }
     FSerror = f_write(FileTable[fnbr].fptr, &t, 1, &bw);
     SDtimer=1000;
     lastfptr[fnbr]=-1; //invalidate the read file buffer
@@ -801,10 +882,56 @@ char FilePutChar(char c, int fnbr) {
 }
 
 
+// get a line from a file opened for INPUT (used by LINE INPUT # and INPUT #)
+// this works directly on the file's read buffer using memchr() to find the end of the line so that the chars do
+// not have to be fetched one at a time through MMfgetc().  Tabs and backspaces are handled the same as MMgetline()
+// returns false if the file is open for writing and the line must be read a char at a time
+int FileGetLine(int fnbr, char *p) {
+    char *buff = SDbuffer[fnbr], *s, *e, *nl;
+    int nbrchars = 0;
+    if(fmode[fnbr] & FA_WRITE) return false;
+    while(!FileEOF(fnbr)) {
+        CheckAbort();
+        if(!(lastfptr[fnbr]==(uint32_t)FileTable[fnbr].fptr && buffpointer[fnbr]<SDbufferSize)){
+            FSerror = f_read(FileTable[fnbr].fptr, buff,SDbufferSize, &bw[fnbr]);
+            ErrorCheck(fnbr);
+            buffpointer[fnbr]=0;
+            lastfptr[fnbr]=(uint32_t)FileTable[fnbr].fptr;
+            SDtimer=1000;
+            if(bw[fnbr] == 0) break;
+        }
+        s = buff + buffpointer[fnbr];
+        nl = memchr(s, '\n', bw[fnbr] - buffpointer[fnbr]);      // look for the end of the line in the buffer
+        e = (nl != NULL) ? nl : buff + bw[fnbr];
+        buffpointer[fnbr] += (e - s) + (nl != NULL);               // consume the chars and the newline
+        for( ; s < e; s++) {
+            if(*s == '\r') continue;                               // for files loop around looking for the following newline
+            if(*s == '\t') {                                       // expand tabs to spaces
+                do {
+                    if(++nbrchars > MAXSTRLEN) error("Line is too long");
+                    *p++ = ' ';
+                } while(nbrchars % Option.Tab);
+                continue;
+            }
+            if(*s == '\b') {                                       // handle the backspace
+                if(nbrchars) { nbrchars--; p--; }
+                continue;
+            }
+            if(++nbrchars > MAXSTRLEN) error("Line is too long");
+            *p++ = *s;
+        }
+        if(nl != NULL) break;                                       // found the end of the line
+    }
+    *p = 0;
+    return true;
+}
+
+
 
 int FileEOF(int fnbr) {
     int i;
     if(!InitSDCard()) return 0;
+    if(fmode[fnbr] & FA_WRITE) FileFlush(fnbr);
     if(buffpointer[fnbr]<=bw[fnbr]-1) i=0;
     else {
     	i = f_eof(FileTable[fnbr].fptr);
@@ -852,9 +979,11 @@ int FindFreeFileNbr(void) {
 }
 
 
-// check the SD card to see if it has been removed.  Also check WAV playback
+// check the SD card to see if it has been removed.  Also check WAV playback and write any ADC STREAM data
 // this is called from cmd_pause(), the main ExecuteProgram() loop and the console's MMgetchar()
 void __attribute__ ((optimize("-O2"))) CheckSDCard(void) {
+    if(FileFlushTimer >= FileFlushTime) FileFlushAll();
+    if(ADCstreaming) ADCStreamService();
     if(CurrentlyPlaying == P_WAV || CurrentlyPlaying == P_FLAC || CurrentlyPlaying == P_MP3 || CurrentlyPlaying == P_MOD)
         checkWAVinput();
     else {
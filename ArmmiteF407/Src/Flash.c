@@ -647,8 +647,8 @@ Minimum 4K sector can be erased i.e. 16 pages
 /*******************************************************************************************************************
  The WindBond W25Q16 is 2 Meg of 8192 256 byte pages.
  It is on SPI1 and F_CS is 35 on VET6 board and 77 VET6 MINI
- The Library and VAR FSAVE are used by MMBasic hence we must not use full Erase.
- The User Area is erased as 30*64K Blocks + 1*32K Block + 7*28K Blocks
+ The Library, VAR FSAVE and KV store are used by MMBasic hence we must not use full Erase.
+ The User Area is erased as 30*64K Blocks
  The usage layout is:
  ===================   << Page 8191 end of 2Meg Flash
  |  64K (256 pages |      64K Block can be erased i.e. 256 pages
@@ -658,14 +658,12 @@ Minimum 4K sector can be erased i.e. 16 pages
  ===================   << Page 7935 End of VAR FSAVE area
  |    VAR FSAVE    |     Minimum 4K sector can be erased i.e. 16 pages
  |    4K Backup    |   << WBVarAddr (is Page 7920 (8192- 272) Start of 4K used for VAR FSAVE backup of VAR ram)
- ===================   << Page 7919 End of user area
- |   User          |     28 K  needs to be erased in 7 * 4K sectors of 16pages
- ~   Area          ~     112 pages
- |   7*4K blocks   |   << Page 7808  continuation of User Area  7*4K Blocks
- ~~~~~~~~~~~~~~~~~~~
- |  1*32K Block    |
- |  128 pages      |   << Page 7680  continuation of User Area 1*32K Block 7806= ((16*flash_size)-2)*256
- ~~~~~~~~~~~~~~~~~~~
+ ===================   << Page 7919 End of KV store
+ |   KV store      |     60K  15 * 4K sectors of 16 pages, see KV.c
+ |  log of key     |     records are appended with page programs and
+ |  value records  |     sectors are erased one at a time by compaction
+ |                 |   << WBKvAddr (is Page 7680 Start of 60K KV store)
+ ===================
  |    User         |   << page 7679 is end 64K blocks
  |    Area         |   Available to User.
  |                 |   erase  Block2 is 64K  256 pages
@@ -1209,7 +1207,7 @@ void cmd_flash(void){
     char *tp;
   //  char *vp;
     int i,j;
-    int userlastpage=7919;
+    int userlastpage=WBKvAddr-1;
 
     tp = checkstring(cmdline, "TEST");
     if (tp){
@@ -1277,18 +1275,8 @@ void cmd_flash(void){
               WBEraseArea(block2erase,i);
               MMPrintString(".");
             }
-            //Erase the 32K Block
-            i=7680;
-            WBEraseArea(blockerase,i);
-            MMPrintString(".");
-           // Erase the 7*4K Blocks
-            for (i=7808;i<7920;i+=16){
-             WBEraseArea(sectorerase,i);
-             MMPrintString(".");
-            }
-
             SPIClose();
-            MMPrintString("\r\nUser Flash Erased (Pages 0-7919)\r\n");
+            MMPrintString("\r\nUser Flash Erased (Pages 0-7679)\r\n");
             return;
        }
 
@@ -1621,6 +1609,63 @@ void WBReadPage(int pageno,char *p){
      //MMPrintString("-------------------------------Read End ");
 }
 
+/* Read n bytes starting at any byte address, used by the KV store *****/
+void WBRead(int addr,char *p,int n){
+     PinSetBit(Option.FLASH_CS,LATCLR);
+	 SPIsend1(readdata);
+	 SPIsend1((addr>>16) & 0xFF);
+	 SPIsend1((addr>>8) & 0xFF);
+	 SPIsend1(addr & 0xFF);
+	 if(n) HAL_SPI_Receive(&hspi1,(uint8_t *)p,n,500);  // in one transfer, the contents of p are clocked out as the dummy bytes
+     PinSetBit(Option.FLASH_CS,LATSET);
+}
+
+/* Program n bytes that must all be in the same page, bytes already programmed must be 0xFF **/
+/* so records can be appended to a page without erasing it                                  */
+void WBProgram(int addr,char *p,int n){
+     unsigned char s=0,q;
+     PinSetBit(Option.FLASH_CS,LATCLR);
+       SPIsend1(writeenable);
+     PinSetBit(Option.FLASH_CS,LATSET);
+     PinSetBit(Option.FLASH_CS,LATCLR);
+	 SPIsend1(pagewrite);
+	 SPIsend1((addr>>16) & 0xFF);
+	 SPIsend1((addr>>8) & 0xFF);
+	 SPIsend1(addr & 0xFF);
+	 while(n--) SPIsend1(*p++);
+	 PinSetBit(Option.FLASH_CS,LATSET);
+	 do {                                           // a page program takes less than 3mS
+	     PinSetBit(Option.FLASH_CS,LATCLR);
+	       SPIsend1(readstatus1);
+	       HAL_SPI_TransmitReceive(&hspi1,&s,&q,1,500);
+         PinSetBit(Option.FLASH_CS,LATSET);
+	 } while(q & 1);
+}
+
+/* Start erasing the 4K sector containing pageno and return without waiting *****/
+void WBEraseStart(int pageno){
+	 int add=(pageno<<8);
+     PinSetBit(Option.FLASH_CS,LATCLR);
+       SPIsend1(writeenable);
+     PinSetBit(Option.FLASH_CS,LATSET);
+     PinSetBit(Option.FLASH_CS,LATCLR);
+      SPIsend1(sectorerase);
+      SPIsend1((add>>16) & 0xFF);
+      SPIsend1((add>>8) & 0xFF);
+      SPIsend1(add & 0xFF);
+     PinSetBit(Option.FLASH_CS,LATSET);
+}
+
+/* Returns true while an erase or program is in progress *****/
+int WBBusy(void){
+     unsigned char s=0,q;
+     PinSetBit(Option.FLASH_CS,LATCLR);
+       SPIsend1(readstatus1);
+       HAL_SPI_TransmitReceive(&hspi1,&s,&q,1,500);
+     PinSetBit(Option.FLASH_CS,LATSET);
+     return q & 1;
+}
+
 #ifdef CMD_FLASH
 /* Write 16 Page Sector  i.e. 4K *****************************/
 void WBWriteSector(int pageno,char *p){
@@ -1674,6 +1719,13 @@ void InitFlash_CS(){
 }
 
 void SPIOpen(void) {
+	SPIOpenFlash(true);
+}
+
+// open SPI1 and check that the flash is there
+// the flash ignores everything but a status read while the KV store is erasing a sector in the background
+// so that is waited for, or if wait is false SPI1 is closed again and false returned
+int SPIOpenFlash(int wait) {
 	        //Option.FLASH_CS is 35 for VET6 or 77 for VET6 Mini
 	        int id;
 		    unsigned char s,r1,r2,r3;
@@ -1693,6 +1745,13 @@ void SPIOpen(void) {
 	       HAL_SPI_DeInit(&hspi1);
 	       HAL_SPI_Init(&hspi1);
 
+	       if(KvErasing()) {
+	           if(!wait && WBBusy()) {
+	               SPIClose();
+	               return false;
+	           }
+	           while(WBBusy());
+	       }
 	       PinSetBit(Option.FLASH_CS,LATCLR);
 	       SPIsend1(JEDEC);
 	       s=0;
@@ -1706,8 +1765,7 @@ void SPIOpen(void) {
 	       id=r1*256*256+r2*256+r3 ;
 	      // PIntH(id);
 	       if (id==0x0 || id==0xFFFFFF){SPIClose(); error("No SPI flash found.Check OPTION FLASH_CS");}
-
-
+	       return true;
 }
 // erase all battery backup memory and reset the options to their defaults
 // used on initial firmware run if options appear corrupt or not set
@@ -1901,7 +1901,7 @@ void UpdateControl(int r) {
 
 
 // check if the pen has touched or been lifted and animate the GUI elements as required
-// this is called after every command (from check_interrupt()), in the getchar() loop and repeatedly in a pause
+// this is called every mSec (from check_interrupt()), in the getchar() loop and repeatedly in a pause
 // TouchDown and TouchUp are set in the Timer 4 interrupt
 void __attribute__ ((optimize("-O2"))) ProcessTouch(void) {
     static int repeat = 0;
@@ -1946,6 +1946,7 @@ void __attribute__ ((optimize("-O2"))) ProcessTouch(void) {
         }
 
         gui_int_down = true;                                        // signal that a MMBasic interrupt is valid
+        IntPost(INT_GUIDOWN);
         for(r = 1; r < Option.MaxCtrls; r++) {
             if(Ctrl[r].type && TouchX >= Ctrl[r].x1 && TouchY >= Ctrl[r].y1 && TouchX <= Ctrl[r].x2 && TouchY <= Ctrl[r].y2) {
                 if(!(CurrentPages & (1 << Ctrl[r].page))) continue;                            // ignore if the page is not displayed
@@ -2051,6 +2052,7 @@ void __attribute__ ((optimize("-O2"))) ProcessTouch(void) {
         }
 
         gui_int_up = true;
+        IntPost(INT_GUIUP);
         if(CurrentRef) {
             if(Ctrl[CurrentRef].type) {
                 if((CurrentPages & (1 << Ctrl[CurrentRef].page)) && !(Ctrl[CurrentRef].state & (CTRL_DISABLED | CTRL_DISABLED2 | CTRL_HIDDEN))) {   // ignore if control is disabled or the page is not displayed
@@ -2422,7 +2424,7 @@ void CheckGuiTimeouts(void) {
 
 
 // This implements a LED flash
-// it is called by check_interrupt()
+// it is called every mSec by check_interrupt()
 // it scans through all controls looking for a LED with a timeout set (in Ctrl[r].inc)
 void CheckGui(void) {
     int r;
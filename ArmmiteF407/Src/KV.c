@@ -0,0 +1,246 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+KV.c
+
+Handles the KV command and KV() function.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024  Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+/********** KV store on the W25Q SPI flash *********************************************
+ * VAR SAVE only has the 4K of backup RAM and VAR FSAVE rewrites a whole sector of the
+ * W25Q so saving one value costs an erase.  The KV store instead appends each value as a
+ * record to a log kept in WBKvSectors 4K sectors starting at page WBKvAddr.  Saving a value
+ * only costs a page program and the sectors are used in turn so that the wear is spread
+ * over all of them.
+ *
+ * Each sector in use starts with a magic number and a sequence number that increases every
+ * time a sector is started.  Records follow (see struct s_kvrec) each with a CRC32 so that
+ * one torn by a power failure is ignored.  A RAM index of KVMAXKEYS entries holds the hash
+ * of each key and the address of its latest record.  It is built on the first use after
+ * power up by replaying the sectors in sequence order and survives RUN and NEW.
+ *
+ * When only two blank sectors are left the store compacts the sector
+ * with the least live data: records that are still the latest for their key are copied to
+ * the end of the log then the sector is erased.  This is done a record at a time from the
+ * housekeeping in check_interrupt() while SPI1 is free, and the erase runs on in the flash
+ * while BASIC carries on.  A put only compacts in line if the background has not kept up.
+ *
+ * The log is in KvLog.c.  It only uses the flash through KvRead, KvProgram, KvErase and KvBusy
+ * so it can be run against a file or RAM that behaves like NOR flash (see test/kv).  This file
+ * points them at the W25Q and has the commands and the housekeeping.
+ *
+ * KV PUT key$, value             value can be a float, integer or string
+ * KV DELETE key$
+ * KV LIST
+ * KV STATUS
+ * KV COMPACT                     compact every sector that has anything to recover
+ * KV FORMAT                      erase the whole store
+ * KV(key$ [, default])           the saved value, or default if the key has not been saved
+ */
+
+
+#include "MMBasic_Includes.h"
+#include "Hardware_Includes.h"
+
+
+static void KvW25Read(uint32_t addr, void *p, int n) { WBRead(addr, p, n); }
+static void KvW25Program(uint32_t addr, const void *p, int n) { WBProgram(addr, (char *)p, n); }
+static void KvW25Erase(uint32_t addr) { WBEraseStart(addr / KV_PAGE); }
+
+void (*KvRead)(uint32_t addr, void *p, int n) = KvW25Read;
+void (*KvProgram)(uint32_t addr, const void *p, int n) = KvW25Program;
+void (*KvErase)(uint32_t addr) = KvW25Erase;
+int (*KvBusy)(void) = WBBusy;
+
+
+static int KvReady = false;                         // true once the index has been built
+
+// get SPI1 for the flash and build the index if this is the first use since power up
+static void KvBegin(void) {
+    SPIOpen();
+    if(!KvReady) {
+        KvOpen((uint32_t)WBKvAddr * KV_PAGE, WBKvSectors);
+        KvReady = true;
+    }
+}
+
+// release SPI1 then report any error
+static void KvEnd(int r) {
+    SPIClose();
+    if(r == KV_FULL) error("KV store full");
+    if(r == KV_NOKEYS) error("Too many keys");
+}
+
+static char *KvKey(char *p) {
+    char *s = getstring(p);
+    if(*s == 0 || *s > KV_MAXKEY) error("Key must be 1 to % characters", KV_MAXKEY);
+    return s;
+}
+
+// called every mSec by the housekeeping in check_interrupt()
+// compacts in the background, but only while BASIC is not using SPI1 or its pins
+// nothing here waits for the flash, while an erase is running the step is skipped
+void KvService(void) {
+    static int count;
+    if(!KvReady || !KvPending()) return;
+    if(++count < 10) return;                        // a step every 10mS is plenty
+    count = 0;
+    if(ExtCurrentConfig[SPI_OUT_PIN] != EXT_NOT_CONFIG || ExtCurrentConfig[SPI_INP_PIN] != EXT_NOT_CONFIG || ExtCurrentConfig[SPI_CLK_PIN] != EXT_NOT_CONFIG) return;
+    if(!SPIOpenFlash(false)) return;                // still erasing, try again in 10mS
+    KvCompactStep();
+    SPIClose();
+}
+
+void cmd_kv(void) {
+    char *tp, *key, *s, buf[KV_MAXVALUE + 1], k[KV_MAXKEY + 1];
+    MMFLOAT f;
+    long long int i64;
+    int r, t, keylen, len, slot;
+
+    if((tp = checkstring(cmdline, "PUT"))) {
+        getargs(&tp, 3, ",");
+        if(argc != 3) error("Argument count");
+        key = KvKey(argv[0]);
+        t = T_NOTYPE;
+        evaluate(argv[2], &f, &i64, &s, &t, false);
+        KvBegin();
+        if(t & T_STR)
+            r = KvPut(key + 1, *key, KV_STR, s + 1, *s);
+        else if(t & T_INT)
+            r = KvPut(key + 1, *key, KV_INT, &i64, sizeof(i64));
+        else
+            r = KvPut(key + 1, *key, KV_NBR, &f, sizeof(f));
+        KvEnd(r);
+        return;
+    }
+    if((tp = checkstring(cmdline, "DELETE"))) {
+        key = KvKey(tp);
+        KvBegin();
+        KvDelete(key + 1, *key);                    // it is not an error if the key was not there
+        KvEnd(KV_OK);
+        return;
+    }
+    if(checkstring(cmdline, "LIST")) {
+        KvBegin();
+        for(slot = 0; (slot = KvEntry(slot, k, &keylen, &t, buf, &len)) >= 0; ) {
+            k[keylen] = 0;
+            MMPrintString(k);
+            MMPrintString(" = ");
+            if(t == KV_STR) {
+                buf[len] = 0;
+                MMPrintString("\"");
+                MMPrintString(buf);
+                MMPrintString("\"");
+            } else if(t == KV_INT) {
+                memcpy(&i64, buf, sizeof(i64));
+                IntToStr(inpbuf, i64, 10);
+                MMPrintString(inpbuf);
+            } else {
+                memcpy(&f, buf, sizeof(f));
+                FloatToStr(inpbuf, f, 0, STR_AUTO_PRECISION, ' ');
+                MMPrintString(inpbuf);
+            }
+            MMPrintString("\r\n");
+        }
+        KvEnd(KV_OK);
+        return;
+    }
+    if(checkstring(cmdline, "STATUS")) {
+        int keys, blank, used, live;
+        KvBegin();
+        KvStatus(&keys, &blank, &used, &live);
+        KvEnd(KV_OK);
+        PIntComma(keys); MMPrintString(" keys, ");
+        PIntComma(live); MMPrintString(" bytes live of ");
+        PIntComma(used); MMPrintString(" used, ");
+        PIntComma(blank); MMPrintString(" of "); PInt(WBKvSectors); MMPrintString(" sectors free\r\n");
+        return;
+    }
+    if(checkstring(cmdline, "COMPACT")) {
+        KvBegin();
+        while(KvCompact());
+        KvEnd(KV_OK);
+        return;
+    }
+    if(checkstring(cmdline, "FORMAT")) {
+        KvBegin();
+        KvFormat();
+        KvEnd(KV_OK);
+        return;
+    }
+    error("Syntax");
+}
+
+// KV(key$ [, default])
+void fun_kv(void) {
+    char *key, *s, buf[KV_MAXVALUE];
+    int r, t, len;
+    getargs(&ep, 3, ",");
+    if(!(argc == 1 || argc == 3)) error("Argument count");
+    key = KvKey(argv[0]);
+    KvBegin();
+    r = KvGet(key + 1, *key, &t, buf, &len);
+    KvEnd(KV_OK);
+    if(r == KV_NOTFOUND) {
+        if(argc == 1) error("Key not found");
+        t = T_NOTYPE;
+        evaluate(argv[2], &fret, &iret, &s, &t, false);
+        if(t & T_STR) {
+            sret = GetTempStrMemory();
+            Mstrcpy(sret, s);
+        }
+        targ = t & (T_NBR | T_INT | T_STR);
+        return;
+    }
+    if(t == KV_STR) {
+        sret = GetTempStrMemory();
+        *sret = len;
+        memcpy(sret + 1, buf, len);
+        targ = T_STR;
+    } else if(t == KV_INT) {
+        memcpy(&iret, buf, sizeof(iret));
+        targ = T_INT;
+    } else {
+        memcpy(&fret, buf, sizeof(fret));
+        targ = T_NBR;
+    }
+}
+
+/************************************************* end of KV.c *******************/
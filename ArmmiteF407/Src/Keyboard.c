@@ -871,6 +871,7 @@ void CNInterrupt(void) {
 
                         if(c==keyselect && KeyInterrupt!=NULL){
                         		Keycomplete=1;
+                        		IntPost(INT_KEY);
                         		return;
                         }
 
@@ -0,0 +1,513 @@
+/*-*****************************************************************************
+MMBasic for STM32F407 [VET6] (Armmite F4)
+
+KvLog.c
+
+The log that holds the KV store.
+
+Copyright 2011-2024 Geoff Graham and  Peter Mather.
+Copyright 2024      Gerry Allardice.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holders nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+4. The name MMBasic be used when referring to the interpreter in any
+   documentation and promotional material and the original copyright message
+  be displayed  on the console at startup (additional copyright messages may
+   be added).
+
+5. All advertising materials mentioning features or use of this software must
+   display the following acknowledgement: This product includes software
+   developed by Geoff Graham and Peter Mather.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*******************************************************************************/
+/* The log itself, see KV.c for the layout and the commands.  Nothing here uses the HAL or MMBasic
+ * (apart from crc32()) and nothing calls error(), the KV_xxx status is returned instead.  The flash
+ * is only reached through KvRead, KvProgram, KvErase and KvBusy (set up in KV.c) so this file can
+ * be built on its own and run against a simulated NOR flash (see test/kv).
+ *
+ * Nothing that can be called from the housekeeping waits for the flash.  An erase is started and
+ * then polled by later calls to KvCompactStep(), and a free sector that might not be blank is
+ * checked a page at a time (then erased the same way) before the background copies into it.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "Configuration.h"
+#include "KV.h"
+
+// in MATHS.c, MATHS.h needs the rest of MMBasic
+extern uint32_t crc32(const uint8_t *array, uint16_t length, const uint32_t polynome, const uint32_t startmask, const uint32_t endmask, const uint8_t reverseIn, const uint8_t reverseOut);
+#define KV_CRCPOLY      0x04C11DB7                  // CRC32_DEFAULT_POLYNOME
+#define true            1
+#define false           0
+
+#define KV_MAGIC        0x3153564B                  // "KVS1" at the start of every sector in use
+#define KV_HDRSIZE      8                           // the magic number and the sequence number
+#define KV_RECSIZE(k, v)    ((sizeof(struct s_kvrec) + (k) + (v) + 3) & ~3)
+#define KV_RECMAX       KV_RECSIZE(KV_MAXKEY, KV_MAXVALUE)
+#define KV_EMPTY        0                           // an index slot that has never been used
+#define KV_REMOVED      1                           // an index slot that was used by a key that has gone
+
+// the state of each sector
+#define KV_SFREE        0                           // no header but it might need erasing before use
+#define KV_SBLANK       1                           // known to be erased
+#define KV_SUSED        2
+#define KV_SERASING     3
+
+struct s_kvindex {
+    uint32_t hash;
+    uint32_t addr;                                  // the latest record for the key, or KV_EMPTY or KV_REMOVED
+};
+
+struct s_kvsector {
+    uint32_t seq;                                   // zero if the sector did not belong to the store
+    uint16_t used;                                  // bytes from the start of the sector to the end of the log
+    uint16_t live;                                  // bytes in records that are the latest for their key
+    uint8_t state;
+};
+
+static struct s_kvindex KvIndex[KVMAXKEYS];
+static struct s_kvsector KvSector[KV_MAXSECTORS];
+static uint32_t KvBase;                             // byte address of the first sector
+static int KvSectors;                               // nbr of sectors, zero if the store has not been opened
+static int KvActive;                                // the sector records are being appended to
+static int KvKeys;                                  // nbr of keys in the index, including deleted ones
+static uint32_t KvSeq;                              // the sequence number of the newest sector
+static int KvVictim = -1, KvCopyPos;                // the sector being compacted and the next record to copy
+static int KvBacklog;                               // true if the background should compact
+static int KvPrep = -1, KvPrepPos;                  // a free sector being made blank for the background and the next page to check
+
+#define KvAddr(s)       (KvBase + (uint32_t)(s) * KV_SECTOR)
+#define KvSectorOf(a)   (((a) - KvBase) / KV_SECTOR)
+
+// FNV-1a
+static uint32_t KvHash(const char *key, int len) {
+    uint32_t h = 2166136261u;
+    while(len--) h = (h ^ (uint8_t)*key++) * 16777619u;
+    return h;
+}
+
+static uint32_t KvCrc(struct s_kvrec *r, const char *data, int n) {
+    uint32_t crc = crc32((const uint8_t *)r, 4, KV_CRCPOLY, 0xFFFFFFFF, 0, 0, 0);
+    return crc32((const uint8_t *)data, n, KV_CRCPOLY, crc, 0, 0, 0);
+}
+
+// program any nbr of bytes, split so that no program crosses a page
+static void KvWrite(uint32_t addr, const void *p, int n) {
+    int k;
+    while(n) {
+        k = KV_PAGE - addr % KV_PAGE;
+        if(k > n) k = n;
+        KvProgram(addr, p, k);
+        addr += k;
+        p = (const char *)p + k;
+        n -= k;
+    }
+}
+
+// find the index slot holding key, returns -1 if it is not there
+// freeslot is set to where it could be added or -1 if the index is full
+static int KvFind(const char *key, int keylen, uint32_t hash, int *freeslot) {
+    struct s_kvrec r;
+    char k[KV_MAXKEY];
+    int i, n;
+    *freeslot = -1;
+    for(n = 0, i = hash % KVMAXKEYS; n < KVMAXKEYS; n++, i = (i + 1) % KVMAXKEYS) {
+        if(KvIndex[i].addr == KV_EMPTY) {
+            if(*freeslot < 0) *freeslot = i;
+            return -1;
+        }
+        if(KvIndex[i].addr == KV_REMOVED) {
+            if(*freeslot < 0) *freeslot = i;
+            continue;
+        }
+        if(KvIndex[i].hash != hash) continue;
+        KvRead(KvIndex[i].addr, &r, sizeof(r));     // the hash matches so check the key itself
+        if(r.keylen != keylen) continue;
+        KvRead(KvIndex[i].addr + sizeof(r), k, keylen);
+        if(memcmp(k, key, keylen) == 0) return i;
+    }
+    return -1;
+}
+
+// make the record of len bytes at addr the latest for key and keep the live count of each sector
+static int KvLink(const char *key, int keylen, uint32_t addr, int len) {
+    struct s_kvrec r;
+    uint32_t hash = KvHash(key, keylen);
+    int slot, freeslot;
+    if((slot = KvFind(key, keylen, hash, &freeslot)) >= 0) {
+        KvRead(KvIndex[slot].addr, &r, sizeof(r));
+        KvSector[KvSectorOf(KvIndex[slot].addr)].live -= KV_RECSIZE(r.keylen, r.vallen);
+    } else {
+        if(freeslot < 0 || KvKeys >= KVMAXKEYS - 1) return KV_NOKEYS;  // always leave one empty slot to end a search
+        slot = freeslot;
+        KvIndex[slot].hash = hash;
+        KvKeys++;
+    }
+    KvIndex[slot].addr = addr;
+    KvSector[KvSectorOf(addr)].live += len;
+    return KV_OK;
+}
+
+// nbr of sectors that a new sector can be taken from
+static int KvFreeCount(void) {
+    int s, n = 0;
+    for(s = 0; s < KvSectors; s++)
+        if(KvSector[s].state == KV_SFREE || KvSector[s].state == KV_SBLANK) n++;
+    return n;
+}
+
+static int KvBlank(int s) {
+    uint32_t buf[KV_PAGE / 4];
+    int i, j;
+    for(i = 0; i < KV_SECTOR; i += KV_PAGE) {
+        KvRead(KvAddr(s) + i, buf, KV_PAGE);
+        for(j = 0; j < KV_PAGE / 4; j++) if(buf[j] != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
+
+// the next free sector after the active sector so that all are used in turn, or -1 if there is none
+static int KvNextFree(void) {
+    int i, s;
+    for(i = 1; i <= KvSectors; i++) {
+        s = (KvActive + i + KvSectors) % KvSectors;
+        if(KvSector[s].state == KV_SFREE || KvSector[s].state == KV_SBLANK) return s;
+    }
+    return -1;
+}
+
+// start a new sector, the caller has checked that there is a free one
+// this waits for the flash if the sector has not been checked by KvPrepStep() so it is not used by the background
+static int KvNewSector(void) {
+    uint32_t h[2];
+    int s = KvNextFree();
+    if(s == KvPrep) KvPrep = -1;                    // KvFinish() has made sure that it is not being erased
+    if(KvSector[s].state == KV_SFREE && !KvBlank(s)) {
+        KvErase(KvAddr(s));
+        while(KvBusy());
+    }
+    h[0] = KV_MAGIC;
+    h[1] = ++KvSeq;
+    KvWrite(KvAddr(s) + 4, &h[1], 4);               // the magic number goes last so a torn header is not used
+    KvWrite(KvAddr(s), &h[0], 4);
+    KvSector[s].seq = KvSeq;
+    KvSector[s].used = KV_HDRSIZE;
+    KvSector[s].live = 0;
+    KvSector[s].state = KV_SUSED;
+    if(KvFreeCount() <= 2) KvBacklog = true;
+    return s;
+}
+
+// append a record to the log, returns its address or zero if that would leave reserve or fewer free sectors
+static uint32_t KvAppend(const char *buf, int len, int reserve) {
+    uint32_t addr;
+    if(KvActive < 0 || KvSector[KvActive].used + len > KV_SECTOR) {
+        if(KvFreeCount() <= reserve) return 0;
+        KvActive = KvNewSector();
+    }
+    addr = KvAddr(KvActive) + KvSector[KvActive].used;
+    KvWrite(addr, buf, len);
+    KvSector[KvActive].used += len;
+    return addr;
+}
+
+// read the records in a sector into the index
+static void KvScan(int s) {
+    char buf[KV_RECMAX];
+    struct s_kvrec *r = (struct s_kvrec *)buf;
+    uint32_t a = KvAddr(s) + KV_HDRSIZE, end = KvAddr(s) + KV_SECTOR;
+    int len, freeslot, torn = false;
+    while(a + sizeof(struct s_kvrec) <= end) {
+        KvRead(a, r, sizeof(struct s_kvrec));
+        if(r->type == 0xFF) break;                  // the end of the log in this sector
+        len = KV_RECSIZE(r->keylen, r->vallen);
+        if(r->type < KV_STR || r->type > KV_DEL || r->keylen == 0 || r->keylen > KV_MAXKEY || r->vallen > KV_MAXVALUE || a + len > end) {
+            torn = true;                            // nonsense so nothing after this can be trusted
+            break;
+        }
+        KvRead(a + sizeof(struct s_kvrec), buf + sizeof(struct s_kvrec), r->keylen + r->vallen);
+        if(KvCrc(r, buf + sizeof(struct s_kvrec), r->keylen + r->vallen) != r->crc)
+            torn = true;                            // a power failure while writing, skip it
+        else if(r->type != KV_DEL || KvFind(buf + sizeof(struct s_kvrec), r->keylen, KvHash(buf + sizeof(struct s_kvrec), r->keylen), &freeslot) >= 0)
+            KvLink(buf + sizeof(struct s_kvrec), r->keylen, a, len);    // a delete of a key that is not there is not needed
+        a += len;
+    }
+    KvSector[s].used = torn ? KV_SECTOR : a - KvAddr(s);    // do not append after a bad record
+}
+
+// open the store and build the index
+int KvOpen(uint32_t base, int sectors) {
+    uint32_t h[2];
+    int order[KV_MAXSECTORS], i, n = 0, s;
+    if(sectors > KV_MAXSECTORS) sectors = KV_MAXSECTORS;
+    memset(KvIndex, 0, sizeof(KvIndex));
+    memset(KvSector, 0, sizeof(KvSector));
+    KvBase = base;
+    KvSectors = sectors;
+    KvActive = KvVictim = KvPrep = -1;
+    KvKeys = KvSeq = KvBacklog = 0;
+    for(s = 0; s < sectors; s++) {
+        KvRead(KvAddr(s), h, sizeof(h));
+        if(h[0] == KV_MAGIC && h[1] != 0) {
+            KvSector[s].state = KV_SUSED;
+            KvSector[s].seq = h[1];
+            if(h[1] > KvSeq) KvSeq = h[1];
+            for(i = n++; i > 0 && KvSector[order[i - 1]].seq > h[1]; i--) order[i] = order[i - 1];
+            order[i] = s;                           // keep them in sequence order
+        } else if(h[0] != 0xFFFFFFFF || h[1] != 0xFFFFFFFF) {
+            KvSector[s].state = KV_SUSED;           // something else was here so compact (ie, erase) it
+            KvSector[s].used = KV_SECTOR;
+        }
+    }
+    for(i = 0; i < n; i++) KvScan(order[i]);
+    if(n) KvActive = order[n - 1];
+    KvBacklog = (KvFreeCount() <= 2);
+    return KV_OK;
+}
+
+// check the next page of the sector in KvPrep, start erasing it if the page is not blank and poll the erase
+// returns true while there is more to do
+static int KvPrepStep(void) {
+    uint32_t buf[KV_PAGE / 4];
+    int j;
+    if(KvSector[KvPrep].state == KV_SERASING) {
+        if(KvBusy()) return true;
+    } else {
+        KvRead(KvAddr(KvPrep) + KvPrepPos, buf, KV_PAGE);
+        for(j = 0; j < KV_PAGE / 4; j++) {
+            if(buf[j] != 0xFFFFFFFF) {
+                KvErase(KvAddr(KvPrep));
+                KvSector[KvPrep].state = KV_SERASING;
+                return true;
+            }
+        }
+        if((KvPrepPos += KV_PAGE) < KV_SECTOR) return true;
+    }
+    KvSector[KvPrep].state = KV_SBLANK;
+    KvPrep = -1;
+    return false;
+}
+
+// true while an erase started by the store might still be running
+int KvErasing(void) {
+    return (KvVictim >= 0 && KvSector[KvVictim].state == KV_SERASING) || (KvPrep >= 0 && KvSector[KvPrep].state == KV_SERASING);
+}
+
+// true if the background has anything to do
+int KvPending(void) {
+    return KvBacklog || KvVictim >= 0 || KvPrep >= 0;
+}
+
+// true if no sector older than s holds records
+static int KvOldest(int s) {
+    int i;
+    for(i = 0; i < KvSectors; i++)
+        if(i != s && KvSector[i].state == KV_SUSED && KvSector[i].seq != 0 && KvSector[i].seq < KvSector[s].seq) return false;
+    return true;
+}
+
+// the sector with the least live data that has something to recover, or -1 if there is none
+static int KvChooseVictim(void) {
+    int s, v = -1;
+    for(s = 0; s < KvSectors; s++) {
+        if(KvSector[s].state != KV_SUSED || s == KvActive) continue;
+        if(KvSector[s].live >= KvSector[s].used - KV_HDRSIZE) continue;
+        if(v < 0 || KvSector[s].live < KvSector[v].live) v = s;
+    }
+    return v;
+}
+
+// do the next step in compacting a sector, returns true while there is more to do
+// one record is copied each time then the erase is started and polled until it is finished
+// this never waits for the flash so it can be called from the housekeeping
+int KvCompactStep(void) {
+    char buf[KV_RECMAX];
+    struct s_kvrec *r = (struct s_kvrec *)buf;
+    char *key = buf + sizeof(struct s_kvrec);
+    uint32_t a, to;
+    int len, slot, freeslot, s;
+    if(KvSectors == 0) return false;
+    if(KvPrep >= 0) {
+        KvPrepStep();
+        return true;
+    }
+    if(KvVictim < 0) {
+        if((KvVictim = KvChooseVictim()) < 0) {
+            KvBacklog = false;
+            return false;
+        }
+        KvCopyPos = KvSector[KvVictim].live ? KV_HDRSIZE : KvSector[KvVictim].used;
+        return true;
+    }
+    if(KvSector[KvVictim].state == KV_SERASING) {
+        if(KvBusy()) return true;
+        memset(&KvSector[KvVictim], 0, sizeof(struct s_kvsector));
+        KvSector[KvVictim].state = KV_SBLANK;
+        KvVictim = -1;
+        KvBacklog = (KvFreeCount() <= 2);
+        return false;
+    }
+    if(KvCopyPos + sizeof(struct s_kvrec) > KvSector[KvVictim].used) {
+        a = 0;                                      // everything has been copied so clear the magic number in case
+        KvWrite(KvAddr(KvVictim), &a, 4);           // the power fails part way through the erase and leaves old records
+        KvErase(KvAddr(KvVictim));
+        KvSector[KvVictim].state = KV_SERASING;
+        return true;
+    }
+    a = KvAddr(KvVictim) + KvCopyPos;
+    KvRead(a, r, sizeof(struct s_kvrec));
+    len = KV_RECSIZE(r->keylen, r->vallen);
+    if(r->type < KV_STR || r->type > KV_DEL || r->keylen == 0 || r->keylen > KV_MAXKEY || r->vallen > KV_MAXVALUE || KvCopyPos + len > KvSector[KvVictim].used) {
+        KvCopyPos = KvSector[KvVictim].used;        // the end of the log or a bad record
+        return true;
+    }
+    if((KvActive < 0 || KvSector[KvActive].used + len > KV_SECTOR) && (s = KvNextFree()) >= 0 && KvSector[s].state == KV_SFREE) {
+        KvPrep = s;                                 // a copy would start a new sector so make sure that it is blank first
+        KvPrepPos = 0;
+        return true;
+    }
+    KvCopyPos += len;
+    KvRead(a + sizeof(struct s_kvrec), key, r->keylen);
+    slot = KvFind(key, r->keylen, KvHash(key, r->keylen), &freeslot);
+    if(slot < 0 || KvIndex[slot].addr != a) return true;    // a later record has replaced it
+    if(r->type == KV_DEL && KvOldest(KvVictim)) {
+        KvIndex[slot].addr = KV_REMOVED;            // no older records for the key are left so the delete is not needed
+        KvSector[KvVictim].live -= len;
+        KvKeys--;
+        return true;
+    }
+    KvRead(a + sizeof(struct s_kvrec) + r->keylen, key + r->keylen, len - sizeof(struct s_kvrec) - r->keylen);
+    if((to = KvAppend(buf, len, 0)) == 0) {         // should not happen as one sector is always kept for this
+        KvVictim = -1;
+        return false;
+    }
+    KvSector[KvVictim].live -= len;
+    KvSector[KvSectorOf(to)].live += len;
+    KvIndex[slot].addr = to;
+    return true;
+}
+
+// wait for an erase started by the background to finish
+static void KvFinish(void) {
+    while(KvErasing()) KvCompactStep();
+}
+
+// compact one sector now, returns false if there was nothing to recover
+int KvCompact(void) {
+    KvFinish();
+    if(KvVictim < 0 && KvChooseVictim() < 0) return false;
+    while(KvCompactStep());
+    return KvVictim < 0;
+}
+
+// save a value, or delete the key if type is KV_DEL
+// nothing is written if the key already has the same value
+int KvPut(const char *key, int keylen, int type, const void *val, int vallen) {
+    char buf[KV_RECMAX];
+    struct s_kvrec *r = (struct s_kvrec *)buf, old;
+    uint32_t addr;
+    int slot, freeslot, len = KV_RECSIZE(keylen, vallen);
+    KvFinish();
+    if((slot = KvFind(key, keylen, KvHash(key, keylen), &freeslot)) >= 0) {
+        KvRead(KvIndex[slot].addr, &old, sizeof(old));
+        if(old.type == type && old.vallen == vallen) {
+            KvRead(KvIndex[slot].addr + sizeof(old) + keylen, buf, vallen);
+            if(vallen == 0 || memcmp(buf, val, vallen) == 0) return KV_OK;
+        }
+    } else {
+        if(type == KV_DEL) return KV_NOTFOUND;
+        if(freeslot < 0 || KvKeys >= KVMAXKEYS - 1) return KV_NOKEYS;
+    }
+    memset(buf, 0xFF, len);                         // the padding is left unprogrammed
+    r->type = type;
+    r->keylen = keylen;
+    r->vallen = vallen;
+    memcpy(buf + sizeof(struct s_kvrec), key, keylen);
+    memcpy(buf + sizeof(struct s_kvrec) + keylen, val, vallen);
+    r->crc = KvCrc(r, buf + sizeof(struct s_kvrec), keylen + vallen);
+    while((addr = KvAppend(buf, len, 1)) == 0)      // one sector is kept back for compaction
+        if(!KvCompact()) return KV_FULL;
+    return KvLink(key, keylen, addr, len);
+}
+
+int KvDelete(const char *key, int keylen) {
+    return KvPut(key, keylen, KV_DEL, "", 0);
+}
+
+// get a value, val must have room for KV_MAXVALUE bytes
+int KvGet(const char *key, int keylen, int *type, void *val, int *vallen) {
+    struct s_kvrec r;
+    int slot, freeslot;
+    KvFinish();
+    if((slot = KvFind(key, keylen, KvHash(key, keylen), &freeslot)) < 0) return KV_NOTFOUND;
+    KvRead(KvIndex[slot].addr, &r, sizeof(r));
+    if(r.type == KV_DEL) return KV_NOTFOUND;
+    *type = r.type;
+    *vallen = r.vallen;
+    KvRead(KvIndex[slot].addr + sizeof(r) + r.keylen, val, r.vallen);
+    return KV_OK;
+}
+
+// get the next key and value in the index starting at slot, returns the slot to carry on from or -1 at the end
+int KvEntry(int slot, char *key, int *keylen, int *type, void *val, int *vallen) {
+    struct s_kvrec r;
+    KvFinish();
+    for(; slot >= 0 && slot < KVMAXKEYS; slot++) {
+        if(KvIndex[slot].addr == KV_EMPTY || KvIndex[slot].addr == KV_REMOVED) continue;
+        KvRead(KvIndex[slot].addr, &r, sizeof(r));
+        if(r.type == KV_DEL) continue;
+        *type = r.type;
+        *keylen = r.keylen;
+        *vallen = r.vallen;
+        KvRead(KvIndex[slot].addr + sizeof(r), key, r.keylen);
+        KvRead(KvIndex[slot].addr + sizeof(r) + r.keylen, val, r.vallen);
+        return slot + 1;
+    }
+    return -1;
+}
+
+// erase every sector and start again
+int KvFormat(void) {
+    int s;
+    KvFinish();
+    for(s = 0; s < KvSectors; s++) {
+        KvErase(KvAddr(s));
+        while(KvBusy());
+    }
+    return KvOpen(KvBase, KvSectors);
+}
+
+void KvStatus(int *keys, int *blank, int *used, int *live) {
+    int s;
+    *keys = KvKeys;
+    *blank = KvFreeCount();
+    *used = *live = 0;
+    for(s = 0; s < KvSectors; s++) {
+        if(KvSector[s].state != KV_SUSED) continue;
+        *used += KvSector[s].used;
+        *live += KvSector[s].live;
+    }
+}
@@ -106,9 +106,9 @@ const double chitable[51][15]={
 		{27.991,29.707,32.357,34.764,37.689,49.335,58.164,63.167,67.505,71.420,72.613,76.154,79.490,83.657,86.661}
 };
 #endif
-MMFLOAT determinant(MMFLOAT **matrix,int size);
-void transpose(MMFLOAT **matrix,MMFLOAT **matrix_cofactor,MMFLOAT **newmatrix, int size);
-void cofactor(MMFLOAT **matrix,MMFLOAT **newmatrix,int size);
+int LUDecompose(MMFLOAT *a, int n, int *perm);
+void LUSolve(MMFLOAT *lu, int n, int *perm, MMFLOAT *b, MMFLOAT *x);
+int QRLeastSquares(MMFLOAT *a, int m, int n, MMFLOAT *b, MMFLOAT *x);
 static void floatshellsort(MMFLOAT a[],  int n) {
     long h, l, j;
     MMFLOAT k;
@@ -499,6 +499,113 @@ int64_t iarr2d(int64_t *arr,int d1, int a, int b){
 	arr+=d1*b+a;
 	return *arr;
 }
+/* MATH SINGLE
+ * MMFLOAT is double but the F407 FPU only does single precision so every MATH operation on a FLOAT array goes
+ * through the soft float library.  MATH SINGLE works on float32 values packed two to each element of an integer
+ * array (the same way that ADC STREAM packs its samples) so these loops compile to FPU instructions with no
+ * conversions.  PACK and UNPACK convert to and from the normal arrays, the values are rounded to 24 bits.
+ */
+#define SINGLEBLOCK 64                                      // nbr of floats summed in single precision before adding to the total
+
+// get an integer array holding packed floats, returns the number of floats in it
+static int parsesinglearray(char *tp, float **a, int argno, bool ConstantNotAllowed){
+	int64_t *a1int=NULL;
+	short dims[MAXDIM]={0};
+	int card=parseintegerarray(tp, &a1int, argno, 0, dims, ConstantNotAllowed);
+	*a = (float *)a1int;
+	return card * 2;
+}
+
+// sum a[] or the products of a[] and b[], each block is summed on the FPU and the blocks are added in double
+// so the rounding error does not grow with the size of the array (this also works with -ffast-math)
+static MMFLOAT SingleSum(float *a, float *b, int n){
+	MMFLOAT sum=0;
+	float part;
+	int i, j;
+	for(i=0; i<n; i+=j){
+		part=0;
+		if(b==NULL) for(j=0; j<SINGLEBLOCK && i+j<n; j++)part += a[i+j];
+		else for(j=0; j<SINGLEBLOCK && i+j<n; j++)part += a[i+j] * b[i+j];
+		sum += part;
+	}
+	return sum;
+}
+
+// MATH SINGLE PACK in(), out%()            UNPACK in%(), out!()
+// MATH SINGLE SCALE in%(), scale, out%()   ADD in%(), num, out%()
+// MATH SINGLE C_ADD | C_SUB | C_MUL | C_DIV a%(), b%(), out%()
+static void cmd_mathsingle(char *pp){
+	char *tp, *tp1;
+	float *a1, *a2, *a3, v;
+	int i, card1, card2, card3;
+	tp = checkstring(pp, (char *)"PACK");
+	if(tp) {
+		MMFLOAT *a1float=NULL;
+		int64_t *a1int=NULL;
+		short dims[MAXDIM]={0};
+		getargs(&tp, 3,(char *)",");
+		if(!(argc == 3)) error("Argument count");
+		card1=parsenumberarray(argv[0], &a1float, &a1int, 1, 0, dims, false);
+		card2=parsesinglearray(argv[2], &a2, 2, true);
+		if(card2 < card1 || card2 > card1 + 1)error("Array size mismatch");
+		if(a1float!=NULL){
+			for(i=0; i< card1;i++)*a2++ = (float)*a1float++;
+		} else {
+			for(i=0; i< card1;i++)*a2++ = (float)*a1int++;
+		}
+		if(card2 > card1)*a2 = 0;                           // an odd number of values leaves half an element over
+		return;
+	}
+	tp = checkstring(pp, (char *)"UNPACK");
+	if(tp) {
+		MMFLOAT *a2float=NULL;
+		short dims[MAXDIM]={0};
+		getargs(&tp, 3,(char *)",");
+		if(!(argc == 3)) error("Argument count");
+		card1=parsesinglearray(argv[0], &a1, 1, false);
+		card2=parsefloatrarray(argv[2], &a2float, 2, 0, dims, true);
+		if(card1 < card2 || card1 > card2 + 1)error("Array size mismatch");
+		for(i=0; i< card2;i++)*a2float++ = *a1++;
+		return;
+	}
+	tp = checkstring(pp, (char *)"SCALE");
+	tp1 = checkstring(pp, (char *)"ADD");
+	if(tp || tp1) {
+		if(tp1)tp=tp1;
+		getargs(&tp, 5,(char *)",");
+		if(!(argc == 5)) error("Argument count");
+		card1=parsesinglearray(argv[0], &a1, 1, false);
+		v=getnumber(argv[2]);
+		card2=parsesinglearray(argv[4], &a2, 3, true);
+		if(card1 != card2)error("Array size mismatch");
+		if(tp1){
+			for(i=0; i< card1;i++)*a2++ = *a1++ + v;
+		} else {
+			for(i=0; i< card1;i++)*a2++ = *a1++ * v;
+		}
+		return;
+	}
+	int op = 0;
+	if((tp = checkstring(pp, (char *)"C_ADD")))op = '+';
+	else if((tp = checkstring(pp, (char *)"C_SUB")))op = '-';
+	else if((tp = checkstring(pp, (char *)"C_MUL")) || (tp = checkstring(pp, (char *)"C_MULT")))op = '*';
+	else if((tp = checkstring(pp, (char *)"C_DIV")))op = '/';
+	if(op) {
+		getargs(&tp, 5,(char *)",");
+		if(!(argc == 5)) error("Argument count");
+		card1=parsesinglearray(argv[0], &a1, 1, false);
+		card2=parsesinglearray(argv[2], &a2, 2, false);
+		card3=parsesinglearray(argv[4], &a3, 3, true);
+		if(card1 != card2 || card1 != card3)error("Array size mismatch");
+		if(op == '+') for(i=0; i< card1;i++)*a3++ = *a1++ + *a2++;
+		if(op == '-') for(i=0; i< card1;i++)*a3++ = *a1++ - *a2++;
+		if(op == '*') for(i=0; i< card1;i++)*a3++ = *a1++ * *a2++;
+		if(op == '/') for(i=0; i< card1;i++)*a3++ = *a1++ / *a2++;
+		return;
+	}
+	error("Syntax");
+}
+
 void cmd_math(void){
 	char *tp;
     int t = T_NBR;
@@ -510,6 +617,12 @@ void cmd_math(void){
 	skipspace(cmdline);
 	if(toupper(*cmdline)=='S'){
 
+		tp = checkstring(cmdline, (char *)"SINGLE");
+		if(tp) {
+			cmd_mathsingle(tp);
+			return;
+		}
+
 		tp = checkstring(cmdline, ( char *)"SET");
 		if(tp) {
 			int i,card1=1;
@@ -830,8 +943,8 @@ void cmd_math(void){
 	} else if(toupper(*cmdline)=='M') {
 		tp = checkstring(cmdline, ( char *)"M_INVERSE");
 		if(tp){
-			int i, j, n, numcols=0, numrows=0;
-			MMFLOAT *a1float=NULL, *a2float=NULL,det;
+			int i, j, n, numcols=0, numrows=0, *perm;
+			MMFLOAT *a1float=NULL, *a2float=NULL, *lu, *b, *x;
 			getargs(&tp, 3,( char *)",");
 			if(!(argc == 3)) error("Argument count");
 			parsefloatrarray(argv[0], &a1float, 1,2,dims, false);
@@ -842,27 +955,44 @@ void cmd_math(void){
 			if(numcols!=numrows)error("Array must be square");
 			if(a1float==a2float)error("Same array specified for input and output");
 			n=numrows+1;
-			MMFLOAT **matrix=alloc2df(n,n);
-			for(i=0;i<n;i++){ //load the matrix
-				for(j=0;j<n;j++){
-					matrix[j][i]=*a1float++;
-				}
-			}
-			det=determinant(matrix,n);
-			if(det==0.0){
-				dealloc2df(matrix,numcols,numrows);
-				error("Determinant of array is zero");
+			lu=GetTempMemory(n*n*sizeof(MMFLOAT));
+			b=GetTempMemory(n*sizeof(MMFLOAT));
+			x=GetTempMemory(n*sizeof(MMFLOAT));
+			perm=GetTempMemory(n*sizeof(int));
+			memcpy(lu,a1float,n*n*sizeof(MMFLOAT));
+			if(LUDecompose(lu,n,perm)==0)error("Determinant of array is zero");
+			for(j=0;j<n;j++){ //solve for each column of the identity matrix
+				for(i=0;i<n;i++)b[i]=(i==j);
+				LUSolve(lu,n,perm,b,x);
+				for(i=0;i<n;i++)a2float[i*n+j]=x[i];
 			}
-			MMFLOAT **matrix1=alloc2df(n,n);
-			cofactor(matrix, matrix1, n);
-			for(i=0;i<n;i++){ //load the matrix
-				for(j=0;j<n;j++){
-					*a2float++=matrix1[j][i];
-				}
+			return;
+		}
+		tp = checkstring(cmdline, ( char *)"M_SOLVE");
+		if(tp){
+			int n, numcols=0, numrows=0, *perm;
+			MMFLOAT *a1float=NULL, *a2float=NULL, *a3float=NULL, *lu, *b;
+			getargs(&tp, 5,( char *)",");
+			if(!(argc == 5)) error("Argument count");
+			parsefloatrarray(argv[0], &a1float, 1,2,dims, false);
+			numcols=dims[0] + 1 - OptionBase;
+			numrows=dims[1] + 1 - OptionBase;
+			if(numrows<numcols)error("Array must have at least as many rows as columns");
+			if(parsefloatrarray(argv[2], &a2float, 2,1,dims, false)!=numrows)error("Array size mismatch");
+			if(parsefloatrarray(argv[4], &a3float, 3,1,dims, true)!=numcols)error("Array size mismatch");
+			if(a3float==a1float || a3float==a2float)error("Destination array same as source");
+			n=numcols;
+			lu=GetTempMemory(numrows*n*sizeof(MMFLOAT));
+			memcpy(lu,a1float,numrows*n*sizeof(MMFLOAT));
+			if(numrows==n){ // a square matrix so solve directly
+				perm=GetTempMemory(n*sizeof(int));
+				if(LUDecompose(lu,n,perm)==0)error("Determinant of array is zero");
+				LUSolve(lu,n,perm,a2float,a3float);
+			} else { // more equations than unknowns so find the least squares fit
+				b=GetTempMemory(numrows*sizeof(MMFLOAT));
+				memcpy(b,a2float,numrows*sizeof(MMFLOAT));
+				if(!QRLeastSquares(lu,numrows,n,b,a3float))error("Array columns are not independent");
 			}
-			dealloc2df(matrix,numcols,numrows);
-			dealloc2df(matrix1,numcols,numrows);
-
 			return;
 		}
 		tp = checkstring(cmdline, ( char *)"M_TRANSPOSE");
@@ -1952,8 +2082,8 @@ void fun_math(void){
 	} else if(toupper(*ep)=='M') {
 		tp = checkstring(ep, (char *)"M_DETERMINANT");
 		if(tp){
-			int i, j, n, numcols=0, numrows=0;
-			MMFLOAT *a1float=NULL;
+			int i, n, numcols=0, numrows=0, *perm, sign;
+			MMFLOAT *a1float=NULL, *lu;
 			getargs(&tp, 1,(char *)",");
 			if(!(argc == 1)) error("Argument count");
 			parsefloatrarray(argv[0],&a1float,1,2,dims, false);
@@ -1961,14 +2091,12 @@ void fun_math(void){
 			numrows=dims[1]+1-OptionBase;
 			if(numcols!=numrows)error("Array must be square");
 			n=numrows;
-			MMFLOAT **matrix=alloc2df(n,n);
-			for(i=0;i<n;i++){ //load the matrix
-				for(j=0;j<n;j++){
-					matrix[j][i]=*a1float++;
-				}
-			}
-			fret=determinant(matrix,n);
-			dealloc2df(matrix,numcols,numrows);
+			lu=GetTempMemory(n*n*sizeof(MMFLOAT));
+			perm=GetTempMemory(n*sizeof(int));
+			memcpy(lu,a1float,n*n*sizeof(MMFLOAT));
+			sign=LUDecompose(lu,n,perm);
+			fret=sign;
+			for(i=0;i<n && sign;i++)fret*=lu[i*n+i];     // the determinant is the product of the diagonal of U
 			targ=T_NBR;
 
 			return;
@@ -2117,6 +2245,30 @@ void fun_math(void){
 		}
 	} else if(toupper(*ep)=='S') {
 
+		// MATH(SINGLE SUM a%())   MATH(SINGLE DOTPRODUCT a%(), b%())   for packed floats (see MATH SINGLE)
+		tp = checkstring(ep, (char *)"SINGLE");
+		if(tp) {
+			char *tp1;
+			float *a1, *a2;
+			int card1, card2;
+			if((tp1 = checkstring(tp, (char *)"SUM"))) {
+				getargs(&tp1, 1,(char *)",");
+				if(!(argc == 1)) error("Argument count");
+				card1=parsesinglearray(argv[0], &a1, 1, false);
+				fret=SingleSum(a1, NULL, card1);
+			} else if((tp1 = checkstring(tp, (char *)"DOTPRODUCT"))) {
+				getargs(&tp1, 3,(char *)",");
+				if(!(argc == 3)) error("Argument count");
+				card1=parsesinglearray(argv[0], &a1, 1, false);
+				card2=parsesinglearray(argv[2], &a2, 2, false);
+				if(card1!=card2)error("Array size mismatch");
+				fret=SingleSum(a1, a2, card1);
+			} else
+				error("Syntax");
+			targ=T_NBR;
+			return;
+		}
+
 		tp = checkstring(ep, (char *)"SINH");
 		if(tp) {
 			getargs(&tp, 1,(char *)",");
@@ -2202,59 +2354,116 @@ void fun_math(void){
 	error("Syntax");
 }
 
-static size_t reverse_bits(size_t val, int width) {
-	size_t result = 0;
-	for (int i = 0; i < width; i++, val >>= 1)
-		result = (result << 1) | (val & 1U);
-	return result;
+/*
+ The FFT engine
+ The twiddle factors are calculated once and kept in a plan which is reused until a different size is needed (or
+ the program is run again).  The plan for n points holds exp(-2*pi*i*k/n) for k = 0 to n/2-1 which covers a complex
+ transform of n/2 points (every second entry) plus the extra step needed for a real transform of n points.
+ A real transform of n points is done as a complex transform of n/2 points and all transforms work in place in the
+ caller's output array so no complex temporary array is needed.
+*/
+static struct {
+	int n;                                                          // the size that the plan is for (zero if none)
+	cplx *tw;                                                       // the twiddle factors
+} fftplan;
+
+// discard the plan.  This must be called before the heap is cleared
+void FftPlanClear(void) {
+	FreeMemorySafe((void **)&fftplan.tw);
+	fftplan.n = 0;
 }
 
-bool Fft_transformRadix2(double complex vec[], size_t n, bool inverse) {
-	// Length variables
-	int levels = 0;  // Compute levels = floor(log2(n))
-	for (size_t temp = n; temp > 1U; temp >>= 1)
-		levels++;
-	if ((size_t)1U << levels != n)
-		return false;  // n is not a power of 2
-
-	// Trigonometric tables
-	if (SIZE_MAX / sizeof(double complex) < n / 2)
-		return false;
-	double complex *exptable = GetMemory((n / 2) * sizeof(double complex));
-	if (exptable == NULL)
-		return false;
-	for (size_t i = 0; i < n / 2; i++)
-		exptable[i] = cexp((inverse ? 2 : -2) * M_PI * i / n * I);
-
-	// Bit-reversed addressing permutation
-	for (size_t i = 0; i < n; i++) {
-		size_t j = reverse_bits(i, levels);
-		if (j > i) {
-			double complex temp = vec[i];
-			vec[i] = vec[j];
-			vec[j] = temp;
+// make sure that the plan is for n points
+static void FftPlan(int n) {
+	int k;
+	if(fftplan.n != n) {
+		FftPlanClear();
+		fftplan.tw = GetMemory((n / 2) * sizeof(cplx));
+		for(k = 0; k < n / 4; k++) {                                // W^(k + n/4) = -i * W^k so only a quarter of a cycle needs sin/cos
+			fftplan.tw[k] = __builtin_complex(cos(2 * M_PI * k / n), -sin(2 * M_PI * k / n));
+			fftplan.tw[k + n / 4] = __builtin_complex(cimag(fftplan.tw[k]), -creal(fftplan.tw[k]));
 		}
+		if(n == 2) fftplan.tw[0] = 1.0;
+		fftplan.n = n;
 	}
+}
+
+// complex multiply without the checks for infinities that the C library does
+static inline cplx cmul(cplx a, cplx b) {
+	return __builtin_complex(creal(a) * creal(b) - cimag(a) * cimag(b), creal(a) * cimag(b) + cimag(a) * creal(b));
+}
 
-	// Cooley-Tukey decimation-in-time radix-2 FFT
-	for (size_t size = 2; size <= n; size *= 2) {
-		size_t halfsize = size / 2;
-		size_t tablestep = n / size;
-		for (size_t i = 0; i < n; i += size) {
-			for (size_t j = i, k = 0; j < i + halfsize; j++, k += tablestep) {
-				size_t l = j + halfsize;
-				double complex temp = vec[l] * exptable[k];
-				vec[l] = vec[j] - temp;
-				vec[j] += temp;
+/*
+ forward complex FFT of m points in place.  tw[] holds the twiddles for n points and s = n/m
+ after the bit reversal permutation, a radix-2 stage is used if the number of levels is odd and then radix-4 stages.
+ Each radix-4 stage combines four transforms of size h into one of size 4h.  Because the order is from the radix-2
+ bit reversal the four transforms are of the samples with the residues 0, 2, 1, 3 (mod 4)
+*/
+static void FftCore(cplx *v, int m, cplx *tw, int s) {
+	int i, j, k, k3, h, step, n2 = m * s / 2;
+	cplx t, t0, t1, t2, t3, *a;
+	for(i = 0, j = 0; i < m - 1; i++) {                             // bit reversal permutation
+		if(i < j) { t = v[i]; v[i] = v[j]; v[j] = t; }
+		k = m >> 1;
+		while(k <= j) { j -= k; k >>= 1; }
+		j += k;
+	}
+	for(h = 1, i = m; i > 1; i >>= 2) if(i == 2) h = 2;             // h = 2 if an odd number of levels
+	if(h == 2) {
+		for(i = 0; i < m; i += 2) { t = v[i + 1]; v[i + 1] = v[i] - t; v[i] += t; }
+	}
+	for(; h < m; h *= 4) {
+		step = s * (m / (4 * h));
+		for(i = 0; i < m; i += 4 * h) {
+			for(j = 0, k = 0; j < h; j++, k += step) {
+				a = &v[i + j];
+				k3 = 3 * k;
+				t0 = a[0];
+				t2 = cmul(a[h], tw[2 * k]);
+				t1 = cmul(a[2 * h], tw[k]);
+				t3 = cmul(a[3 * h], (k3 < n2) ? tw[k3] : -tw[k3 - n2]);
+				t = t1 + t3;
+				a[0] = t0 + t2 + t;
+				a[2 * h] = t0 + t2 - t;
+				t = t1 - t3;
+				t = __builtin_complex(cimag(t), -creal(t));             // -i * (t1 - t3)
+				a[h] = t0 - t2 + t;
+				a[3 * h] = t0 - t2 - t;
 			}
 		}
-		if (size == n)  // Prevent overflow in 'size *= 2'
-			break;
 	}
+}
 
+// forward complex FFT of m points in place using the current plan
+static void FftComplex(cplx *z, int m) {
+	FftCore(z, m, fftplan.tw, fftplan.n / m);
+}
+
+// FFT of n real samples in v[].  On return v[] holds X[0] to X[n/2-1] as complex values and X[n/2] (which is real)
+// is returned in *nyq.  The rest of the transform is the complex conjugate of these in reverse order.
+static void FftReal(MMFLOAT *v, int n, MMFLOAT *nyq) {
+	int k, m = n / 2;
+	cplx *z = (cplx *)v, zk, zm, e, o, d;
+	FftPlan(n);
+	FftComplex(z, m);                                               // transform the even samples (real part) and odd samples (imaginary part) together
+	*nyq = creal(z[0]) - cimag(z[0]);
+	z[0] = creal(z[0]) + cimag(z[0]);
+	for(k = 1; k <= m / 2; k++) {                                   // separate them and combine into the transform of n points
+		zk = z[k];
+		zm = conj(z[m - k]);
+		e = (zk + zm) * 0.5;
+		d = zk - zm;
+		o = __builtin_complex(cimag(d) * 0.5, -creal(d) * 0.5);
+		z[k] = e + cmul(fftplan.tw[k], o);
+		if(k != m - k) z[m - k] = conj(e) + cmul(fftplan.tw[m - k], conj(o));
+	}
+}
 
-	FreeMemory(exptable);
-	return true;
+// check that the size of a FFT is a power of 2 (between 2 and 32768)
+static void FftCheckSize(int n) {
+	int i;
+	for(i = 2; i < 65536; i *= 2) if(n == i) return;
+	error("array size must be a power of 2");
 }
 
 
@@ -2262,78 +2471,64 @@ void cmd_FFT(char *pp){
     char *tp;
 	PI = atan2(1, 1) * 4;
 	short dims[MAXDIM]={0};
-    cplx *a1cplx=NULL, *a2cplx=NULL;
-    MMFLOAT *a3float=NULL, *a4float=NULL, *a5float;
-    int i, card1,card2, powerof2=0;
+    cplx *z, *x;
+    MMFLOAT *a3float=NULL, *a4float=NULL, nyq, e;
+    int i, card1,card2, m;
 	tp = checkstring(pp, (char *)"MAGNITUDE");
+	if(!tp) tp = checkstring(pp, (char *)"PHASE");
 	if(tp) {
+		int phase = (toupper(*pp) == 'P');
 		getargs(&tp,3,(char *)",");
 		card1=parsefloatrarray(argv[0],&a3float,1,1,dims, false);
 		card2=parsefloatrarray(argv[2],&a4float,2,1,dims, true);
 	    if(card1 !=card2)error("Array size mismatch");
-	    for(i=1;i<65536;i*=2){
-	    	if(card1==i)powerof2=1;
-	    }
-	    if(!powerof2)error("array size must be a power of 2");
-        a1cplx=(cplx *)GetTempMemory((card1)*16);
-        a5float=(MMFLOAT *)a1cplx;
-        for(i=0;i<card1;i++){a5float[i*2]=a3float[i];a5float[i*2+1]=0;}
-        Fft_transformRadix2(a1cplx, card1, 0);
-//	    fft((MMFLOAT *)a1cplx,size+1);
-	    for(i=0;i<card1;i++)a4float[i]=cabs(a1cplx[i]);
-		return;
-	}
-	tp = checkstring(pp, (char *)"PHASE");
-	if(tp) {
-		getargs(&tp,3,(char *)",");
-		card1=parsefloatrarray(argv[0],&a3float,1,1,dims, false);
-		card2=parsefloatrarray(argv[2],&a4float,2,1,dims, true);
-	    if(card1 !=card2)error("Array size mismatch");
-	    for(i=1;i<65536;i*=2){
-	    	if(card1==i)powerof2=1;
+	    FftCheckSize(card1);
+	    m = card1 / 2;
+	    if(a4float != a3float) memcpy(a4float, a3float, card1 * sizeof(MMFLOAT));
+	    FftReal(a4float, card1, &nyq);
+	    z = (cplx *)a4float;
+	    for(i = 0; i < m; i++) {                                    // the result for X[i] goes where the real part of X[i/2] was so this does not overwrite X[] before it is used
+	    	e = phase ? carg(z[i]) : cabs(z[i]);
+	    	a4float[i] = e;
 	    }
-	    if(!powerof2)error("array size must be a power of 2");
-        a1cplx=(cplx *)GetTempMemory((card1)*16);
-        a5float=(MMFLOAT *)a1cplx;
-        for(i=0;i<card1;i++){a5float[i*2]=a3float[i];a5float[i*2+1]=0;}
-        Fft_transformRadix2(a1cplx, card1, 0);
-//	    fft((MMFLOAT *)a1cplx,size+1);
-	    for(i=0;i<card1;i++)a4float[i]=carg(a1cplx[i]);
+	    a4float[m] = phase ? atan2(0.0, nyq) : fabs(nyq);
+	    for(i = 1; i < m; i++) a4float[card1 - i] = phase ? -a4float[i] : a4float[i];
 		return;
 	}
 	tp = checkstring(pp, (char *)"INVERSE");
 	if(tp) {
+		cplx h0, h1, o;
 		getargs(&tp,3,(char *)",");
 		card1=parsefloatrarray(argv[0],&a4float,1,2,dims, false);
 		int size=dims[1] - OptionBase +1;
-		a1cplx=(cplx *)a4float;
+		x=(cplx *)a4float;
 		card2=parsefloatrarray(argv[2],&a3float,2,1,dims, true);
 	    if(card2 !=size)error("Array size mismatch");
-	    for(i=1;i<65536;i*=2){
-	    	if(card2==i)powerof2=1;
+	    FftCheckSize(card2);
+	    m = card2 / 2;
+	    z = (cplx *)a3float;
+	    FftPlan(card2);
+	    for(i = 0; i < m; i++) {                                    // only the real part of the result is wanted so use the conjugate symmetric part of the input
+	    	h0 = (x[i] + conj(x[(card2 - i) % card2])) * 0.5;
+	    	h1 = (x[i + m] + conj(x[m - i])) * 0.5;
+	    	o = cmul((h0 - h1) * 0.5, conj(fftplan.tw[i]));        // the transform of the odd samples
+	    	z[i] = conj((h0 + h1) * 0.5 + __builtin_complex(-cimag(o), creal(o)));
 	    }
-	    if(!powerof2)error("array size must be a power of 2");
-        a2cplx=(cplx *)GetTempMemory((card2)*16);
-	    memcpy(a2cplx,a1cplx,card2*16);
-	    for(i=0;i<card2;i++)a2cplx[i]=conj(a2cplx[i]);
-        Fft_transformRadix2(a2cplx, card2, 0);
-//	    fft((MMFLOAT *)a2cplx,size+1);
-	    for(i=0;i<card2;i++)a2cplx[i]=conj(a2cplx[i])/(cplx)(card2);
-	    for(i=0;i<card2;i++)a3float[i]=creal(a2cplx[i]);
+	    FftComplex(z, m);                                           // the inverse is the conjugate of the forward transform of the conjugate
+	    for(i = 0; i < m; i++) z[i] = conj(z[i]) / (MMFLOAT)m;      // this leaves the even samples in the real part and the odd samples in the imaginary part
 	    return;
 	}
 	getargs(&pp,3,(char *)",");
 	card1=parsefloatrarray(argv[0],&a3float,1,1,dims, false);
 	card2=parsefloatrarray(argv[2],&a4float,2,2,dims, true);
-    a2cplx = (cplx *)a4float;
     if((dims[1] - OptionBase + 1) !=card1)error("Array size mismatch");
-    for(i=1;i<65536;i*=2){
-    	if(card1==i)powerof2=1;
-    }
-    if(!powerof2)error("array size must be a power of 2");
-    for(i=0;i<card1;i++){a4float[i*2]=a3float[i];a4float[i*2+1]=0;}
-//    fft((MMFLOAT *)a2cplx,size+1);
-    Fft_transformRadix2(a2cplx, card1, 0);
+    FftCheckSize(card1);
+    m = card1 / 2;
+    memcpy(a4float, a3float, card1 * sizeof(MMFLOAT));
+    FftReal(a4float, card1, &nyq);
+    z = (cplx *)a4float;
+    z[m] = nyq;
+    for(i = 1; i < m; i++) z[card1 - i] = conj(z[i]);
 }
 /*
 void cmd_SensorFusion(char *passcmdline){
@@ -2618,116 +2813,89 @@ void MahonyQuaternionUpdate(MMFLOAT ax, MMFLOAT ay, MMFLOAT az, MMFLOAT gx, MMFL
             *yaw = atan2(t3, t4);
         }
 */
-/*Finding transpose of cofactor of matrix*/
-void transpose(MMFLOAT **matrix,MMFLOAT **matrix_cofactor,MMFLOAT **newmatrix, int size)
+/*
+ LU decomposition with partial pivoting of the n x n matrix in a[] (row major, which is how MMBasic stores a
+ 2D array with the column as the first index).  This is done in place, L (with an implied unit diagonal) is
+ below the diagonal and U is on and above it.  perm[] receives the order of the rows.
+ Returns the sign of the permutation (+1 or -1) or 0 if the matrix is singular
+*/
+int LUDecompose(MMFLOAT *a, int n, int *perm)
 {
-    int i,j;
-    MMFLOAT d;
-	MMFLOAT **m_transpose=alloc2df(size,size);
-	MMFLOAT **m_inverse=alloc2df(size,size);
-
-    for (i=0;i<size;i++)
-    {
-        for (j=0;j<size;j++)
-        {
-            m_transpose[i][j]=matrix_cofactor[j][i];
+    int i, j, k, p, sign = 1;
+    MMFLOAT max, t, *rk, *ri;
+    for (i = 0; i < n; i++) perm[i] = i;
+    for (k = 0; k < n; k++) {
+        p = k; max = fabs(a[k * n + k]);
+        for (i = k + 1; i < n; i++) {                               // find the pivot
+            if (fabs(a[i * n + k]) > max) { max = fabs(a[i * n + k]); p = i; }
         }
-    }
-    d=determinant(matrix,size);
-    for (i=0;i<size;i++)
-    {
-        for (j=0;j<size;j++)
-        {
-            m_inverse[i][j]=m_transpose[i][j] / d;
+        if (max == 0.0) return 0;
+        if (p != k) {                                               // swap the rows
+            rk = &a[k * n]; ri = &a[p * n];
+            for (j = 0; j < n; j++) { t = rk[j]; rk[j] = ri[j]; ri[j] = t; }
+            i = perm[k]; perm[k] = perm[p]; perm[p] = i;
+            sign = -sign;
         }
-    }
-
-    for (i=0;i<size;i++)
-    {
-        for (j=0;j<size;j++)
-        {
-            newmatrix[i][j]=m_inverse[i][j];
+        rk = &a[k * n];
+        for (i = k + 1; i < n; i++) {                               // eliminate below the pivot
+            ri = &a[i * n];
+            t = ri[k] /= rk[k];
+            if (t != 0.0) for (j = k + 1; j < n; j++) ri[j] -= t * rk[j];
         }
     }
-	dealloc2df(m_transpose,size,size);
-	dealloc2df(m_inverse,size,size);
+    return sign;
 }
-/*calculate cofactor of matrix*/
-void cofactor(MMFLOAT **matrix,MMFLOAT **newmatrix,int size)
+
+/* solve A x = b using the output of LUDecompose(). b[] and x[] must be different arrays */
+void LUSolve(MMFLOAT *lu, int n, int *perm, MMFLOAT *b, MMFLOAT *x)
 {
-	MMFLOAT **m_cofactor=alloc2df(size,size);
-	MMFLOAT **matrix_cofactor=alloc2df(size,size);
-    int p,q,m,n,i,j;
-    for (q=0;q<size;q++)
-    {
-        for (p=0;p<size;p++)
-        {
-            m=0;
-            n=0;
-            for (i=0;i<size;i++)
-            {
-                for (j=0;j<size;j++)
-                {
-                    if (i != q && j != p)
-                    {
-                       m_cofactor[m][n]=matrix[i][j];
-                       if (n<(size-2))
-                          n++;
-                       else
-                       {
-                           n=0;
-                           m++;
-                       }
-                    }
-                }
-            }
-            matrix_cofactor[q][p]=pow(-1,q + p) * determinant(m_cofactor,size-1);
-        }
+    int i, j;
+    MMFLOAT sum;
+    for (i = 0; i < n; i++) {                                       // forward substitution with L
+        sum = b[perm[i]];
+        for (j = 0; j < i; j++) sum -= lu[i * n + j] * x[j];
+        x[i] = sum;
+    }
+    for (i = n - 1; i >= 0; i--) {                                  // back substitution with U
+        sum = x[i];
+        for (j = i + 1; j < n; j++) sum -= lu[i * n + j] * x[j];
+        x[i] = sum / lu[i * n + i];
     }
-    transpose(matrix, matrix_cofactor, newmatrix, size);
-	dealloc2df(m_cofactor,size,size);
-	dealloc2df(matrix_cofactor,size,size);
-
 }
-/*For calculating Determinant of the Matrix . this function is recursive*/
-MMFLOAT determinant(MMFLOAT **matrix,int size)
+
+/*
+ least squares solution of the m x n (m >= n) system A x = b using Householder QR.  a[] (row major) and b[]
+ are overwritten.  Returns false if A does not have full rank
+*/
+int QRLeastSquares(MMFLOAT *a, int m, int n, MMFLOAT *b, MMFLOAT *x)
 {
-   MMFLOAT s=1,det=0;
-   MMFLOAT **m_minor=alloc2df(size,size);
-   int i,j,m,n,c;
-   if (size==1)
-   {
-       return (matrix[0][0]);
-   }
-   else
-   {
-       det=0;
-       for (c=0;c<size;c++)
-       {
-           m=0;
-           n=0;
-           for (i=0;i<size;i++)
-           {
-               for (j=0;j<size;j++)
-               {
-                   m_minor[i][j]=0;
-                   if (i != 0 && j != c)
-                   {
-                      m_minor[m][n]=matrix[i][j];
-                      if (n<(size-2))
-                         n++;
-                      else
-                      {
-                          n=0;
-                          m++;
-                      }
-                   }
-               }
-           }
-           det=det + s * (matrix[0][c] * determinant(m_minor,size-1));
-           s=-1 * s;
-       }
-   }
-   dealloc2df(m_minor,size,size);
-   return (det);
+    int i, j, k;
+    MMFLOAT norm, alpha, vtv, s, *diag = GetTempMemory(n * sizeof(MMFLOAT));
+    for (k = 0; k < n; k++) {
+        norm = 0.0;
+        for (i = k; i < m; i++) norm += a[i * n + k] * a[i * n + k];
+        norm = sqrt(norm);
+        if (norm == 0.0) return false;
+        alpha = (a[k * n + k] > 0) ? -norm : norm;
+        a[k * n + k] -= alpha;                                      // column k below the diagonal is now the Householder vector v
+        vtv = 0.0;
+        for (i = k; i < m; i++) vtv += a[i * n + k] * a[i * n + k];
+        for (j = k + 1; j < n; j++) {                               // apply I - 2vv'/v'v to the remaining columns
+            s = 0.0;
+            for (i = k; i < m; i++) s += a[i * n + k] * a[i * n + j];
+            s = 2.0 * s / vtv;
+            for (i = k; i < m; i++) a[i * n + j] -= s * a[i * n + k];
+        }
+        s = 0.0;                                                    // and to b
+        for (i = k; i < m; i++) s += a[i * n + k] * b[i];
+        s = 2.0 * s / vtv;
+        for (i = k; i < m; i++) b[i] -= s * a[i * n + k];
+        diag[k] = alpha;                                            // the diagonal of R
+    }
+    for (k = n - 1; k >= 0; k--) {                                  // back substitution with R
+        s = b[k];
+        for (j = k + 1; j < n; j++) s -= a[k * n + j] * x[j];
+        x[k] = s / diag[k];
+    }
+    return true;
 }
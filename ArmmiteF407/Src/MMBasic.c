@@ -137,6 +137,29 @@ char OptionExplicit,OptionEscape;
 char DefaultType;                                                   // the default type if a variable is not specifically typed
 
 char *subfun[MAXSUBFUN];                                            // table used to locate all subroutines and functions
+short subfunhash[MAXSUBHASH];                                       // hashed index into subfun[] (plus one), zero means an empty slot
+struct s_jumptbl *jumptbl = NULL;                                   // cache of resolved FOR/NEXT, DO/LOOP, etc targets (allocated on the heap)
+int jumptblsize = 0, jumptblcnt = 0;                                // size of the cache (a power of 2) and the number of entries used
+int NbrJumps;                                                       // number of commands found by PrepareProgram() that can use the jump cache
+struct s_numtbl *numtbl = NULL;                                     // cache of the values of numeric constants in the program (allocated on the heap)
+int numtblsize = 0, numtblcnt = 0;                                  // size of the cache (a power of 2) and the number of entries used
+int NbrNumbers;                                                     // number of numeric constants found by PrepareProgram()
+struct s_varcache *varcache = NULL;                                 // inline cache of variable references in the program (allocated on the heap)
+int varcachesize = 0, varcachecnt = 0;                              // size of the cache (a power of 2) and the number of entries used
+int NbrNames;                                                       // number of identifiers found by PrepareProgram()
+unsigned int VarGenGlobal = 0, VarGenLocal = 0;                     // incremented whenever a global or local variable is created or deleted
+struct s_exprtbl *exprtbl = NULL;                                   // index of compiled expressions (allocated on the heap)
+union u_exprop *exprcode = NULL;                                    // the compiled code (allocated on the heap)
+int exprtblsize = 0, exprtblcnt = 0;                                // size of the index (a power of 2) and the number of entries used
+int exprcodesize = 0, exprcodecnt = 0;                              // size of the code space (in slots) and the number of slots used
+int ExprBusy = 0;                                                   // nbr of compiled expressions running (they can be nested)
+unsigned int ExprFlushes = 0;                                       // nbr of times the cache has been cleared to make room
+struct s_labeltbl *labeltbl = NULL;                                 // hashed index of all labels in the program and library (allocated on the heap)
+int labeltblsize = 0;                                               // size of the label index (a power of 2)
+char **lineidx = NULL;                                              // pointers to every line number in the program and library in program order
+int lineidxcnt = 0, lineidxmain = 0;                                // total nbr of line numbers and the nbr in the main program
+char lineidxsorted[2];                                              // true if the line numbers in the main program [0] or library [1] are in order
+unsigned int StatementCount = 0;                                    // nbr of statements executed since RUN, reported by MM.INFO(STATEMENTS)
 char CurrentSubFunName[MAXVARLEN + 1];                              // the name of the current sub or fun
 char CurrentInterruptName[MAXVARLEN + 1];                           // the name of the current interrupt function
 
@@ -376,7 +399,7 @@ static void inline __attribute__((always_inline)) TestStackOverflow(void) {
 // the argument p must point to the first line to be executed
 //https://www.thebackshed.com/forum/ViewTopic.php?TID=15448  Toms Fix for nested
 void ExecuteProgram(char *p) {
-    int i, SaveLocalIndex = 0;
+    int i, SaveLocalIndex = 0, SaveExprBusy = 0;
     jmp_buf SaveErrNext;
     memcpy(SaveErrNext, ErrNext, sizeof(jmp_buf));                  // we call ExecuteProgram() recursively so we need to store/restore old jump buffer between calls
     skipspace(p);                                                   // just in case, skip any white space
@@ -394,6 +417,7 @@ void ExecuteProgram(char *p) {
                 MMPrintString(inpbuf);
                 uSec(1000);
             }
+            if(ProfileOn) ProfileLine(p);                           // used by PROFILE
             p++;                                                    // and step over the token
         }
         if(*p == T_LINENBR) p += 3;                                 // and step over the number
@@ -409,6 +433,8 @@ void ExecuteProgram(char *p) {
             skipelement(nextstmt);
             if(*p && *p != '\'') { // ignore a comment line
             	SaveLocalIndex = LocalIndex;                    // save this if we need to cleanup after an error
+                SaveExprBusy = ExprBusy;                        // ditto for any compiled expressions that were running
+                StatementCount++;
                 if(setjmp(ErrNext) == 0) {                          // return to the else leg of this if error and OPTION ERROR SKIP/IGNORE is in effect
                     //SaveLocalIndex = LocalIndex;                    // save this if we need to cleanup after an error
                     if(*(char*)p >= C_BASETOKEN && *(char*)p - C_BASETOKEN < CommandTableSize - 1 && (commandtbl[*(char*)p - C_BASETOKEN].type & T_CMD)) {
@@ -417,7 +443,7 @@ void ExecuteProgram(char *p) {
                         commandtbl[*(char*)p - C_BASETOKEN].fptr(); // execute the command
                     } else {
                         if(!isnamestart(*p)) error("Invalid character: @", (int)(*p));
-                        i = FindSubFun(p, false);                   // it could be a defined command
+                        i = FindSubFunCached(p, false);             // it could be a defined command
                         if(i >= 0) {                                // >= 0 means it is a user defined command
                             DefinedSubFun(false, p, i, NULL, NULL, NULL, NULL);
                         }
@@ -426,6 +452,7 @@ void ExecuteProgram(char *p) {
                     }
                 } else {
                     LocalIndex = SaveLocalIndex;                    // restore so that we can clean up any memory leaks
+                    ExprBusy = SaveExprBusy;
                     ClearTempMemory();
                 }
                 if(OptionErrorSkip > 0) OptionErrorSkip--;          // if OPTION ERROR SKIP decrement the count - we do not error if it is greater than zero
@@ -450,38 +477,51 @@ void ExecuteProgram(char *p) {
 // this routine also looks for embedded fonts and adds them to the font table
 void MIPS16 PrepareProgram(int ErrAbort) {
     int MIPS16 PrepareProgramExt(char *, int, unsigned char **, int);
-    int i, j, NbrFuncts;
-    char *p1, *p2;
+    int i, NbrFuncts;
 
     for(i = FONT_BUILTIN_NBR; i < FONT_TABLE_SIZE; i++)
         FontTable[i] = NULL;                                        // clear the font table
 
-    NbrFuncts = 0;
+    memset(subfunhash, 0, sizeof(subfunhash));                      // clear the sub/fun hash index
+    NbrFuncts = NbrJumps = NbrNumbers = NbrNames = 0;
     CFunctionFlash = CFunctionLibrary = NULL;
      if(Option.ProgFlashSize != PROG_FLASH_SIZE)
          NbrFuncts = PrepareProgramExt(ProgMemory + Option.ProgFlashSize, 0, &CFunctionLibrary, ErrAbort);
     PrepareProgramExt(ProgMemory, NbrFuncts, &CFunctionFlash, ErrAbort);
 
-    // check the sub/fun table for duplicates
+    // duplicate sub/fun names were checked for when they were added to the hash index
     if(!ErrAbort) return;
-    for(i = 0; i < MAXSUBFUN && subfun[i] != NULL; i++) {
-        for(j = i + 1; j < MAXSUBFUN && subfun[j] != NULL; j++) {
-            CurrentLinePtr = p1 = subfun[i];
-            p1++;
-            skipspace(p1);
-            p2 = subfun[j];
-            p2++;
-            skipspace(p2);
-            while(1) {
-                if(!isnamechar(*p1) && !isnamechar(*p2)) {
-                    error("Duplicate name");
-                    return;
-                }
-                if(toupper(*p1) != toupper(*p2)) break;
-                p1++; p2++;
-            }
+
+    // we are about to run the program so allocate the jump cache sized to suit the number of FOR, DO, etc commands
+    // all of these caches are optional, if there is not plenty of free memory the cache is left as NULL and the
+    // interpreter falls back to searching the program.  This way a program that fits without the caches still runs.
+    ClearJumpCache();
+    if(NbrJumps) {
+        for(jumptblsize = 16; jumptblsize < NbrJumps * 2 && jumptblsize < MAXJUMPCACHE; jumptblsize <<= 1);
+        if(FreeSpaceOnHeap() >= jumptblsize * sizeof(struct s_jumptbl) * 2)
+            jumptbl = GetMemory(jumptblsize * sizeof(struct s_jumptbl));
+    }
+    if(NbrNumbers) {                                                // and the cache for numeric constants
+        for(numtblsize = 16; numtblsize < NbrNumbers * 2 && numtblsize < MAXNUMCACHE; numtblsize <<= 1);
+        if(FreeSpaceOnHeap() >= numtblsize * sizeof(struct s_numtbl) * 2)
+            numtbl = GetMemory(numtblsize * sizeof(struct s_numtbl));
+    }
+    if(NbrNames) {                                                  // and the inline cache for variables
+        for(varcachesize = 16; varcachesize < NbrNames * 2 && varcachesize < MAXVARCACHE; varcachesize <<= 1);
+        if(FreeSpaceOnHeap() >= varcachesize * sizeof(struct s_varcache) * 2)
+            varcache = GetMemory(varcachesize * sizeof(struct s_varcache));
+    }
+    if(NbrNames + NbrNumbers) {                                     // and the compiled expressions
+        for(exprtblsize = 16; exprtblsize < NbrNames + NbrNumbers && exprtblsize < MAXEXPRCACHE; exprtblsize <<= 1);
+        exprcodesize = exprtblsize * 8;
+        if(exprcodesize > EXPRCODESIZE / sizeof(union u_exprop)) exprcodesize = EXPRCODESIZE / sizeof(union u_exprop);
+        if(FreeSpaceOnHeap() >= (exprtblsize * sizeof(struct s_exprtbl) + exprcodesize * sizeof(union u_exprop)) * 2) {
+            exprtbl = GetMemory(exprtblsize * sizeof(struct s_exprtbl));
+            exprcode = GetMemory(exprcodesize * sizeof(union u_exprop));
         }
     }
+
+    BuildLabelIndex();                                              // and the index used by GOTO, GOSUB, RESTORE, etc
 }
 
 
@@ -489,9 +529,12 @@ void MIPS16 PrepareProgram(int ErrAbort) {
 // It is only used by PrepareProgram() above.
 int MIPS16 PrepareProgramExt(char *p, int i, unsigned char **CFunPtr, int ErrAbort) {
     unsigned int *cfp;
+    int instring;
     while(*p != 0xff) {
         p = GetNextCommand(p, &CurrentLinePtr, NULL);
         if(*p == 0) break;                                          // end of the program or module
+        if(*p == cmdFOR || *p == cmdDO || isnamestart(*p)) NbrJumps++;  // count the commands that will use the jump cache
+        if(*p == cmdIF || *p == cmdELSEIF || *p == cmdELSE || *p == cmdSELECT_CASE || *p == cmdCASE || *p == cmdCASE_ELSE) NbrJumps++;
         if(*p == cmdSUB || *p == cmdFUN || *p == cmdCFUN || *p == cmdCSUB) {         // found a SUB, FUN, CFUNCTION or CSUB token
             if(i >= MAXSUBFUN) {
                 if(ErrAbort) error("Too many subroutines and functions");
@@ -504,8 +547,20 @@ int MIPS16 PrepareProgramExt(char *p, int i, unsigned char **CFunPtr, int ErrAbo
                 i--;
                 continue;
             }
+            AddSubFunHash(i - 1, ErrAbort);
+        }
+        instring = false;
+        while(*p) {                                                 // look for the zero marking the start of the next element
+            if(*p == '"') instring = !instring;
+            if(!instring) {
+                if(*p == '(') NbrJumps++;                           // a possible function call or array that will use the jump cache
+                if((IsDigit(*p) || *p == '.') && !isnamechar(p[-1]) && !IsDigit(p[-1]) && p[-1] != '.' && p[-1] != '&')
+                    NbrNumbers++;                                   // the start of a numeric constant
+                if(isnamestart(*p) && !isnamechar(p[-1]) && p[-1] != '&')
+                    NbrNames++;                                     // the start of a possible variable
+            }
+            p++;
         }
-        while(*p) p++;                                              // look for the zero marking the start of the next element
     }
     while(*p == 0) p++;                                             // the end of the program can have multiple zeros
     p++;                                                            // step over the terminating 0xff
@@ -526,30 +581,197 @@ int MIPS16 PrepareProgramExt(char *p, int i, unsigned char **CFunPtr, int ErrAbo
 
 
 
-// searches the subfun[] table to locate a defined sub or fun
-// returns with the index of the sub/function in the table or -1 if not found
-// if type = 0 then look for a sub otherwise a function
-int FindSubFun(char *p, int type) {
-    char *p1, *p2;
+// The jump cache remembers where the matching NEXT, LOOP, ENDIF, END SELECT etc is for a command in program memory so that the
+// scan through the program only needs to be done the first time that the command is executed.
+// The key is a pointer into the command (eg, nextstmt for FOR and DO) which is unique for every command in the program.
+// Commands typed at the prompt are not in program memory and are never cached.
+// returns the target or NULL if it has not been cached
+char *FindJumpTarget(char *from) {
     int i;
+    if(jumptbl == NULL) return NULL;
+    i = ((unsigned int)from ^ ((unsigned int)from >> 8)) & (jumptblsize - 1);
+    while(jumptbl[i].from != NULL) {
+        if(jumptbl[i].from == from) return jumptbl[i].to;
+        i = (i + 1) & (jumptblsize - 1);
+    }
+    return NULL;
+}
 
-    for(i = 0;  i < MAXSUBFUN && subfun[i] != NULL; i++) {
-        p2 = subfun[i];                                             // point to the command token
-        if(type == 0) {                                             // if it is a sub and we want a fun or vice versa skip this one
-            if(!(*p2 == cmdSUB || *p2 == cmdCSUB)) continue;
-        } else {
-            if(!(*p2 == cmdFUN || *p2 == cmdCFUN)) continue;
+
+// save a target in the jump cache.  If the cache is nearly full the target is not saved and the caller
+// will simply have to scan the program again the next time
+void SaveJumpTarget(char *from, char *to) {
+    int i;
+    if(jumptbl == NULL || from < ProgMemory || from >= ProgMemory + PROG_FLASH_SIZE) return;
+    if(jumptblcnt >= jumptblsize - (jumptblsize >> 2)) return;
+    i = ((unsigned int)from ^ ((unsigned int)from >> 8)) & (jumptblsize - 1);
+    while(jumptbl[i].from != NULL) {
+        if(jumptbl[i].from == from) break;
+        i = (i + 1) & (jumptblsize - 1);
+    }
+    if(jumptbl[i].from == NULL) jumptblcnt++;
+    jumptbl[i].from = from;
+    jumptbl[i].to = to;
+}
+
+
+// discard the jump cache (and the numeric constant, variable and compiled expression caches) and return their memory to the heap
+// this must be called whenever the program in flash is changed
+void ClearJumpCache(void) {
+    FreeMemorySafe((void **)&jumptbl);
+    jumptblsize = jumptblcnt = 0;
+    FreeMemorySafe((void **)&numtbl);
+    numtblsize = numtblcnt = 0;
+    FreeMemorySafe((void **)&varcache);
+    varcachesize = varcachecnt = 0;
+    FreeMemorySafe((void **)&exprtbl);
+    FreeMemorySafe((void **)&exprcode);
+    exprtblsize = exprtblcnt = exprcodesize = exprcodecnt = 0;
+    ExprBusy = ExprFlushes = 0;
+    SelectMapClear();                                               // the SELECT CASE maps are referenced by the jump cache
+}
+
+
+// The numeric constant cache saves the value of a numeric constant in program memory the first time that it is evaluated
+// by getvalue() so that it does not have to be converted from text again.  The program text is not changed.
+// The key is the location of the constant.  Returns a pointer to the entry or NULL if it is not in the cache.
+struct s_numtbl *FindNumber(char *p) {
+    int i;
+    if(numtbl == NULL) return NULL;
+    i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (numtblsize - 1);
+    while(numtbl[i].p != NULL) {
+        if(numtbl[i].p == p) return &numtbl[i];
+        i = (i + 1) & (numtblsize - 1);
+    }
+    return NULL;
+}
+
+
+// The variable cache remembers the vartbl[] index that a simple (not an array) variable reference in program memory
+// resolved to.  An entry is only valid if it is used at the same LocalIndex and no variable has been created or deleted
+// since (tracked by VarGenGlobal and VarGenLocal).  Outside a sub/fun locals are not searched so VarGenLocal is ignored.
+// Returns the index or -1 if there is no valid entry
+int FindVarCache(char *p) {
+    int i;
+    i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (varcachesize - 1);
+    while(varcache[i].p != NULL) {
+        if(varcache[i].p == p) {
+            if(varcache[i].level == LocalIndex && varcache[i].ggen == VarGenGlobal && (LocalIndex == 0 || varcache[i].lgen == VarGenLocal))
+                return varcache[i].index;
+            return -1;
         }
-        p2++; skipspace(p2);                                        // point to the identifier
-        if(toupper(*p) != toupper(*p2)) continue;                   // quick first test
-        p1 = p + 1;  p2++;
-        while(isnamechar(*p1) && toupper(*p1) == toupper(*p2)) { p1++; p2++; };
-        if((*p1 == '$' && *p2 == '$') || (*p1 == '%' && *p2 == '%') || (*p1 == '!' && *p2 == '!') || (!isnamechar(*p1) && !isnamechar(*p2))) return i;          // found it !
+        i = (i + 1) & (varcachesize - 1);
     }
     return -1;
 }
 
 
+// save (or update) an entry in the variable cache
+void SaveVarCache(char *p, int index) {
+    int i;
+    if(varcache == NULL || p < ProgMemory || p >= ProgMemory + PROG_FLASH_SIZE) return;
+    i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (varcachesize - 1);
+    while(varcache[i].p != NULL && varcache[i].p != p) i = (i + 1) & (varcachesize - 1);
+    if(varcache[i].p == NULL) {
+        if(varcachecnt >= varcachesize - (varcachesize >> 2)) return;
+        varcachecnt++;
+        varcache[i].p = p;
+    }
+    varcache[i].index = index;
+    varcache[i].level = LocalIndex;
+    varcache[i].ggen = VarGenGlobal;
+    varcache[i].lgen = VarGenLocal;
+}
+
+
+// save a numeric constant in the cache.  len is the number of characters in the constant and type is T_INT or T_NBR
+void SaveNumber(char *p, int len, int type, MMFLOAT f, long long int i64) {
+    int i;
+    if(numtbl == NULL || p < ProgMemory || p >= ProgMemory + PROG_FLASH_SIZE || len > 255) return;
+    if(numtblcnt >= numtblsize - (numtblsize >> 2)) return;
+    i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (numtblsize - 1);
+    while(numtbl[i].p != NULL) i = (i + 1) & (numtblsize - 1);
+    numtblcnt++;
+    numtbl[i].p = p;
+    numtbl[i].len = len;
+    numtbl[i].type = type;
+    if(type & T_INT) numtbl[i].v.i = i64; else numtbl[i].v.f = f;
+}
+
+
+
+// hash the name of a sub or fun.  The same FNV hash as findvar() is used but it is not case sensitive
+static unsigned int SubFunHash(char *p) {
+    unsigned int hash = FNV_offset_basis;
+    while(isnamechar(*p)) {
+        hash ^= toupper(*p++);
+        hash *= FNV_prime;
+    }
+    return hash % MAXSUBHASH;
+}
+
+
+// return true if the name in p1 is the same as the name of the sub/fun defined by subfun[i]
+// if suffix is true and both names have a type suffix ($, % or !) the suffixes must also be the same, a name without
+// a suffix matches either.  If suffix is false only the names are compared (so f$ and f% are duplicates)
+static int SubFunNameEqual(char *p1, int i, int suffix) {
+    char *p2 = subfun[i];
+    p2++; skipspace(p2);                                            // point to the identifier
+    while(isnamechar(*p1) && toupper(*p1) == toupper(*p2)) { p1++; p2++; };
+    if(isnamechar(*p1) || isnamechar(*p2)) return false;            // one name is longer than the other
+    if(suffix && *p1 && *p2 && strchr("$%!", *p1) != NULL && strchr("$%!", *p2) != NULL) return *p1 == *p2;
+    return true;
+}
+
+
+// add subfun[i] to the hash index.  If ErrAbort is true duplicate names will throw an error
+void AddSubFunHash(int i, int ErrAbort) {
+    int h, n;
+    char *p = subfun[i];
+    p++; skipspace(p);                                              // point to the identifier
+    h = SubFunHash(p);
+    for(n = 0; n < MAXSUBHASH && subfunhash[h]; n++) {
+        if(ErrAbort && SubFunNameEqual(p, subfunhash[h] - 1, false)) {
+            CurrentLinePtr = subfun[subfunhash[h] - 1];
+            error("Duplicate name");
+        }
+        h = (h + 1) % MAXSUBHASH;
+    }
+    if(n < MAXSUBHASH) subfunhash[h] = i + 1;
+}
+
+
+// searches the subfun[] table to locate a defined sub or fun
+// returns with the index of the sub/function in the table or -1 if not found
+// if type = 0 then look for a sub, if type = 1 a function and if type = -1 either
+int FindSubFun(char *p, int type) {
+    int h, n, i;
+    char c;
+
+    h = SubFunHash(p);
+    for(n = 0; n < MAXSUBHASH && subfunhash[h]; n++) {              // entries were added in order so the first match is the lowest index
+        i = subfunhash[h] - 1;
+        c = *subfun[i];                                             // the command token
+        if(type < 0 || (type == 0 && (c == cmdSUB || c == cmdCSUB)) || (type > 0 && (c == cmdFUN || c == cmdCFUN)))
+            if(SubFunNameEqual(p, i, true)) return i;               // found it !
+        h = (h + 1) % MAXSUBHASH;
+    }
+    return -1;
+}
+
+
+// same as FindSubFun() but the result is remembered in the jump cache so that on the next execution of this
+// call site (in program memory) the lookup can be skipped.  Misses are also cached as these are array references.
+int FindSubFunCached(char *p, int type) {
+    char *t;
+    int i;
+    if((t = FindJumpTarget(p)) != NULL) return (int)t - 2;
+    i = FindSubFun(p, type);
+    SaveJumpTarget(p, (char *)(i + 2));                             // offset by 2 so that the value is never NULL
+    return i;
+}
+
+
 
 // This function is responsible for executing a defined subroutine or function.
 // As these two are similar they are processed in the one lump of code.
@@ -568,14 +790,9 @@ void DefinedSubFun(int isfun, char *cmd, int index, MMFLOAT *fa, long long int *
 	int i;
     int ArgType, FunType;
     int *argtype;
-    union u_argval {
-        MMFLOAT f;                                                    // the value if it is a float
-        long long int i;                                            // the value if it is an integer
-        MMFLOAT *fa;                                                  // pointer to the allocated memory if it is an array of floats
-        long long int *ia;                                          // pointer to the allocated memory if it is an array of integers
-        char *s;                                                    // pointer to the allocated memory if it is a string
-    } *argval;
+    union u_argval *argval;
     int *argVarIndex;
+    struct s_callframe *frame;
 
     CallersLinePtr = CurrentLinePtr;
     SubLinePtr = subfun[index];                                     // used for error reporting
@@ -673,12 +890,11 @@ void DefinedSubFun(int isfun, char *cmd, int index, MMFLOAT *fa, long long int *
     errorstack[gosubindex] = CallersLinePtr;
 	gosubstack[gosubindex++] = isfun ? NULL : nextstmt;             // NULL signifies that this is returned to by ending ExecuteProgram()
 
-    // allocate memory for processing the arguments
-    argval = GetTempMemory(MAX_ARG_COUNT * sizeof(union u_argval));
-    argtype = GetTempMemory(MAX_ARG_COUNT * sizeof(int));
-    argVarIndex = GetTempMemory(MAX_ARG_COUNT * sizeof(int));
-    argbuf1 = GetTempMemory(STRINGSIZE); argv1 = GetTempMemory(MAX_ARG_COUNT * sizeof(char *));  // these are for the caller
-    argbuf2 = GetTempMemory(STRINGSIZE); argv2 = GetTempMemory(MAX_ARG_COUNT * sizeof(char *));  // and these for the definition of the sub or function
+    // get the memory for processing the arguments, normally this comes from the call frame arena rather than the heap
+    frame = GetCallFrame();
+    argval = frame->argval; argtype = frame->argtype; argVarIndex = frame->argVarIndex;
+    argbuf1 = frame->argbuf1; argv1 = frame->argv1;                 // these are for the caller
+    argbuf2 = frame->argbuf2; argv2 = frame->argv2;                 // and these for the definition of the sub or function
 
     // now split up the arguments in the caller
     CurrentLinePtr = CallersLinePtr;                                // report errors at the caller
@@ -694,6 +910,8 @@ void DefinedSubFun(int isfun, char *cmd, int index, MMFLOAT *fa, long long int *
     if(argc2 && (argc2 & 1) == 0) error("Argument list");
     CurrentLinePtr = CallersLinePtr;                                // report errors at the caller
     if(argc1 > argc2 || (argc1 && (argc1 & 1) == 0)) error("Argument list");
+    memset(argtype, 0, argc2 * sizeof(int));                        // only clear the entries that will be used
+    memset(argVarIndex, 0, argc2 * sizeof(int));
 
 	// step through the arguments supplied by the caller and get the value supplied
     // these can be:
@@ -802,10 +1020,8 @@ void DefinedSubFun(int isfun, char *cmd, int index, MMFLOAT *fa, long long int *
         }
     }
 
-    // temp memory used in setting up the arguments can be deleted now
-    ClearSpecificTempMemory(argval); ClearSpecificTempMemory(argtype); ClearSpecificTempMemory(argVarIndex);
-    ClearSpecificTempMemory(argbuf1); ClearSpecificTempMemory(argv1);
-    ClearSpecificTempMemory(argbuf2); ClearSpecificTempMemory(argv2);
+    // the memory used in setting up the arguments can be released now
+    FreeCallFrame(frame);
 
     // if it is a defined command we simply point to the first statement in our command and allow ExecuteProgram() to carry on as before
     // exit from the sub is via cmd_return which will decrement LocalIndex
@@ -1324,6 +1540,347 @@ void *DoExpression(char *p, int *t) {
 
 
 
+// apply a binary operator to two values.  The result is returned in the first value.
+// this is used by doexpr() and by the expression compiler so that both follow exactly the same rules for types
+static inline void __attribute__((always_inline)) ApplyOperator(int o1, MMFLOAT *fa, long long int *ia, char **sa, int *ta, MMFLOAT fa2, long long int ia2, char *sa2, int t2) {
+    MMFLOAT fa1 = *fa;
+    long long int ia1 = *ia;
+    char *sa1 = *sa;
+    int t1 = TypeMask(*ta);
+    if((t1 & T_STR) != (t2 & T_STR)) error("Incompatible types in expression");
+    targ = tokentbl[o1].type & (T_NBR | T_INT);
+    if(targ == T_NBR) {                                             // if the operator does not work with ints convert the args to floats
+        if(t1 & T_INT) { fa1 = ia1; t1 = T_NBR; }                   // at this time the only example of this is op_div (/)
+        if(t2 & T_INT) { fa2 = ia2; t2 = T_NBR; }
+    }
+    if(targ == T_INT) {                                             // if the operator does not work with floats convert the args to ints
+        if(t1 & T_NBR) { ia1 = FloatToInt64(fa1); t1 = T_INT; }
+        if(t2 & T_NBR) { ia2 = FloatToInt64(fa2); t2 = T_INT; }
+    }
+    if(targ == (T_NBR | T_INT)) {                                   // if the operator will work with both floats and ints
+        if(t1 & T_NBR && t2 & T_INT) { fa2 = ia2; t2 = T_NBR; }     // if one arg is float convert the other to a float
+        if(t1 & T_INT && t2 & T_NBR) { fa1 = ia1; t1 = T_NBR; }
+    }
+    if(!(tokentbl[o1].type & T_OPER) || !(tokentbl[o1].type & t1)) {
+        error("Invalid operator");
+    }
+    farg1 = fa1; farg2 = fa2;                                       // setup the float args (incase it is a float)
+    sarg1 = sa1; sarg2 = sa2;                                       // ditto string args
+    iarg1 = ia1; iarg2 = ia2;                                       // ditto integer args
+    targ = t1;                                                      // this is what both args are
+    tokentbl[o1].fptr();                                            // call the operator function
+    *fa = fret;
+    *ia = iret;
+    *sa = sret;
+    *ta = targ;
+}
+
+
+
+/********************************************************************************************************************************************
+ The expression compiler
+ The first time that evaluate() is given an expression in program memory it is converted to postfix code which is saved in
+ exprcode[] and indexed by the location of the expression in exprtbl[].  After that evaluate() just runs the code.
+ - constants are converted once and constant sub expressions such as 2*PI_2 (but not functions) are folded
+ - simple variables are looked up with findvar() which resolves them from the inline variable cache after the first time
+ - binary operators are applied in the same order as doexpr() with ApplyOperator() (+, - and * and the comparisons have a
+   fast path if both args are the same numeric type)
+ - anything else (functions, arrays, user defined functions and string constants) is left to getvalue() at run time
+ When the cache or the code space is full it is cleared and filled again (but not while compiled code is running).
+********************************************************************************************************************************************/
+
+#define E_XEND      0                                               // the codes used in the compiled expression
+#define E_CONST     1                                               // a numeric constant, the value is in the next slot
+#define E_VAR       2                                               // a simple variable
+#define E_LEAF      3                                               // anything else, evaluated by getvalue()
+#define E_OPER      4                                               // a binary operator
+#define E_ADD       5
+#define E_SUB       6
+#define E_MUL       7
+#define E_CMP       8                                               // a comparison operator
+#define E_NEG       9                                               // unary minus
+#define E_NOT       10
+#define E_INV       11
+
+struct s_exprval {                                                  // a value on the stack used when running the code
+    MMFLOAT f;
+    long long int i;
+    char *s;
+    int t;
+};
+
+static char *CompileExprList(char *p, int *n, int *depth);
+
+// get the operator following a value, the same as the end of getvalue()
+static inline char *CompileGetOper(char *p, int *oo) {
+    skipspace(p);
+    if(tokentype(*p) & T_OPER)
+        *oo = *p++ - C_BASETOKEN;
+    else
+        *oo = E_END;
+    return p;
+}
+
+// add an op to the code being compiled.  Returns false if the expression is too long
+static inline int CompileEmit(int *n, int op, int arg, char *p) {
+    if(exprcodecnt + *n >= exprcodesize || *n >= EXPRMAXOPS) return false;
+    exprcode[exprcodecnt + *n].c.op = op;
+    exprcode[exprcodecnt + *n].c.arg = arg;
+    exprcode[exprcodecnt + *n].c.kind = 0;
+    exprcode[exprcodecnt + *n].c.p = p;
+    (*n)++;
+    return true;
+}
+
+// compile a value and return the operator following it (the same as getvalue()), returns NULL if it cannot be compiled
+// cs[] tracks the start of the code for each value on the stack and if it is a constant (for folding)
+static char *CompileValue(char *p, int *n, int *depth, int *cs, char *isconst, int *oo) {
+    char *tp;
+    int start = *n, t;
+    MMFLOAT f;
+    long long int i64;
+    char *s;
+
+    skipspace(p);
+    if(*p >= C_BASETOKEN) {
+        if(tokenfunction(*p) == op_not || tokenfunction(*p) == op_inv || tokenfunction(*p) == op_subtract || tokenfunction(*p) == op_add) {
+            int op = (tokenfunction(*p) == op_not) ? E_NOT : (tokenfunction(*p) == op_inv) ? E_INV : (tokenfunction(*p) == op_subtract) ? E_NEG : 0;
+            p = CompileValue(p + 1, n, depth, cs, isconst, oo);     // a unary operator applies to the next value only
+            if(p == NULL || op == 0) return p;
+            if(isconst[*depth - 1]) {                               // fold the operator into the constant
+                union u_exprop *c = &exprcode[exprcodecnt + cs[*depth - 1] + 1];
+                t = exprcode[exprcodecnt + cs[*depth - 1]].c.arg;
+                if(op == E_NEG) { if(t & T_NBR) c->f = -c->f; else c->i = -c->i; }
+                if(op == E_NOT) { if(t & T_NBR) c->f = (c->f != 0) ? 0 : 1; else c->i = (c->i != 0) ? 0 : 1; }
+                if(op == E_INV) { if(t & T_NBR) c->i = FloatToInt64(c->f); c->i = ~c->i; exprcode[exprcodecnt + cs[*depth - 1]].c.arg = T_INT; }
+                return p;
+            }
+            if(!CompileEmit(n, op, 0, NULL)) return NULL;
+            isconst[*depth - 1] = false;
+            return p;
+        }
+        if(tokentype(*p) & T_FUN) {
+            if(!CompileEmit(n, E_LEAF, 0, p)) return NULL;
+            p = getclosebracket(p) + 1;
+        } else if(tokentype(*p) & T_FNA) {
+            if(!CompileEmit(n, E_LEAF, 0, p)) return NULL;
+            p++;
+        } else
+            return NULL;
+    } else if(isnamestart(*p)) {
+        tp = p + 1;
+        while(isnamechar(*tp)) tp++;                                // search for the end of the identifier
+        if(*tp == '$' || *tp == '%' || *tp == '!') tp++;
+        skipspace(tp);
+        if(!CompileEmit(n, (*tp == '(') ? E_LEAF : E_VAR, 0, p)) return NULL;  // an array or function is left to getvalue()
+        p = skipvar(p, false);
+    } else if(IsDigit(*p) || *p == '.' || *p == '&') {
+        p = getvalue(p, &f, &i64, &s, oo, &t);                      // a constant so just get its value now
+        if(!CompileEmit(n, E_CONST, t, NULL) || !CompileEmit(n, E_CONST, t, NULL)) return NULL;
+        if(t & T_INT) exprcode[exprcodecnt + start + 1].i = i64; else exprcode[exprcodecnt + start + 1].f = f;
+        if(*depth >= EXPRSTACKSIZE) return NULL;
+        cs[*depth] = start; isconst[*depth] = true; (*depth)++;
+        return p;
+    } else if(*p == '(') {
+        int d = *depth;
+        p = CompileExprList(p + 1, n, depth);                       // compile the contents of the brackets
+        if(p == NULL || *p != ')' || *depth != d + 1) return NULL;
+        cs[d] = start; isconst[d] = (exprcode[exprcodecnt + start].c.op == E_CONST && *n == start + 2);
+        return CompileGetOper(p + 1, oo);
+    } else if(*p == '"') {
+        if(!CompileEmit(n, E_LEAF, 0, p)) return NULL;
+        p = strchr(p + 1, '"') + 1;
+    } else
+        return NULL;
+    if(*depth >= EXPRSTACKSIZE) return NULL;
+    cs[*depth] = start; isconst[*depth] = false; (*depth)++;
+    return CompileGetOper(p, oo);
+}
+
+// compile an expression (the same as evaluate() and its calls to doexpr()), returns NULL if it cannot be compiled
+// this converts the expression to postfix, the operators are stacked until an operator with lower priority (a higher
+// precedence number) or the end of the expression is found.  This applies them in the same order as doexpr()
+static char *CompileExprList(char *p, int *n, int *depth) {
+    int ostack[EXPRSTACKSIZE], cs[EXPRSTACKSIZE], nops = 0, o, o1, code;
+    char isconst[EXPRSTACKSIZE];
+    void (*fp)(void);
+
+    p = CompileValue(p, n, depth, cs, isconst, &o);
+    while(p != NULL) {
+        while(nops > 0 && (o == E_END || tokentbl[ostack[nops - 1]].precedence <= tokentbl[o].precedence)) {
+            o1 = ostack[--nops];
+            fp = tokentbl[o1].fptr;
+            if(isconst[*depth - 2] && isconst[*depth - 1] && fp != op_div && fp != op_divint && fp != op_mod && fp != op_exp && fp != op_not && fp != op_inv) {
+                // both args are constants so do it now (operators that can throw an error are left until the program runs)
+                union u_exprop *c1 = &exprcode[exprcodecnt + cs[*depth - 2]], *c2 = &exprcode[exprcodecnt + cs[*depth - 1]];
+                MMFLOAT f = (c1->c.arg & T_NBR) ? c1[1].f : 0;
+                long long int i64 = (c1->c.arg & T_INT) ? c1[1].i : 0;
+                char *s = NULL;
+                int t = c1->c.arg;
+                ApplyOperator(o1, &f, &i64, &s, &t, (c2->c.arg & T_NBR) ? c2[1].f : 0, (c2->c.arg & T_INT) ? c2[1].i : 0, NULL, c2->c.arg);
+                c1->c.arg = t;
+                if(t & T_INT) c1[1].i = i64; else c1[1].f = f;
+                *n = cs[*depth - 2] + 2;                            // discard the code for the second constant
+                (*depth)--;
+                continue;
+            }
+            code = E_OPER;
+            if(fp == op_add) code = E_ADD;
+            if(fp == op_subtract) code = E_SUB;
+            if(fp == op_mul) code = E_MUL;
+            if(fp == op_equal || fp == op_ne || fp == op_lt || fp == op_gt || fp == op_lte || fp == op_gte) code = E_CMP;
+            if(!CompileEmit(n, code, o1, NULL)) return NULL;
+            if(code == E_CMP) exprcode[exprcodecnt + *n - 1].c.kind = (fp == op_equal) ? 0 : (fp == op_ne) ? 1 : (fp == op_lt) ? 2 : (fp == op_gt) ? 3 : (fp == op_lte) ? 4 : 5;
+            (*depth)--;
+            isconst[*depth - 1] = false;
+        }
+        if(o == E_END) break;
+        if(nops >= EXPRSTACKSIZE) return NULL;
+        ostack[nops++] = o;
+        p = CompileValue(p, n, depth, cs, isconst, &o);
+    }
+    return p;
+}
+
+
+// find the compiled code for an expression in program memory, compiling it if this is the first time it has been seen
+// returns NULL if the expression cannot be compiled, otherwise *end is set to the end of the expression
+static union u_exprop *FindExpr(char *p, char **end) {
+    int i, n = 0, depth = 0;
+    char *ep;
+    if(p < ProgMemory || p >= ProgMemory + PROG_FLASH_SIZE) return NULL;
+    i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (exprtblsize - 1);
+    while(exprtbl[i].p != NULL) {
+        if(exprtbl[i].p == p) {
+            if(exprtbl[i].code != NULL) *end = exprtbl[i].end;      // the caller's pointer is left alone if it was not compiled
+            return exprtbl[i].code;
+        }
+        i = (i + 1) & (exprtblsize - 1);
+    }
+
+    // not found so compile it, first make room if the cache is full
+    if(exprtblcnt >= exprtblsize - (exprtblsize >> 2) || exprcodecnt > exprcodesize - EXPRMAXOPS) {
+        if(ExprBusy) return NULL;                                   // compiled code is running so the cache cannot be cleared now
+        memset(exprtbl, 0, exprtblsize * sizeof(struct s_exprtbl));
+        exprtblcnt = exprcodecnt = 0;
+        ExprFlushes++;
+        i = ((unsigned int)p ^ ((unsigned int)p >> 8)) & (exprtblsize - 1);
+    }
+    ep = CompileExprList(p, &n, &depth);
+    exprtbl[i].p = p;
+    exprtbl[i].code = NULL;                                         // remember that it cannot be compiled
+    if(ep != NULL && depth == 1 && CompileEmit(&n, E_XEND, 0, NULL)) {
+        exprtbl[i].code = &exprcode[exprcodecnt];
+        exprtbl[i].end = *end = ep;
+        exprcodecnt += n;
+    }
+    exprtblcnt++;
+    return exprtbl[i].code;
+}
+
+
+// run a compiled expression
+static void RunExpr(union u_exprop *c, MMFLOAT *fa, long long int *ia, char **sa, int *ta) {
+    struct s_exprval st[EXPRSTACKSIZE], *v = st - 1;
+    long long int r;
+    int o;
+    char *s;
+
+    TestStackOverflow();                                            // throw an error if we have overflowed the stack
+    ExprBusy++;
+    while(c->c.op != E_XEND) {
+        switch(c->c.op) {
+            case E_CONST:   v++;
+                            v->t = c->c.arg;
+                            if(v->t & T_INT) v->i = c[1].i; else v->f = c[1].f;
+                            v->s = NULL;
+                            c++;                                    // step over the value
+                            break;
+            case E_VAR:     v++;                                    // the same as getvalue()
+                            s = (char *)findvar(c->c.p, V_FIND);
+                            v->t = TypeMask(vartbl[VarIndex].type);
+                            if(v->t & T_NBR) v->f = (*(MMFLOAT *)s);
+                            if(v->t & T_INT) v->i = (*(long long int *)s);
+                            v->s = s;
+                            break;
+            case E_LEAF:    v++;
+                            getvalue(c->c.p, &v->f, &v->i, &v->s, &o, &v->t);
+                            break;
+            case E_ADD:     if(v[-1].t == v->t && (v->t & (T_NBR | T_INT))) {
+                                if(v->t & T_INT) v[-1].i += v->i; else v[-1].f += v->f;
+                                v--;
+                                break;
+                            }
+                            goto oper;
+            case E_SUB:     if(v[-1].t == v->t && (v->t & (T_NBR | T_INT))) {
+                                if(v->t & T_INT) v[-1].i -= v->i; else v[-1].f -= v->f;
+                                v--;
+                                break;
+                            }
+                            goto oper;
+            case E_MUL:     if(v[-1].t == v->t && (v->t & (T_NBR | T_INT))) {
+                                if(v->t & T_INT) v[-1].i *= v->i; else v[-1].f *= v->f;
+                                v--;
+                                break;
+                            }
+                            goto oper;
+            case E_CMP:     if(v[-1].t == v->t && (v->t & (T_NBR | T_INT))) {
+                                if(v->t & T_NBR) {                  // the same as compare() in Operators.c
+                                    MMFLOAT d = v[-1].f - v->f;
+                                    r = (d > 0) ? 1 : (d < 0) ? -1 : 0;
+                                } else
+                                    r = (long long int)((unsigned long long int)v[-1].i - (unsigned long long int)v->i);
+                                switch(c->c.kind) {
+                                    case 0: r = (r == 0); break;
+                                    case 1: r = (r != 0); break;
+                                    case 2: r = (r < 0); break;
+                                    case 3: r = (r > 0); break;
+                                    case 4: r = (r <= 0); break;
+                                    default: r = (r >= 0); break;
+                                }
+                                v--;
+                                v->i = r;
+                                v->t = T_INT;
+                                break;
+                            }
+                            goto oper;
+            case E_NEG:     if(v->t & T_NBR)                        // the unary operators are the same as getvalue()
+                                v->f = -v->f;
+                            else if(v->t & T_INT)
+                                v->i = -v->i;
+                            else
+                                error("Expected a number");
+                            break;
+            case E_NOT:     if(v->t & T_NBR)
+                                v->f = (MMFLOAT)((v->f != 0)?0:1);
+                            else if(v->t & T_INT)
+                                v->i = ((v->i != 0)?0:1);
+                            else
+                                error("Expected a number");
+                            break;
+            case E_INV:     if(v->t & T_NBR)
+                                v->i = FloatToInt64(v->f);
+                            else if(!(v->t & T_INT))
+                                error("Expected a number");
+                            v->i = ~v->i;
+                            v->t = T_INT;
+                            break;
+            default:
+            oper:           ApplyOperator(c->c.arg, &v[-1].f, &v[-1].i, &v[-1].s, &v[-1].t, v->f, v->i, v->s, v->t);
+                            v--;
+                            break;
+        }
+        c++;
+    }
+    ExprBusy--;
+    *fa = v->f;
+    *ia = v->i;
+    *sa = v->s;
+    *ta = v->t;
+}
+
+
+
 // evaluate an expression.  p points to the start of the expression in memory
 // returns either the float or string in the pointer arguments
 // *t points to an integer which holds the type of variable we are looking for
@@ -1334,9 +1891,15 @@ char *evaluate(char *p, MMFLOAT *fa, long long int *ia, char **sa, int *ta, int
     int o;
     int t = *ta;
     char *s;
+    union u_exprop *code;
 
-    p = getvalue(p, fa, ia, &s, &o, &t);                            // get the left hand side of the expression, the operator is returned in o
-    while(o != E_END) p = doexpr(p, fa, ia, &s, &o, &t);            // get the right hand side of the expression and evaluate the operator in o
+    if(exprtbl != NULL && (code = FindExpr(p, &p)) != NULL) {      // if it has been compiled just run the code
+        RunExpr(code, fa, ia, &s, &t);
+        o = E_END;
+    } else {
+        p = getvalue(p, fa, ia, &s, &o, &t);                        // get the left hand side of the expression, the operator is returned in o
+        while(o != E_END) p = doexpr(p, fa, ia, &s, &o, &t);        // get the right hand side of the expression and evaluate the operator in o
+    }
 
     // check that the types match and convert them if we can
     if((*ta & (T_NBR |T_INT)) && t & T_STR) error("Expected a number");
@@ -1456,49 +2019,20 @@ char *getFstring(char *p) {
 
 // recursively evaluate an expression observing the rules of operator precedence
 char *doexpr(char *p, MMFLOAT *fa, long long int *ia, char **sa, int *oo, int *ta) {
-    MMFLOAT fa1, fa2;
-    long long int ia1, ia2;
+    MMFLOAT fa2;
+    long long int ia2;
     int o1, o2;
-    int t1, t2;
-    char *sa1, *sa2;
+    int t2;
+    char *sa2;
 
     TestStackOverflow();                                            // throw an error if we have overflowed the PIC32's stack
 
-    fa1 = *fa;
-    ia1 = *ia;
-    sa1 = *sa;
-    t1 = TypeMask(*ta);
     o1 = *oo;
     p = getvalue(p, &fa2, &ia2, &sa2, &o2, &t2);
     while(1) {
         if(o2 == E_END || tokentbl[o1].precedence <= tokentbl[o2].precedence) {
-            if((t1 & T_STR) != (t2 & T_STR)) error("Incompatible types in expression");
-            targ = tokentbl[o1].type & (T_NBR | T_INT);
-            if(targ == T_NBR) {                                     // if the operator does not work with ints convert the args to floats
-                if(t1 & T_INT) { fa1 = ia1; t1 = T_NBR; }           // at this time the only example of this is op_div (/)
-                if(t2 & T_INT) { fa2 = ia2; t2 = T_NBR; }
-            }
-            if(targ == T_INT) {                                     // if the operator does not work with floats convert the args to ints
-                if(t1 & T_NBR) { ia1 = FloatToInt64(fa1); t1 = T_INT; }
-                if(t2 & T_NBR) { ia2 = FloatToInt64(fa2); t2 = T_INT; }
-            }
-            if(targ == (T_NBR | T_INT)) {                               // if the operator will work with both floats and ints
-                if(t1 & T_NBR && t2 & T_INT) { fa2 = ia2; t2 = T_NBR; } // if one arg is float convert the other to a float
-                if(t1 & T_INT && t2 & T_NBR) { fa1 = ia1; t1 = T_NBR; }
-            }
-            if(!(tokentbl[o1].type & T_OPER) || !(tokentbl[o1].type & t1)) {
-                error("Invalid operator");
-            }
-            farg1 = fa1; farg2 = fa2;                               // setup the float args (incase it is a float)
-            sarg1 = sa1; sarg2 = sa2;                               // ditto string args
-            iarg1 = ia1; iarg2 = ia2;                               // ditto integer args
-            targ = t1;                                              // this is what both args are
-            tokentbl[o1].fptr();                                    // call the operator function
-            *fa = fret;
-            *ia = iret;
-            *sa = sret;
+            ApplyOperator(o1, fa, ia, sa, ta, fa2, ia2, sa2, t2);
             *oo = o2;
-            *ta = targ;
             return p;
         }
         // the next operator has a higher precedence, recursive call to evaluate it
@@ -1517,6 +2051,7 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
     int t = T_NOTYPE;
     char *tp, *p1, *p2;
     int i;
+    struct s_numtbl *nt;
 
     TestStackOverflow();                                            // throw an error if we have overflowed the PIC32's stack
 
@@ -1598,18 +2133,21 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
     // if a function execute it and save the result
     if(tokentype(*p) & (T_FUN | T_FNA)) {
         int tmp;
+        char *argbuf = NULL;
         tp = p;
         // if it is a function with arguments we need to locate the closing bracket and copy the argument to
-        // a temporary variable so that functions like getarg() will work.
+        // a buffer so that functions like getarg() will work.  The buffer is released when the function returns
         if(tokentype(*p) & T_FUN) {
             p1 = p + 1;
             p = getclosebracket(p);                                 // find the closing bracket
-            p2 = ep = GetTempStrMemory();                           // this will last for the life of the command
+            p2 = ep = argbuf = GetFunArgBuf();
             while(p1 != p) *p2++ = *p1++;
+            *p2 = 0;
         }
         p++;                                                        // point to after the function (without argument) or after the closing bracket
         tmp = targ = TypeMask(tokentype(*tp));                      // set the type of the function (which might need to know this)
         tokenfunction(*tp)();                                       // execute the function
+        if(argbuf != NULL) FreeFunArgBuf(argbuf);
         if((tmp & targ) == 0) error("Internal fault (sorry)");      // as a safety check the function must return a type the same as set in the header
         t = targ;                                                   // save the type of the function
         f = fret; i64 = iret; s = sret;                             // save the result
@@ -1622,7 +2160,7 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
 			while(isnamechar(*tp)) tp++;                                // search for the end of the identifier
 			if(*tp == '$' || *tp == '%' || *tp == '!') tp++;
 			i = -1;
-			if(*tp == '(') i = FindSubFun(p, 1);                        // if terminated with a bracket it could be a function
+			if(*tp == '(') i = FindSubFunCached(p, 1);                  // if terminated with a bracket it could be a function
 			if(i >= 0) {                                                // >= 0 means it is a user defined function
 				char *SaveCurrentLinePtr = CurrentLinePtr;              // in case the code in DefinedSubFun messes with this
 				DefinedSubFun(true, p, i, &f, &i64, &s, &t);
@@ -1637,8 +2175,13 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
 		}
 		// is it an ordinary numeric constant?  get its value if yes
 		// a leading + or - might have been converted to a token so we need to check for them also
+		else if((IsDigit(*p) || *p == '.') && (nt = FindNumber(p)) != NULL) {  // the value of this constant has been cached
+			t = nt->type;
+			if(t & T_INT) i64 = nt->v.i; else f = nt->v.f;
+			p += nt->len;
+		}
 		else if(IsDigit(*p) || *p == '.') {
-			char ts[31], *tsp;
+			char ts[31], *tsp, *sp = p;
 			int isi64 = true;
 			tsp = ts;
 			int isf=true;
@@ -1680,6 +2223,7 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
 				f = (MMFLOAT)strtod(ts, &tsp);                          // and convert to a MMFLOAT
 				t = T_NBR;
 			}
+			SaveNumber(sp, p - sp, t, f, i64);                          // so that we don't have to do this again
 		}
 
 
@@ -1812,6 +2356,113 @@ char __attribute__ ((optimize("-O3"))) *getvalue(char *p, MMFLOAT *fa, long long
 
 
 
+// hash a label in the token format (ie, length byte followed by the characters).  Labels are not case sensitive.
+static unsigned int LabelHash(char *p) {
+    unsigned int hash = FNV_offset_basis;
+    int i;
+    for(i = 0; i <= (unsigned char)p[0]; i++) {
+        hash ^= toupper(p[i]);
+        hash *= FNV_prime;
+    }
+    return hash;
+}
+
+
+// scan one area of program memory (main program or the library) for labels and line numbers
+// if index is false it just counts them, otherwise it adds them to the label and line number index
+static void IndexArea(char *p, char *end, int lib, int index, int *nlabels, int *nlines) {
+    char *lastp = p + 1;
+    unsigned int h;
+    while(p < end && !(p[0] == 0 && p[1] == 0)) {                   // the same scan as findline() and findlabel()
+        if(p[0] == T_NEWLINE) {
+            lastp = p++;
+            continue;
+        }
+        if(p[0] == T_LINENBR) {
+            if(index) {
+                if(*nlines > (lib ? lineidxmain : 0) && ((lineidx[*nlines - 1][1] << 8) | lineidx[*nlines - 1][2]) > ((p[1] << 8) | p[2]))
+                    lineidxsorted[lib] = false;
+                lineidx[*nlines] = p;
+            }
+            (*nlines)++;
+            p += 3;
+            continue;
+        }
+        if(p[0] == T_LABEL) {
+            p++;
+            if(index) {
+                h = LabelHash(p) & (labeltblsize - 1);
+                while(labeltbl[h].label != NULL) h = (h + 1) & (labeltblsize - 1);
+                labeltbl[h].label = p;
+                labeltbl[h].line = lastp;
+            }
+            (*nlabels)++;
+            p += p[0] + 1;
+            continue;
+        }
+        p++;
+    }
+}
+
+
+// build the index of labels and line numbers used by findlabel() and findline()
+// this is called by PrepareProgram() before the program is run.  The index lives on the heap and
+// if there is not enough memory it is simply not built and the searches will scan the program instead
+void BuildLabelIndex(void) {
+    int nlabels = 0, nlines = 0, size;
+    char *libend = ProgMemory + PROG_FLASH_SIZE;
+
+    ClearLabelIndex();
+    IndexArea(ProgMemory, ProgMemory + Option.ProgFlashSize, 0, false, &nlabels, &nlines);
+    if(Option.ProgFlashSize != PROG_FLASH_SIZE) IndexArea(ProgMemory + Option.ProgFlashSize, libend, 1, false, &nlabels, &nlines);
+    if(nlabels == 0 && nlines == 0) return;
+    if(nlabels) for(labeltblsize = 16; labeltblsize < nlabels * 2; labeltblsize <<= 1);
+    size = labeltblsize * sizeof(struct s_labeltbl) + nlines * sizeof(char *);
+    if(size > FreeSpaceOnHeap() / 4) {                              // don't hog the heap, the program might need it
+        labeltblsize = 0;
+        return;
+    }
+    if(labeltblsize) labeltbl = GetMemory(labeltblsize * sizeof(struct s_labeltbl));
+    if(nlines) lineidx = GetMemory(nlines * sizeof(char *));
+    lineidxsorted[0] = lineidxsorted[1] = true;
+    nlabels = nlines = 0;
+    IndexArea(ProgMemory, ProgMemory + Option.ProgFlashSize, 0, true, &nlabels, &nlines);
+    lineidxmain = nlines;
+    if(Option.ProgFlashSize != PROG_FLASH_SIZE) IndexArea(ProgMemory + Option.ProgFlashSize, libend, 1, true, &nlabels, &nlines);
+    lineidxcnt = nlines;
+}
+
+
+// discard the label and line number index and return its memory to the heap
+void ClearLabelIndex(void) {
+    FreeMemorySafe((void **)&labeltbl);
+    FreeMemorySafe((void **)&lineidx);
+    labeltblsize = lineidxcnt = lineidxmain = 0;
+}
+
+
+// search one area of the line number index.  Returns NULL if not found
+static char *FindLineIdx(int lib, int nbr, int mustfind) {
+    int lo, hi, mid, i;
+    lo = lib ? lineidxmain : 0;
+    hi = lib ? lineidxcnt : lineidxmain;
+    if(lineidxsorted[lib]) {
+        while(lo < hi) {                                            // binary search for the first line >= nbr
+            mid = (lo + hi) / 2;
+            if(((lineidx[mid][1] << 8) | lineidx[mid][2]) < nbr) lo = mid + 1; else hi = mid;
+        }
+        if(lo == (lib ? lineidxcnt : lineidxmain)) return NULL;
+        i = (lineidx[lo][1] << 8) | lineidx[lo][2];
+        return (i == nbr || (!mustfind && i > nbr)) ? lineidx[lo] : NULL;
+    }
+    for(; lo < hi; lo++) {                                          // line numbers out of order, do a linear search
+        i = (lineidx[lo][1] << 8) | lineidx[lo][2];
+        if(i == nbr || (!mustfind && i > nbr)) return lineidx[lo];
+    }
+    return NULL;
+}
+
+
 // search through program memory looking for a line number. Stops when it has a matching or larger number
 // returns a pointer to the T_NEWLINE token or a pointer to the two zero characters representing the end of the program
 char *findline(int nbr, int mustfind) {
@@ -1819,6 +2470,14 @@ char *findline(int nbr, int mustfind) {
     char *next;
     int i,j=0;
 
+    // use the index if it has been built
+    if(lineidx != NULL) {
+        i = (CurrentLinePtr >= ProgMemory + Option.ProgFlashSize);  // search the library first if we are running in it
+        if((p = FindLineIdx(i, nbr, mustfind)) != NULL) return p;
+        if(Option.ProgFlashSize != PROG_FLASH_SIZE && (p = FindLineIdx(!i, nbr, mustfind)) != NULL) return p;
+        if(mustfind) error("Line number");
+    }
+
     // point to the main program memory or the library
     p = ProgMemory;
     next=ProgMemory + Option.ProgFlashSize;
@@ -1875,7 +2534,7 @@ char *findline(int nbr, int mustfind) {
 
 // search through program memory looking for a label.
 // returns a pointer to the T_NEWLINE token or throws an error if not found
-// non cached version
+// a NULL argument will clear the label index
 char *findlabel(char *labelptr) {
     char *p, *lastp = ProgMemory + 1;
     char *next;
@@ -1883,7 +2542,10 @@ char *findlabel(char *labelptr) {
     char label[MAXVARLEN + 1];
 
     // first, just exit we have a NULL argument
-    if(labelptr == NULL) return NULL;
+    if(labelptr == NULL) {
+        ClearLabelIndex();
+        return NULL;
+    }
 
     // convert the label to the token format and load into label[]
     // this assumes that the first character has already been verified as a valid label character
@@ -1895,6 +2557,24 @@ char *findlabel(char *labelptr) {
     }
     label[0] = i - 1;                                               // the length byte
 
+    // use the index if it has been built
+    // labels in the area that we are running in (main program or library) take precedence
+    if(labeltbl != NULL) {
+        j = (CurrentLinePtr >= ProgMemory + Option.ProgFlashSize);
+        lastp = NULL;
+        i = LabelHash(label) & (labeltblsize - 1);
+        while(labeltbl[i].label != NULL) {
+            p = labeltbl[i].label;
+            if(mem_equal(p, label, label[0] + 1)) {
+                if((p >= ProgMemory + Option.ProgFlashSize) == j) return labeltbl[i].line;
+                if(lastp == NULL) lastp = labeltbl[i].line;         // in the other area, use it if nothing better is found
+            }
+            i = (i + 1) & (labeltblsize - 1);
+        }
+        if(lastp == NULL) error("Cannot find label");
+        return lastp;
+    }
+
     // point to the main program memory or the library
     p = ProgMemory;
     next=ProgMemory + Option.ProgFlashSize;
@@ -2177,6 +2857,7 @@ routines for storing and manipulating variables
 
         // if it is a non arrayed variable or an empty array it is easy, just calculate and return a pointer to the value
         if(dnbr == -1 || vartbl[vindex].dims[0] == 0) {
+            if(dnbr == 0 && action == V_FIND) SaveVarCache(sp, vindex); // remember this for the next time
             if(dnbr == -1 || vartbl[vindex].type & (T_PTR | T_STR))
                 return vartbl[vindex].val.s;                        // if it is a string or pointer just return the pointer to the data
             else
@@ -2354,6 +3035,7 @@ void *findvar(char *p, int action) {
     uint32_t hash=FNV_offset_basis;
 	char  *tp, *ip;
     int dim[MAXDIM]={0}, dnbr;
+    char *sp;                                                       // start of the name, this is the key for the variable cache
 //	if(__get_MSP() < (uint32_t)&stackcheck-0x5000){
 //		error("Expression is too complex at depth %",LocalIndex);
 //	}
@@ -2366,6 +3048,18 @@ void *findvar(char *p, int action) {
     skipspace(p);
     if(!isnamestart(*p)) error("Variable name");
 
+    // if this is a simple reference to a variable in the program it might have been resolved before
+    sp = p;
+    if(action == V_FIND && varcache != NULL && (tmp = FindVarCache(p)) >= 0) {
+        VarIndex = tmp;
+        if(vartbl[tmp].type & (T_PTR | T_STR))
+            return vartbl[tmp].val.s;                               // if it is a string or pointer just return the pointer to the data
+        else if(vartbl[tmp].type & T_INT)
+            return &(vartbl[tmp].val.i);                            // must be an integer, point to its value
+        else
+            return &(vartbl[tmp].val.f);                            // must be a straight number (float), point to its value
+    }
+
     // copy the variable name into name
     s = name; namelen = 0;
 	do {
@@ -2578,6 +3272,7 @@ void *findvar(char *p, int action) {
 
         // if it is a non arrayed variable or an empty array it is easy, just calculate and return a pointer to the value
         if(dnbr == -1 || vartbl[vindex].dims[0] == 0) {
+            if(dnbr == 0 && action == V_FIND) SaveVarCache(sp, vindex); // remember this for the next time
             if(dnbr == -1 || vartbl[vindex].type & (T_PTR | T_STR))
                 return vartbl[vindex].val.s;                        // if it is a string or pointer just return the pointer to the data
             else
@@ -2644,17 +3339,7 @@ void *findvar(char *p, int action) {
     }
 #else
     if(!(action & V_FUNCT)) {                                       // don't do this if we are defining the local variable for a function name
-        for(i = 0;  i < MAXSUBFUN && subfun[i] != NULL; i++) {
-            x = subfun[i];                                          // point to the command token
-            x++; skipspace(x);                                      // point to the identifier
-            s = name;                                               // point to the new variable
-            if(*s != toupper(*x)) continue;                         // quick first test
-            while(1) {
-                if(!isnamechar(*s) && !isnamechar(*x)) error("A sub/fun has the same name: $", name);
-                if(*s != toupper(*x) || *s == 0 || !isnamechar(*x) || s - name >= MAXVARLEN) break;
-                s++; x++;
-            }
-        }
+        if(FindSubFun(name, -1) >= 0) error("A sub/fun has the same name: $", name);
     }
 #endif
     // set a default string size
@@ -2689,9 +3374,11 @@ void *findvar(char *p, int action) {
  // if we are adding to the top, increment the number of vars
 	if(ifree>=MAXVARS/2){
 		Globalvarcnt++;
+		VarGenGlobal++;                                             // invalidate the variable cache
 		if(Globalvarcnt>=MAXVARS/2)error("Not enough Global variable memory");
 	} else {
 		Localvarcnt++;
+		VarGenLocal++;
 		if(Localvarcnt>=MAXVARS/2)error("Not enough Local variable memory");
 	}
 	varcnt=Globalvarcnt+Localvarcnt;
@@ -3247,6 +3934,9 @@ Various routines to clear memory or the interpreter's state
 void ClearVars(int level) {
    int i, newhashpointer,hashcurrent,hashnext;
 
+    VarGenLocal++;                                                  // invalidate the variable cache
+    if(level == 0) VarGenGlobal++;
+
     // first step through the variable table and delete local variables at that level or greater
 	if(level){
 		newhashpointer=hashlistpointer; //save the current number of stored values
@@ -3256,6 +3946,7 @@ void ClearVars(int level) {
 				hashnext++;
 				hashnext %= MAXVARS/2;
 				if(((vartbl[hashcurrent].type & T_STR) || vartbl[hashcurrent].dims[0] != 0) && !(vartbl[hashcurrent].type & T_PTR) && ((uint32_t)vartbl[hashcurrent].val.s<(uint32_t)RAMEND)&& ((uint32_t)vartbl[hashcurrent].val.s>(uint32_t)RAMBase)) {
+					ADCStreamVarFreed(vartbl[hashcurrent].val.s);
 					FreeMemorySafe((void **)&vartbl[hashcurrent].val.s);
 					// free any memory (if allocated)
 				}
@@ -3275,6 +3966,7 @@ void ClearVars(int level) {
 		for(i = 0; i < MAXVARS; i++) {
 			if(((vartbl[i].type & T_STR) || vartbl[i].dims[0] != 0) && !(vartbl[i].type & T_PTR)) {
 				if((uint32_t)vartbl[i].val.s>(uint32_t)RAMBase && (uint32_t)vartbl[i].val.s<(uint32_t)RAMEND){
+                    ADCStreamVarFreed(vartbl[i].val.s);                              // stop ADC STREAM if this is its buffer
                     FreeMemorySafe((void **)&vartbl[i].val.s);                        // free any memory (if allocated)
                 }
 			}
@@ -3342,6 +4034,12 @@ void MIPS16 ClearRuntime(void) {
     ds18b20Timers = NULL;                                           // InitHeap() will recover the memory allocated to this array
     CloseAllFiles();
     findlabel(NULL);                                                // clear the label cache
+    ClearJumpCache();                                               // and the FOR/NEXT, DO/LOOP, etc cache
+    StatementCount = 0;
+    ProfileClear();                                                 // InitHeap() will recover the memory used by the profile
+    FftPlanClear();                                                 // and the FFT twiddle factors
+    JsonClear();                                                    // and any open JSON documents
+    CanClear();                                                     // and the CAN receive queues
     ClearExternalIO();                                              // this MUST come before InitHeap()
     OptionErrorSkip = 0;
     MMerrno = 0;                                                    // clear the error flags
@@ -3354,6 +4052,7 @@ void MIPS16 ClearRuntime(void) {
     varcnt = 0;
     CurrentLinePtr = ContinuePoint = NULL;
     for(i = 0;  i < MAXSUBFUN; i++)  subfun[i] = NULL;
+    memset(subfunhash, 0, sizeof(subfunhash));
 }
 
 
@@ -3365,6 +4064,7 @@ void MIPS16 ClearProgram(void) {
     StartEditPoint = NULL;
     StartEditChar = 0;
     TraceOn = false;
+    ProfileOn = false;
 }
 
 
@@ -131,6 +131,110 @@ int ADCNumchannels=0;
 int ADCtriggervalue=0;
 int ADCtriggertimeout=0;
 char *ADCInterrupt;
+int ADCrate;                                        // the sample rate set by ADC OPEN or ADC FREQUENCY
+
+/* ADC STREAM
+ * Instead of filling one float array per channel and stopping, ADC STREAM samples continuously into an integer
+ * array used as a circular buffer of packed 16 bit samples (four to each element, interleaved when more than
+ * one channel is open).  Each time half of the buffer has been filled the ADC interrupt is posted so that BASIC
+ * can use that half (ADC STREAM READ) while the other half is being filled.  If a file is given each half is also
+ * written to the SD card by CheckSDCard() so the length of a capture is limited by the card, not the RAM.
+ * The buffer itself is managed by ADCStreamPut(), ADCStreamTake() and ADCStreamRelease() in ADCStream.c.
+ * The buffer is a BASIC array so it cannot be LOCAL and the stream is stopped if the array is freed by ERASE
+ * or CLEAR (see ADCStreamVarFreed()).
+ */
+struct s_adcstream ADCstream;
+volatile int ADCstreaming = false;
+static int ADCstreamfnbr = 0;                       // the file the samples are written to, zero if none
+static int ADCstreamwav;                            // true if the file is in WAV format, otherwise it is raw samples
+static unsigned int ADCstreambytes;                 // nbr of bytes of samples written to the file
+static int ADCstreamerror;                          // the file system error if a write failed
+static unsigned int ADCstreamtorn;                  // nbr of READs that were overwritten by the interrupt while reading
+
+// called from the TIM7 interrupt when streaming
+void __attribute__ ((optimize("-O2"))) ADCStreamISR(void) {
+    uint16_t s[3];
+    int n = 0;
+    s[n++] = hadc1.Instance->DR;                    // get the conversion started on the previous tick
+    hadc1.Instance->CR2 |= ADC_CR2_SWSTART;         // and start the next one
+    if(ADCchannelB) {
+        s[n++] = hadc3.Instance->DR;
+        hadc3.Instance->CR2 |= ADC_CR2_SWSTART;
+    }
+    if(ADCchannelC) {
+        s[n++] = hadc2.Instance->DR;
+        hadc2.Instance->CR2 |= ADC_CR2_SWSTART;
+    }
+    if(ADCStreamPut(&ADCstream, s, n)) IntPost(INT_ADC);
+}
+
+// write the WAV file header, the sizes are correct for the samples written so far
+static void ADCStreamHeader(void) {
+    unsigned char h[44] = { 'R','I','F','F', 0,0,0,0, 'W','A','V','E', 'f','m','t',' ', 16,0,0,0, 1,0, 0,0,
+                            0,0,0,0, 0,0,0,0, 0,0, 16,0, 'd','a','t','a', 0,0,0,0 };
+    unsigned int v[6] = { 36 + ADCstreambytes, ADCNumchannels, ADCrate, ADCrate * ADCNumchannels * 2, ADCNumchannels * 2, ADCstreambytes };
+    const unsigned char offset[6] = { 4, 22, 24, 28, 32, 40 }, len[6] = { 4, 2, 4, 4, 2, 4 };
+    unsigned int nbr;
+    int i, j;
+    for(i = 0; i < 6; i++)
+        for(j = 0; j < len[i]; j++) h[offset[i] + j] = v[i] >> (j * 8);
+    if(!ADCstreamerror) ADCstreamerror = f_lseek(FileTable[ADCstreamfnbr].fptr, 0);
+    if(!ADCstreamerror) ADCstreamerror = f_write(FileTable[ADCstreamfnbr].fptr, h, 44, &nbr);
+}
+
+// write n samples to the file, WAV files need signed 16 bit samples
+static void ADCStreamWrite(uint16_t *p, int n) {
+    uint16_t out[128];
+    unsigned int nbr;
+    int i, j, shift = 16 - ADCbits[ADCchannelA];
+    if(ADCstreamerror || FileTable[ADCstreamfnbr].fptr == NULL) return;
+    if(ADCstreamwav) {
+        for(i = 0; i < n && !ADCstreamerror; i += j) {
+            for(j = 0; j < 128 && i + j < n; j++) out[j] = (p[i + j] << shift) - 32768;
+            ADCstreamerror = f_write(FileTable[ADCstreamfnbr].fptr, out, j * 2, &nbr);
+        }
+    } else
+        ADCstreamerror = f_write(FileTable[ADCstreamfnbr].fptr, p, n * 2, &nbr);
+    if(!ADCstreamerror) ADCstreambytes += n * 2;
+}
+
+// write any full halves to the file, called by CheckSDCard()
+void ADCStreamService(void) {
+    uint16_t *p;
+    int h;
+    if(ADCstreamfnbr == 0) return;
+    while((p = ADCStreamTake(&ADCstream, &h)) != NULL) {
+        ADCStreamWrite(p, ADCstream.size / 2);
+        ADCStreamRelease(&ADCstream, h);
+    }
+}
+
+// stop streaming and close the file, returns the file system error if writing to the file failed
+static int ADCStreamStop(void) {
+    int h, e;
+    if(!ADCstreaming) return 0;
+    HAL_TIM_Base_Stop(&htim7);
+    HAL_TIM_Base_DeInit(&htim7);
+    ADCstreaming = false;
+    if(ADCstreamfnbr) {
+        ADCStreamService();                         // write any full halves still waiting
+        h = (ADCstream.pos >= ADCstream.size / 2);  // and the part of the half being filled
+        ADCStreamWrite(ADCstream.buf + h * (ADCstream.size / 2), ADCstream.pos - h * (ADCstream.size / 2));
+        if(ADCstreamwav && FileTable[ADCstreamfnbr].fptr != NULL) ADCStreamHeader();
+        ForceFileClose(ADCstreamfnbr);
+        ADCstreamfnbr = 0;
+    }
+    ADCstream.buf = NULL;
+    e = ADCstreamerror;
+    ADCstreamerror = 0;
+    return e;
+}
+
+// called before the memory of a variable is freed, the stream must stop if its buffer is in that memory
+void ADCStreamVarFreed(void *p) {
+    if(ADCstreaming && p != NULL && (char *)ADCstream.buf >= (char *)p && (char *)ADCstream.buf < (char *)p + MemSize(p))
+        ADCStreamStop();
+}
 
 static void MX_TIM6_Init(int prescale, int period)
 {
@@ -224,6 +328,7 @@ void dacclose(void){
     d2max=0;
 }
 void ADCclose(void){
+    ADCStreamStop();
     if(ADCchannelA){
         HAL_TIM_Base_Stop(&htim7);
         HAL_TIM_Base_DeInit(&htim7);
@@ -279,6 +384,7 @@ void cmd_ADC(void){
         } else
             ADCInterrupt = NULL;
         freq=getnumber(argv[0]);
+        ADCrate = freq;
         freq*=2;
         prescale=(int)((MMFLOAT)(SystemCoreClock*2)/(freq*50000.0L));
         period=(int)(((MMFLOAT)SystemCoreClock/(MMFLOAT)(prescale+1))/freq);
@@ -407,6 +513,7 @@ void cmd_ADC(void){
 	if(tp) {
         getargs(&tp, 17, ",");
         if(!ADCchannelA)error("ADC not open");
+        if(ADCstreaming)error("ADC already streaming");
         if(!(argc >= 1))error("Argument count");
        // int64_t *a1point;
         //int64_t *)a1point=NULL; a2point=NULL; a3point=NULL;
@@ -531,6 +638,98 @@ void cmd_ADC(void){
 
         }
         return;
+    }
+	tp = checkstring(cmdline, "STREAM");
+	if(tp) {
+        char *p;
+        int i, j, n, h, nch = ADCNumchannels;
+        if(!ADCchannelA)error("ADC not open");
+        // ADC STREAM READ a!() [, b!() [, c!()]]   convert the oldest half not yet read to voltages
+        // when a file is open the file writer takes each half so this reads the last half filled without using it up
+        if((p = checkstring(tp, "READ"))) {
+            MMFLOAT *a[3];
+            uint16_t *s;
+            unsigned int f;
+            int idx[3] = { 0, ADCchannelB ? 1 : 2, 2 };    // the ADCscale[] entry for each channel in the stream
+            getargs(&p, 5, ",");
+            if(!ADCstreaming) error("ADC not streaming");
+            if(argc < 1 || (argc + 1) / 2 > nch) error("Argument count");
+            n = ADCstream.size / 2 / nch;
+            for(i = 0; i < (argc + 1) / 2; i++)
+                if(parsefloatrarray(argv[i * 2], &a[i], i + 1, 1, NULL, true) < n) error("Array too small");
+            if(ADCstreamfnbr) {
+                h = ADCstream.last;
+                f = ADCstream.filled[h];
+                if(f == 0 || ADCstream.started[h] != f) error("No samples ready");
+                s = ADCstream.buf + h * (ADCstream.size / 2);
+            } else if((s = ADCStreamTake(&ADCstream, &h)) == NULL)
+                error("No samples ready");
+            for(j = 0; j < n; j++)
+                for(i = 0; i < (argc + 1) / 2; i++)
+                    a[i][j] = (MMFLOAT)(ADCscale[idx[i]] * s[j * nch + i]) + ADCbottom[idx[i]];
+            if(ADCstreamfnbr ? ADCstream.started[h] != f : ADCStreamRelease(&ADCstream, h))
+                ADCstreamtorn++;                            // some of the samples were replaced while converting them
+            return;
+        }
+        // ADC STREAM STATUS halves%, overruns% [, torn%]
+        if((p = checkstring(tp, "STATUS"))) {
+            long long int *halves, *overruns, *torn;
+            getargs(&p, 5, ",");
+            if(argc != 3 && argc != 5) error("Argument count");
+            halves = findvar(argv[0], V_FIND);
+            if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable");
+            overruns = findvar(argv[2], V_FIND);
+            if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable");
+            if(argc == 5) {
+                torn = findvar(argv[4], V_FIND);
+                if(!(vartbl[VarIndex].type & T_INT)) error("Invalid variable");
+                *torn = ADCstreamtorn;
+            }
+            *halves = ADCstream.count;
+            *overruns = ADCstream.overrun;
+            return;
+        }
+        // ADC STREAM STOP
+        if(checkstring(tp, "STOP")) {
+            if(ADCStreamStop()) error("Stream file write failed");
+            return;
+        }
+        // ADC STREAM buffer%() [, interrupt] [, file$]
+        int64_t *buf;
+        getargs(&tp, 5, ",");
+        if(argc < 1) error("Argument count");
+        if(ADCstreaming) error("ADC already streaming");
+        n = parseintegerarray(argv[0], &buf, 1, 1, NULL, true) * 4 / (2 * nch) * (2 * nch);
+        if(vartbl[VarIndex].level && !(vartbl[VarIndex].type & T_PTR)) error("Buffer cannot be a LOCAL array");
+        if(n == 0) error("Array too small");
+        if(argc >= 3 && *argv[2]) {
+            InterruptUsed = true;
+            ADCInterrupt = GetIntAddress(argv[2]);                          // called as each half is filled
+        } else
+            ADCInterrupt = NULL;
+        memset(&ADCstream, 0, sizeof(ADCstream));
+        ADCstream.buf = (uint16_t *)buf;
+        ADCstream.size = n;
+        ADCstreamerror = ADCstreambytes = ADCstreamtorn = 0;
+        if(argc == 5) {
+            if(!InitSDCard()) return;
+            p = getCstring(argv[4]);
+            ADCstreamwav = (strchr(p, '.') != NULL && strcasecmp(strchr(p, '.'), ".WAV") == 0);
+            i = FindFreeFileNbr();
+            if(!BasicFileOpen(p, i, FA_WRITE | FA_CREATE_ALWAYS)) return;
+            ADCstreamfnbr = i;
+            if(ADCstreamwav) ADCStreamHeader();                             // the sizes are filled in by ADC STREAM STOP
+        }
+        for(i = 0; i < 3; i++) {
+            ADCscale[i] = VCC / ADCdiv[ADCbits[ADCchannelA]];
+            ADCbottom[i] = 0;
+        }
+        if (HAL_ADC_Start(&hadc1) != HAL_OK) error("HAL_ADC_StartA");       // the first conversion, the ISR starts the rest
+        if(ADCchannelB && HAL_ADC_Start(&hadc3) != HAL_OK) error("HAL_ADC_StartB");
+        if(ADCchannelC && HAL_ADC_Start(&hadc2) != HAL_OK) error("HAL_ADC_StartC");
+        ADCstreaming = true;
+        MX_TIM7_Init(prescale,period);
+        return;
     }
 	tp = checkstring(cmdline, "FREQUENCY");
 	if(tp) {
@@ -546,6 +745,8 @@ void cmd_ADC(void){
         if(freq>160000.0)newbits=10;
         if(freq>320000.0)newbits=8;
         if(ADCbits[ADCchannelA]!=newbits)error("Invalid frequency change - use CLOSE then OPEN");
+        if(ADCstreaming)error("Cannot change the frequency while streaming");
+        ADCrate = freq;
         prescale=(int)((MMFLOAT)(SystemCoreClock*2)/(freq*50000.0L));
         period=(int)(((MMFLOAT)SystemCoreClock/(MMFLOAT)(prescale+1))/freq);
         return;
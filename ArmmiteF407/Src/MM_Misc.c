@@ -64,6 +64,18 @@ volatile int TickTimer[NBRSETTICKS];
 char *TickInt[NBRSETTICKS];
 volatile unsigned char TickActive[NBRSETTICKS];
 
+volatile unsigned int IntPending;                                   // interrupt sources posted by IntPost(), one bit for each
+static unsigned int IntPolled;                                      // sources that must be checked after every command
+unsigned char IntPriority[INT_NBRSOURCES];                          // 1 is the highest priority, 9 the lowest
+struct s_intstat {
+    unsigned int count;                                             // nbr of times the interrupt routine was called
+    unsigned int dropped;                                           // events lost because the previous one was still pending
+    unsigned int maxlatency;                                        // worst case CPU cycles from the event to the call
+} IntStat[INT_NBRSOURCES];
+static volatile unsigned int IntPostTime[INT_NBRSOURCES];           // cycle count when the pending event was posted
+static char *IntAddr[INT_NBRSOURCES];                               // the interrupt routine found when a source was polled
+static int IntLast;                                                 // the last source dispatched
+
 char *OnKeyGOSUB = NULL;
 const char *daystrings[] = {"dummy","Monday","Tuesday","Wednesday","Thursday","Friday","Saturday","Sunday"};
 
@@ -91,7 +103,7 @@ extern char LCDAttrib;
 extern volatile BYTE SDCardStat;
 extern volatile int keyboardseen;
 extern USBD_HandleTypeDef hUsbDeviceFS;
-extern uint64_t TIM12count;
+extern volatile uint64_t TIM12count;
 extern TIM_HandleTypeDef htim12;
 MMFLOAT optionangle=1.0;
 
@@ -116,178 +128,365 @@ char SaveMMErrMsg[MAXERRMSG];  // save the error message
 //extern unsigned int _excep_code;//  __attribute__ ((persistent));  // if there was an exception this is the exception code
 //extern unsigned int _restart_reason;//  __attribute__ ((persistent));  // if there was an exception this is the exception code
 
-void integersort(int64_t *iarray, int n, long long *index, int flags, int startpoint){
-    int i, j = n, s = 1;
-    int64_t t;
-    if((flags & 1) == 0){
-		while (s) {
-			s = 0;
-			for (i = 1; i < j; i++) {
-				if (iarray[i] < iarray[i - 1]) {
-					t = iarray[i];
-					iarray[i] = iarray[i - 1];
-					iarray[i - 1] = t;
-					s = 1;
-			        if(index!=NULL){
-			        	t=index[i-1+startpoint];
-			        	index[i-1+startpoint]=index[i+startpoint];
-			        	index[i+startpoint]=t;
-			        }
-				}
-			}
-			j--;
-		}
-    } else {
-		while (s) {
-			s = 0;
-			for (i = 1; i < j; i++) {
-				if (iarray[i] > iarray[i - 1]) {
-					t = iarray[i];
-					iarray[i] = iarray[i - 1];
-					iarray[i - 1] = t;
-					s = 1;
-			        if(index!=NULL){
-			        	t=index[i-1+startpoint];
-			        	index[i-1+startpoint]=index[i+startpoint];
-			        	index[i+startpoint]=t;
-			        }
-				}
-			}
-			j--;
-		}
+// context for the sort engine used by the SORT command
+// the elements are sorted in place with a stable merge sort that needs no extra memory (insertion sort for blocks of
+// SORTBLOCK elements which are then merged using rotations, the SymMerge algorithm of Kim and Kutzner).  It is stable,
+// like the bubble sort that it replaced, so equal elements keep their order and the index array is moved along with them
+#define SORTBLOCK   20
+static struct {
+    MMFLOAT *f; int64_t *i; unsigned char *s; int len;              // the array being sorted (only one of f, i or s is used)
+    MMFLOAT *kf; int64_t *ki; unsigned char *ks; int klen;          // the secondary key array (if any)
+    int64_t *index;                                                 // the index array (or NULL)
+    int *pos;                                                       // original position of each element if there is no index array
+    int flags;                                                      // 1 = descending, 2 = case insensitive, 4 = empty strings last
+} srt;
+
+// compare two strings (MMBasic format), optionally ignoring case
+static int SortStrCmp(unsigned char *s1, unsigned char *s2, int nocase) {
+    int i, n = (*s1 < *s2) ? *s1 : *s2;
+    unsigned char *p1 = s1 + 1, *p2 = s2 + 1;
+    for(i = 0; i < n; i++, p1++, p2++) {
+        if(nocase) {
+            if(toupper(*p1) != toupper(*p2)) return toupper(*p1) - toupper(*p2);
+        } else {
+            if(*p1 != *p2) return *p1 - *p2;
+        }
     }
+    return *s1 - *s2;                                               // if they match up to this point the shorter one is smaller
 }
-void floatsort(MMFLOAT *farray, int n, long long *index, int flags, int startpoint){
-    int i, j = n, s = 1;
-    int64_t t;
-    MMFLOAT f;
-    if((flags & 1) == 0){
-		while (s) {
-			s = 0;
-			for (i = 1; i < j; i++) {
-				if (farray[i] < farray[i - 1]) {
-					f = farray[i];
-					farray[i] = farray[i - 1];
-					farray[i - 1] = f;
-					s = 1;
-			        if(index!=NULL){
-			        	t=index[i-1+startpoint];
-			        	index[i-1+startpoint]=index[i+startpoint];
-			        	index[i+startpoint]=t;
-			        }
-				}
-			}
-			j--;
-		}
-    } else {
-		while (s) {
-			s = 0;
-			for (i = 1; i < j; i++) {
-				if (farray[i] > farray[i - 1]) {
-					f = farray[i];
-					farray[i] = farray[i - 1];
-					farray[i - 1] = f;
-					s = 1;
-			        if(index!=NULL){
-			        	t=index[i-1+startpoint];
-			        	index[i-1+startpoint]=index[i+startpoint];
-			        	index[i+startpoint]=t;
-			        }
-				}
-			}
-			j--;
-		}
+
+// get the original position of the element at position a
+static inline int SortPos(int a) {
+    return srt.index != NULL ? (int)srt.index[a] - OptionBase : srt.pos[a];
+}
+
+// compare the elements at positions a and b, returns < 0 if a should come before b
+static int SortCompare(int a, int b) {
+    int k, pa, pb;
+    if(srt.f != NULL) k = (srt.f[a] > srt.f[b]) - (srt.f[a] < srt.f[b]);
+    else if(srt.i != NULL) k = (srt.i[a] > srt.i[b]) - (srt.i[a] < srt.i[b]);
+    else {
+        unsigned char *s1 = srt.s + a * srt.len, *s2 = srt.s + b * srt.len;
+        if((srt.flags & 4) && (*s1 == 0) != (*s2 == 0)) return (*s1 == 0) ? 1 : -1;  // empty strings go last regardless of the order
+        k = SortStrCmp(s1, s2, srt.flags & 2);
+    }
+    if(k == 0 && (srt.kf != NULL || srt.ki != NULL || srt.ks != NULL)) {  // equal so use the secondary key
+        pa = SortPos(a); pb = SortPos(b);
+        if(srt.kf != NULL) k = (srt.kf[pa] > srt.kf[pb]) - (srt.kf[pa] < srt.kf[pb]);
+        else if(srt.ki != NULL) k = (srt.ki[pa] > srt.ki[pb]) - (srt.ki[pa] < srt.ki[pb]);
+        else k = SortStrCmp(srt.ks + pa * srt.klen, srt.ks + pb * srt.klen, srt.flags & 2);
+    }
+    if(srt.flags & 1) k = -k;
+    return k;
+}
+
+// swap the elements at positions a and b (and their entries in the index array)
+static void SortSwap(int a, int b) {
+    if(srt.f != NULL) { MMFLOAT t = srt.f[a]; srt.f[a] = srt.f[b]; srt.f[b] = t; }
+    else if(srt.i != NULL) { int64_t t = srt.i[a]; srt.i[a] = srt.i[b]; srt.i[b] = t; }
+    else {
+        unsigned char t, *p1 = srt.s + a * srt.len, *p2 = srt.s + b * srt.len;
+        int n = ((*p1 > *p2) ? *p1 : *p2) + 1;                      // only swap the characters in use
+        while(n--) { t = *p1; *p1++ = *p2; *p2++ = t; }
     }
+    if(srt.index != NULL) { int64_t t = srt.index[a]; srt.index[a] = srt.index[b]; srt.index[b] = t; }
+    else if(srt.pos != NULL) { int t = srt.pos[a]; srt.pos[a] = srt.pos[b]; srt.pos[b] = t; }
+}
+
+// swap the n elements starting at a with the n elements starting at b
+static void SortSwapRange(int a, int b, int n) {
+    while(n--) SortSwap(a++, b++);
 }
 
-void stringsort(unsigned char *sarray, int n, int offset, long long *index, int flags, int startpoint){
-	int ii,i, s = 1,isave;
-	int k;
-	unsigned char *s1,*s2,*p1,*p2;
-	unsigned char temp;
-	int reverse= 1-((flags & 1)<<1);
-    while (s){
-      s=0;
-      for(i=1;i<n;i++){
-        s2=i*offset+sarray;
-        s1=(i-1)*offset+sarray;
-        ii = *s1 < *s2 ? *s1 : *s2; //get the smaller  length
-        p1 = s1 + 1; p2 = s2 + 1;
-        k=0; //assume the strings match
-        while((ii--) && (k==0)) {
-          if(flags & 2){
-			  if(toupper(*p1) > toupper(*p2)){
-				k=reverse; //earlier in the array is bigger
-			  }
-			  if(toupper(*p1) < toupper(*p2)){
-				 k=-reverse; //later in the array is bigger
-			  }
-          } else {
-			  if(*p1 > *p2){
-				k=reverse; //earlier in the array is bigger
-			  }
-			  if(*p1 < *p2){
-				 k=-reverse; //later in the array is bigger
-			  }
-          }
-          p1++; p2++;
+// exchange the blocks a..m-1 and m..b-1
+static void SortRotate(int a, int m, int b) {
+    int i = m - a, j = b - m;
+    while(i != j) {
+        if(i > j) {
+            SortSwapRange(m - i, m, j);
+            i -= j;
+        } else {
+            SortSwapRange(m - i, m + j - i, i);
+            j -= i;
         }
-      // if up to this point the strings match
-      // make the decision based on which one is shorter
-      if(k==0){
-        if(*s1 > *s2) k=reverse;
-        if(*s1 < *s2) k=-reverse;
-      }
-      if (k==1){ // if earlier is bigger swap them round
-        ii = *s1 > *s2 ? *s1 : *s2; //get the bigger length
-        ii++;
-        p1=s1;p2=s2;
-        while(ii--){
-          temp=*p1;
-          *p1=*p2;
-          *p2=temp;
-          p1++; p2++;
+    }
+    SortSwapRange(m - i, m, i);
+}
+
+// merge the sorted runs a..m-1 and m..b-1 in place
+static void SortMerge(int a, int m, int b) {
+    int i, j, h, k, mid, n, start, r, p, end;
+    if(m - a == 1) {                                                // insert a single element with a binary search
+        for(i = m, j = b; i < j; ) {
+            h = (i + j) / 2;
+            if(SortCompare(h, a) < 0) i = h + 1; else j = h;
         }
-        s=1;
-        if(index!=NULL){
-        	isave=index[i-1+startpoint];
-        	index[i-1+startpoint]=index[i+startpoint];
-        	index[i+startpoint]=isave;
+        for(k = a; k < i - 1; k++) SortSwap(k, k + 1);
+        return;
+    }
+    if(b - m == 1) {
+        for(i = a, j = m; i < j; ) {
+            h = (i + j) / 2;
+            if(SortCompare(m, h) >= 0) i = h + 1; else j = h;
         }
-      }
+        for(k = m; k > i; k--) SortSwap(k, k - 1);
+        return;
+    }
+    mid = (a + b) / 2;
+    n = mid + m;
+    if(m > mid) { start = n - b; r = mid; }
+    else { start = a; r = m; }
+    p = n - 1;
+    while(start < r) {                                              // find where to split the two runs
+        h = (start + r) / 2;
+        if(SortCompare(p - h, h) >= 0) start = h + 1; else r = h;
+    }
+    end = n - start;
+    if(start < m && m < end) SortRotate(start, m, end);
+    if(a < start && start < mid) SortMerge(a, start, mid);
+    if(mid < end && end < b) SortMerge(mid, end, b);
+}
+
+// sort the elements 0..n-1
+static void SortRange(int n) {
+    int a, b, i, j, block;
+    for(a = 0; a < n; a += SORTBLOCK) {                             // insertion sort each block
+        b = (a + SORTBLOCK < n) ? a + SORTBLOCK : n;
+        for(i = a + 1; i < b; i++)
+            for(j = i; j > a && SortCompare(j, j - 1) < 0; j--) SortSwap(j, j - 1);
+    }
+    for(block = SORTBLOCK; block < n; block *= 2) {                 // then merge pairs of blocks doubling the size each pass
+        for(a = 0; a + 2 * block <= n; a += 2 * block) SortMerge(a, a + block, a + 2 * block);
+        if(a + block < n) SortMerge(a, a + block, n);
     }
-  }
 }
+
+// SORT array() [,indexarray()] [,flags] [,startposition] [,elementstoinclude] [,keyarray()]
 void cmd_sort(void){
-    MMFLOAT *a3float=NULL;
-    int64_t *a3int=NULL,*a4int=NULL;
-    unsigned char *a3str=NULL;
-    int i, size=0, truesize,flags=0, maxsize=0, startpoint=0;
-	getargs(&cmdline,9,(char *)",");
+    MMFLOAT *a3float=NULL, *a5float=NULL;
+    int64_t *a3int=NULL,*a4int=NULL,*a5int=NULL;
+    unsigned char *a3str=NULL,*a5str=NULL;
+    int i, size=0, truesize,flags=0, maxsize=0, keysize=0, startpoint=0;
+	getargs(&cmdline,11,(char *)",");
     size=parseany(argv[0],&a3float,&a3int,&a3str,&maxsize,true)-1;
     truesize=size;
     if(argc>=3 && *argv[2]){
         int card=parseintegerarray(argv[2],&a4int,2,1,NULL,true)-1;
     	if(card !=size)error("Array size mismatch");
     }
-    if(argc>=5 && *argv[4])flags=getint(argv[4],0,3);
+    if(argc>=5 && *argv[4])flags=getint(argv[4],0,15);             // 8 (stable) is still accepted, the sort is always stable
     if(argc>=7 && *argv[6])startpoint=getint(argv[6],OptionBase,size+OptionBase);
     size-=startpoint;
-    if(argc==9)size=getint(argv[8],1,size+1+OptionBase)-1;
+    if(argc>=9 && *argv[8])size=getint(argv[8],1,size+1+OptionBase)-1;
+    if(argc==11){
+        int card=parseany(argv[10],&a5float,&a5int,&a5str,&keysize,true)-1;
+    	if(card !=truesize)error("Array size mismatch");
+    }
     if(startpoint)startpoint-=OptionBase;
-    if(a3float!=NULL){
-    	a3float+=startpoint;
-    	if(a4int!=NULL)for(i=0;i<truesize+1;i++)a4int[i]=i+OptionBase;
-    	floatsort(a3float, size+1, a4int, flags, startpoint);
-    } else if(a3int!=NULL){
-    	a3int+=startpoint;
-    	if(a4int!=NULL)for(i=0;i<truesize+1;i++)a4int[i]=i+OptionBase;
-    	integersort(a3int,  size+1, a4int, flags, startpoint);
-    } else if(a3str!=NULL){
-    	a3str+=((startpoint)*(maxsize+1));
-    	if(a4int!=NULL)for(i=0;i<truesize+1;i++)a4int[i]=i+OptionBase;
-    	stringsort(a3str,  size+1,maxsize+1, a4int, flags, startpoint);
+    memset(&srt, 0, sizeof(srt));
+    srt.flags = flags;
+    srt.kf = a5float; srt.ki = a5int; srt.ks = a5str; srt.klen = keysize + 1;
+    if(a4int!=NULL){
+        for(i=0;i<truesize+1;i++)a4int[i]=i+OptionBase;
+        srt.index = a4int + startpoint;
+    } else if(argc==11){                                            // the key array needs the original positions but there is no index array
+        srt.pos = GetTempMemory((size + 1) * sizeof(int));
+        for(i=0;i<size+1;i++)srt.pos[i]=i+startpoint;
+    }
+    if(a3float!=NULL) srt.f = a3float + startpoint;
+    else if(a3int!=NULL) srt.i = a3int + startpoint;
+    else if(a3str!=NULL) {
+        srt.s = a3str + startpoint * (maxsize + 1);
+        srt.len = maxsize + 1;
+    } else return;
+    SortRange(size + 1);
+    if(srt.pos != NULL) ClearSpecificTempMemory(srt.pos);
+}
+
+
+// the execution profiler (PROFILE ON/OFF/LIST)
+// ExecuteProgram() calls ProfileLine() at the start of every line while ProfileOn is true.  This counts the hit on the
+// new line and charges the time since the previous line started to that line.  The table has one entry per line of the
+// program in program order and is built on the heap when the first line is profiled (RUN clears the heap so it is
+// rebuilt for each run).  Consecutive lines are found by checking the next entry, other jumps use a binary search.
+struct s_profile {
+    char *line;                                                     // points to the T_NEWLINE token of the line
+    unsigned int hits;                                              // nbr of times that the line was started
+    uint64_t ticks;                                                 // time spent in the line (uS)
+};
+int ProfileOn = false;
+struct s_profile *ProfileTbl = NULL;
+static int ProfileCnt = 0, ProfileLast = -1;
+static uint64_t ProfileStart;
+
+// read the 1uS timer used by TIMER (TIM12 extended by TIM12count in the interrupt)
+// TIM12count is 64 bits so reading it takes two loads, the loop also catches an interrupt between them
+static uint64_t ProfileTicks(void) {
+    uint64_t hi;
+    uint32_t lo;
+    do {
+        hi = TIM12count;
+        lo = __HAL_TIM_GET_COUNTER(&htim12);
+    } while(hi != TIM12count);                                      // the counter wrapped while we were reading it
+    return (hi << 16) | lo;
+}
+
+// step over a line in program memory, returns a pointer to the start of the next line
+static char *ProfileSkipLine(char *p) {
+    p++;                                                            // step over the T_NEWLINE
+    if(*p == T_LINENBR) p += 3;                                     // the line number could contain a zero byte
+    while(1) {
+        while(*p) p++;                                              // skip to the end of the element
+        p++;
+        if(*p == T_NEWLINE || *p == 0 || *p == 0xff) return p;
+    }
+}
+
+static void ProfileBuild(void) {
+    char *p;
+    int n = 0;
+    for(p = ProgMemory; *p == T_NEWLINE; p = ProfileSkipLine(p)) n++;
+    if(n == 0) return;
+    ProfileTbl = GetMemory(n * sizeof(struct s_profile));
+    for(p = ProgMemory, n = 0; *p == T_NEWLINE; p = ProfileSkipLine(p)) ProfileTbl[n++].line = p;
+    ProfileCnt = n;
+    ProfileLast = -1;
+}
+
+void ProfileLine(char *p) {
+    int i, lo, hi;
+    uint64_t now;
+    if(ProfileTbl == NULL) {
+        if(p < ProgMemory || p >= ProgMemory + Option.ProgFlashSize) return;
+        ProfileBuild();
+        if(ProfileTbl == NULL) return;
+    }
+    now = ProfileTicks();
+    if(ProfileLast >= 0) ProfileTbl[ProfileLast].ticks += now - ProfileStart;
+    ProfileStart = now;
+    i = ProfileLast + 1;
+    if(!(i < ProfileCnt && ProfileTbl[i].line == p)) {              // not the following line so search for it
+        lo = 0; hi = ProfileCnt - 1; i = -1;
+        while(lo <= hi) {
+            int mid = (lo + hi) / 2;
+            if(ProfileTbl[mid].line == p) { i = mid; break; }
+            if(ProfileTbl[mid].line < p) lo = mid + 1; else hi = mid - 1;
+        }
     }
+    if(i >= 0) ProfileTbl[i].hits++;                                // lines not in the program (eg, the library) are not counted
+    ProfileLast = i;
+}
+
+// charge the time since the last line to that line and stop the clock
+// called by PROFILE OFF and when the program returns to the command prompt
+void ProfileStop(void) {
+    if(ProfileTbl != NULL && ProfileLast >= 0) ProfileTbl[ProfileLast].ticks += ProfileTicks() - ProfileStart;
+    ProfileLast = -1;
+}
+
+// called by ClearRuntime(), the table was on the heap
+void ProfileClear(void) {
+    ProfileTbl = NULL;
+    ProfileCnt = 0;
+    ProfileLast = -1;
+}
+
+static void ProfilePrint(char *s, int fnbr) {
+    if(fnbr == 0)
+        MMPrintString(s);
+    else
+        while(*s) MMfputc(*s++, fnbr);
+}
+
+// print one line of the report: name, hits, time in uS and percentage of the total time
+static void ProfileReport(char *name, unsigned int hits, uint64_t ticks, uint64_t total, int fnbr) {
+    char b[STRINGSIZE];
+    strcpy(b, name);
+    while(strlen(b) < 20) strcat(b, " ");
+    IntToStrPad(b + strlen(b), hits, ' ', 11, 10);
+    IntToStrPad(b + strlen(b), ticks, ' ', 14, 10);
+    FloatToStr(b + strlen(b), total ? (MMFLOAT)ticks * 100.0 / (MMFLOAT)total : 0.0, 5, 1, ' ');
+    strcat(b, "\r\n");
+    ProfilePrint(b, fnbr);
+}
+
+// PROFILE ON | OFF | LIST [nbr] [,#fnbr]
+void cmd_profile(void) {
+    char *tp;
+    if(checkstring(cmdline, "ON")) {
+        if(ProfileTbl != NULL) FreeMemorySafe((void **)&ProfileTbl);  // start again with a clean table
+        ProfileClear();
+        ProfileOn = true;
+    } else if(checkstring(cmdline, "OFF")) {
+        ProfileStop();
+        ProfileOn = false;
+    } else if((tp = checkstring(cmdline, "LIST")) != NULL) {
+        int i, j, k, nbr = 20, fnbr = 0, *order, cnt;
+        char *p = NULL, name[MAXVARLEN + 2];
+        uint64_t total = 0, subticks;
+        unsigned int subhits;
+        getargs(&tp, 3, ",");
+        if(argc >= 1 && *argv[0]) nbr = getint(argv[0], 1, 10000);
+        if(argc == 3) {
+            if(*argv[2] == '#') argv[2]++;
+            fnbr = getint(argv[2], 1, MAXOPENFILES);
+            if(FileTable[fnbr].com == 0) error("File number is not open");
+        }
+        if(ProfileTbl == NULL) error("No profile data");
+        ProfileLast = -1;                                           // the time since the last line is not part of the program
+        order = GetTempMemory(ProfileCnt * sizeof(int));
+        for(i = cnt = 0; i < ProfileCnt; i++) {
+            total += ProfileTbl[i].ticks;
+            if(ProfileTbl[i].hits) order[cnt++] = i;
+        }
+        if(nbr > cnt) nbr = cnt;
+        for(i = 0; i < nbr; i++) {                                  // select the hottest lines
+            for(k = i, j = i + 1; j < cnt; j++)
+                if(ProfileTbl[order[j]].ticks > ProfileTbl[order[k]].ticks) k = j;
+            j = order[i]; order[i] = order[k]; order[k] = j;
+        }
+        ProfilePrint("Line                      Hits     Time (uS)      %\r\n", fnbr);
+        for(i = 0; i < nbr; i++) {
+            name[0] = '[';
+            IntToStr(name + 1, CountLines(ProfileTbl[order[i]].line), 10);
+            strcat(name, "]");
+            ProfileReport(name, ProfileTbl[order[i]].hits, ProfileTbl[order[i]].ticks, total, fnbr);
+        }
+
+        // total the lines in each SUB or FUNCTION, lines outside a sub/fun are reported as the main program
+        ProfilePrint("\r\nSub/Function        Lines run     Time (uS)      %\r\n", fnbr);
+        strcpy(name, "(main)");
+        subticks = 0; subhits = 0;
+        for(i = 0; i <= ProfileCnt; i++) {
+            int c = 0, endsub = false;
+            if(i < ProfileCnt) {
+                p = ProfileTbl[i].line + 1;
+                if(*p == T_LINENBR) p += 3;
+                skipspace(p);
+                if(p[0] == T_LABEL) { p += p[1] + 2; skipspace(p); }
+                c = *p;
+                endsub = (c == cmdENDSUB || c == cmdENDFUNCTION);
+            }
+            if(i == ProfileCnt || c == cmdSUB || c == cmdFUN) {     // the start of a sub/fun or the end of the program
+                if(subhits || subticks) ProfileReport(name, subhits, subticks, total, fnbr);
+                if(i == ProfileCnt) break;
+                p++; skipspace(p);
+                for(j = 0; j < MAXVARLEN && isnamechar(p[j]); j++) name[j] = p[j];
+                if(p[j] == '$' || p[j] == '%' || p[j] == '!') { name[j] = p[j]; j++; }
+                name[j] = 0;
+                subticks = 0; subhits = 0;
+            }
+            subhits += ProfileTbl[i].hits;
+            subticks += ProfileTbl[i].ticks;
+            if(endsub) {
+                ProfileReport(name, subhits, subticks, total, fnbr);
+                strcpy(name, "(main)");
+                subticks = 0; subhits = 0;
+            }
+        }
+        ClearSpecificTempMemory(order);
+    } else
+        error("Syntax");
 }
 /*
 void fun_format(void) {
@@ -469,6 +668,32 @@ void cmd_pause(void) {
     }
 }
 
+// Boyer-Moore-Horspool search used by LINSTR, LCOUNT and LONGSTRING REPLACE/SPLIT
+// build the bad character table for the search string s, with nocase set both cases of each letter get the same shift
+static void LSearchInit(unsigned char *s, int slen, int nocase, unsigned char *skip) {
+    int i;
+    memset(skip, slen, 256);
+    for(i = 0; i < slen - 1; i++) {
+        skip[s[i]] = slen - 1 - i;
+        if(nocase) skip[tolower(s[i])] = skip[toupper(s[i])] = slen - 1 - i;
+    }
+}
+
+// search len bytes of p starting at offset start for the string s
+// returns the offset of the first match or -1 if not found
+static int LSearch(unsigned char *p, int start, int len, unsigned char *s, int slen, int nocase, unsigned char *skip) {
+    int i, j;
+    unsigned char c;
+    for(i = start; i <= len - slen; i += skip[c]) {
+        c = p[i + slen - 1];
+        if(nocase) {
+            for(j = slen - 1; j >= 0 && toupper(p[i + j]) == toupper(s[j]); j--);
+            if(j < 0) return i;
+        } else if(c == s[slen - 1] && memcmp(p + i, s, slen - 1) == 0) return i;
+    }
+    return -1;
+}
+
 void MIPS16 cmd_longString(void){
     char *tp;
     tp = checkstring(cmdline, (char *)"SETBYTE");
@@ -527,18 +752,84 @@ void MIPS16 cmd_longString(void){
         int64_t *dest=NULL;
         char *p=NULL;
         char *q=NULL;
-        int i,nbr;
-        getargs(&tp, 5, (char *)",");
-        if(argc != 5)error("Argument count");
-        parseintegerarray(argv[0],&dest,1,1,NULL,true);
+        int i,j,nbr,t=T_NOTYPE;
+        MMFLOAT f;
+        long long int i64;
+        char *s;
+        getargs(&tp, 7, (char *)",");
+        if(argc != 5 && argc != 7)error("Argument count");
+        j=(parseintegerarray(argv[0],&dest,1,1,NULL,true)-1)*8;
         q=(char *)&dest[1];
         p=(char *)getstring(argv[2]);
-        nbr=getint(argv[4],1,dest[0]-*p+1);
+        evaluate(argv[4], &f, &i64, &s, &t, false);
+        if(t & T_STR) {                                             // LONGSTRING REPLACE array%(), find$, replace$ [, nocase]
+            unsigned char skip[256];
+            unsigned char *src=(unsigned char *)q;
+            int flen=*p, rlen=*s, len=dest[0], out=0, pos;
+            int nocase = (argc == 7) ? getint(argv[6],0,1) : 0;
+            if(flen == 0) error("Search string is empty");
+            LSearchInit((unsigned char *)p + 1, flen, nocase, skip);
+            if(rlen > flen) {                                       // the text grows so check the final length before changing anything
+                for(nbr = 0, i = 0; (pos = LSearch(src, i, len, (unsigned char *)p + 1, flen, nocase, skip)) >= 0; i = pos + flen) nbr++;
+                if(len + nbr * (rlen - flen) > j) error("Integer array too small");
+                src = GetTempMemory(len + 1);                       // and work from a copy
+                memcpy(src, q, len);
+            }
+            // when the text shrinks the output never overtakes the input so this works in place
+            for(i = 0; (pos = LSearch(src, i, len, (unsigned char *)p + 1, flen, nocase, skip)) >= 0; i = pos + flen) {
+                memmove(q + out, src + i, pos - i);
+                out += pos - i;
+                memcpy(q + out, s + 1, rlen);
+                out += rlen;
+            }
+            memmove(q + out, src + i, len - i);
+            dest[0] = out + len - i;
+            return;
+        }
+        if(argc != 5)error("Argument count");
+        if(t & T_NBR) i64 = FloatToInt64(f);
+        if(i64 < 1 || i64 > dest[0]-*p+1) error("~ is invalid (valid is ~ to ~)", i64, 1, dest[0]-*p+1);
+        nbr=i64;
         q+=nbr-1;
         i = *p++;
         while(i--)*q++=*p++;
         return;
     }
+    tp = checkstring(cmdline, (char *)"SPLIT");
+    if(tp){                                                         // LONGSTRING SPLIT array%(), delim$, str$() [, count%]
+        int64_t *dest=NULL;
+        unsigned char skip[256];
+        unsigned char *p, *q, *a=NULL;
+        int i, n, pos, len, size=0, elements;
+        MMFLOAT *a1float=NULL;
+        int64_t *a1int=NULL, *cnt=NULL;
+        getargs(&tp, 7, (char *)",");
+        if(argc != 5 && argc != 7)error("Argument count");
+        parseintegerarray(argv[0],&dest,1,1,NULL,false);
+        q=(unsigned char *)&dest[1];
+        len=dest[0];
+        p=(unsigned char *)getstring(argv[2]);
+        if(*p == 0) error("Search string is empty");
+        elements = parseany(argv[4], &a1float, &a1int, &a, &size, true);
+        if(a == NULL) error("Argument 3 must be a string array");
+        if(argc == 7) {
+            cnt = findvar(argv[6], V_FIND);
+            if(!(vartbl[VarIndex].type & T_INT) || vartbl[VarIndex].dims[0] != 0) error("Invalid variable");
+        }
+        LSearchInit(p + 1, *p, 0, skip);
+        for(i = n = 0; ; i = pos + *p) {
+            pos = LSearch(q, i, len, p + 1, *p, 0, skip);
+            if(pos < 0) pos = len;
+            if(n >= elements) error("Array too small");
+            if(pos - i > size) error("String too long");
+            a[n * (size + 1)] = pos - i;
+            memcpy(a + n * (size + 1) + 1, q + i, pos - i);
+            n++;
+            if(pos == len) break;
+        }
+        if(cnt) *cnt = n;
+        return;
+    }
     tp = checkstring(cmdline, (char *)"LOAD");
     if(tp){
         int64_t *dest=NULL;
@@ -814,41 +1105,55 @@ void MIPS16 fun_LInstr(void){
         int64_t *dest=NULL;
         char *srch;
         char *str=NULL;
-        int slen,found=0,i,j,n;
-        getargs(&ep, 5, ",");
-        if(argc <3  || argc > 5)error("Argument count");
-        int64_t start;
-        if(argc==5)start=getinteger(argv[4])-1;
-        else start=0;
+        unsigned char skip[256];
+        int slen,found=0,i,nocase=0;
+        getargs(&ep, 7, ",");
+        if(argc <3  || argc > 7 || argc == 4 || argc == 6)error("Argument count");
+        int64_t start=0;
+        if(argc>=5 && *argv[4])start=getinteger(argv[4])-1;
+        if(argc==7)nocase=getint(argv[6],0,1);
         ptr1 = findvar(argv[0], V_FIND | V_EMPTY_OK);
         if(vartbl[VarIndex].type & T_INT) {
             if(vartbl[VarIndex].dims[1] != 0) error("Invalid variable");
             if(vartbl[VarIndex].dims[0] <= 0) {      // Not an array
                 error("Argument 1 must be integer array");
             }
-            dest = (long long int *)ptr1;
+            dest = (int64_t *)ptr1;
             str=(char *)&dest[0];
         } else error("Argument 1 must be integer array");
-        j=(vartbl[VarIndex].dims[0] - OptionBase);
         srch=getstring(argv[2]);
         slen=*srch;
         iret=0;
         if(start>dest[0] || start<0 || slen==0 || dest[0]==0 || slen>dest[0]-start)found=1;
         if(!found){
-            n=dest[0]- slen - start;
-
-            for(i = start; i <= n + start; i++) {
-                if(str[i + 8] == srch[1]) {
-                    for(j = 0; j < slen; j++)
-                        if(str[j + i + 8] != srch[j + 1])
-                            break;
-                    if(j == slen) {iret= i + 1; break;}
-                }
-            }
+            LSearchInit((unsigned char *)srch + 1, slen, nocase, skip);
+            i = LSearch((unsigned char *)str + 8, start, dest[0], (unsigned char *)srch + 1, slen, nocase, skip);
+            iret = i + 1;
         }
         targ = T_INT;
 }
 
+// LCOUNT(array%(), search$ [, nocase])
+// returns the number of non overlapping occurrences of search$ in the longstring
+void fun_LCount(void){
+    int64_t *dest=NULL;
+    unsigned char skip[256];
+    unsigned char *p, *q;
+    int i, nocase=0;
+    getargs(&ep, 5, (char *)",");
+    if(argc != 3 && argc != 5)error("Argument count");
+    parseintegerarray(argv[0],&dest,1,1,NULL,false);
+    q=(unsigned char *)&dest[1];
+    p=(unsigned char *)getstring(argv[2]);
+    if(argc == 5) nocase=getint(argv[4],0,1);
+    iret=0;
+    if(*p) {
+        LSearchInit(p + 1, *p, nocase, skip);
+        for(i = 0; (i = LSearch(q, i, dest[0], p + 1, *p, nocase, skip)) >= 0; i += *p) iret++;
+    }
+    targ = T_INT;
+}
+
 void fun_LCompare(void){
     int64_t *dest, *src;
     char *p=NULL;
@@ -1221,6 +1526,7 @@ void cmd_option(void) {
 
     tp = checkstring(cmdline, "DEFAULT");
     if(tp) {
+        VarGenGlobal++;                                             // cached variable references were type checked against the old default
         if(checkstring(tp, "INTEGER"))  { DefaultType = T_INT;  return; }
         if(checkstring(tp, "FLOAT"))    { DefaultType = T_NBR;  return; }
         if(checkstring(tp, "STRING"))   { DefaultType = T_STR;  return; }
@@ -1703,6 +2009,18 @@ void fun_info(void){
                 iret=(int64_t)((uint32_t)varcnt);
                 targ=T_INT;
                 return;
+      } else if(checkstring(ep, "LABEL INDEX")){
+                iret=(int64_t)((uint32_t)(labeltblsize * sizeof(struct s_labeltbl) + lineidxcnt * sizeof(char *)));
+                targ=T_INT;                                             // bytes of heap used by the label and line number index
+                return;
+      } else if(checkstring(ep, "STATEMENTS")){
+                iret=(int64_t)StatementCount;                           // nbr of statements executed since RUN
+                targ=T_INT;
+                return;
+      } else if(checkstring(ep, "HEAP MAX")){
+                iret=(int64_t)(HeapPagesHigh * RAMPAGESIZE);            // the most heap used since RUN
+                targ=T_INT;
+                return;
      } else if(checkstring(ep, "BOOT")){
     	 if(_restart_reason == 0x0)strcpy((char *)sret, "Power On");
     	 else if(_restart_reason == 0x1)strcpy((char *)sret, "Reset Switch");
@@ -1901,7 +2219,51 @@ void MIPS16 cmd_cpu(void) {
     } else error("Syntax");
 }
 
+// get the name of an interrupt source as used by INTERRUPT PRIORITY and INTERRUPT STATS
+static void IntName(int src, char *buf) {
+    static const char *names[INT_TICK] = { "ONKEY", "KEY", "COM1", "COM2", "COM3", "COM4", "GUIDOWN", "GUIUP",
+                                           "WAV", "ADC", "IR", "KEYPAD", "CSUB", "PIN", "I2CRX", "I2CTX", "CAN" };
+    if(src >= INT_TICK)
+        sprintf(buf, "TICK%d", src - INT_TICK + 1);
+    else
+        strcpy(buf, names[src]);
+}
+
+// INTERRUPT PRIORITY source, n       set the priority of an interrupt source (1 is the highest, 9 the lowest)
+// INTERRUPT STATS [RESET]            list the count, dropped events and worst case latency for each source used
+// INTERRUPT [location | 0]           set/clear the routine called when a CSub signals an interrupt
 void cmd_csubinterrupt(void){
+    char *p, name[16], line[80];
+    int src;
+    uint64_t t;
+    if((p = checkstring(cmdline, "PRIORITY"))) {
+        getargs(&p, 3, ",");
+        if(argc != 3) error("Argument count");
+        for(src = 0; src < INT_NBRSOURCES; src++) {
+            IntName(src, name);
+            if(checkstring(argv[0], name)) break;
+        }
+        if(src == INT_NBRSOURCES) error("Unknown interrupt source");
+        IntPriority[src] = getint(argv[2], 1, 9);
+        return;
+    }
+    if((p = checkstring(cmdline, "STATS"))) {
+        if(checkstring(p, "RESET")) {
+            memset(IntStat, 0, sizeof(IntStat));
+            return;
+        }
+        if(*p) error("Syntax");
+        MMPrintString("Source   Priority      Count    Dropped  Max latency (uS)\r\n");
+        for(src = 0; src < INT_NBRSOURCES; src++) {
+            if(IntStat[src].count == 0 && IntStat[src].dropped == 0) continue;
+            IntName(src, name);
+            t = (uint64_t)IntStat[src].maxlatency * 10 / (SystemCoreClock / 1000000);
+            sprintf(line, "%-8s %8d %10u %10u %15u.%u\r\n", name, IntPriority[src], IntStat[src].count, IntStat[src].dropped,
+                    (unsigned int)(t / 10), (unsigned int)(t % 10));
+            MMPrintString(line);
+        }
+        return;
+    }
     getargs(&cmdline,1,",");
     if(argc != 0){
         if(checkstring(argv[0],"0")){
@@ -1912,7 +2274,7 @@ void cmd_csubinterrupt(void){
             CSubComplete=0;
             InterruptUsed = true;
         }
-    } else CSubComplete=1;
+    } else CSubComplete=1;                                          // CSubs can also set this directly so it is polled
 }
 
 void cmd_cfunction(void) {
@@ -2253,6 +2615,8 @@ void MIPS16 cmd_autosave(void) {
     	ClearVars(0);
         CloseAudio();
         CloseAllFiles();
+        ClearJumpCache();                                               // the program is about to change
+        findlabel(NULL);                                                // clear the label cache
         ClearExternalIO();                                              // this MUST come before InitHeap()
 
        // p = buf = GetMemory(EDIT_BUFFER_SIZE);
@@ -2326,204 +2690,238 @@ readin:
 /***********************************************************************************************
 interrupt check
 
-The priority of interrupts (highest to low) is:
-Touch (MM+ only)
-CFunction Interrupt
+Interrupt service routines (and the 1mS timer) record an event by calling IntPost() which sets
+the bit for the source in IntPending.  Sources that are level triggered or that cannot be posted
+from an ISR (ON KEY, COM ports, keypad, CSub and I/O pin interrupts) are polled after every
+command, but only while they are in use.  So when nothing is pending check_interrupt() costs
+a single test.  The 1mS timer also posts INT_HOUSEKEEP to run the touch, SD card, KV store and GPS checks.
+
+When several sources are pending the one with the highest priority (INTERRUPT PRIORITY source, n)
+is called.  Sources with the same priority (all default to INT_DEFPRIORITY) are served in turn
+starting after the last one called so that none can be starved.  The sources are:
 ON KEY
-I2C Slave Rx
-I2C Slave Tx
-COM1
-COM2
-COM3 (MM+ only)
-COM4 (MM+ only)
-GUI Int Down (MM+ only)
-GUI Int Up (MM+ only)
-WAV Finished (MM+ only)
+ON KEY key
+COM1 to COM4
+GUI Int Down
+GUI Int Up
+WAV Finished
+ADC Finished
 IR Receive
+Keypad
 Interrupt command/CSub Interrupt
-I/O Pin Interrupts in order of definition
-Tick Interrupts (1 to 4 in that order)
+I/O Pin Interrupts (in order of definition)
+I2C Slave Rx and Tx
+CAN receive queue level
+Tick Interrupts (1 to 4)
 
+For each source the number of calls, the events dropped because the previous one had not been
+dispatched and the worst case latency from posting to dispatch is kept for INTERRUPT STATS.
 ************************************************************************************************/
 
-// check if an interrupt has occured and if so, set the next command to the interrupt routine
-// will return true if interrupt detected or false if not
-int __attribute__ ((optimize("-O2"))) check_interrupt(void) {
-    int i, v;
-    char *intaddr;
-    static char rti[2];
-    ProcessTouch();
-    CheckSDCard();
-    processgps();
-    if(CheckGuiFlag) CheckGui();                                    // This implements a LED flash
-
-//  if(CFuncInt) CallCFuncInt();                                    // check if the CFunction wants to do anything (see CFunction.c)
-    if(!InterruptUsed) return 0;                                    // quick exit if there are no interrupts set
-    if(InterruptReturn != NULL || CurrentLinePtr == NULL) return 0; // skip if we are in an interrupt or in immediate mode
-
-    // check for an  ON KEY loc  interrupt
-    if(OnKeyGOSUB && kbhitConsole()) {
-        intaddr = OnKeyGOSUB;                                       // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-
-    // check for an  ON KEY key ,loc  interrupt
-    if(KeyInterrupt != NULL && Keycomplete) {
-   		Keycomplete=false;
-   		intaddr = KeyInterrupt;									    // set the next stmt to the interrupt location
-   		goto GotAnInterrupt;
-   	}
+// record that an interrupt source has something pending, this is safe to call from an ISR
+void __attribute__ ((optimize("-O2"))) IntPost(int src) {
+    unsigned int v, bit = 1u << src;
+    do {
+        v = __LDREXW(&IntPending);
+        if(v & bit) {                                               // the previous event has not been dispatched yet
+            __CLREX();
+            if(src < INT_NBRSOURCES) IntStat[src].dropped++;
+            return;
+        }
+        if(src < INT_NBRSOURCES) IntPostTime[src] = DWT->CYCCNT;
+    } while(__STREXW(v | bit, &IntPending));
+}
 
+// clear bits in IntPending without losing any posted by an ISR at the same time
+static void IntTake(unsigned int bits) {
+    unsigned int v;
+    do {
+        v = __LDREXW(&IntPending);
+    } while(__STREXW(v & ~bits, &IntPending));
+}
 
+// find the sources that must be polled, called every mSec so that it will pick up any changes
+static unsigned int IntPollMask(void) {
+    unsigned int m = 0;
+    int i;
+    if(OnKeyGOSUB) m |= 1u << INT_ONKEY;
+    if(com1_interrupt || com1_TX_interrupt) m |= 1u << INT_COM1;
+    if(com2_interrupt || com2_TX_interrupt) m |= 1u << (INT_COM1 + 1);
+    if(com3_interrupt || com3_TX_interrupt) m |= 1u << (INT_COM1 + 2);
+    if(com4_interrupt || com4_TX_interrupt) m |= 1u << (INT_COM1 + 3);
+    if(KeypadInterrupt) m |= 1u << INT_KEYPAD;
+    if(CSubInterrupt) m |= 1u << INT_CSUB;
+    for(i = 0; i < NBRINTERRUPTS; i++) if(inttbl[i].pin != 0) m |= 1u << INT_PIN;
 #ifdef INCLUDE_I2C_SLAVE
-
-    if ((I2C_Status & I2C_Status_Slave_Receive_Rdy)) {
-        I2C_Status &= ~I2C_Status_Slave_Receive_Rdy;                // clear completed flag
-        intaddr = I2C_Slave_Receive_IntLine;                        // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-    if ((I2C_Status & I2C_Status_Slave_Send_Rdy)) {
-        I2C_Status &= ~I2C_Status_Slave_Send_Rdy;                   // clear completed flag
-        intaddr = I2C_Slave_Send_IntLine;                           // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
+    if(I2C_Slave_Receive_IntLine) m |= 1u << INT_I2CRX;
+    if(I2C_Slave_Send_IntLine) m |= 1u << INT_I2CTX;
 #endif
+    return m;
+}
 
+// reset the priorities and statistics, called when a program is run
+void InterruptClear(void) {
+    int i;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;                 // enable the cycle counter used to time the latency
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    for(i = 0; i < INT_NBRSOURCES; i++) IntPriority[i] = INT_DEFPRIORITY;
+    memset(IntStat, 0, sizeof(IntStat));
+    IntLast = INT_NBRSOURCES - 1;
+    IntPolled = 0;
+    IntTake(~(1u << INT_HOUSEKEEP));
+}
 
-  // interrupt routines for the serial ports
-  if(com1 || com2 || com3 || com4){
-    if(com1_interrupt != NULL && SerialRxStatus(1) >= com1_ilevel) {// do we need to interrupt?
-        intaddr = com1_interrupt;                                   // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-    if(com1_TX_interrupt && com1_TX_complete){
-        intaddr=com1_TX_interrupt;
-        com1_TX_complete=false;
-        goto GotAnInterrupt;
-    }
-    if(com2_interrupt != NULL && SerialRxStatus(2) >= com2_ilevel) {// do we need to interrupt?
-        intaddr = com2_interrupt;                                   // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-    if(com2_TX_interrupt && com2_TX_complete){
-        intaddr=com2_TX_interrupt;
-        com2_TX_complete=false;
-        goto GotAnInterrupt;
-    }
-
-    if(com3_interrupt != NULL && SerialRxStatus(3) >= com3_ilevel) {// do we need to interrupt?
-        intaddr = com3_interrupt;                                   // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
+// poll a COM port, returns the interrupt routine if it needs to be called
+static char *IntComCheck(int n, char *rxint, int ilevel, char *txint, int *txcomplete) {
+    if(rxint != NULL && SerialRxStatus(n) >= ilevel) return rxint;
+    if(txint != NULL && *txcomplete) {
+        *txcomplete = false;
+        return txint;
     }
+    return NULL;
+}
 
-    if(com3_TX_interrupt && com3_TX_complete){
-        intaddr=com3_TX_interrupt;
-        com3_TX_complete=false;
-        goto GotAnInterrupt;
-    }
-    if(com4_interrupt != NULL && SerialRxStatus(4) >= com4_ilevel) {// do we need to interrupt?
-        intaddr = com4_interrupt;                                   // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
+// check if an interrupt has occured and if so, set the next command to the interrupt routine
+// will return true if interrupt detected or false if not
+int __attribute__ ((optimize("-O2"))) check_interrupt(void) {
+    unsigned int pending;
+    int i, v, src, best, missed;
+    char *intaddr;
+    static char rti[2];
 
-    if(com4_TX_interrupt && com4_TX_complete){
-        intaddr=com4_TX_interrupt;
-        com4_TX_complete=false;
-        goto GotAnInterrupt;
-    }
-  }
+    if(!(IntPending | IntPolled)) return 0;                         // quick exit if nothing has been posted or needs polling
 
-    if(gui_int_down && GuiIntDownVector) {                          // interrupt on pen down
-        intaddr = GuiIntDownVector;                                 // get a pointer to the interrupt routine
-        gui_int_down = false;
-        goto GotAnInterrupt;
+    if(IntPending & (1u << INT_HOUSEKEEP)) {                        // this is set every mSec
+        IntTake(1u << INT_HOUSEKEEP);
+        ProcessTouch();
+        CheckSDCard();
+        KvService();                                                // compact the KV store in the background
+        processgps();
+        if(CheckGuiFlag) CheckGui();                                // This implements a LED flash
+        IntPolled = InterruptUsed ? IntPollMask() : 0;
     }
 
-    if(gui_int_up && GuiIntUpVector) {
-        intaddr = GuiIntUpVector;                                   // get a pointer to the interrupt routine
-        gui_int_up = false;
-        goto GotAnInterrupt;
+//  if(CFuncInt) CallCFuncInt();                                    // check if the CFunction wants to do anything (see CFunction.c)
+    if(!InterruptUsed) {                                            // no interrupts set so throw away anything posted
+        if(IntPending & ~(1u << INT_HOUSEKEEP)) IntTake(~(1u << INT_HOUSEKEEP));
+        return 0;
     }
+    if(InterruptReturn != NULL || CurrentLinePtr == NULL) return 0; // skip if we are in an interrupt or in immediate mode
 
-    if(WAVInterrupt != NULL && WAVcomplete) {
-        WAVcomplete=false;
-        intaddr = WAVInterrupt;                                     // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-    if(ADCInterrupt != NULL && ADCcomplete){
-        ADCcomplete=false;
-        intaddr = ADCInterrupt;                                     // set the next stmt to the interrupt location
-        /*
-        for(i=0;i<=ADCmax;i++){
-            if(ADCbits[ADCchannelA]==12)a1float[i]=((MMFLOAT)(a1point[i])/(MMFLOAT)0XFFF * VCC);
-            else if(ADCbits[ADCchannelA]==10)a1float[i]=((MMFLOAT)(a1point[i])/(MMFLOAT)0X3FF * VCC);
-            else if(ADCbits[ADCchannelA])a1float[i]=((MMFLOAT)(a1point[i])/(MMFLOAT)0XFF * VCC);
-            if(ADCchannelB){
-                if(ADCbits[ADCchannelB]==12)a2float[i]=((MMFLOAT)(a2point[i])/(MMFLOAT)0XFFF * VCC);
-                else if(ADCbits[ADCchannelB]==10)a2float[i]=((MMFLOAT)(a2point[i])/(MMFLOAT)0X3FF * VCC);
-                else if(ADCbits[ADCchannelB]==8)a2float[i]=((MMFLOAT)(a2point[i])/(MMFLOAT)0XFF * VCC);
-            }
-            if(ADCchannelC){
-                if(ADCbits[ADCchannelC]==12)a3float[i]=((MMFLOAT)(a3point[i])/(MMFLOAT)0XFFF * VCC);
-                else if(ADCbits[ADCchannelC]==10)a3float[i]=((MMFLOAT)(a3point[i])/(MMFLOAT)0X3FF * VCC);
-                else if(ADCbits[ADCchannelC]==8)a3float[i]=((MMFLOAT)(a3point[i])/(MMFLOAT)0XFF * VCC);
-            }
+    // poll the sources that are in use but cannot be posted by an ISR
+    // when found they are posted so that they are dispatched by priority like the others
+    if(IntPolled) {
+        pending = IntPending;
+        if((IntPolled & (1u << INT_ONKEY)) && !(pending & (1u << INT_ONKEY)) && OnKeyGOSUB && kbhitConsole())
+            IntPost(INT_ONKEY);
+        if(IntPolled & (0b1111u << INT_COM1)) {
+            if(!(pending & (1u << INT_COM1)) && (IntAddr[INT_COM1] = IntComCheck(1, com1_interrupt, com1_ilevel, com1_TX_interrupt, &com1_TX_complete)))
+                IntPost(INT_COM1);
+            if(!(pending & (1u << (INT_COM1 + 1))) && (IntAddr[INT_COM1 + 1] = IntComCheck(2, com2_interrupt, com2_ilevel, com2_TX_interrupt, &com2_TX_complete)))
+                IntPost(INT_COM1 + 1);
+            if(!(pending & (1u << (INT_COM1 + 2))) && (IntAddr[INT_COM1 + 2] = IntComCheck(3, com3_interrupt, com3_ilevel, com3_TX_interrupt, &com3_TX_complete)))
+                IntPost(INT_COM1 + 2);
+            if(!(pending & (1u << (INT_COM1 + 3))) && (IntAddr[INT_COM1 + 3] = IntComCheck(4, com4_interrupt, com4_ilevel, com4_TX_interrupt, &com4_TX_complete)))
+                IntPost(INT_COM1 + 3);
         }
-        */
-        for(i=0;i<=ADCmax;i++){
-                      a1float[i]=((MMFLOAT)(ADCscale[0]*a1point[i]) + ADCbottom[0] );
-                      if(ADCchannelB)a2float[i]=((MMFLOAT)(ADCscale[1]*a2point[i]) + ADCbottom[1] );
-                      if(ADCchannelC)a3float[i]=((MMFLOAT)(ADCscale[2]*a3point[i]) + ADCbottom[2] );
-       }
-
-        goto GotAnInterrupt;
-    }
-    if(IrGotMsg && IrInterrupt != NULL) {
-        IrGotMsg = false;
-        intaddr = IrInterrupt;                                      // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-
-    if(KeypadInterrupt != NULL && KeypadCheck()) {
-        intaddr = KeypadInterrupt;                                  // set the next stmt to the interrupt location
-        goto GotAnInterrupt;
-    }
-
-    if(CSubInterrupt != NULL && CSubComplete) {
-       	intaddr = CSubInterrupt;                                  // set the next stmt to the interrupt location
-    	CSubComplete=0;
-    	goto GotAnInterrupt;
-    }
-
-
-    for(i = 0; i < NBRINTERRUPTS; i++) {                            // scan through the interrupt table
-        if(inttbl[i].pin != 0) {                                    // if this entry has an interrupt pin set
-            v = ExtInp(inttbl[i].pin);                              // get the current value of the pin
-            // check if interrupt occured
-            if((inttbl[i].lohi == T_HILO && v < inttbl[i].last) || (inttbl[i].lohi == T_LOHI && v > inttbl[i].last) || (inttbl[i].lohi == T_BOTH && v != inttbl[i].last)) {
-                intaddr = inttbl[i].intp;                           // set the next stmt to the interrupt location
-                inttbl[i].last = v;                                 // save the new pin value
-                goto GotAnInterrupt;
-            } else
-                inttbl[i].last = v;                                 // no interrupt, just update the pin value
+        if((IntPolled & (1u << INT_KEYPAD)) && !(pending & (1u << INT_KEYPAD)) && KeypadInterrupt != NULL && KeypadCheck())
+            IntPost(INT_KEYPAD);
+        if((IntPolled & (1u << INT_CSUB)) && !(pending & (1u << INT_CSUB)) && CSubComplete)
+            IntPost(INT_CSUB);
+#ifdef INCLUDE_I2C_SLAVE
+        if(!(pending & (1u << INT_I2CRX)) && (I2C_Status & I2C_Status_Slave_Receive_Rdy)) IntPost(INT_I2CRX);
+        if(!(pending & (1u << INT_I2CTX)) && (I2C_Status & I2C_Status_Slave_Send_Rdy)) IntPost(INT_I2CTX);
+#endif
+        if((IntPolled & (1u << INT_PIN)) && !(pending & (1u << INT_PIN))) {
+            for(i = 0; i < NBRINTERRUPTS; i++) {                    // scan through the interrupt table
+                if(inttbl[i].pin != 0) {                            // if this entry has an interrupt pin set
+                    v = ExtInp(inttbl[i].pin);                      // get the current value of the pin
+                    // check if interrupt occured
+                    if((inttbl[i].lohi == T_HILO && v < inttbl[i].last) || (inttbl[i].lohi == T_LOHI && v > inttbl[i].last) || (inttbl[i].lohi == T_BOTH && v != inttbl[i].last)) {
+                        IntAddr[INT_PIN] = inttbl[i].intp;          // save the interrupt location
+                        inttbl[i].last = v;                         // save the new pin value
+                        IntPost(INT_PIN);
+                        break;                                      // any other pins will be found next time
+                    } else
+                        inttbl[i].last = v;                         // no interrupt, just update the pin value
+                }
+            }
         }
     }
 
-    // check if one of the tick interrupts is enabled and if it has occured
-    for(i = 0; i < NBRSETTICKS; i++) {
-        if(TickInt[i] != NULL && TickTimer[i] > TickPeriod[i]) {
-            // reset for the next tick but skip any ticks completely missed
-            while(TickTimer[i] > TickPeriod[i]) TickTimer[i] -= TickPeriod[i];
-            intaddr = TickInt[i];
-            goto GotAnInterrupt;
+    // pick the pending source with the highest priority, those with the same priority are served in turn
+    pending = IntPending & ((1u << INT_NBRSOURCES) - 1);
+    if(!pending) return 0;
+    for(src = -1, best = 0x7fffffff; pending; pending &= pending - 1) {
+        i = __builtin_ctz(pending);
+        v = IntPriority[i] * 32 + (i + INT_NBRSOURCES - 1 - IntLast) % INT_NBRSOURCES;
+        if(v < best) {
+            best = v;
+            src = i;
         }
     }
+    IntTake(1u << src);
 
-    // if no interrupt was found then return having done nothing
-    return 0;
-
-    // an interrupt was found if we jumped to here
-GotAnInterrupt:
+    switch(src) {
+        case INT_ONKEY:     intaddr = OnKeyGOSUB;
+                            break;
+        case INT_KEY:       Keycomplete = false;
+                            intaddr = KeyInterrupt;
+                            break;
+        case INT_GUIDOWN:   gui_int_down = false;                   // interrupt on pen down
+                            intaddr = GuiIntDownVector;
+                            break;
+        case INT_GUIUP:     gui_int_up = false;
+                            intaddr = GuiIntUpVector;
+                            break;
+        case INT_WAV:       WAVcomplete = false;
+                            intaddr = WAVInterrupt;
+                            break;
+        case INT_ADC:       ADCcomplete = false;
+                            intaddr = ADCInterrupt;
+                            if(intaddr == NULL || ADCstreaming) break;  // a stream's data is read by ADC STREAM READ
+                            for(i = 0; i <= ADCmax; i++) {
+                                a1float[i] = ((MMFLOAT)(ADCscale[0] * a1point[i]) + ADCbottom[0]);
+                                if(ADCchannelB) a2float[i] = ((MMFLOAT)(ADCscale[1] * a2point[i]) + ADCbottom[1]);
+                                if(ADCchannelC) a3float[i] = ((MMFLOAT)(ADCscale[2] * a3point[i]) + ADCbottom[2]);
+                            }
+                            break;
+        case INT_IR:        IrGotMsg = false;
+                            intaddr = IrInterrupt;
+                            break;
+        case INT_KEYPAD:    intaddr = KeypadInterrupt;
+                            break;
+        case INT_CSUB:      CSubComplete = 0;
+                            intaddr = CSubInterrupt;
+                            break;
+#ifdef INCLUDE_I2C_SLAVE
+        case INT_I2CRX:     I2C_Status &= ~I2C_Status_Slave_Receive_Rdy;    // clear completed flag
+                            intaddr = I2C_Slave_Receive_IntLine;
+                            break;
+        case INT_I2CTX:     I2C_Status &= ~I2C_Status_Slave_Send_Rdy;       // clear completed flag
+                            intaddr = I2C_Slave_Send_IntLine;
+                            break;
+#endif
+        case INT_CAN:       intaddr = CanInterrupt;
+                            break;
+        default:            if(src >= INT_TICK) {                   // one of the tick interrupts
+                                i = src - INT_TICK;
+                                intaddr = TickInt[i];
+                                if(intaddr == NULL || TickTimer[i] <= TickPeriod[i]) return 0;
+                                // reset for the next tick but skip (and count) any ticks completely missed
+                                for(missed = -1; TickTimer[i] > TickPeriod[i]; missed++) TickTimer[i] -= TickPeriod[i];
+                                IntStat[src].dropped += missed;
+                            } else
+                                intaddr = IntAddr[src];             // the COM ports and I/O pins were found when polled
+    }
+    if(intaddr == NULL) return 0;                                   // the interrupt was turned off after it was posted
+
+    IntLast = src;
+    IntStat[src].count++;
+    v = DWT->CYCCNT - IntPostTime[src];
+    if((unsigned int)v > IntStat[src].maxlatency) IntStat[src].maxlatency = v;
+
+    // an interrupt was found
     LocalIndex++;                                                   // IRETURN will decrement this
     if(OptionErrorSkip>0)SaveOptionErrorSkip=OptionErrorSkip;
     else SaveOptionErrorSkip = 0;
@@ -2577,109 +2975,220 @@ void *mymalloc(size_t size){
 	}
 	return a;
 }
-void MIPS16 fun_json(void){
-    char *json_string=NULL;
-    const cJSON *root = NULL;
-    void *ptr1 = NULL;
+/*
+ JSON support
+ The tree built by the cJSON parser is allocated from an arena (a chain of large blocks) rather than with many small
+ allocations so that it can be freed in one go.  JSON$(array%(), path) parses the document into temporary memory for
+ each call.  JSON OPEN h, array%() parses it once and keeps the tree until JSON CLOSE h or the program is run again,
+ JSON$(h, path) then just walks the tree.  For an open document the node before the last field of the previous path
+ and the position of the last array item found are remembered so that reading several fields of the same object or
+ stepping through an array does not start from the root every time.
+*/
+struct s_jsonchunk {                                                // header of a block in the arena
+    struct s_jsonchunk *next;
+    int size, used;
+    int pad;                                                        // keep the data 8 byte aligned
+};
+
+#define JSONPREFIXSIZE  (RAMPAGESIZE - 12 * sizeof(void *))
+struct s_jsondoc {                                                  // an open document, allocated with GetMemory()
+    cJSON *root;                                                    // the parsed tree
+    struct s_jsonchunk *chunks;                                     // the arena holding the tree
+    cJSON *prefixnode;                                              // the node found for prefix[]
+    cJSON *arr, *arritem;                                           // the last array indexed and the item found
+    int arrindex;                                                   // the index of arritem
+    int prefixlen;
+    char prefix[JSONPREFIXSIZE];                                    // the path up to the last field of the previous lookup
+};
+struct s_jsondoc *JsonDoc[MAXJSONHANDLES];
+
+static struct s_jsonchunk **JsonChain;                              // the arena being used by the parser
+static int JsonChunkSize, JsonTemp;
+
+static void *JsonAlloc(size_t size) {
+    struct s_jsonchunk *c = *JsonChain;
     char *p;
-    sret=GetTempMemory(STRINGSIZE);
-	int64_t *dest=NULL;
-    MMFLOAT tempd;
-    int i,j,k,mode,index;
-    char field[32],num[6];
-    getargs(&ep, 3, ",");
-    char *a=GetTempStrMemory();
-    ptr1 = findvar(argv[0], V_FIND | V_EMPTY_OK);
-    if(vartbl[VarIndex].type & T_INT) {
+    int n;
+    size = (size + 7) & ~7;
+    if(c == NULL || c->used + size > c->size) {
+        n = (size > JsonChunkSize) ? size : JsonChunkSize;
+        c = JsonTemp ? GetTempMemory(n + sizeof(struct s_jsonchunk)) : GetMemory(n + sizeof(struct s_jsonchunk));
+        c->size = n;
+        c->used = 0;
+        c->next = *JsonChain;
+        *JsonChain = c;
+    }
+    p = (char *)(c + 1) + c->used;
+    c->used += size;
+    return p;
+}
+
+static void JsonFree(void *p) {                                     // nothing to do, the arena is freed in one go
+}
+
+// check that the argument is a long string (an integer array) and return a pointer to it
+static int64_t *JsonArray(char *p) {
+    int64_t *dest = findvar(p, V_FIND | V_EMPTY_OK);
+    if(!(vartbl[VarIndex].type & T_INT)) error("Argument must be an integer array");
     if(vartbl[VarIndex].dims[1] != 0) error("Invalid variable");
-    if(vartbl[VarIndex].dims[0] <= 0) {		// Not an array
-        error("Argument 1 must be integer array");
-    }
-    dest = (long long int *)ptr1;
-    json_string=(char *)&dest[1];
-    } else error("Argument 1 must be integer array");
+    if(vartbl[VarIndex].dims[0] <= 0) error("Argument must be an integer array");
+    return dest;
+}
+
+// parse a JSON document held in a long string into an arena.  If temp is true temporary memory is used
+// returns NULL if the document is not valid
+static cJSON *JsonParse(int64_t *dest, struct s_jsonchunk **chain, int temp) {
+    cJSON_Hooks hooks = { JsonAlloc, JsonFree };
+    cJSON *root;
+    JsonChain = chain;
+    JsonTemp = temp;
+    JsonChunkSize = dest[0] + dest[0] / 2;                          // the tree is usually a bit bigger than the text
+    if(JsonChunkSize < 1024) JsonChunkSize = 1024;
+    cJSON_InitHooks(&hooks);
+    root = cJSON_ParseWithLength((char *)&dest[1], dest[0]);
     cJSON_InitHooks(NULL);
-    cJSON * parse = cJSON_Parse(json_string);
-    if(parse==NULL)error("Invalid JSON data");
-    root=parse;
-    p=getCstring(argv[2]);
-    int len = strlen(p);
-    memset(field,0,32);
-    memset(num,0,6);
-    i=0;j=0;k=0;mode=0;
-    while(i<len){
-        if(p[i]=='['){ //start of index
-            mode=1;
-            field[j]=0;
-            root = cJSON_GetObjectItemCaseSensitive(root, field);
-            memset(field,0,32);
-            j=0;
-        }
-        if(p[i]==']'){
-            num[k]=0;
-            index=atoi(num);
-            root = cJSON_GetArrayItem(root, index);
-            memset(num,0,6);
-            k=0;
-        }
-        if(p[i]=='.'){ //new field separator
-            if(mode==0){
-                field[j]=0;
-                root = cJSON_GetObjectItemCaseSensitive(root, field);
-             memset(field,0,32);
-                j=0;
-            } else { //step past the dot after a close bracket
-                mode=0;
+    return root;
+}
+
+// close an open document and free its memory
+static void JsonClose(int h) {
+    struct s_jsonchunk *c, *next;
+    if(JsonDoc[h] == NULL) return;
+    for(c = JsonDoc[h]->chunks; c != NULL; c = next) {
+        next = c->next;
+        FreeMemory(c);
+    }
+    FreeMemorySafe((void **)&JsonDoc[h]);
+}
+
+// forget all open documents.  This is called before the heap is cleared
+void JsonClear(void) {
+    int h;
+    for(h = 0; h < MAXJSONHANDLES; h++) JsonDoc[h] = NULL;
+}
+
+// get an item from an array, this can step forward from the last item found in an open document
+static cJSON *JsonArrayItem(cJSON *node, int index, struct s_jsondoc *d) {
+    cJSON *item;
+    int i = 0;
+    if(!cJSON_IsArray(node) || index < 0) return NULL;
+    item = node->child;
+    if(d != NULL && d->arr == node && d->arritem != NULL && index >= d->arrindex) {
+        item = d->arritem;
+        i = d->arrindex;
+    }
+    for(; item != NULL && i < index; i++) item = item->next;
+    if(d != NULL && item != NULL) {
+        d->arr = node;
+        d->arritem = item;
+        d->arrindex = index;
+    }
+    return item;
+}
+
+// find the node for a path like "a.b[2].c".  The last field name is not case sensitive
+static cJSON *JsonFind(cJSON *node, char *path, struct s_jsondoc *d) {
+    char field[32], *p = path, *last = path;
+    cJSON *parent = node;
+    int j;
+    if(d != NULL && d->prefixlen > 0 && strncmp(path, d->prefix, d->prefixlen) == 0 && (path[d->prefixlen] == '.' || path[d->prefixlen] == '[')) {
+        node = parent = d->prefixnode;                              // the start of the path is the same as the last one
+        p = last = path + d->prefixlen;
+    }
+    while(*p && node != NULL) {
+        parent = node;
+        last = p;
+        if(*p == '.') p++;
+        if(*p == '[') {
+            node = JsonArrayItem(node, atoi(++p), d);
+            while(*p && *p != ']') p++;
+            if(*p) p++;
+        } else {
+            j = 0;
+            while(*p && *p != '.' && *p != '[') {
+                if(j < sizeof(field) - 1) field[j++] = *p;
+                p++;
             }
-        } else  {
-            if(mode==0)field[j++]=p[i];
-            else if(p[i]!='[')num[k++]=p[i];
+            field[j] = 0;
+            if(*p) node = cJSON_GetObjectItemCaseSensitive(node, field);
+            else node = cJSON_GetObjectItem(node, field);
         }
-        i++;
     }
-    root = cJSON_GetObjectItem(root, field);
+    if(d != NULL && node != NULL && last - path < JSONPREFIXSIZE) { // remember where the last field started
+        d->prefixlen = last - path;
+        memcpy(d->prefix, path, d->prefixlen);
+        d->prefixnode = parent;
+    }
+    return node;
+}
 
-    if (cJSON_IsObject(root)){
-        cJSON_Delete(parse);
-        error("Not an item");
+// JSON OPEN h, array%() or JSON CLOSE h
+void cmd_json(void) {
+    char *tp;
+    int h;
+    if((tp = checkstring(cmdline, "OPEN"))) {
+        getargs(&tp, 3, ",");
+        if(argc != 3) error("Argument count");
+        h = getint(argv[0], 1, MAXJSONHANDLES) - 1;
+        JsonClose(h);
+        int64_t *dest = JsonArray(argv[2]);
+        JsonDoc[h] = GetMemory(sizeof(struct s_jsondoc));
+        JsonDoc[h]->root = JsonParse(dest, &JsonDoc[h]->chunks, false);
+        if(JsonDoc[h]->root == NULL) {
+            JsonClose(h);
+            error("Invalid JSON data");
+        }
         return;
     }
-    if (cJSON_IsInvalid(root)){
-        cJSON_Delete(parse);
-        error("Not an item");
+    if((tp = checkstring(cmdline, "CLOSE"))) {
+        JsonClose(getint(tp, 1, MAXJSONHANDLES) - 1);
         return;
     }
-    if (cJSON_IsNumber(root))
-    {
-        tempd = root->valuedouble;
+    error("Syntax");
+}
+
+// JSON$(array%(), path) or JSON$(h, path)
+// for an open document an array or object returns the number of items that it holds
+void MIPS16 fun_json(void){
+    struct s_jsonchunk *chain = NULL;
+    struct s_jsondoc *d = NULL;
+    cJSON *root;
+    char *a, *tp;
+    MMFLOAT tempd;
+    getargs(&ep, 3, ",");
+    if(argc != 3) error("Argument count");
+    a = GetTempStrMemory();
+    tp = argv[0];
+    if(isnamestart(*tp)) {                                          // check for the name of an array (ie, var())
+        while(isnamechar(*tp)) tp++;
+        if(*tp == '%' || *tp == '!' || *tp == '$') tp++;
+        skipspace(tp);
+        if(*tp == '(') { tp++; skipspace(tp); }
+    }
+    if(*tp == ')') {
+        root = JsonParse(JsonArray(argv[0]), &chain, true);         // the temporary memory will be freed when the command finishes
+        if(root == NULL) error("Invalid JSON data");
+    } else {
+        d = JsonDoc[getint(argv[0], 1, MAXJSONHANDLES) - 1];
+        if(d == NULL || d->root == NULL) error("JSON document not open");
+        root = d->root;
+    }
+    root = JsonFind(root, getCstring(argv[2]), d);
 
+    if(d != NULL && (cJSON_IsArray(root) || cJSON_IsObject(root))) {
+        IntToStr(a, cJSON_GetArraySize(root), 10);
+    } else if (cJSON_IsObject(root) || cJSON_IsInvalid(root)){
+        error("Not an item");
+    } else if (cJSON_IsNumber(root)) {
+        tempd = root->valuedouble;
         if((MMFLOAT)((int64_t)tempd)==tempd) IntToStr(a,(int64_t)tempd,10);
         else FloatToStr(a, tempd, 0, STR_AUTO_PRECISION, ' ');   // set the string value to be saved
-        cJSON_Delete(parse);
-        sret=a;
-        sret=CtoM(sret);
-        targ=T_STR;
-        return;
-    }
-    if (cJSON_IsBool(root)){
-        int64_t tempint;
-        tempint=root->valueint;
-        cJSON_Delete(parse);
-        if(tempint)strcpy(sret,"true");
-        else strcpy(sret,"false");
-        sret=CtoM(sret);
-        targ=T_STR;
-        return;
-    }
-    if (cJSON_IsString(root)){
+    } else if (cJSON_IsBool(root)){
+        strcpy(a, root->valueint ? "true" : "false");
+    } else if (cJSON_IsString(root)){
+        if(strlen(root->valuestring) >= MAXSTRLEN) error("String too long");
         strcpy(a,root->valuestring);
-        cJSON_Delete(parse);
-        sret=a;
-        sret=CtoM(sret);
-        targ=T_STR;
-        return;
     }
-    cJSON_Delete(parse);
+    sret=CtoM(a);
     targ=T_STR;
-    sret=a;
 }
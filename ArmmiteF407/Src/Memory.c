@@ -134,6 +134,22 @@ void heapstats(char *m1);
 uint32_t SavedMemoryBufferSize;
 int TempMemoryIsChanged = false;						            // used to prevent unnecessary scanning of strtmp[]
 int StrTmpIndex = 0;                                                // index to the next unallocated slot in strtmp[]
+struct s_callframe *CallFrames = NULL;                              // the call frame arena (allocated on the heap the first time that it is needed)
+int CallFrameIndex = 0;                                             // index to the next unallocated frame in the arena
+char CallFrameLevel[MAXCALLFRAMES];                                 // used to track the LocalIndex for each frame
+char CallFrameNoRoom = false;                                       // true if there was not enough heap for the arena
+char *FunArgBufs = NULL;                                            // the argument buffers for built-in functions (allocated on the heap when first needed)
+int FunArgIndex = 0;                                                // index to the next unallocated argument buffer
+char FunArgLevel[MAXFUNARGBUFS];                                    // used to track the LocalIndex for each argument buffer
+void *TempPool[TEMPPOOLSIZE];                                       // single page temporary buffers kept for reuse (still marked as used in mmap[])
+int TempPoolCnt = 0;                                                // nbr of buffers in TempPool[]
+unsigned int HeapPagesUsed = 0;                                     // nbr of pages marked as used in mmap[] (includes TempPool[])
+unsigned char *HeapFreeTop = (unsigned char *)RAMEND - RAMPAGESIZE;  // every page above this is in use so searches for free memory can start here
+unsigned int HeapAllocs = 0, HeapFrees = 0, TempPoolHits = 0;       // allocation statistics reported by MEMORY HEAP
+unsigned int HeapPagesHigh = 0;                                     // the high water mark of the pages in use (not counting TempPool[])
+static void *HeapAlloc(size_t size);
+static void FreeTempMemory(void *addr);
+static void FlushTempPool(void);
 unsigned int mmap[128];
 
 
@@ -501,6 +517,33 @@ void MIPS16 cmd_memory(void) {
     	memset(to, val, n);
     	return;
     }
+    tp = checkstring(cmdline, (char *)"HEAP");
+    if(tp){
+        unsigned char *addr;
+        int FreeRuns = 0, LargestRun = 0, run = 0;
+        // scan the page map to measure the fragmentation of the free memory
+        for(addr = (unsigned char *)RAMEND - RAMPAGESIZE; addr > (unsigned char *)RAMBase; addr -= RAMPAGESIZE) {
+            if(!(MBitsGet(addr) & PUSED)) {
+                if(run++ == 0) FreeRuns++;
+                if(run > LargestRun) LargestRun = run;
+            } else
+                run = 0;
+        }
+        MMPrintString("Heap:\r\n");
+        IntToStrPad(inpbuf, UsedHeap(), ' ', 8, 10); strcat(inpbuf, " bytes used\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, FreeSpaceOnHeap(), ' ', 8, 10); strcat(inpbuf, " bytes free in "); MMPrintString(inpbuf);
+        IntToStr(inpbuf, FreeRuns, 10); strcat(inpbuf, FreeRuns == 1 ? " block\r\n" : " blocks\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, LargestRun * RAMPAGESIZE, ' ', 8, 10); strcat(inpbuf, " bytes largest free block\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, TempPoolCnt * RAMPAGESIZE, ' ', 8, 10); strcat(inpbuf, " bytes held for temporary strings\r\n"); MMPrintString(inpbuf);
+        MMPrintString("\r\nSince RUN:\r\n");
+        IntToStrPad(inpbuf, HeapAllocs, ' ', 8, 10); strcat(inpbuf, " allocations\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, HeapFrees, ' ', 8, 10); strcat(inpbuf, " frees\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, TempPoolHits, ' ', 8, 10); strcat(inpbuf, " temporary buffers reused\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, HeapPagesHigh * RAMPAGESIZE, ' ', 8, 10); strcat(inpbuf, " bytes maximum used\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, StatementCount, ' ', 8, 10); strcat(inpbuf, " statements executed\r\n"); MMPrintString(inpbuf);
+        IntToStrPad(inpbuf, ExprFlushes, ' ', 8, 10); strcat(inpbuf, " expression cache flushes\r\n"); MMPrintString(inpbuf);
+        return;
+    }
     //-----------Output of memory command-------------
 	//-------------------------------------------------
     int i, j, var, nbr, vsize, VarCnt,pmax;
@@ -729,21 +772,81 @@ void m_alloc(int size) {
 void *GetTempMemory(int NbrBytes) {
     if(StrTmpIndex >= MAXTEMPSTRINGS) error("Not enough memory");
     StrTmpLocalIndex[StrTmpIndex] = LocalIndex;
-    StrTmp[StrTmpIndex] = GetMemory(NbrBytes);
+    if(NbrBytes <= RAMPAGESIZE && TempPoolCnt) {                    // if it will fit in a single page reuse a recently freed buffer
+        StrTmp[StrTmpIndex] = TempPool[--TempPoolCnt];
+        memset((void *)StrTmp[StrTmpIndex], 0, RAMPAGESIZE);
+        TempPoolHits++;
+        if(HeapPagesUsed - TempPoolCnt > HeapPagesHigh) HeapPagesHigh = HeapPagesUsed - TempPoolCnt;
+    } else
+        StrTmp[StrTmpIndex] = GetMemory(NbrBytes);
     TempMemoryIsChanged = true;
     return (void *)StrTmp[StrTmpIndex++];
 }
 
 
+// Get a frame used by DefinedSubFun() for processing the arguments of a sub/fun call
+// Frames are taken from a small stack (the call frame arena) so that calling a sub/fun normally does not need
+// any allocation on the heap.  The arena is allocated once and is freed by InitHeap().
+// If the arena is full (very deep nesting of function calls within arguments) the frame is allocated as temporary memory
+// Like temporary memory CallFrameLevel[] is used to track the sub/fun nesting level so that ClearTempMemory() can
+// recover frames abandoned by an error
+struct s_callframe *GetCallFrame(void) {
+    if(CallFrameIndex < MAXCALLFRAMES && !CallFrameNoRoom) {
+        if(CallFrames == NULL) {
+            if(FreeSpaceOnHeap() < MAXCALLFRAMES * sizeof(struct s_callframe) * 2) {
+                CallFrameNoRoom = true;                             // don't steal the last of the memory, use temp memory instead
+                return GetTempMemory(sizeof(struct s_callframe));
+            }
+            CallFrames = GetMemory(MAXCALLFRAMES * sizeof(struct s_callframe));
+        }
+        CallFrameLevel[CallFrameIndex] = LocalIndex;
+        return &CallFrames[CallFrameIndex++];
+    }
+    return GetTempMemory(sizeof(struct s_callframe));
+}
+
+
+// release a frame obtained from GetCallFrame()
+// this also releases any frames obtained after it
+void FreeCallFrame(struct s_callframe *frame) {
+    if(CallFrames != NULL && frame >= CallFrames && frame < CallFrames + MAXCALLFRAMES)
+        CallFrameIndex = frame - CallFrames;
+    else
+        ClearSpecificTempMemory(frame);
+}
+
+
+
+// Get a buffer for the argument text of a built-in function (used by getvalue())
+// The buffers are a small stack indexed by the depth of function calls within function arguments so
+// calling a built-in function normally does not need any allocation on the heap.  If the stack is full (or there is
+// no room for it) a temporary string is used instead and that will last for the life of the command.
+char *GetFunArgBuf(void) {
+    if(FunArgIndex < MAXFUNARGBUFS) {
+        if(FunArgBufs == NULL) {
+            if(FreeSpaceOnHeap() < MAXFUNARGBUFS * STRINGSIZE * 2) return GetTempStrMemory();
+            FunArgBufs = GetMemory(MAXFUNARGBUFS * STRINGSIZE);
+        }
+        FunArgLevel[FunArgIndex] = LocalIndex;
+        return FunArgBufs + STRINGSIZE * FunArgIndex++;
+    }
+    return GetTempStrMemory();
+}
+
+
+// release a buffer obtained from GetFunArgBuf()
+// this also releases any buffers obtained after it.  Temporary strings are left for ClearTempMemory()
+void FreeFunArgBuf(char *buf) {
+    if(FunArgBufs != NULL && buf >= FunArgBufs && buf < FunArgBufs + MAXFUNARGBUFS * STRINGSIZE)
+        FunArgIndex = (buf - FunArgBufs) / STRINGSIZE;
+}
+
+
+
 // get a temporary string buffer
 // this is used by many BASIC string functions.  The space only lasts for the length of the command.
 void *GetTempStrMemory(void) {
-    if(StrTmpIndex >= MAXTEMPSTRINGS) error("Not enough memory");
-    StrTmpLocalIndex[StrTmpIndex] = LocalIndex;
-    StrTmp[StrTmpIndex] = GetMemory(STRINGSIZE);
-    TempMemoryIsChanged = true;
-    return (void *)StrTmp[StrTmpIndex++];
-//    return GetTempMemory(STRINGSIZE);
+    return GetTempMemory(STRINGSIZE);
 }
 
 
@@ -751,10 +854,12 @@ void *GetTempStrMemory(void) {
 // this will not clear memory allocated with a local index less than LocalIndex, sub/funs will increment LocalIndex
 // and this prevents the automatic use of ClearTempMemory from clearing memory allocated before calling the sub/fun
 void ClearTempMemory(void) {
+    while(CallFrameIndex > 0 && CallFrameLevel[CallFrameIndex - 1] >= LocalIndex) CallFrameIndex--;
+    while(FunArgIndex > 0 && FunArgLevel[FunArgIndex - 1] >= LocalIndex) FunArgIndex--;
     while(StrTmpIndex > 0) {
         if(StrTmpLocalIndex[StrTmpIndex - 1] >= LocalIndex) {
             StrTmpIndex--;
-            FreeMemory((char *)StrTmp[StrTmpIndex]);
+            FreeTempMemory((char *)StrTmp[StrTmpIndex]);
             StrTmp[StrTmpIndex] = NULL;
             TempMemoryIsChanged = false;
         } else
@@ -764,11 +869,29 @@ void ClearTempMemory(void) {
 
 
 
+// return temporary memory to the heap
+// single pages (eg, temporary strings) are the most common and they are kept in TempPool[] so that the next
+// request for temporary memory does not need to search the heap
+static void FreeTempMemory(void *addr) {
+    if(TempPoolCnt < TEMPPOOLSIZE && MBitsGet(addr) == (PUSED | PLAST))
+        TempPool[TempPoolCnt++] = addr;
+    else
+        FreeMemory(addr);
+}
+
+
+// return all of the buffers held in TempPool[] to the heap
+static void FlushTempPool(void) {
+    while(TempPoolCnt) FreeMemory(TempPool[--TempPoolCnt]);
+}
+
+
+
 void ClearSpecificTempMemory(void *addr) {
     int i;
     for(i = 0; i < StrTmpIndex; i++) {
         if(StrTmp[i] == addr) {
-            FreeMemory(addr);
+            FreeTempMemory(addr);
             StrTmp[i] = NULL;
             StrTmpIndex--;
             while(i < StrTmpIndex) {
@@ -797,12 +920,17 @@ int MemSize(void *addr){
 
 void FreeMemory(void *addr) {
     int bits;
+    if(addr < (void *)RAMBase || addr >= (void *)RAMEND) return;
+    HeapFrees++;
     do {
-        if(addr < (void *)RAMBase || addr >= (void *)RAMEND) return;
+        if(addr >= (void *)RAMEND) break;
         bits = MBitsGet(addr);
+        if(bits & PUSED) HeapPagesUsed--;
         MBitsSet(addr, 0);
         addr += RAMPAGESIZE;
     } while(bits != (PUSED | PLAST));
+    addr -= RAMPAGESIZE;                                            // the last page freed
+    if((unsigned char *)addr > HeapFreeTop) HeapFreeTop = addr;     // there is now free memory above the old limit
 }
 
 
@@ -831,6 +959,12 @@ void InitHeap(void) {
     for(i = 0; i < MAXTEMPSTRINGS; i++) StrTmp[i] = NULL;
     MBitsSet((unsigned char *)RAMEND, PUSED | PLAST);
     StrTmpIndex = TempMemoryIsChanged = 0;
+    CallFrames = NULL;                                              // the call frame arena was on the heap
+    CallFrameIndex = CallFrameNoRoom = 0;
+    FunArgBufs = NULL;                                              // so were the function argument buffers
+    FunArgIndex = 0;
+    TempPoolCnt = HeapPagesUsed = HeapAllocs = HeapFrees = TempPoolHits = HeapPagesHigh = 0;
+    HeapFreeTop = (unsigned char *)RAMEND - RAMPAGESIZE;
 }
 
 
@@ -861,15 +995,37 @@ void MBitsSet(void *addr, int bits) {
 
 
 void *GetMemory(size_t size) {
+    void *addr;
     TestStackOverflow();
-//void *getheap(int size) {
+    addr = HeapAlloc(size);
+    if(addr == NULL && TempPoolCnt) {                               // the buffers held for reuse might be in the way
+        FlushTempPool();
+        addr = HeapAlloc(size);
+    }
+    if(addr != NULL) return addr;
+
+    // out of memory
+    LocalIndex = 0;
+    ClearTempMemory();                                              // hopefully this will give us enough to print the prompt
+    error("Not enough memory");
+    return NULL;                                                    // keep the compiler happy
+}
+
+
+// search the heap (from the top down) for enough contiguous free pages and mark them as used
+// returns NULL if there is not enough memory
+static void *HeapAlloc(size_t size) {
     uint64_t *i;
     unsigned int j, n, k;
     unsigned char *addr;
     k = j = n = (size + RAMPAGESIZE - 1)/RAMPAGESIZE;                         // nbr of pages rounded up
-    for(addr = (unsigned char *)RAMEND -  RAMPAGESIZE; addr > (unsigned char *)RAMBase; addr -= RAMPAGESIZE) {
+    for(addr = HeapFreeTop; addr > (unsigned char *)RAMBase; addr -= RAMPAGESIZE) {
         if(!(MBitsGet(addr) & PUSED)) {
             if(--n == 0) {                                          // found a free slot
+                HeapPagesUsed += k;
+                HeapAllocs++;
+                if(HeapPagesUsed - TempPoolCnt > HeapPagesHigh) HeapPagesHigh = HeapPagesUsed - TempPoolCnt;
+                if(addr + (k - 1) * RAMPAGESIZE == HeapFreeTop) HeapFreeTop = addr - RAMPAGESIZE;
                 j--;
                 MBitsSet(addr + (j * RAMPAGESIZE), PUSED | PLAST);     // show that this is used and the last in the chain of pages
                 while(j--) MBitsSet(addr + (j * RAMPAGESIZE), PUSED);  // set the other pages to show that they are used
@@ -913,32 +1069,20 @@ void *GetMemory(size_t size) {
         } else
             n = j;                                                  // not enough space here so reset our count
     }
-    // out of memory
-    LocalIndex = 0;
-    ClearTempMemory();                                              // hopefully this will give us enough to print the prompt
-    error("Not enough memory");
-    return NULL;                                                    // keep the compiler happy
+    return NULL;
 }
 
 
+// the free space and used space are calculated from the count of used pages maintained by GetMemory() and FreeMemory()
+// the buffers held in TempPool[] are counted as free
 int FreeSpaceOnHeap(void) {
-    unsigned int nbr;
-    unsigned char *addr;
-    nbr = 0;
-    for(addr = (unsigned char *)RAMEND -  RAMPAGESIZE; addr > (unsigned char *)RAMBase; addr -= RAMPAGESIZE)
-        if(!(MBitsGet(addr) & PUSED)) nbr++;
-    return nbr * RAMPAGESIZE;
+    return (((unsigned int)RAMEND - (unsigned int)RAMBase) / RAMPAGESIZE - 1 - HeapPagesUsed + TempPoolCnt) * RAMPAGESIZE;
 }
 
 
 
 unsigned int UsedHeap(void) {
-    unsigned int nbr;
-    unsigned char *addr;
-    nbr = 0;
-    for(addr = (unsigned char *)RAMEND -  RAMPAGESIZE; addr > (unsigned char *)RAMBase; addr -= RAMPAGESIZE)
-        if(MBitsGet(addr) & PUSED) nbr++;
-    return nbr * RAMPAGESIZE;
+    return (HeapPagesUsed - TempPoolCnt) * RAMPAGESIZE;
 }
 
 
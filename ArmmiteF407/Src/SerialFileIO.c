@@ -211,6 +211,7 @@ void fun_loc(void) {
         if(fnbr < 1 || fnbr > MAXOPENFILES) error("File number");
         if(FileTable[fnbr].com == 0) error("File number is not open");
         if(FileTable[fnbr].com > MAXCOMPORTS) {
+            FileFlush(fnbr);
             iret = (*(FileTable[fnbr].fptr)).fptr + 1;
         } else
         iret = SerialRxStatus(FileTable[fnbr].com);
@@ -231,6 +232,7 @@ void fun_lof(void) {
         if(fnbr < 1 || fnbr > MAXOPENFILES) error("File number");
         if(FileTable[fnbr].com == 0) error("File number is not open");
         if(FileTable[fnbr].com > MAXCOMPORTS) {
+            FileFlush(fnbr);
             iret = f_size(FileTable[fnbr].fptr);
         } else
         iret = (TX_BUFFER_SIZE - SerialTxStatus(FileTable[fnbr].com));
@@ -256,6 +258,9 @@ void MMgetline(int filenbr, char *p) {
 	int c, nbrchars = 0;
 	char *tp;
 
+    // a file opened for input is read a line at a time from its buffer
+    if(filenbr > 0 && filenbr <= MAXOPENFILES && FileTable[filenbr].com > MAXCOMPORTS && FileGetLine(filenbr, p)) return;
+
     while(1) {
 
 		CheckAbort();												// jump right out if CTRL-C
@@ -91,6 +91,7 @@ extern TIM_HandleTypeDef htim10;
 extern int LCD_BL_Period;
 extern volatile BYTE SDCardStat;
 volatile unsigned int SDtimer=1000, checkSD=0;
+extern volatile unsigned int FileFlushTimer;
 #include "usbd_cdc_if.h"
 extern volatile int ConsoleTxBufHead;
 extern volatile int ConsoleTxBufTail;
@@ -129,6 +130,7 @@ if(processtick){
     if(CFuncmSec) CallCFuncmSec();                                  // the 1mS tick for CFunctions (see CFunction.c)
     keytimer++;
     SDtimer--;
+    FileFlushTimer++;
     if(SDtimer==0){
     	SDtimer=1000;
     	if(!(SDCardStat & STA_NOINIT))checkSD=1; //card supposed to be mounted so set a check
@@ -160,8 +162,12 @@ if(processtick){
     if(InterruptUsed) {
     	int i;
 	   // for(i = 0; i < NBRSETTICKS; i++) TickTimer[i]++;			// used in the interrupt tick
-	    for(i = 0; i < NBRSETTICKS; i++) if(TickActive[i])TickTimer[i]++;			// used in the interrupt tick
+	    for(i = 0; i < NBRSETTICKS; i++) if(TickActive[i]) {
+	        TickTimer[i]++;			                                    // used in the interrupt tick
+	        if(TickInt[i] != NULL && TickTimer[i] > TickPeriod[i] && !(IntPending & (1u << (INT_TICK + i)))) IntPost(INT_TICK + i);
+	    }
 	}
+    IntPost(INT_HOUSEKEEP);                                         // run the touch, SD card and GPS checks in check_interrupt()
 
 	if(WDTimer) {
     	if(--WDTimer == 0) {
@@ -233,6 +239,7 @@ if(processtick){
             else
                 *(long long int *)IrCmd = IrCmdTmp;
             IrGotMsg = true;
+            IntPost(INT_IR);
             NextIrTick += 250;
         }
         IrTimeout = IrTick + 150;
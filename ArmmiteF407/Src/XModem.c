@@ -51,18 +51,34 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 void xmodemTransmit(char *p, int fnbr);
 void xmodemReceive(char *sp, int maxbytes, int fnbr, int crunch);
+static void ymodemTransmit(char *pattern);
+static void ymodemReceive(void);
 int FindFreeFileNbr(void);
 
+static unsigned char *xbuff;                                        // the packet buffer
+static unsigned char *xfbuf;                                        // buffer used to write received data to the SD card
+static int xfcount;                                                 // nbr of bytes waiting in xfbuf
+static unsigned int xfremain;                                       // nbr of bytes still expected in a YMODEM file, 0xffffffff if not known
+
+#define X_BLOCK_SIZE	128
+#define X_1K_SIZE	1024
+#define X_BUF_SIZE	X_1K_SIZE + 6								// 1024 for XModem-1K + 3 head chars + 2 crc + nul
+#define X_FILE_BUF	4096										// received files are written to the SD card in chunks of this size
+
 void cmd_xmodem(void) {
 	char *buf, BreakKeySave, *p, *fromp;
-    int rcv = 0, fnbr, crunch = false;
+    int rcv = 0, fnbr, crunch = false, ymodem = false;
 	char *fname;
 
+    if(toupper(*cmdline) == 'Y') {                                  // YSEND or YRECEIVE for a YMODEM batch
+        ymodem = true;
+        cmdline++;
+    }
     if(toupper(*cmdline) == 'R')
         rcv = true;
     else if(toupper(*cmdline) == 'S')
         rcv = false;
-    else if(toupper(*cmdline) == 'C')
+    else if(toupper(*cmdline) == 'C' && !ymodem)
          crunch = rcv = true;
     else
         error("Syntax");
@@ -72,13 +88,25 @@ void cmd_xmodem(void) {
     BreakKeySave = BreakKey;
     BreakKey = 0;
         
-    if(*cmdline == 0 || *cmdline == '\'') {
+    if(ymodem) {
+        // a YMODEM batch always uses the SD card
+        if(!InitSDCard()) return;
+        xbuff = GetTempMemory(X_BUF_SIZE);
+        if(rcv) {
+            xfbuf = GetTempMemory(X_FILE_BUF);
+            ymodemReceive();
+        } else {
+            if(*cmdline == 0 || *cmdline == '\'') error("Syntax");
+            ymodemTransmit(getFstring(cmdline));
+        }
+    } else if(*cmdline == 0 || *cmdline == '\'') {
         // no file name, so this is a transfer to/from program memory
         if(CurrentLinePtr) error("Invalid in a program");
         ClearProgram();                                             // we need all the RAM
-        buf = GetTempMemory(EDIT_BUFFER_SIZE);
+        xbuff = GetTempMemory(X_BUF_SIZE);
+        buf = GetTempMemory(EDIT_BUFFER_SIZE - 2048);               // leave room for the packet buffer
         if(rcv) {
-            xmodemReceive(buf, EDIT_BUFFER_SIZE, 0, crunch);
+            xmodemReceive(buf, EDIT_BUFFER_SIZE - 2048, 0, crunch);
             SaveProgramToFlash(buf, true);
         } else {
             // we must copy program memory into RAM expanding tokens as we go
@@ -88,7 +116,7 @@ void cmd_xmodem(void) {
                 if(*fromp == T_NEWLINE) {
                     fromp = llist(p, fromp);                        // expand the line into the buffer
                     p += strlen(p);
-                    if(p - buf + 40 > EDIT_BUFFER_SIZE) error("Not enough memory");
+                    if(p - buf + 40 > EDIT_BUFFER_SIZE - 2048) error("Not enough memory");
                     *p++ = '\n'; *p = 0;                            // terminate that line
                 }
                 if(fromp[0] == 0 || fromp[0] == 0xff) break;        // finally, is it the end of the program?
@@ -101,8 +129,10 @@ void cmd_xmodem(void) {
         if(!InitSDCard()) return;
         fnbr = FindFreeFileNbr();
         fname = getFstring(cmdline);                               // get the file name
+        xbuff = GetTempMemory(X_BUF_SIZE);
         
         if(rcv) {
+            xfbuf = GetTempMemory(X_FILE_BUF);
             if(!BasicFileOpen(fname, fnbr, FA_WRITE | FA_CREATE_ALWAYS)) return;
             xmodemReceive(NULL, 0, fnbr, false);
         } else {
@@ -140,7 +170,8 @@ the xmodem protocol
 /* derived from the work of Georges Menie (www.menie.org) Copyright 2001-2010 Georges Menie
  * very much debugged and changed
  *
- * this is just the basic XModem protocol (no 1K blocks, crc, etc).  It has been tested on
+ * this implements XModem with checksums or CRC16, XModem-1K (1024 byte blocks are sent when the
+ * receiver asks for CRC16) and YModem batch transfers of files on the SD card.  It has been tested on
  * Terra Term and is intended for use with that software.
  */
 
@@ -152,18 +183,62 @@ the xmodem protocol
 #define NAK  0x15
 #define CAN  0x18
 #define PAD  0x1a
+#define CRCCHR 'C'
 
 #define DLY_1S 1000
 #define MAXRETRANS 25
-
-#define X_BLOCK_SIZE	128
-#define X_BUF_SIZE	X_BLOCK_SIZE + 6								// 128 for XModem + 3 head chars + 2 crc + nul
+#define CRCTRIES 3													// nbr of requests for CRC16 before falling back to checksums
+
+
+// CRC16 (CCITT polynomial 0x1021, initial value zero) as used by XModem
+static const unsigned short crctab[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+static unsigned short crc16x(const unsigned char *buf, int sz) {
+	unsigned short crc = 0;
+	while(sz--) crc = (crc << 8) ^ crctab[(crc >> 8) ^ *buf++];
+	return crc;
+}
 
 
-static int check(const unsigned char *buf, int sz)
+// check the checksum or CRC which follows sz bytes of data in buf
+static int check(int crc, const unsigned char *buf, int sz)
 {
 	int i;
 	unsigned char cks = 0;
+	if(crc) return crc16x(buf, sz) == ((buf[sz] << 8) | buf[sz + 1]);
 	for (i = 0; i < sz; ++i) {
 		cks += buf[i];
 	}
@@ -180,207 +255,347 @@ static void flushinput(void)
 }
 
 
+static void cancel(void)
+{
+	flushinput();
+	putConsole(CAN);
+	putConsole(CAN);
+	putConsole(CAN);
+}
+
+
+// get the rest of a packet into xbuff, c is the header char (SOH or STX) which has already been received
+// returns the size of the data in the packet (it starts at xbuff[3]) or zero if the packet was corrupt
+static int getpacket(int c, int crc) {
+	int i, size = (c == STX) ? X_1K_SIZE : X_BLOCK_SIZE;
+	xbuff[0] = c;
+	for (i = 1;  i < size + 4 + crc; ++i) {
+		if ((c = _inbyte(DLY_1S)) < 0) return 0;
+		xbuff[i] = c;
+	}
+	if (xbuff[1] != (unsigned char)(~xbuff[2]) || !check(crc, &xbuff[3], size)) return 0;
+	return size;
+}
+
+
+// write the received data to the file through xfbuf
+// this is flushed in whole multiples of X_FILE_BUF so that FatFs can write full clusters directly to the card
+static void savetofile(unsigned char *p, int len, int fnbr) {
+	int n;
+	if ((unsigned int)len > xfremain) len = xfremain;			// YModem tells us the file size so drop the padding
+	if (xfremain != 0xffffffff) xfremain -= len;
+	while (len) {
+		n = X_FILE_BUF - xfcount;
+		if (n > len) n = len;
+		memcpy(xfbuf + xfcount, p, n);
+		xfcount += n; p += n; len -= n;
+		if (xfcount == X_FILE_BUF) {
+			FilePutStr(xfcount, (char *)xfbuf, fnbr);
+			xfcount = 0;
+		}
+	}
+}
+
+
+// ask the sender to start sending and wait for the first packet
+// the request is repeated every 2 seconds.  If asked for CRC16 and fallback is true we fall back to checksums
+// after CRCTRIES requests (YModem must use CRC16 so it does not fall back)
+// returns the first char received (SOH, STX or EOT)
+static int startreceive(int *crc, int fallback) {
+	int c, retry;
+	for( retry = 0; retry < 32; ++retry) {
+		if (fallback && retry == CRCTRIES) *crc = false;			// the sender does not understand CRC
+		putConsole(*crc ? CRCCHR : NAK);
+		if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
+			switch (c) {
+			case SOH:
+			case STX:
+			case EOT:
+				return c;
+			case CAN:
+				flushinput();
+				putConsole(ACK);
+				error("Cancelled by remote");
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	cancel();
+	error("Remote did not respond");                            // no sync
+	return 0;
+}
+
+
+// receive the data packets of a file, c is the first char of the first packet which has already been received
+// if sp == NULL we are saving to a file on the SD card (fnbr is the file number)
+// otherwise we are saving to RAM which will later be written to program memory
+static void receivedata(char *sp, int maxbytes, int fnbr, int crunch, int crc, int c) {
+	unsigned char packetno = 1;
+	int i, size, errors = 0;										// bad or repeated packets and timeouts since the last good packet
+
+	xfcount = 0;
+	CrunchData(&sp, 0);                                         // initialise the crunch subroutine
+	while(c != EOT) {
+		if (c == CAN) {
+			flushinput();
+			putConsole(ACK);
+			error("Cancelled by remote");
+		}
+		if ((c == SOH || c == STX) && (size = getpacket(c, crc)) != 0 && (xbuff[1] == packetno || xbuff[1] == (unsigned char)(packetno-1))) {
+			if (xbuff[1] == packetno) {
+				if (sp != NULL) {
+					for(i = 0 ; i < size ; i++) {
+						// save the data to the RAM buffer
+						if(--maxbytes > 0) {
+							if(xbuff[i + 3] == PAD) continue;
+							if(xbuff[i + 3] == 0) continue;
+							if(crunch)
+								CrunchData(&sp, xbuff[i + 3]);
+							else
+								*sp++ = xbuff[i + 3];           // saving to a memory buffer
+						}
+					}
+				} else
+					savetofile(&xbuff[3], size, fnbr);			// we are saving to a file
+				++packetno;
+				errors = 0;
+			} else if (++errors >= MAXRETRANS) {					// the sender keeps repeating the last packet
+				cancel();
+				error("Too many errors");
+			}
+			putConsole(ACK);
+		} else {
+			if (++errors >= MAXRETRANS) {							// a corrupt packet counts the same as a timeout
+				cancel();
+				error("Too many errors");
+			}
+			flushinput();
+			putConsole(NAK);
+		}
+		// wait for the next packet, nagging the sender if it goes quiet
+		while((c = _inbyte((DLY_1S)<<1)) < 0) {
+			if (++errors >= MAXRETRANS) {
+				cancel();
+				error("Remote did not respond");
+			}
+			putConsole(NAK);
+		}
+	}
+	putConsole(ACK);												// acknowledge the EOT
+	if(sp != NULL) {
+		if(maxbytes <= 0) error("Not enough memory");
+		*sp++ = 0;													// terminate the data
+	} else if (xfcount)
+		FilePutStr(xfcount, (char *)xfbuf, fnbr);					// write whatever is left
+}
+
+
 // receive data
 // if sp == NULL we are saving to a file on the SD card (fnbr is the file number)
 // otherwise we are saving to RAM which will later be written to program memory
 void xmodemReceive(char *sp, int maxbytes, int fnbr, int crunch) {
-    unsigned char xbuff[X_BUF_SIZE];
-    unsigned char *p;
-    unsigned char trychar = NAK; //'C';
-    unsigned char packetno = 1;
-    int i, c;
-    int retry, retrans = MAXRETRANS;
-
-    CrunchData(&sp, 0);                                         // initialise the crunch subroutine
-
-        // first establish communication with the remote
-    while(1) {
-        for( retry = 0; retry < 32; ++retry) {
-            if(trychar) putConsole(trychar);
-            if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
-                switch (c) {
-                case SOH:
-                    goto start_recv;
-                case EOT:
-                    flushinput();
-                    putConsole(ACK);
-                    if(sp != NULL) {
-                        if(maxbytes <= 0) error("Not enough memory");
-                        *sp++ = 0;                                  // terminate the data
-                    }
-                    return;                                         // no more data
-                case CAN:
-                    flushinput();
-                    putConsole(ACK);
-                    error("Cancelled by remote");
-                    break;
-                default:
-                    break;
-                }
-            }
-        }
-        flushinput();
-        putConsole(CAN);
-        putConsole(CAN);
-        putConsole(CAN);
-        error("Remote did not respond");                            // no sync
-
-    start_recv:
-        trychar = 0;
-        p = xbuff;
-        *p++ = SOH;
-        for (i = 0;  i < (X_BLOCK_SIZE+3); ++i) {
-            if ((c = _inbyte(DLY_1S)) < 0) goto reject;
-            *p++ = c;
-        }
-        if (xbuff[1] == (unsigned char)(~xbuff[2]) && (xbuff[1] == packetno || xbuff[1] == (unsigned char)packetno-1) && check(&xbuff[3], X_BLOCK_SIZE)) {
-            if (xbuff[1] == packetno) {
-                for(i = 0 ; i < X_BLOCK_SIZE ; i++) {
-                    if(sp != NULL) {
-                        // save the data to the RAM buffer
-                        if(--maxbytes > 0) {
-                            if(xbuff[i + 3] == PAD) continue;
-//                            if(xbuff[i + 3] == PAD)
-//                                *sp++ = 0;                          // replace any EOF's (used to pad out a block) with NUL
-//                            else
-                            if(xbuff[i + 3] == 0) continue;
-                                if(crunch)
-                                    CrunchData(&sp, xbuff[i + 3]);
-                                else
-                                    *sp++ = xbuff[i + 3];           // saving to a memory buffer
-                        }
-                    } else {
-                        // we are saving to a file
-                        FilePutChar(xbuff[i + 3], fnbr);
-                    }
-                }
-                ++packetno;
-                retrans = MAXRETRANS+1;
-            }
-            if (--retrans <= 0) {
-                flushinput();
-                putConsole(CAN);
-                putConsole(CAN);
-                putConsole(CAN);
-                error("Too many errors");
-            }
-            putConsole(ACK);
-            continue;
-        }
-    reject:
-        flushinput();
-        putConsole(NAK);
-    }
+	int crc = true;
+	int c = startreceive(&crc, true);
+	xfremain = 0xffffffff;
+	receivedata(sp, maxbytes, fnbr, crunch, crc, c);
+	flushinput();
 }
 
 
-// transmit data
-// if p == NULL we are reading the data to be sent from a file on the SD card (fnbr is the file number)
-// otherwise we are reading from RAM and p points to the start of the data (which is terminated by a zero char)
-void xmodemTransmit(char *p, int fnbr) {
-	unsigned char xbuff[X_BUF_SIZE]; 
-	unsigned char packetno = 1;
-    char prevchar = 0;
-	int i, c, len;
-	int retry;
+// receive a batch of files with YModem, they are saved in the current directory
+static void ymodemReceive(void) {
+	int c, crc = true, fnbr, errors = 0, ok, abort;
+	char *p, *q;
 
-	// first establish communication with the remote
 	while(1) {
-		for( retry = 0; retry < 32; ++retry) {
-			if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
-				switch (c) {
-				case NAK:											// start sending
-					goto start_trans;
-				case CAN:
-					if ((c = _inbyte(DLY_1S)) == CAN) {
-						putConsole(ACK);
-						flushinput();
-						error("Cancelled by remote");
-					}
-					break;
-				default:
-					break;
-				}
+		// ask for the header packet (packet zero) with the file name and size
+		c = startreceive(&crc, false);
+		if (c == EOT || !getpacket(c, crc) || xbuff[1] != 0) {
+			if (++errors >= MAXRETRANS) {
+				cancel();
+				error("Too many errors");
 			}
+			flushinput();
+			putConsole(NAK);
+			continue;
 		}
-		putConsole(CAN);
-		putConsole(CAN);
-		putConsole(CAN);
-		flushinput();
-		error("Remote did not respond");							// no sync
-
-		// send a packet
-		while(1) {
-		start_trans:
-			memset (xbuff, 0, X_BUF_SIZE);							// start with an empty buffer
-			
-			xbuff[0] = SOH;											// copy the header
-			xbuff[1] = packetno;
-			xbuff[2] = ~packetno;
-			
-            if(p != NULL) {
-                // our data is in RAM
-                for(len = 0; len < 128 && *p; len++) {
-                    if(*p == '\n' && prevchar != '\r')
-                        prevchar = xbuff[len + 3] = '\r';
-                    else
-                        prevchar = xbuff[len + 3] = *p++;			// copy the data from memory into the packet
-                }
-            } else {
-                // we get the data from a file
-                for(len = 0; len < 128 && !FileEOF(fnbr); len++) {
-                    xbuff[len + 3] = FileGetChar(fnbr);				// copy the data from the file into the packet
-                }
-            }
-			if (len > 0) {
-				unsigned char ccks = 0;
-				for (i = 3; i < X_BLOCK_SIZE+3; ++i) {
-					ccks += xbuff[i];
-				}
-				xbuff[X_BLOCK_SIZE+3] = ccks;
-				
-				// now send the block
-				for (retry = 0; retry < MAXRETRANS && !MMAbort; ++retry) {
-					// send the block
-					for (i = 0; i < X_BLOCK_SIZE+4 && !MMAbort; ++i) {
-						putConsole(xbuff[i]);
-					}
-					// check the response
-					if ((c = _inbyte(DLY_1S)) >= 0 ) {
-						switch (c) {
-						case ACK:
-							++packetno;
-							goto start_trans;
-						case CAN:									// cancelled by remote
-							putConsole(ACK);
-							flushinput();
-							error("Cancelled by remote");
-							break;
-						case NAK:									// receiver got a corrupt block
-						default:
-							break;
-						}
-					}
+		errors = 0;
+		putConsole(ACK);
+		p = (char *)&xbuff[3];
+		if (*p == 0) break;											// an empty file name ends the batch
+		q = p + strlen(p) + 1;										// the size follows the name
+		xfremain = (*q >= '0' && *q <= '9') ? strtoul(q, NULL, 10) : 0xffffffff;
+		if ((q = strrchr(p, '/')) != NULL) p = q + 1;				// ignore any directory sent with the name
+		fnbr = FindFreeFileNbr();
+		abort = OptionFileErrorAbort;								// the sender must be cancelled before the error is reported
+		OptionFileErrorAbort = false;
+		ok = BasicFileOpen(p, fnbr, FA_WRITE | FA_CREATE_ALWAYS);
+		OptionFileErrorAbort = abort;
+		if (!ok) {
+			cancel();
+			error("Cannot create $", p);
+		}
+		// now ask for the data
+		c = startreceive(&crc, false);
+		receivedata(NULL, 0, fnbr, false, crc, c);
+		FileClose(fnbr);
+	}
+	flushinput();
+}
+
+
+// wait for the receiver to ask us to start
+// returns CRCCHR if it wants CRC16 or NAK for checksums
+static int starttransmit(void) {
+	int c, retry;
+	for( retry = 0; retry < 32; ++retry) {
+		if ((c = _inbyte((DLY_1S)<<1)) >= 0) {
+			switch (c) {
+			case NAK:											// start sending
+			case CRCCHR:
+				return c;
+			case CAN:
+				if ((c = _inbyte(DLY_1S)) == CAN) {
+					putConsole(ACK);
+					flushinput();
+					error("Cancelled by remote");
 				}
-				// too many retrys... give up
-				putConsole(CAN);
-				putConsole(CAN);
-				putConsole(CAN);
-				flushinput();
-				error("Too many errors");
+				break;
+			default:
+				break;
 			}
-			
-			// finished sending - send end of text
-			else {
-				for (retry = 0; retry < 10; ++retry) {
-					putConsole(EOT);
-					if ((c = _inbyte((DLY_1S)<<1)) == ACK) break;
-				}
+		}
+	}
+	cancel();
+	error("Remote did not respond");							// no sync
+	return 0;
+}
+
+
+// send the packet in xbuff (the data must already be in xbuff[3]) and wait for it to be acknowledged
+static void sendpacket(unsigned char packetno, int size, int crc) {
+	int i, c, retry;
+	unsigned char ccks = 0;
+
+	xbuff[0] = (size == X_1K_SIZE) ? STX : SOH;						// copy the header
+	xbuff[1] = packetno;
+	xbuff[2] = ~packetno;
+	if (crc) {
+		i = crc16x(&xbuff[3], size);
+		xbuff[size + 3] = i >> 8;
+		xbuff[size + 4] = i;
+	} else {
+		for (i = 3; i < size + 3; ++i) {
+			ccks += xbuff[i];
+		}
+		xbuff[size + 3] = ccks;
+	}
+
+	for (retry = 0; retry < MAXRETRANS && !MMAbort; ++retry) {
+		// send the block
+		for (i = 0; i < size + 4 + crc && !MMAbort; ++i) {
+			putConsole(xbuff[i]);
+		}
+		// check the response
+		if ((c = _inbyte(DLY_1S)) >= 0 ) {
+			switch (c) {
+			case ACK:
+				return;
+			case CAN:									// cancelled by remote
+				putConsole(ACK);
 				flushinput();
-				if(c == ACK) return;
-				error("Error closing");
+				error("Cancelled by remote");
+				break;
+			case NAK:									// receiver got a corrupt block
+			default:
+				break;
+			}
+		}
+	}
+	// too many retrys... give up
+	cancel();
+	error("Too many errors");
+}
+
+
+// send the data packets of a file followed by EOT
+// if p == NULL we are reading the data to be sent from a file on the SD card (fnbr is the file number)
+// otherwise we are reading from RAM and p points to the start of the data (which is terminated by a zero char)
+static void senddata(char *p, int fnbr, int crc) {
+	unsigned char packetno = 1;
+	char prevchar = 0;
+	unsigned int len;
+	int c, retry, size = crc ? X_1K_SIZE : X_BLOCK_SIZE;		// 1K blocks can only be used with CRC16
+
+	while(1) {
+		memset(&xbuff[3], 0, size);								// start with an empty buffer
+		if(p != NULL) {
+			// our data is in RAM
+			for(len = 0; len < size && *p; len++) {
+				if(*p == '\n' && prevchar != '\r')
+					prevchar = xbuff[len + 3] = '\r';
+				else
+					prevchar = xbuff[len + 3] = *p++;			// copy the data from memory into the packet
 			}
+		} else {
+			// read the data straight from the file into the packet
+			FSerror = f_read(FileTable[fnbr].fptr, &xbuff[3], size, &len);
+			ErrorCheck(fnbr);
 		}
+		if (len == 0) break;
+		sendpacket(packetno++, len <= X_BLOCK_SIZE ? X_BLOCK_SIZE : size, crc);	// use a short block for the tail
+	}
+
+	// finished sending - send end of text
+	for (retry = 0; retry < 10; ++retry) {
+		putConsole(EOT);
+		if ((c = _inbyte((DLY_1S)<<1)) == ACK) return;
 	}
+	flushinput();
+	error("Error closing");
+}
+
+
+// transmit data
+// if p == NULL we are reading the data to be sent from a file on the SD card (fnbr is the file number)
+// otherwise we are reading from RAM and p points to the start of the data (which is terminated by a zero char)
+void xmodemTransmit(char *p, int fnbr) {
+	senddata(p, fnbr, starttransmit() == CRCCHR);
+	flushinput();
 }
 
+
+// send all files in the current directory matching pattern as a YModem batch
+static void ymodemTransmit(char *pattern) {
+	DIR djd;
+	FILINFO fnod;
+	int crc, fnbr;
+
+	memset(&djd, 0, sizeof(DIR));
+	memset(&fnod, 0, sizeof(FILINFO));
+	FSerror = f_findfirst(&djd, &fnod, "", pattern);
+	ErrorCheck(0);
+	while(FSerror == FR_OK && fnod.fname[0]) {
+		if(!(fnod.fattrib & (AM_DIR | AM_SYS | AM_HID))) {
+			// packet zero holds the file name and its size in decimal
+			crc = (starttransmit() == CRCCHR);
+			memset(&xbuff[3], 0, X_BLOCK_SIZE);
+			strcpy((char *)&xbuff[3], fnod.fname);
+			IntToStr((char *)&xbuff[3] + strlen(fnod.fname) + 1, fnod.fsize, 10);
+			sendpacket(0, X_BLOCK_SIZE, crc);
+			fnbr = FindFreeFileNbr();
+			if(!BasicFileOpen(fnod.fname, fnbr, FA_READ)) break;
+			senddata(NULL, fnbr, starttransmit() == CRCCHR);
+			FileClose(fnbr);
+		}
+		FSerror = f_findnext(&djd, &fnod);
+	}
+	f_closedir(&djd);
+	// an empty packet zero ends the batch
+	crc = (starttransmit() == CRCCHR);
+	memset(&xbuff[3], 0, X_BLOCK_SIZE);
+	sendpacket(0, X_BLOCK_SIZE, crc);
+	flushinput();
+}
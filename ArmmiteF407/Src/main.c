@@ -838,6 +838,7 @@ int main(void)
         BreakKey = BREAK_KEY;
         EchoOption = true;
         LocalIndex = 0;                                             // this should not be needed but it ensures that all space will be cleared
+        ExprBusy = 0;                                               // an error or Ctrl-C inside a compiled expression skipped the decrement
         ClearTempMemory();                                           // clear temp string space (might have been used by the prompt)
         CurrentLinePtr = NULL;                                      // do not use the line number in error reporting
         if(MMCharPos > 1) PRet();                                   // prompt should be on a new line
@@ -860,6 +861,7 @@ int main(void)
             }
         }
         _excep_code = 0;
+        ProfileStop();                                              // the time waiting at the prompt is not part of the program
         PrepareProgram(false);
         if(!ErrorInPrompt && FindSubFun("MM.PROMPT", 0) >= 0) {
             ErrorInPrompt = true;
@@ -93,6 +93,8 @@ extern int ADCtriggertimeout;
 extern int ADCtriggerchannel;
 extern int ADCnegativeslope;
 extern volatile int ADCcomplete;
+extern volatile int ADCstreaming;
+extern void ADCStreamISR(void);
 extern void MIPS16 error(char *msg, ...);
 extern volatile int periodstarted;
 extern volatile int ConsoleRxBufHead;
@@ -104,11 +106,13 @@ extern char ConsoleRxBuf[];
 extern char BreakKey;
 extern char *KeyInterrupt;
 extern volatile int Keycomplete;
+extern void IntPost(int src);
+extern void CanReceive(int fifo);
 extern int keyselect;
 extern volatile int MMAbort;
 extern volatile struct option_s Option, *SOption;
 extern char SerialConDisabled;
-uint64_t TIM12count=0;
+volatile uint64_t TIM12count=0;
 
 /* USER CODE END EV */
 
@@ -321,6 +325,7 @@ void USART1_IRQHandler(void)
 
 	  		} else if(ConsoleRxBuf[ConsoleRxBufHead] ==keyselect && KeyInterrupt!=NULL){
 	  					Keycomplete=1;
+	  					IntPost(INT_KEY);
 	  		} else {
 	  			ConsoleRxBufHead = (ConsoleRxBufHead + 1) % CONSOLE_RX_BUF_SIZE;     // advance the head of the queue
 	  			if(ConsoleRxBufHead == ConsoleRxBufTail) {                           // if the buffer has overflowed
@@ -529,6 +534,11 @@ void TIM7_IRQHandler(void)
   /* USER CODE BEGIN TIM7_IRQn 0 */
 	static int lastread, ADCtriggerfound,timeout;
 	int c, c1=0, c2=0, c3=0;
+	if(ADCstreaming){
+		ADCStreamISR();
+		TIM7->SR=0;
+		return;
+	}
 //	a=10000; while (HAL_IS_BIT_CLR(hadc1.Instance->SR, EOC_SINGLE_CONV) && a--);
 	HAL_ADC_PollForConversion(&hadc1, 10);
 	c1=HAL_ADC_GetValue(&hadc1);
@@ -552,6 +562,7 @@ void TIM7_IRQHandler(void)
 		HAL_TIM_Base_Stop(&htim7);
 		HAL_TIM_Base_DeInit(&htim7);
 		ADCcomplete=true;
+		IntPost(INT_ADC);
 		TIM7->SR=0;
 		return;
 	}
@@ -602,6 +613,22 @@ void TIM7_IRQHandler(void)
   /* USER CODE END TIM7_IRQn 1 */
 }
 
+/**
+  * @brief This function handles CAN1 RX0 interrupt.
+  */
+void CAN1_RX0_IRQHandler(void)
+{
+  CanReceive(0);                                                    // move the frames in FIFO0 to the receive queue
+}
+
+/**
+  * @brief This function handles CAN1 RX1 interrupt.
+  */
+void CAN1_RX1_IRQHandler(void)
+{
+  CanReceive(1);                                                    // and FIFO1
+}
+
 /**
   * @brief This function handles USB On The Go FS global interrupt.
   */
@@ -21,6 +21,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc_if.h"
+#include "configuration.h"
 
 /* USER CODE BEGIN INCLUDE */
 
@@ -41,6 +42,7 @@ extern volatile int ConsoleTxBufTail;
 extern char BreakKey;                                          // defaults to CTRL-C.  Set to zero to disable the break function
 extern char *KeyInterrupt;
 extern volatile int Keycomplete;
+extern void IntPost(int src);
 extern int keyselect;
 extern volatile int MMAbort;
 extern char SerialConDisabled;
@@ -306,6 +308,7 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 				ConsoleRxBufHead = ConsoleRxBufTail;                    // empty the buffer
 			} else if(ConsoleRxBuf[ConsoleRxBufHead] ==keyselect && KeyInterrupt!=NULL){
 						Keycomplete=1;
+						IntPost(INT_KEY);
 			} else {
 				ConsoleRxBufHead = (ConsoleRxBufHead + 1) % CONSOLE_RX_BUF_SIZE;     // advance the head of the queue
 				if(ConsoleRxBufHead == ConsoleRxBufTail) {                           // if the buffer has overflowed
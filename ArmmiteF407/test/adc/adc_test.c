@@ -0,0 +1,170 @@
+/*
+ * Host test of the ADC STREAM double buffer in Src/ADCStream.c
+ *
+ * The buffer is set up the same way as ADC STREAM does (a multiple of twice the number of channels) and filled one
+ * tick at a time with synthetic samples the way ADCStreamISR() does, sample = tick * channels + channel.  The reader
+ * plays the part of ADC STREAM READ and ADCStreamService(): take the oldest full half, copy it and release it.
+ *
+ * On the F407 the interrupt runs to completion between any two steps of the reader, so the interleaving is simulated
+ * here with a pseudo random schedule rather than a second thread.  That lets the interrupt land between the Take, each
+ * sample copied and the Release, and it keeps the test repeatable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ADCStream.h"
+
+static int failed;
+
+#define CHECK(c) do { if(!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); failed = 1; return; } } while(0)
+
+// the synthetic sample for a tick and channel
+static uint16_t Sample(uint32_t tick, int nch, int ch) {
+    return (uint16_t)(tick * nch + ch);
+}
+
+// one TIM7 tick, returns what ADCStreamPut() returned
+static int Tick(struct s_adcstream *s, uint32_t tick, int nch) {
+    uint16_t v[3];
+    int i;
+    for(i = 0; i < nch; i++) v[i] = Sample(tick, nch, i);
+    return ADCStreamPut(s, v, nch);
+}
+
+static int HalfStartsAt(uint16_t *p, int n, uint32_t tick, int nch) {
+    int i;
+    for(i = 0; i < n; i++) if(p[i] != Sample(tick + i / nch, nch, i % nch)) return 0;
+    return 1;
+}
+
+
+// a reader that always keeps up, then one that falls behind, all without interruptions
+static void TestInOrder(int nch) {
+    int size = 8 * nch, ticks = size / 2 / nch, h, r, i;
+    uint16_t *buf = calloc(size, sizeof(uint16_t)), *p;
+    struct s_adcstream s = { .buf = buf, .size = size };
+    uint32_t t = 0;
+
+    CHECK(ADCStreamTake(&s, &h) == NULL);
+    for(i = 0; i < ticks - 1; i++) CHECK(Tick(&s, t++, nch) == 0);
+    CHECK(ADCStreamTake(&s, &h) == NULL);
+    CHECK(Tick(&s, t++, nch) == 1);                             // the first half is full
+    p = ADCStreamTake(&s, &h);
+    CHECK(p == buf && h == 0 && HalfStartsAt(p, size / 2, 0, nch));
+    ADCStreamRelease(&s, h);
+    CHECK(ADCStreamTake(&s, &h) == NULL);
+    for(i = 0; i < ticks - 1; i++) CHECK(Tick(&s, t++, nch) == 0);
+    CHECK(Tick(&s, t++, nch) == 2);                             // the second half is full and pos wraps
+    CHECK(s.pos == 0);
+    p = ADCStreamTake(&s, &h);
+    CHECK(p == buf + size / 2 && h == 1 && HalfStartsAt(p, size / 2, ticks, nch));
+    ADCStreamRelease(&s, h);
+    CHECK(s.overrun == 0 && s.count == 2 && ADCStreamTake(&s, &h) == NULL);
+
+    // both halves full, the older one must come first
+    for(i = 0; i < 2 * ticks; i++) Tick(&s, t++, nch);
+    CHECK(s.count == 4 && s.overrun == 0);
+    p = ADCStreamTake(&s, &h);
+    CHECK(h == 0 && HalfStartsAt(p, size / 2, 2 * ticks, nch));
+    ADCStreamRelease(&s, h);
+    for(i = 0; i < ticks; i++) Tick(&s, t++, nch);             // refill the first half, now it is the newer one
+    p = ADCStreamTake(&s, &h);
+    CHECK(h == 1 && HalfStartsAt(p, size / 2, 3 * ticks, nch));
+    ADCStreamRelease(&s, h);
+    p = ADCStreamTake(&s, &h);
+    CHECK(h == 0 && HalfStartsAt(p, size / 2, 4 * ticks, nch));
+    ADCStreamRelease(&s, h);
+    CHECK(s.overrun == 0 && s.count == 5);
+
+    // nobody reads for three buffers, every fill after the first two is an overrun
+    for(i = 0; i < 6 * ticks; i++) r = Tick(&s, t++, nch);
+    CHECK(r == 1 && s.overrun == 4 && s.count == 11);
+    Tick(&s, t++, nch);                                         // start to fill the second half again
+    CHECK(s.overrun == 5);
+    p = ADCStreamTake(&s, &h);                                  // so only the first half can be used
+    CHECK(h == 0 && HalfStartsAt(p, size / 2, t - 1 - ticks, nch));
+    CHECK(ADCStreamRelease(&s, h) == 0);
+    CHECK(ADCStreamTake(&s, &h) == NULL);
+
+    // the second half is refilled while it is being read
+    for(i = 0; i < ticks - 1; i++) Tick(&s, t++, nch);
+    p = ADCStreamTake(&s, &h);
+    CHECK(h == 1);
+    Tick(&s, t++, nch);
+    CHECK(s.overrun == 5);                                      // the first half was used so this is not an overrun
+    for(i = 0; i < ticks; i++) Tick(&s, t++, nch);
+    CHECK(s.overrun == 6);
+    CHECK(ADCStreamRelease(&s, h) == 1);
+    p = ADCStreamTake(&s, &h);                                  // the new samples are not lost by the late release
+    CHECK(h == 0 && HalfStartsAt(p, size / 2, t - 1 - ticks, nch));
+    ADCStreamRelease(&s, h);
+    CHECK(ADCStreamTake(&s, &h) == NULL);
+    free(buf);
+    printf("PASS in order, %d channel%s\n", nch, nch > 1 ? "s" : "");
+}
+
+
+// the interrupt lands anywhere in the reader, speed is how many reader steps it gets per tick on average
+static void TestInterleaved(int nch, int size, int speed, uint32_t ticks) {
+    uint16_t *buf = calloc(size, sizeof(uint16_t)), *p = NULL, *copy = calloc(size / 2, sizeof(uint16_t));
+    struct s_adcstream s = { .buf = buf, .size = size };
+    uint32_t t = 0, start[2] = { 0, 0 }, begun[2] = { 0, 0 }, before = 0, clean = 0, torn = 0, last = 0, gaps = 0;
+    uint32_t from = 0;
+    int h = 0, step = 0, i;
+    unsigned int r = 407;
+
+    while(t < ticks || step != 0 || ADCStreamTake(&s, &h) != NULL) {
+        r = r * 1103515245 + 12345;
+        if(t < ticks && (r >> 16) % (speed + 1) == 0) {         // the TIM7 interrupt
+            if(s.pos % (size / 2) == 0) {
+                start[s.pos != 0] = t;
+                begun[s.pos != 0]++;
+            }
+            Tick(&s, t++, nch);
+            continue;
+        }
+        if(step == 0) {                                         // ADC STREAM READ or ADCStreamService()
+            if((p = ADCStreamTake(&s, &h)) == NULL) continue;
+            before = begun[h];
+            from = start[h];
+            step = 1;
+        } else if(step <= size / 2) {
+            copy[step - 1] = p[step - 1];
+            step++;
+        } else {
+            i = ADCStreamRelease(&s, h);
+            step = 0;
+            CHECK(i == (begun[h] != before));                   // it knows when the half was being refilled
+            if(i) {
+                torn++;
+                continue;
+            }
+            CHECK(HalfStartsAt(copy, size / 2, from, nch));
+            CHECK(clean == 0 || from > last);                   // never older than the last one
+            if(clean && from != last + size / 2 / nch) gaps++;
+            last = from;
+            clean++;
+        }
+    }
+    // every half that was filled was either used or counted as an overrun
+    CHECK(s.count == clean + s.overrun);
+    CHECK(gaps <= s.overrun && torn <= s.overrun);
+    if(speed > 2 * nch) CHECK(s.overrun == 0 && gaps == 0);
+    printf("PASS interleaved: %d channel%s, %d samples, %u halves, %u used, %u overrun, %u torn\n",
+           nch, nch > 1 ? "s" : "", size, s.count, clean, s.overrun, torn);
+    free(buf);
+    free(copy);
+}
+
+
+int main(void) {
+    int nch;
+    for(nch = 1; nch <= 3; nch++) TestInOrder(nch);
+    for(nch = 1; nch <= 3; nch++) {
+        TestInterleaved(nch, 64 * nch, 100, 200000);            // the reader keeps up
+        TestInterleaved(nch, 64 * nch, 2 * nch, 200000);        // only just
+        TestInterleaved(nch, 4 * nch, 1, 200000);               // it cannot
+    }
+    return failed;
+}
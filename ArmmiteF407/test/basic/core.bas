@@ -0,0 +1,26 @@
+' Smoke test of the interpreter core, the expected output is in core.out
+DIM INTEGER i, t
+DIM a$(3) = ("one", "two", "three", "four")
+FOR i = 1 TO 10: t = t + i: NEXT
+PRINT t, 7 \ 2, 7 MOD 3, 2 ^ 10, &HFF, &B101, &O17
+PRINT UCASE$(a$(2)), LEN(a$(3)), INSTR("hello", "ll"), MID$("abcdef", 2, 3)
+i = 0
+DO WHILE i < 5: i = i + 1: LOOP
+PRINT i; Twice(i); " "; STR$(PI, 1, 4)
+SELECT CASE i
+  CASE 1 TO 4: PRINT "low"
+  CASE 5: PRINT "five"
+  CASE ELSE: PRINT "high"
+END SELECT
+GOSUB greet
+Show "done"
+END
+greet:
+  PRINT "gosub"
+  RETURN
+SUB Show(s$)
+  PRINT s$
+END SUB
+FUNCTION Twice(x)
+  Twice = x * 2
+END FUNCTION
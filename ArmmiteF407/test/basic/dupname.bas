@@ -0,0 +1,8 @@
+' FUNCTION f$ and FUNCTION f% have the same name so the program must not run
+PRINT f$(); f%()
+FUNCTION f$()
+  f$ = "str"
+END FUNCTION
+FUNCTION f%()
+  f% = 42
+END FUNCTION
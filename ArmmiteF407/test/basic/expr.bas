@@ -0,0 +1,96 @@
+' The compiled expressions in MMBasic.c (FindExpr() and RunExpr()) must give the same results as the interpreter
+' the expected output is in expr.out
+DIM INTEGER i, j, k, n, t
+DIM FLOAT f, g
+DIM STRING s, u
+i = 7: j = -3: f = 2.5: g = 0: s = "abc": u = "abd"
+
+' constants and constant sub expressions that are folded when compiled
+PRINT 2 * 3 + 4, 2 ^ 10, 7 \ 2, 10 MOD 3, 1 / 4, -3 * -2, (1 + 2) * (3 + 4)
+PRINT 1.5 + 2, 3 - 0.5, &HFF + &B101, 2 * PI, "ab" + "cd", (2 < 3) + (3 > 2)
+PRINT &H7FFFFFFFFFFFFFFF + 0, 4611686018427387904 * 2, 1E300 * 10 > 1E300
+ON ERROR SKIP: t = 1 \ 0: PRINT MM.ERRMSG$
+ON ERROR SKIP: f = 1 / 0: PRINT MM.ERRMSG$
+ON ERROR SKIP: t = 5 MOD 0: PRINT MM.ERRMSG$
+f = 2.5
+
+' unary operators on constants, variables and sub expressions
+PRINT -5, - -5, -i, - -i, -f, -(i + j), -2 ^ 2, -i * j
+PRINT NOT 0, NOT 3, NOT i, NOT g, NOT (i > j), NOT -1, NOT NOT i
+PRINT INV 0, INV 5, INV i, INV -i, INV f, INV (i + 1), -INV 0, NOT INV -1
+PRINT +i, +f, 3 - -i, 3 + -f, i - -j
+
+' mixed integers, floats and strings
+PRINT i + f, i * f, f - i, i / 2, i \ 2, f \ 1, i MOD 4, f MOD 2, i ^ 2, f ^ 2
+PRINT i + 1, i * 2, i - 10, f + 1, f * 2, f - 10, i = 7.0, f <> 2.5, i < f, j >= -3
+PRINT s + u, s = "abc", s <> u, s < u, s > u, s <= "abc", s >= "abd", LEN(s + u) * 2
+PRINT i AND 3, i OR 8, i XOR 5, f AND 3, i << 2, i >> 1, j >> 1, 1 << 40
+PRINT i + j * f, (i + j) * f, i * j + f / 2, i + LEN(s) * 2, MID$(s + u, i - 5, 3)
+
+' operators with the same precedence are applied from left to right
+PRINT 10 - 4 - 3, 100 / 10 / 5, 2 ^ 3 ^ 2, 8 \ 3 * 3, 7 MOD 4 * 2, 9 - 2 + 1, 24 / 2 * 3
+PRINT i - j - 1, i / 2 * f, i \ 2 * 2, f * 4 / 2, 1 < 2 = 1, 3 > 2 > 1, i = 7 = 1
+PRINT 1 OR 0 AND 0, (1 OR 0) AND 0, 5 + 3 << 1, 1 = 1 AND 2 = 2, NOT 1 = 2
+
+' too many codes to compile, this is evaluated by the interpreter
+t = 0
+FOR n = 1 TO 3
+  t = t + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i + n + i + i + i
+  f = n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f - n - f
+NEXT n
+PRINT t, f
+
+' more expressions than MAXEXPRCACHE (256) so the cache fills and is flushed each time around the loop
+' and Sum() compiles more while compiled code is running, those are left to the interpreter when the cache is full
+t = 0: f = 0
+FOR n = 1 TO 3
+  t = t + 1 * n: f = f + n / 2: t = t - (3 - n) \ 2: t = t + Sum(n, 4) + i: t = t + 5 * n: f = f + n / 6: t = t - (7 - n) \ 2: t = t + Sum(n, 8) + i
+  t = t + 9 * n: f = f + n / 10: t = t - (11 - n) \ 2: t = t + Sum(n, 12) + i: t = t + 13 * n: f = f + n / 14: t = t - (15 - n) \ 2: t = t + Sum(n, 16) + i
+  t = t + 17 * n: f = f + n / 18: t = t - (19 - n) \ 2: t = t + Sum(n, 20) + i: t = t + 21 * n: f = f + n / 22: t = t - (23 - n) \ 2: t = t + Sum(n, 24) + i
+  t = t + 25 * n: f = f + n / 26: t = t - (27 - n) \ 2: t = t + Sum(n, 28) + i: t = t + 29 * n: f = f + n / 30: t = t - (31 - n) \ 2: t = t + Sum(n, 32) + i
+  t = t + 33 * n: f = f + n / 34: t = t - (35 - n) \ 2: t = t + Sum(n, 36) + i: t = t + 37 * n: f = f + n / 38: t = t - (39 - n) \ 2: t = t + Sum(n, 40) + i
+  t = t + 41 * n: f = f + n / 42: t = t - (43 - n) \ 2: t = t + Sum(n, 44) + i: t = t + 45 * n: f = f + n / 46: t = t - (47 - n) \ 2: t = t + Sum(n, 48) + i
+  t = t + 49 * n: f = f + n / 50: t = t - (51 - n) \ 2: t = t + Sum(n, 52) + i: t = t + 53 * n: f = f + n / 54: t = t - (55 - n) \ 2: t = t + Sum(n, 56) + i
+  t = t + 57 * n: f = f + n / 58: t = t - (59 - n) \ 2: t = t + Sum(n, 60) + i: t = t + 61 * n: f = f + n / 62: t = t - (63 - n) \ 2: t = t + Sum(n, 64) + i
+  t = t + 65 * n: f = f + n / 66: t = t - (67 - n) \ 2: t = t + Sum(n, 68) + i: t = t + 69 * n: f = f + n / 70: t = t - (71 - n) \ 2: t = t + Sum(n, 72) + i
+  t = t + 73 * n: f = f + n / 74: t = t - (75 - n) \ 2: t = t + Sum(n, 76) + i: t = t + 77 * n: f = f + n / 78: t = t - (79 - n) \ 2: t = t + Sum(n, 80) + i
+  t = t + 81 * n: f = f + n / 82: t = t - (83 - n) \ 2: t = t + Sum(n, 84) + i: t = t + 85 * n: f = f + n / 86: t = t - (87 - n) \ 2: t = t + Sum(n, 88) + i
+  t = t + 89 * n: f = f + n / 90: t = t - (91 - n) \ 2: t = t + Sum(n, 92) + i: t = t + 93 * n: f = f + n / 94: t = t - (95 - n) \ 2: t = t + Sum(n, 96) + i
+  t = t + 97 * n: f = f + n / 98: t = t - (99 - n) \ 2: t = t + Sum(n, 100) + i: t = t + 101 * n: f = f + n / 102: t = t - (103 - n) \ 2: t = t + Sum(n, 104) + i
+  t = t + 105 * n: f = f + n / 106: t = t - (107 - n) \ 2: t = t + Sum(n, 108) + i: t = t + 109 * n: f = f + n / 110: t = t - (111 - n) \ 2: t = t + Sum(n, 112) + i
+  t = t + 113 * n: f = f + n / 114: t = t - (115 - n) \ 2: t = t + Sum(n, 116) + i: t = t + 117 * n: f = f + n / 118: t = t - (119 - n) \ 2: t = t + Sum(n, 120) + i
+  t = t + 121 * n: f = f + n / 122: t = t - (123 - n) \ 2: t = t + Sum(n, 124) + i: t = t + 125 * n: f = f + n / 126: t = t - (127 - n) \ 2: t = t + Sum(n, 128) + i
+  t = t + 129 * n: f = f + n / 130: t = t - (131 - n) \ 2: t = t + Sum(n, 132) + i: t = t + 133 * n: f = f + n / 134: t = t - (135 - n) \ 2: t = t + Sum(n, 136) + i
+  t = t + 137 * n: f = f + n / 138: t = t - (139 - n) \ 2: t = t + Sum(n, 140) + i: t = t + 141 * n: f = f + n / 142: t = t - (143 - n) \ 2: t = t + Sum(n, 144) + i
+  t = t + 145 * n: f = f + n / 146: t = t - (147 - n) \ 2: t = t + Sum(n, 148) + i: t = t + 149 * n: f = f + n / 150: t = t - (151 - n) \ 2: t = t + Sum(n, 152) + i
+  t = t + 153 * n: f = f + n / 154: t = t - (155 - n) \ 2: t = t + Sum(n, 156) + i: t = t + 157 * n: f = f + n / 158: t = t - (159 - n) \ 2: t = t + Sum(n, 160) + i
+  t = t + 161 * n: f = f + n / 162: t = t - (163 - n) \ 2: t = t + Sum(n, 164) + i: t = t + 165 * n: f = f + n / 166: t = t - (167 - n) \ 2: t = t + Sum(n, 168) + i
+  t = t + 169 * n: f = f + n / 170: t = t - (171 - n) \ 2: t = t + Sum(n, 172) + i: t = t + 173 * n: f = f + n / 174: t = t - (175 - n) \ 2: t = t + Sum(n, 176) + i
+  t = t + 177 * n: f = f + n / 178: t = t - (179 - n) \ 2: t = t + Sum(n, 180) + i: t = t + 181 * n: f = f + n / 182: t = t - (183 - n) \ 2: t = t + Sum(n, 184) + i
+  t = t + 185 * n: f = f + n / 186: t = t - (187 - n) \ 2: t = t + Sum(n, 188) + i: t = t + 189 * n: f = f + n / 190: t = t - (191 - n) \ 2: t = t + Sum(n, 192) + i
+  t = t + 193 * n: f = f + n / 194: t = t - (195 - n) \ 2: t = t + Sum(n, 196) + i: t = t + 197 * n: f = f + n / 198: t = t - (199 - n) \ 2: t = t + Sum(n, 200) + i
+  t = t + 201 * n: f = f + n / 202: t = t - (203 - n) \ 2: t = t + Sum(n, 204) + i: t = t + 205 * n: f = f + n / 206: t = t - (207 - n) \ 2: t = t + Sum(n, 208) + i
+  t = t + 209 * n: f = f + n / 210: t = t - (211 - n) \ 2: t = t + Sum(n, 212) + i: t = t + 213 * n: f = f + n / 214: t = t - (215 - n) \ 2: t = t + Sum(n, 216) + i
+  t = t + 217 * n: f = f + n / 218: t = t - (219 - n) \ 2: t = t + Sum(n, 220) + i: t = t + 221 * n: f = f + n / 222: t = t - (223 - n) \ 2: t = t + Sum(n, 224) + i
+  t = t + 225 * n: f = f + n / 226: t = t - (227 - n) \ 2: t = t + Sum(n, 228) + i: t = t + 229 * n: f = f + n / 230: t = t - (231 - n) \ 2: t = t + Sum(n, 232) + i
+  t = t + 233 * n: f = f + n / 234: t = t - (235 - n) \ 2: t = t + Sum(n, 236) + i: t = t + 237 * n: f = f + n / 238: t = t - (239 - n) \ 2: t = t + Sum(n, 240) + i
+  t = t + 241 * n: f = f + n / 242: t = t - (243 - n) \ 2: t = t + Sum(n, 244) + i: t = t + 245 * n: f = f + n / 246: t = t - (247 - n) \ 2: t = t + Sum(n, 248) + i
+  t = t + 249 * n: f = f + n / 250: t = t - (251 - n) \ 2: t = t + Sum(n, 252) + i: t = t + 253 * n: f = f + n / 254: t = t - (255 - n) \ 2: t = t + Sum(n, 256) + i
+  t = t + 257 * n: f = f + n / 258: t = t - (259 - n) \ 2: t = t + Sum(n, 260) + i: t = t + 261 * n: f = f + n / 262: t = t - (263 - n) \ 2: t = t + Sum(n, 264) + i
+  t = t + 265 * n: f = f + n / 266: t = t - (267 - n) \ 2: t = t + Sum(n, 268) + i: t = t + 269 * n: f = f + n / 270: t = t - (271 - n) \ 2: t = t + Sum(n, 272) + i
+  t = t + 273 * n: f = f + n / 274: t = t - (275 - n) \ 2: t = t + Sum(n, 276) + i: t = t + 277 * n: f = f + n / 278: t = t - (279 - n) \ 2: t = t + Sum(n, 280) + i
+  t = t + 281 * n: f = f + n / 282: t = t - (283 - n) \ 2: t = t + Sum(n, 284) + i: t = t + 285 * n: f = f + n / 286: t = t - (287 - n) \ 2: t = t + Sum(n, 288) + i
+  t = t + 289 * n: f = f + n / 290: t = t - (291 - n) \ 2: t = t + Sum(n, 292) + i: t = t + 293 * n: f = f + n / 294: t = t - (295 - n) \ 2: t = t + Sum(n, 296) + i
+  t = t + 297 * n: f = f + n / 298: t = t - (299 - n) \ 2: t = t + Sum(n, 300) + i: t = t + 301 * n: f = f + n / 302: t = t - (303 - n) \ 2: t = t + Sum(n, 304) + i
+  t = t + 305 * n: f = f + n / 306: t = t - (307 - n) \ 2: t = t + Sum(n, 308) + i: t = t + 309 * n: f = f + n / 310: t = t - (311 - n) \ 2: t = t + Sum(n, 312) + i
+  t = t + 313 * n: f = f + n / 314: t = t - (315 - n) \ 2: t = t + Sum(n, 316) + i: t = t + 317 * n: f = f + n / 318: t = t - (319 - n) \ 2: t = t + Sum(n, 320) + i
+NEXT n
+PRINT t, f
+
+FUNCTION Sum(a, b)
+  LOCAL INTEGER x
+  x = a * b + 1: x = x - a: x = x + b * 2 - 3: x = (x + a) \ 2: x = x + 1 - a: x = x * 2 - b
+  x = x \ 3 + a: x = x - b \ 4: x = x + (a - b) * 2: x = x - 5: x = x + a * a: x = x - b \ 7
+  x = x + 6 \ a: x = (x - b) \ 2: x = x + a - 1: x = x - (b \ 3): x = x * 3 \ 2: x = x - a - 2
+  Sum = x + a - b
+END FUNCTION
@@ -0,0 +1,15 @@
+' LONGSTRING REPLACE growing, shrinking and failing, the expected output is in longstring.out
+DIM INTEGER a(5), b(1)
+LONGSTRING APPEND a(), "one two one two one"
+LONGSTRING REPLACE a(), "one", "three"
+PRINT LGETSTR$(a(), 1, LLEN(a())); LLEN(a())
+LONGSTRING REPLACE a(), "THREE", "1", 1
+PRINT LGETSTR$(a(), 1, LLEN(a())); LLEN(a())
+' b() holds 8 chars so this cannot fit and must leave b() as it was
+LONGSTRING APPEND b(), "ab ab ab"
+ON ERROR SKIP
+LONGSTRING REPLACE b(), "ab", "abcd"
+PRINT MM.ERRMSG$
+PRINT LGETSTR$(b(), 1, LLEN(b())); LLEN(b())
+LONGSTRING REPLACE b(), "ab", "x"
+PRINT LGETSTR$(b(), 1, LLEN(b())); LLEN(b())
@@ -0,0 +1,36 @@
+' PROFILE hit counts for a known loop, the times vary so only the counts are printed
+DIM l$(20)
+PROFILE ON
+FOR i = 1 TO 10
+  a = a + i
+NEXT i
+Inner 4
+Inner 6
+PROFILE OFF
+a = a + 1
+OPEN "prof.txt" FOR OUTPUT AS #1
+PROFILE LIST 20, #1
+CLOSE #1
+OPEN "prof.txt" FOR INPUT AS #1
+LINE INPUT #1, s$
+n = 0
+DO
+  LINE INPUT #1, s$
+  IF s$ = "" THEN EXIT DO
+  l$(n) = LEFT$(s$, 31)
+  n = n + 1
+LOOP
+SORT l$(), , , 0, n
+FOR i = 0 TO n - 1 : PRINT l$(i) : NEXT i
+DO WHILE NOT EOF(#1)
+  LINE INPUT #1, s$
+  PRINT LEFT$(s$, 31)
+LOOP
+CLOSE #1
+PRINT a
+
+SUB Inner n
+  LOCAL j
+  FOR j = 1 TO n
+  NEXT j
+END SUB
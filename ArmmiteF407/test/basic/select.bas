@@ -0,0 +1,33 @@
+' SELECT CASE with constant tables, the expected output is in select.out
+OPTION EXPLICIT
+DIM INTEGER i, n
+DIM t$(3)
+FOR i = 0 TO 9
+  SELECT CASE i
+    CASE &B11, &O7: PRINT i; " bin/oct"
+    CASE &H2, 5, 8: PRINT i; " list"
+    CASE 4 TO 6: PRINT i; " range"
+    CASE ELSE: PRINT i; " else"
+  END SELECT
+NEXT i
+' a string with a backslash changes meaning when OPTION ESCAPE is turned on
+t$(1) = "a\tb" : t$(2) = "a" + CHR$(9) + "b" : t$(3) = "plain"
+FOR n = 1 TO 2
+  IF n = 2 THEN OPTION ESCAPE
+  FOR i = 1 TO 3
+    SELECT CASE t$(i)
+      CASE "a\tb": PRINT n; i; " backslash"
+      CASE "plain": PRINT n; i; " plain"
+      CASE ELSE: PRINT n; i; " else"
+    END SELECT
+  NEXT i
+NEXT n
+' a constant with a digit outside its radix is only an error if the CASE is reached
+FOR i = 1 TO 2
+  ON ERROR SKIP 4
+  SELECT CASE i
+    CASE 1, &H1F: PRINT i; " one"
+    CASE &O9, 5: PRINT i; " wrong"
+  END SELECT
+  PRINT i; MM.ERRNO <> 0
+NEXT i
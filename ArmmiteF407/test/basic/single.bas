@@ -0,0 +1,52 @@
+' MATH SINGLE: float32 values packed two to an integer element, checked against the same operations on FLOAT arrays
+DIM INTEGER i, n = 999
+DIM FLOAT x(n), y(n), d(n), e, m
+DIM INTEGER p(n \ 2), q(n \ 2), r(n \ 2)
+
+' values that are exact in single precision give the same results as the double path
+DIM FLOAT a(9), b(9)
+DIM INTEGER pa(4), pb(4)
+FOR i = 0 TO 9: a(i) = i * 1.5 - 4: NEXT i
+MATH SINGLE PACK a(), pa()
+MATH SINGLE SCALE pa(), 2, pb()
+MATH SINGLE ADD pb(), 0.5, pb()
+MATH SINGLE C_MUL pa(), pb(), pb()
+MATH SINGLE C_SUB pb(), pa(), pb()
+MATH SINGLE UNPACK pb(), b()
+FOR i = 0 TO 9: PRINT b(i);: NEXT i: PRINT
+PRINT MATH(SINGLE SUM pa()), MATH(SUM a()), MATH(SINGLE DOTPRODUCT pa(), pa()), MATH(DOTPRODUCT a(), a())
+
+' a thousand values that are not exact, the error must stay within float32 rounding
+FOR i = 0 TO n: x(i) = SIN(i / 7) * 100 + i / 3: NEXT i
+MATH SINGLE PACK x(), p()
+MATH SINGLE SCALE p(), 1.7, q()
+MATH SINGLE C_ADD p(), q(), r()
+MATH SINGLE C_DIV r(), p(), r()
+MATH SINGLE UNPACK r(), y()
+MATH SCALE x(), 1.7, d()
+MATH C_ADD x(), d(), d()
+MATH C_DIV d(), x(), d()
+m = 0
+FOR i = 0 TO n: e = ABS(y(i) - d(i)) / ABS(d(i)): IF e > m THEN m = e
+NEXT i
+PRINT "elementwise relative error < 1E-6: "; m < 1E-6
+e = ABS(MATH(SINGLE SUM p()) - MATH(SUM x())) / ABS(MATH(SUM x()))
+PRINT "sum relative error < 1E-6: "; e < 1E-6
+e = ABS(MATH(SINGLE DOTPRODUCT p(), q()) - MATH(DOTPRODUCT x(), x()) * 1.7) / (MATH(DOTPRODUCT x(), x()) * 1.7)
+PRINT "dot product relative error < 1E-6: "; e < 1E-6
+
+' an odd number of values leaves the last half element unused
+DIM FLOAT o(4), o2(4)
+DIM INTEGER po(2)
+FOR i = 0 TO 4: o(i) = i + 0.25: NEXT i
+MATH SINGLE PACK o(), po()
+MATH SINGLE UNPACK po(), o2()
+FOR i = 0 TO 4: PRINT o2(i);: NEXT i: PRINT
+PRINT MATH(SINGLE SUM po())
+
+ON ERROR SKIP: MATH SINGLE PACK x(), pa(): PRINT MM.ERRMSG$
+ON ERROR SKIP: MATH SINGLE C_ADD pa(), p(), pa(): PRINT MM.ERRMSG$
+ON ERROR SKIP: MATH SINGLE SCALE x(), 2, p(): PRINT MM.ERRMSG$
+ON ERROR SKIP: MATH SINGLE FFT p(), q(): PRINT MM.ERRMSG$
+ON ERROR SKIP: e = MATH(SINGLE MEAN p()): PRINT MM.ERRMSG$
+ON ERROR CLEAR
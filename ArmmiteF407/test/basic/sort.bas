@@ -0,0 +1,35 @@
+' SORT: ordering, stability (equal elements keep their order in the index array) and the flags
+DIM INTEGER i, k(9), idx(9)
+DIM FLOAT f(9)
+DIM STRING s$(9) LENGTH 8
+DATA 5, 3, 9, 3, 1, 5, 7, 3, 0, 5
+FOR i = 0 TO 9: READ k(i): f(i) = k(i) / 2: NEXT
+SORT k(), idx()
+FOR i = 0 TO 9: PRINT k(i); "/"; idx(i);: NEXT: PRINT
+SORT f(), idx(), 1
+FOR i = 0 TO 9: PRINT f(i); "/"; idx(i);: NEXT: PRINT
+DATA "b", "A", "", "a", "c", "B", "", "a", "C", "b"
+FOR i = 0 TO 9: READ s$(i): NEXT
+SORT s$(), idx(), 2
+FOR i = 0 TO 9: PRINT "["; s$(i); "]"; idx(i);: NEXT: PRINT
+RESTORE
+FOR i = 0 TO 9: READ k(i): NEXT
+FOR i = 0 TO 9: READ s$(i): NEXT
+SORT s$(), idx(), 4 + 2
+FOR i = 0 TO 9: PRINT "["; s$(i); "]"; idx(i);: NEXT: PRINT
+' secondary key: order by k() within equal strings
+SORT s$(), idx(), 0, , , k()
+FOR i = 0 TO 9: PRINT "["; s$(i); "]"; idx(i);: NEXT: PRINT
+' part of an array
+FOR i = 0 TO 9: k(i) = 9 - i: NEXT
+SORT k(), , , 2, 5
+FOR i = 0 TO 9: PRINT k(i);: NEXT: PRINT
+' a larger array, check the order and that equal keys stay in their original order
+DIM INTEGER big(4999), bidx(4999), ok = 1
+FOR i = 0 TO 4999: big(i) = (i * 7919) MOD 101: NEXT
+SORT big(), bidx()
+FOR i = 1 TO 4999
+  IF big(i) < big(i - 1) THEN ok = 0
+  IF big(i) = big(i - 1) AND bidx(i) < bidx(i - 1) THEN ok = 0
+NEXT
+PRINT "big"; ok
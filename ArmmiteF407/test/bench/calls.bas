@@ -0,0 +1,54 @@
+' SUB and FUNCTION call rate with a handful of scalar arguments, plus a recursive FUNCTION
+' The counts suit the host build, divide Scale by about 50 on the board
+OPTION EXPLICIT
+CONST Scale = 200000
+DIM INTEGER i, n
+DIM FLOAT t, f
+
+t = TIMER
+FOR i = 1 TO Scale: Nothing: NEXT i
+Report "SUB calls, no arguments", Scale, t
+
+t = TIMER
+FOR i = 1 TO Scale: Three i, 2.5, "s": NEXT i
+Report "SUB calls, 3 arguments", Scale, t
+
+t = TIMER
+FOR i = 1 TO Scale: n = Add(i, 1): NEXT i
+Report "FUNCTION calls, 2 arguments", Scale, t
+
+t = TIMER
+FOR i = 1 TO Scale: f = Mix(i, 2, 3.5, 4.5): NEXT i
+Report "FUNCTION calls, 4 arguments", Scale, t
+
+t = TIMER
+n = Fib(20)
+Report "recursive FUNCTION calls", 21891, t
+
+SUB Nothing
+END SUB
+
+SUB Three(a AS INTEGER, b AS FLOAT, c AS STRING)
+END SUB
+
+FUNCTION Add(a AS INTEGER, b AS INTEGER) AS INTEGER
+  Add = a + b
+END FUNCTION
+
+FUNCTION Mix(a AS INTEGER, b AS INTEGER, c AS FLOAT, d AS FLOAT) AS FLOAT
+  Mix = a * c + b * d
+END FUNCTION
+
+' Fib(20) makes 21891 calls
+FUNCTION Fib(x AS INTEGER) AS INTEGER
+  IF x < 2 THEN
+    Fib = x
+  ELSE
+    Fib = Fib(x - 1) + Fib(x - 2)
+  ENDIF
+END FUNCTION
+
+SUB Report what$, count AS INTEGER, start
+  LOCAL FLOAT ms = TIMER - start
+  PRINT what$; ":"; count; " in "; STR$(ms, 0, 1); " mS ="; INT(count / ms * 1000); "/sec"
+END SUB
@@ -0,0 +1,51 @@
+' File throughput: CSV lines written with PRINT # and read back with LINE INPUT # and INPUT #
+' In the host build the SD card is a RAM disk so this measures the interpreter and FatFs, not the card
+OPTION EXPLICIT
+CONST Lines = 100000
+DIM INTEGER i, n, bytes
+DIM FLOAT t, a, b
+DIM STRING s$
+
+t = TIMER
+OPEN "bench.csv" FOR OUTPUT AS #1
+FOR i = 1 TO Lines
+  PRINT #1, i; ","; i * 3; ","; "sensor"
+NEXT i
+CLOSE #1
+Report "PRINT # lines", Lines, t
+
+t = TIMER
+OPEN "bench.csv" FOR INPUT AS #1
+bytes = LOF(#1)
+n = 0
+DO WHILE NOT EOF(#1)
+  LINE INPUT #1, s$
+  n = n + 1
+LOOP
+CLOSE #1
+IF n <> Lines THEN ERROR "read" + STR$(n) + " lines"
+Report "LINE INPUT # lines", Lines, t
+
+t = TIMER
+OPEN "bench.csv" FOR INPUT AS #1
+FOR i = 1 TO Lines
+  INPUT #1, a, b, s$
+NEXT i
+CLOSE #1
+IF a <> Lines OR b <> Lines * 3 THEN ERROR "wrong data"
+Report "INPUT # lines", Lines, t
+
+t = TIMER
+OPEN "bench.csv" FOR APPEND AS #1
+FOR i = 1 TO Lines
+  PRINT #1, "x";
+NEXT i
+CLOSE #1
+Report "single character PRINT #", Lines, t
+PRINT "file size"; bytes; " bytes"
+KILL "bench.csv"
+
+SUB Report what$, count AS INTEGER, start
+  LOCAL FLOAT ms = TIMER - start
+  PRINT what$; ":"; count; " in "; STR$(ms, 0, 1); " mS ="; INT(count / ms * 1000); "/sec"
+END SUB
@@ -0,0 +1,55 @@
+' FOR/NEXT and DO/LOOP throughput, the loops are entered many times from inside a SUB so that the cost of
+' finding the matching NEXT/LOOP on entry shows up as well as the cost of each iteration
+' The counts suit the host build, divide Scale by about 50 on the board
+OPTION EXPLICIT
+CONST Scale = 1000000
+DIM INTEGER i, n
+DIM FLOAT t
+
+t = TIMER
+FOR i = 1 TO Scale: n = n + 1: NEXT i
+Report "FOR/NEXT iterations", Scale, t
+
+t = TIMER
+i = 0
+DO WHILE i < Scale: i = i + 1: LOOP
+Report "DO/LOOP iterations", Scale, t
+
+t = TIMER
+FOR i = 1 TO Scale / 10: Inner: NEXT i
+Report "FOR entries in a SUB", Scale / 10, t
+
+t = TIMER
+FOR i = 1 TO Scale / 10: InnerDo: NEXT i
+Report "DO entries in a SUB", Scale / 10, t
+
+SUB Inner
+  LOCAL INTEGER j
+  ' skip over a long loop body so that a scan for NEXT has something to do
+  FOR j = 1 TO 3
+    IF j = 0 THEN
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+    ENDIF
+  NEXT j
+END SUB
+
+SUB InnerDo
+  LOCAL INTEGER j
+  DO
+    j = j + 1
+    IF j = 0 THEN
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+      PRINT "never": PRINT "never": PRINT "never": PRINT "never": PRINT "never"
+    ENDIF
+  LOOP UNTIL j >= 3
+END SUB
+
+SUB Report what$, count AS INTEGER, start
+  LOCAL FLOAT ms = TIMER - start
+  PRINT what$; ":"; count; " in "; STR$(ms, 0, 1); " mS ="; INT(count / ms * 1000); "/sec"
+END SUB
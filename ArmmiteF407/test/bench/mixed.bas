@@ -0,0 +1,32 @@
+' A mixed workload for comparing interpreter changes: arithmetic, strings, arrays and SUB/FUNCTION calls.
+' Run with "make bench" in test/host, which reports the statements/sec and the heap high water mark.
+OPTION EXPLICIT
+DIM INTEGER i, j, n
+DIM FLOAT f, a(99)
+DIM STRING s
+
+FOR i = 1 TO 20000
+  f = f + SQR(i) * 1.5 - i / 3
+  n = n + (i MOD 7) * 2
+  IF i AND 1 THEN n = n + 1 ELSE n = n - 1
+NEXT i
+
+FOR j = 1 TO 200
+  s = ""
+  FOR i = 1 TO 20
+    s = s + CHR$(65 + (i + j) MOD 26)
+  NEXT i
+  IF LEFT$(s, 1) = "Z" THEN n = n + LEN(s)
+NEXT j
+
+FOR j = 1 TO 100
+  FOR i = 0 TO 99
+    a(i) = Scale(i, j)
+  NEXT i
+NEXT j
+
+PRINT "mixed:"; n; " "; STR$(f, 0, 2); " "; STR$(a(99), 0, 2)
+
+FUNCTION Scale(x AS INTEGER, y AS INTEGER) AS FLOAT
+  Scale = x * y / 10
+END FUNCTION
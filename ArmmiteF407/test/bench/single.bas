@@ -0,0 +1,53 @@
+' MATH SINGLE (float32 packed in integer arrays) against the same MATH operations on FLOAT (MMFLOAT) arrays
+' On the board MMFLOAT is done by the soft float library and MATH SINGLE by the FPU, on the host both are hardware
+' so this mostly shows the cost of the interpreter around each kernel.  The counts suit the host build, divide Scale
+' by about 50 on the board
+OPTION EXPLICIT
+CONST Scale = 50000
+CONST N = 2000
+DIM INTEGER i
+DIM FLOAT x(N - 1), y(N - 1), d(N - 1), t, s1, s2
+DIM INTEGER p(N / 2 - 1), q(N / 2 - 1)
+
+FOR i = 0 TO N - 1: x(i) = SIN(i / 7) * 100 + i / 3 + 200: NEXT i
+MATH SINGLE PACK x(), p()
+
+t = TIMER
+FOR i = 1 TO Scale: MATH SCALE x(), 1.7, d(): NEXT i
+Report "MATH SCALE FLOAT", t
+t = TIMER
+FOR i = 1 TO Scale: MATH SINGLE SCALE p(), 1.7, q(): NEXT i
+Report "MATH SINGLE SCALE", t
+MATH SINGLE UNPACK q(), y()
+ShowError "MATH SINGLE SCALE"
+
+t = TIMER
+FOR i = 1 TO Scale: MATH C_MUL x(), d(), d(): MATH SCALE x(), 1.7, d(): NEXT i
+Report "MATH C_MUL FLOAT", t
+t = TIMER
+FOR i = 1 TO Scale: MATH SINGLE C_MUL p(), q(), q(): MATH SINGLE SCALE p(), 1.7, q(): NEXT i
+Report "MATH SINGLE C_MUL", t
+
+t = TIMER
+FOR i = 1 TO Scale: s1 = MATH(DOTPRODUCT x(), d()): NEXT i
+Report "MATH(DOTPRODUCT) FLOAT", t
+t = TIMER
+FOR i = 1 TO Scale: s2 = MATH(SINGLE DOTPRODUCT p(), q()): NEXT i
+Report "MATH(SINGLE DOTPRODUCT)", t
+PRINT "MATH(SINGLE DOTPRODUCT) relative error "; STR$(ABS(s2 - s1) / ABS(s1), 0, -3)
+
+SUB Report what$, start
+  LOCAL FLOAT ms = TIMER - start
+  PRINT what$; ":"; Scale * N; " elements in "; STR$(ms, 0, 1); " mS ="; INT(Scale * N / ms * 1000); "/sec"
+END SUB
+
+' the largest relative difference between y() and d()
+SUB ShowError what$
+  LOCAL INTEGER j
+  LOCAL FLOAT m, r
+  FOR j = 0 TO N - 1
+    r = ABS(y(j) - d(j)) / ABS(d(j))
+    IF r > m THEN m = r
+  NEXT j
+  PRINT what$; " largest relative error "; STR$(m, 0, -3)
+END SUB
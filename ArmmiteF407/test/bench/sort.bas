@@ -0,0 +1,64 @@
+' SORT of random integer, float and string arrays, each size is sorted several times with fresh data
+' The heap is about 115KB (less the interpreter's caches) so 8,000 numbers or 5,000 short strings is about the
+' most that fits, 10,000 numbers or more will not
+OPTION EXPLICIT
+DIM INTEGER i
+DIM FLOAT t, total
+
+SortInts 1000, 50
+SortInts 8000, 5
+SortFloats 1000, 50
+SortFloats 8000, 5
+SortStrings 1000, 20
+SortStrings 5000, 4
+
+SUB SortInts n AS INTEGER, reps AS INTEGER
+  LOCAL INTEGER a(n - 1), i, r
+  total = 0
+  FOR r = 1 TO reps
+    FOR i = 0 TO n - 1: a(i) = INT(RND * 1000000): NEXT
+    t = TIMER
+    SORT a()
+    total = total + TIMER - t
+    FOR i = 1 TO n - 1: IF a(i) < a(i - 1) THEN ERROR "not sorted"
+    NEXT
+  NEXT
+  Report "integers", n, reps
+END SUB
+
+SUB SortFloats n AS INTEGER, reps AS INTEGER
+  LOCAL FLOAT a(n - 1)
+  LOCAL INTEGER i, r
+  total = 0
+  FOR r = 1 TO reps
+    FOR i = 0 TO n - 1: a(i) = RND * 1000: NEXT
+    t = TIMER
+    SORT a(), , 1
+    total = total + TIMER - t
+    FOR i = 1 TO n - 1: IF a(i) > a(i - 1) THEN ERROR "not sorted"
+    NEXT
+  NEXT
+  Report "floats (descending)", n, reps
+END SUB
+
+SUB SortStrings n AS INTEGER, reps AS INTEGER
+  LOCAL STRING a(n - 1) LENGTH 6
+  LOCAL INTEGER i, j, r
+  total = 0
+  FOR r = 1 TO reps
+    FOR i = 0 TO n - 1
+      a(i) = ""
+      FOR j = 1 TO 6: a(i) = a(i) + CHR$(65 + INT(RND * 26)): NEXT
+    NEXT
+    t = TIMER
+    SORT a()
+    total = total + TIMER - t
+    FOR i = 1 TO n - 1: IF a(i) < a(i - 1) THEN ERROR "not sorted"
+    NEXT
+  NEXT
+  Report "strings", n, reps
+END SUB
+
+SUB Report what$, n AS INTEGER, reps AS INTEGER
+  PRINT "SORT"; n; " "; what$; ": "; STR$(total / reps, 0, 2); " mS each ="; INT(n * reps / total * 1000); "/sec"
+END SUB
@@ -0,0 +1,44 @@
+' Variable access in hot loops: global and local scalars among many other variables, and array elements
+' The counts suit the host build, divide Scale by about 50 on the board
+OPTION EXPLICIT
+CONST Scale = 300000
+DIM INTEGER i, n, alpha, beta, gamma, delta, epsilon
+DIM FLOAT x, y, z, total
+DIM STRING s$
+DIM INTEGER a(99)
+DIM FLOAT t
+' a crowd of other variables so that the lookups have a realistic table to search
+DIM INTEGER v01, v02, v03, v04, v05, v06, v07, v08, v09, v10, v11, v12, v13, v14, v15, v16
+DIM FLOAT f01, f02, f03, f04, f05, f06, f07, f08, f09, f10, f11, f12, f13, f14, f15, f16
+
+t = TIMER
+FOR i = 1 TO Scale
+  alpha = beta + gamma
+  delta = epsilon + alpha
+  x = y * z + total
+NEXT i
+Report "global scalar statements", Scale * 3, t
+
+t = TIMER
+FOR i = 1 TO Scale / 10: Locals: NEXT i
+Report "local scalar statements", Scale * 3, t
+
+t = TIMER
+FOR i = 1 TO Scale
+  a(i MOD 100) = a((i + 1) MOD 100) + 1
+NEXT i
+Report "array element statements", Scale, t
+
+SUB Locals
+  LOCAL INTEGER j, p, q, r
+  FOR j = 1 TO 10
+    p = q + r
+    q = p + j
+    r = r + 1
+  NEXT j
+END SUB
+
+SUB Report what$, count AS INTEGER, start
+  LOCAL FLOAT ms = TIMER - start
+  PRINT what$; ":"; count; " in "; STR$(ms, 0, 1); " mS ="; INT(count / ms * 1000); "/sec"
+END SUB
@@ -0,0 +1,150 @@
+/*
+ * Host test of the CAN receive queue in Src/CanQueue.c
+ *
+ * The queue is created the same way as CanQueueOpen() in CAN.c does.  A thread plays the part of the receive ISR
+ * (CanReceive() calls CanQueuePut() for each frame in the hardware FIFO) and the main thread plays CAN READ.  Each
+ * frame carries a sequence number so the reader can check that frames arrive once, in order and intact, and that
+ * every frame which did not arrive was counted as an overflow.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include "CanQueue.h"
+
+static int failed;
+
+#define CHECK(c) do { if(!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); failed = 1; return; } } while(0)
+
+// the same allocation as CanQueueOpen()
+static struct s_canqueue *NewQueue(int depth) {
+    struct s_canqueue *q = calloc(1, sizeof(struct s_canqueue) + (depth + 1) * sizeof(struct s_canframe));
+    q->size = depth + 1;
+    return q;
+}
+
+// a simulated frame, everything in it is derived from its sequence number
+static void MakeFrame(struct s_canframe *f, uint32_t n) {
+    int i;
+    memset(f, 0, sizeof(*f));
+    f->eid = n & 1;
+    f->id = f->eid ? (n & 0x1fffffff) : (n & 0x7ff);
+    f->timestamp = n;
+    f->rtr = (n % 7) == 0;
+    f->dlc = f->rtr ? 0 : n % 9;
+    f->fmi = n % 28;
+    for(i = 0; i < 8; i++) f->data[i] = n >> ((i & 3) * 8);
+}
+
+static int SameFrame(struct s_canframe *a, struct s_canframe *b) {
+    return a->id == b->id && a->eid == b->eid && a->rtr == b->rtr && a->dlc == b->dlc && a->fmi == b->fmi &&
+           a->timestamp == b->timestamp && memcmp(a->data, b->data, 8) == 0;
+}
+
+
+// empty, full and wrapping around, all from one thread
+static void TestSingle(void) {
+    struct s_canqueue *q = NewQueue(5);
+    struct s_canframe f, g;
+    uint32_t put = 0, got = 0;
+    int i, round;
+
+    CHECK(CanQueueCount(q) == 0);
+    CHECK(!CanQueueGet(q, &g));
+    for(i = 0; i < 5; i++) { MakeFrame(&f, put++); CHECK(CanQueuePut(q, &f)); }
+    CHECK(CanQueueCount(q) == 5);
+    MakeFrame(&f, 999);
+    CHECK(!CanQueuePut(q, &f));                                 // the depth is 5, one entry is always left empty
+    CHECK(q->overflow == 1);
+    CHECK(CanQueueCount(q) == 5);
+    for(i = 0; i < 5; i++) { CHECK(CanQueueGet(q, &g)); MakeFrame(&f, got++); CHECK(SameFrame(&f, &g)); }
+    CHECK(!CanQueueGet(q, &g));
+
+    // put 3 and take 2 so that the head and tail go round many times at different offsets
+    for(round = 0; round < 100; round++) {
+        for(i = 0; i < 3; i++) {
+            MakeFrame(&f, put);
+            if(CanQueuePut(q, &f)) put++;
+        }
+        for(i = 0; i < 2; i++) {
+            CHECK(CanQueueGet(q, &g));
+            MakeFrame(&f, got++);
+            CHECK(SameFrame(&f, &g));
+        }
+        CHECK(CanQueueCount(q) == (int)(put - got));
+        CHECK(CanQueueCount(q) <= 5);
+    }
+    while(CanQueueGet(q, &g)) { MakeFrame(&f, got++); CHECK(SameFrame(&f, &g)); }
+    CHECK(got == put);
+    CHECK(q->overflow == 1 + 300 - put + 5);
+    free(q);
+    printf("PASS single thread\n");
+}
+
+
+// the simulated ISR: frames arrive in bursts of up to three (the size of a bxCAN FIFO)
+struct feed {
+    struct s_canqueue *q;
+    uint32_t frames;
+    int pause;                                                  // yield after each burst so the reader keeps up
+    volatile int finished;                                      // set when the last frame has been put
+};
+
+static void *Isr(void *arg) {
+    struct feed *s = arg;
+    struct s_canframe f;
+    uint32_t n = 0;
+    unsigned int r = 407;
+    while(n < s->frames) {
+        int burst = 1 + (r = r * 1103515245 + 12345) % 3;
+        while(burst-- && n < s->frames) {
+            MakeFrame(&f, n++);
+            CanQueuePut(s->q, &f);
+        }
+        if(s->pause) sched_yield();
+    }
+    __sync_synchronize();
+    s->finished = true;
+    return NULL;
+}
+
+static void TestIsr(int depth, uint32_t frames, int pause) {
+    struct feed s = { NewQueue(depth), frames, pause, false };
+    struct s_canframe f, g;
+    pthread_t t;
+    uint32_t got = 0, next = 0;
+    int done = false;
+
+    pthread_create(&t, NULL, Isr, &s);
+    while(1) {
+        if(CanQueueGet(s.q, &g)) {
+            // the sequence number is in the first four data bytes
+            uint32_t n = g.data[0] | g.data[1] << 8 | g.data[2] << 16 | (uint32_t)g.data[3] << 24;
+            CHECK(n >= next);                                   // in order and never twice
+            MakeFrame(&f, n);
+            CHECK(SameFrame(&f, &g));                           // and not torn by a Put into the same entry
+            CHECK(CanQueueCount(s.q) <= depth);
+            next = n + 1;
+            got++;
+        } else if(done)
+            break;
+        else if(s.finished)
+            done = true;                                        // empty the queue once more then stop
+    }
+    pthread_join(t, NULL);
+    CHECK(got + s.q->overflow == frames);
+    printf("PASS simulated ISR: depth %d, %u frames, %u read, %u overflowed\n", depth, frames, got, s.q->overflow);
+    free(s.q);
+}
+
+
+int main(void) {
+    TestSingle();
+    TestIsr(256, 200000, true);
+    TestIsr(4, 200000, false);                                  // a reader that cannot keep up
+    TestIsr(1, 50000, false);
+    return failed;
+}
@@ -0,0 +1,454 @@
+/***********************************************************************************************************************
+host.c
+
+Runs the MMBasic interpreter core as a Linux program so that it can be tested and benchmarked without the hardware.
+
+The firmware sources are compiled unchanged.  They assume the STM32F407 memory map (program flash at 0x08000000,
+the CCM RAM holding the variable table at 0x10000000, the heap at 0x20000000 and the peripherals at 0x40000000) and
+32 bit pointers, so this maps memory at those addresses and runs the interpreter on a stack below 4GB.  A thread
+stands in for the 1mS SysTick interrupt and the USB console (which is the console used by the host build).
+
+    mmbasic                   the normal command prompt (Ctrl-C to break, the RESET or CPU RESTART commands exit)
+    mmbasic [-s] prog.bas     load prog.bas into program flash and RUN it, -s prints statistics when it finishes
+
+The program memory, options and saved variables only last as long as the process.  Files are on a RAM disk.
+***********************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "MMBasic_Includes.h"
+#include "Hardware_Includes.h"
+#include "main.h"
+#include "ff_gen_drv.h"
+#include <termios.h>                                        // after the firmware, it defines CR1, CR2, etc
+
+// the STM32F407 memory map as seen by the firmware
+#define HOST_FLASH_BASE     0x08000000u
+#define HOST_FLASH_SIZE     0x00100000u                             // 1MB
+#define HOST_CCM_BASE       0x10000000u
+#define HOST_CCM_SIZE       0x00010000u                             // 64KB
+#define HOST_SRAM_BASE      0x20000000u
+#define HOST_SRAM_SIZE      0x00020000u                             // 128KB
+#define HOST_PERIPH_BASE    0x40000000u
+#define HOST_PERIPH_SIZE    0x10100000u                             // APB, AHB1/2 (includes the backup RAM and USB)
+#define HOST_CORE_BASE      0xE0000000u
+#define HOST_CORE_SIZE      0x00100000u                             // SysTick, NVIC, SCB, DWT
+#define HOST_STACK_BASE     0x30000000u                             // the interpreter's stack (this is not used by the STM32)
+#define HOST_STACK_SIZE     0x00800000u
+
+#define RAMDISK_SECTORS     (16 * 1024 * 1024 / _MAX_SS)            // a 16MB RAM disk for the file commands
+
+extern volatile long long int mSecTimer;
+extern volatile unsigned int PauseTimer, IntPauseTimer, InkeyTimer, SecondsTimer, ScrewUpTimer;
+extern volatile uint64_t TIM12count;
+extern volatile int ConsoleRxBufHead, ConsoleRxBufTail, ConsoleTxBufHead, ConsoleTxBufTail;
+extern char ConsoleRxBuf[], ConsoleTxBuf[];
+extern TIM_HandleTypeDef htim12;
+extern char SerialConDisabled;
+extern jmp_buf jmprun;
+extern int FirmwareMain(void);
+extern unsigned int StatementCount;
+extern unsigned int HeapPagesHigh;
+extern void SaveProgramToFlash(char *pm, int msg);
+extern void ResetAllFlash(void);
+
+static volatile int TickRun = 1;
+static struct termios SavedTerm;
+static int TermSaved;
+static ucontext_t HostContext, BasicContext;
+static char *ProgFile;
+static int ShowStats, ExitCode;
+static uint32_t BackupReg[RTC_BKP_NUMBER];
+static unsigned char *RamDisk;
+static long long CoreTimerBase;
+
+
+/***********************************************************************************************************************
+ timing and the simulated interrupts
+***********************************************************************************************************************/
+
+static long long HostMicroSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+// copy anything in the console transmit queue to stdout
+static void HostFlushConsole(void) {
+    while(ConsoleTxBufHead != ConsoleTxBufTail) {
+        int head = ConsoleTxBufHead, tail = ConsoleTxBufTail;
+        int n = (head > tail ? head : CONSOLE_TX_BUF_SIZE) - tail;
+        n = write(1, &ConsoleTxBuf[tail], n);
+        if(n <= 0) break;
+        ConsoleTxBufTail = (tail + n) % CONSOLE_TX_BUF_SIZE;
+    }
+}
+
+
+// this does the work of Timer1msHandler() in Timers.c and of the USB CDC receive and transmit interrupts
+static void *HostTick(void *arg) {
+    struct timespec next;
+    long long base = HostMicroSec(), last = 0, t;
+    char c;
+    int held = false;                                               // true if c was read but the receive buffer was full
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(TickRun) {
+        next.tv_nsec += 1000000;
+        if(next.tv_nsec >= 1000000000) { next.tv_nsec -= 1000000000; next.tv_sec++; }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        mSecTimer++;
+        PauseTimer++;
+        IntPauseTimer++;
+        InkeyTimer++;
+        if(mSecTimer % 1000 == 0) SecondsTimer++;
+        IntPost(INT_HOUSEKEEP);
+
+        // the 1uS TIMER is TIM12 extended to 64 bits by TIM12count, restart our count if the program has set it
+        t = (long long)(TIM12count << 16 | TIM12->CNT);
+        if(t != last) base = HostMicroSec() - t;
+        last = HostMicroSec() - base;
+        TIM12count = (uint64_t)last >> 16;
+        TIM12->CNT = last & 0xffff;
+        last = (long long)(TIM12count << 16 | TIM12->CNT);
+
+        // the USB console (see CDC_Receive_FS() in usbd_cdc_if.c)
+        // the USB host holds back data while the buffer is full so nothing is lost, XMODEM relies on that
+        while(held || read(0, &c, 1) == 1) {
+            held = false;
+            if(c == '\n' && !TermSaved) c = '\r';                   // a pipe has Unix line ends, a terminal sends CR
+            if(BreakKey && c == BreakKey) {
+                MMAbort = true;
+                ConsoleRxBufHead = ConsoleRxBufTail;
+                continue;
+            }
+            if((ConsoleRxBufHead + 1) % CONSOLE_RX_BUF_SIZE == ConsoleRxBufTail) {
+                held = true;
+                break;
+            }
+            ConsoleRxBuf[ConsoleRxBufHead] = c;
+            ConsoleRxBufHead = (ConsoleRxBufHead + 1) % CONSOLE_RX_BUF_SIZE;
+        }
+        HostFlushConsole();
+
+        // NVIC_SystemReset() writes the reset request then spins, treat that as the end of the session
+        if(SCB->AIRCR & SCB_AIRCR_SYSRESETREQ_Msk) {
+            HostFlushConsole();
+            if(TermSaved) tcsetattr(0, TCSANOW, &SavedTerm);
+            _exit(ExitCode);
+        }
+    }
+    return NULL;
+}
+
+
+// the core timer is TIM2 running at 84MHz, it is used by uSec()
+void WriteCoreTimer(unsigned long timeset) {
+    CoreTimerBase = HostMicroSec() * 84 - timeset;
+}
+
+unsigned long ReadCoreTimer(void) {
+    return HostMicroSec() * 84 - CoreTimerBase;
+}
+
+void HAL_Delay(uint32_t Delay) {
+    usleep(Delay * 1000);
+}
+
+uint32_t HostGetMSP(void) {
+    return (uint32_t)(uintptr_t)__builtin_frame_address(0);
+}
+
+uint32_t HostRBIT(uint32_t v) {
+    uint32_t r = 0;
+    for(int i = 0; i < 32; i++, v >>= 1) r = (r << 1) | (v & 1);
+    return r;
+}
+
+
+/***********************************************************************************************************************
+ program flash, backup registers and the random number generator
+***********************************************************************************************************************/
+
+// programming flash can only clear bits
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+    switch(TypeProgram) {
+        case FLASH_TYPEPROGRAM_BYTE:        *(volatile uint8_t *)Address &= (uint8_t)Data; break;
+        case FLASH_TYPEPROGRAM_HALFWORD:    *(volatile uint16_t *)Address &= (uint16_t)Data; break;
+        case FLASH_TYPEPROGRAM_WORD:        *(volatile uint32_t *)Address &= (uint32_t)Data; break;
+        default:                            *(volatile uint64_t *)Address &= Data; break;
+    }
+    return HAL_OK;
+}
+
+// sectors 0-3 are 16KB, sector 4 is 64KB and sectors 5-11 are 128KB
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError) {
+    uint32_t s, addr, size;
+    for(s = pEraseInit->Sector; s < pEraseInit->Sector + pEraseInit->NbSectors; s++) {
+        if(s < 4) { addr = HOST_FLASH_BASE + s * 0x4000; size = 0x4000; }
+        else if(s == 4) { addr = HOST_FLASH_BASE + 0x10000; size = 0x10000; }
+        else { addr = HOST_FLASH_BASE + (s - 4) * 0x20000; size = 0x20000; }
+        if(s > 11) { *SectorError = s; return HAL_ERROR; }
+        memset((void *)(uintptr_t)addr, 0xff, size);
+    }
+    *SectorError = 0xffffffff;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    return HAL_OK;
+}
+
+uint32_t HAL_RTCEx_BKUPRead(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister) {
+    return BackupReg[BackupRegister];
+}
+
+void HAL_RTCEx_BKUPWrite(RTC_HandleTypeDef *hrtc, uint32_t BackupRegister, uint32_t Data) {
+    BackupReg[BackupRegister] = Data;
+}
+
+HAL_StatusTypeDef HAL_RNG_GenerateRandomNumber(RNG_HandleTypeDef *hrng, uint32_t *random32bit) {
+    *random32bit = (uint32_t)random() << 1 ^ (uint32_t)random();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+    time_t t = time(NULL);
+    struct tm *tm = localtime(&t);
+    sTime->Hours = tm->tm_hour;
+    sTime->Minutes = tm->tm_min;
+    sTime->Seconds = tm->tm_sec;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+    time_t t = time(NULL);
+    struct tm *tm = localtime(&t);
+    sDate->Year = tm->tm_year - 100;
+    sDate->Month = tm->tm_mon + 1;
+    sDate->Date = tm->tm_mday;
+    sDate->WeekDay = tm->tm_wday ? tm->tm_wday : 7;
+    return HAL_OK;
+}
+
+
+/***********************************************************************************************************************
+ the RAM disk used in place of the SD card
+***********************************************************************************************************************/
+
+static DSTATUS RamDiskInitialize(BYTE lun) {
+    return 0;
+}
+
+static DSTATUS RamDiskStatus(BYTE lun) {
+    return 0;
+}
+
+static DRESULT RamDiskRead(BYTE lun, BYTE *buff, DWORD sector, UINT count) {
+    if(sector + count > RAMDISK_SECTORS) return RES_PARERR;
+    memcpy(buff, RamDisk + sector * _MAX_SS, count * _MAX_SS);
+    return RES_OK;
+}
+
+static DRESULT RamDiskWrite(BYTE lun, const BYTE *buff, DWORD sector, UINT count) {
+    if(sector + count > RAMDISK_SECTORS) return RES_PARERR;
+    memcpy(RamDisk + sector * _MAX_SS, buff, count * _MAX_SS);
+    return RES_OK;
+}
+
+static DRESULT RamDiskIoctl(BYTE lun, BYTE cmd, void *buff) {
+    switch(cmd) {
+        case CTRL_SYNC:         return RES_OK;
+        case GET_SECTOR_COUNT:  *(DWORD *)buff = RAMDISK_SECTORS; return RES_OK;
+        case GET_SECTOR_SIZE:   *(WORD *)buff = _MAX_SS; return RES_OK;
+        case GET_BLOCK_SIZE:    *(DWORD *)buff = 1; return RES_OK;
+    }
+    return RES_PARERR;
+}
+
+static const Diskio_drvTypeDef RamDiskDriver = {
+    RamDiskInitialize, RamDiskStatus, RamDiskRead, RamDiskWrite, RamDiskIoctl
+};
+
+char SDPath[4];
+
+// called by InitSDCard() in FileIO.c, the first call formats the disk
+void MX_FATFS_Init(void) {
+    FATFS_LinkDriver(&RamDiskDriver, SDPath);
+    if(RamDisk == NULL) {
+        static BYTE work[_MAX_SS];
+        RamDisk = calloc(RAMDISK_SECTORS, _MAX_SS);
+        if(RamDisk == NULL || f_mkfs(SDPath, FM_ANY, 0, work, sizeof(work)) != FR_OK) {
+            fprintf(stderr, "mmbasic: cannot create the RAM disk\n");
+            exit(2);
+        }
+    }
+}
+
+uint8_t BSP_SD_GetCardState(void) {
+    return MSD_OK;
+}
+
+void *ff_memalloc(UINT msize) {
+    return malloc(msize);
+}
+
+void ff_memfree(void *mblock) {
+    free(mblock);
+}
+
+
+/***********************************************************************************************************************
+ startup
+***********************************************************************************************************************/
+
+// Memory.c has an array called mmap[] (the heap page map) so this uses the system call directly
+static void HostMap(uint32_t addr, uint32_t size, int fill) {
+    void *p = (void *)syscall(SYS_mmap, (uintptr_t)addr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+    if(p != (void *)(uintptr_t)addr) {
+        fprintf(stderr, "mmbasic: cannot map 0x%08x (%s)\n", addr, strerror(errno));
+        exit(2);
+    }
+    if(fill) memset(p, fill, size);
+}
+
+
+// load the program into flash and run it, this is what main() in main.c does for RUN at the command prompt
+static void HostRunProgram(void) {
+    char *buf;
+    FILE *fp;
+    int n;
+    static long long start;                                     // static because it must survive the longjmp()
+    static int started;
+
+    if(setjmp(mark) != 0) {
+        // we got here via END, an error or Ctrl-C
+        if(MMerrno || MMAbort) ExitCode = 1;
+        if(started && ShowStats) {
+            long long t = HostMicroSec() - start;
+            while(ConsoleTxBufHead != ConsoleTxBufTail) usleep(1000);  // let the tick thread send the program's output
+            fprintf(stderr, "%s: %.3f sec, %u statements, %.0f statements/sec, heap high water %u bytes\n",
+                    ProgFile, t / 1e6, StatementCount, t ? StatementCount * 1e6 / t : 0.0,
+                    HeapPagesHigh * RAMPAGESIZE);
+        }
+        return;
+    }
+    ClearProgram();
+    PrepareProgram(true);
+
+    buf = GetTempMemory(EDIT_BUFFER_SIZE);
+    if((fp = fopen(ProgFile, "r")) == NULL) {
+        fprintf(stderr, "mmbasic: cannot open %s\n", ProgFile);
+        ExitCode = 2;
+        return;
+    }
+    n = fread(buf, 1, EDIT_BUFFER_SIZE - 1, fp);
+    fclose(fp);
+    if(n >= EDIT_BUFFER_SIZE - 1) error("Not enough memory");
+    buf[n] = 0;
+    SaveProgramToFlash(buf, false);
+    ClearTempMemory();
+
+    if(setjmp(jmprun) != 0) {
+        PrepareProgram(false);                                      // a RUN inside the program
+        CurrentLinePtr = 0;
+    } else {
+        strcpy(inpbuf, "RUN");
+        multi = false;
+        tokenise(true);
+    }
+    started = true;
+    start = HostMicroSec();
+    ExecuteProgram(tknbuf);
+    cmdline = "";
+    cmd_end();
+}
+
+
+static void HostBasic(void) {
+    if(ProgFile == NULL) {
+        FirmwareMain();                                             // the normal command prompt, this does not return
+        return;
+    }
+
+    ProgMemory = (char *)FLASH_PROGRAM_ADDR;
+    SavedMemoryBufferSize = 0;
+    HAL_FLASH_Unlock();
+    CurrentCpuSpeed = SystemCoreClock;
+    PeripheralBusSpeed = SystemCoreClock / 2;
+    LoadOptions();
+    SerialConDisabled = Option.SerialConDisabled;
+    RAMBase = (void *)((unsigned int)RAMBASE + (Option.MaxCtrls * sizeof(struct s_ctrl)) + SavedMemoryBufferSize);
+    RAMBase = (void *)MRoundUp((unsigned int)RAMBase);
+    Ctrl = (struct s_ctrl *)RAMBASE;
+    InitBasic();
+    InitHeap();
+    HostRunProgram();
+}
+
+
+int main(int argc, char *argv[]) {
+    pthread_t tick;
+    struct termios t;
+    int i;
+
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-s") == 0) ShowStats = true;
+        else if(*argv[i] == '-' || ProgFile != NULL) {
+            fprintf(stderr, "usage: mmbasic [-s] [program.bas]\n");
+            return 2;
+        } else
+            ProgFile = argv[i];
+    }
+
+    HostMap(HOST_FLASH_BASE, HOST_FLASH_SIZE, 0xff);
+    HostMap(HOST_CCM_BASE, HOST_CCM_SIZE, 0);
+    HostMap(HOST_SRAM_BASE, HOST_SRAM_SIZE, 0);
+    HostMap(HOST_PERIPH_BASE, HOST_PERIPH_SIZE, 0);
+    HostMap(HOST_CORE_BASE, HOST_CORE_SIZE, 0);
+    HostMap(HOST_STACK_BASE, HOST_STACK_SIZE, 0);
+    htim12.Instance = TIM12;
+    srandom(time(NULL));
+
+    // start with an empty program and the default options, but always use the USB console (the one that we emulate)
+    ResetAllFlash();
+    Option.SerialConDisabled = 1;
+    SaveOptions();
+
+    if(isatty(0) && tcgetattr(0, &SavedTerm) == 0) {
+        t = SavedTerm;
+        t.c_lflag &= ~(ICANON | ECHO | ISIG);                       // MMBasic does its own echo and Ctrl-C
+        t.c_iflag &= ~(ICRNL | IXON);
+        tcsetattr(0, TCSANOW, &t);
+        TermSaved = true;
+    }
+    fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+    pthread_create(&tick, NULL, HostTick, NULL);
+
+    // run the interpreter on a stack below 4GB because the firmware keeps stack addresses in 32 bit integers
+    getcontext(&BasicContext);
+    BasicContext.uc_stack.ss_sp = (void *)(uintptr_t)HOST_STACK_BASE;
+    BasicContext.uc_stack.ss_size = HOST_STACK_SIZE;
+    BasicContext.uc_link = &HostContext;
+    makecontext(&BasicContext, HostBasic, 0);
+    swapcontext(&HostContext, &BasicContext);
+
+    usleep(20000);                                                  // let the tick thread send the last of the output
+    TickRun = false;
+    pthread_join(tick, NULL);
+    HostFlushConsole();
+    if(TermSaved) tcsetattr(0, TCSANOW, &SavedTerm);
+    return ExitCode;
+}
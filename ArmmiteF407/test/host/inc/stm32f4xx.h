@@ -0,0 +1,43 @@
+#ifndef HOST_STM32F4XX_H
+#define HOST_STM32F4XX_H
+#include <stdint.h>
+#define __CMSIS_GCC_H                       // use the definitions below instead of the ARM inline assembler
+#define __ASM                               __asm
+#define __INLINE                            inline
+#define __STATIC_INLINE                     static inline
+#define __STATIC_FORCEINLINE                __attribute__((always_inline)) static inline
+#define __NO_RETURN                         __attribute__((__noreturn__))
+#define __USED                              __attribute__((used))
+#define __WEAK                              __attribute__((weak))
+#define __PACKED                            __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT                     struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION                      union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)                        __attribute__((aligned(x)))
+#define __RESTRICT                          __restrict
+#define __COMPILER_BARRIER()                __asm volatile("":::"memory")
+#define __NOP()                             ((void)0)
+#define __WFI()                             ((void)0)
+#define __WFE()                             ((void)0)
+#define __SEV()                             ((void)0)
+#define __BKPT(value)                       ((void)0)
+#define __ISB()                             __COMPILER_BARRIER()
+#define __DSB()                             __COMPILER_BARRIER()
+#define __DMB()                             __COMPILER_BARRIER()
+#define __CLZ                               (uint8_t)__builtin_clz
+#define __REV(x)                            __builtin_bswap32(x)
+#define __REV16(x)                          ((uint32_t)((((x) & 0xff00ff00u) >> 8) | (((x) & 0x00ff00ffu) << 8)))
+#define __RBIT(x)                           HostRBIT(x)
+#define __enable_irq()                      ((void)0)
+#define __disable_irq()                     ((void)0)
+#define __get_PRIMASK()                     0u
+#define __set_PRIMASK(x)                    ((void)(x))
+#define __get_FPSCR()                       0u
+#define __set_FPSCR(x)                      ((void)(x))
+#define __get_MSP()                         HostGetMSP()
+#define __LDREXW(p)                         (*(p))
+#define __STREXW(v, p)                      (*(p) = (v), 0u)
+#define __CLREX()                           ((void)0)
+uint32_t HostGetMSP(void);
+uint32_t HostRBIT(uint32_t v);
+#include_next "stm32f4xx.h"
+#endif
@@ -0,0 +1,6 @@
+#ifndef HOST_TIME_H
+#define HOST_TIME_H
+#define timegm host_glibc_timegm
+#include_next <time.h>
+#undef timegm
+#endif
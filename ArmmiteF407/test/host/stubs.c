@@ -0,0 +1,432 @@
+/***********************************************************************************************************************
+stubs.c
+
+The parts of the firmware that are not in the host build.  Commands and functions that need hardware (graphics, I/O
+pins, audio, the serial ports, CAN, the W25Q flash, etc) report an error, the HAL functions do nothing and the
+variables that belong to the missing modules are defined here so that the core can reference them.
+***********************************************************************************************************************/
+
+#include <stdio.h>
+#include "MMBasic_Includes.h"
+#include "Hardware_Includes.h"
+#include "main.h"
+#include "usbd_def.h"
+
+
+static void NotInHost(void) {
+    error("Not available in the host build");
+}
+
+void cmd_ADC(void) { NotInHost(); }
+void cmd_DAC(void) { NotInHost(); }
+void cmd_arc(void) { NotInHost(); }
+void cmd_backlight(void) { NotInHost(); }
+void cmd_bezier(void) { NotInHost(); }
+void cmd_blit(void) { NotInHost(); }
+void cmd_box(void) { NotInHost(); }
+void cmd_can(void) { NotInHost(); }
+void cmd_circle(void) { NotInHost(); }
+void cmd_cls(void) { NotInHost(); }
+void cmd_colour(void) { NotInHost(); }
+void cmd_ctrlval(void) { NotInHost(); }
+void cmd_device(void) { NotInHost(); }
+void cmd_ds18b20(void) { NotInHost(); }
+void cmd_edit(void) { NotInHost(); }
+void cmd_font(void) { NotInHost(); }
+void cmd_gui(void) { NotInHost(); }
+void cmd_i2c(void) { NotInHost(); }
+void cmd_i2c2(void) { NotInHost(); }
+void cmd_ir(void) { NotInHost(); }
+void cmd_keypad(void) { NotInHost(); }
+void cmd_kv(void) { NotInHost(); }
+void cmd_line(void) { NotInHost(); }
+void cmd_onewire(void) { NotInHost(); }
+void cmd_pin(void) { NotInHost(); }
+void cmd_pixel(void) { NotInHost(); }
+void cmd_play(void) { NotInHost(); }
+void cmd_polygon(void) { NotInHost(); }
+void cmd_port(void) { NotInHost(); }
+void cmd_pulse(void) { NotInHost(); }
+void cmd_pwm(void) { NotInHost(); }
+void cmd_rbox(void) { NotInHost(); }
+void cmd_setpin(void) { NotInHost(); }
+void cmd_spi(void) { NotInHost(); }
+void cmd_spi2(void) { NotInHost(); }
+void cmd_sync(void) { NotInHost(); }
+void cmd_text(void) { NotInHost(); }
+void cmd_triangle(void) { NotInHost(); }
+void fun_GPS(void) { NotInHost(); }
+void fun_baudrate(void) { NotInHost(); }
+void fun_ctrlval(void) { NotInHost(); }
+void fun_distance(void) { NotInHost(); }
+void fun_ds18b20(void) { NotInHost(); }
+void fun_getscanline(void) { NotInHost(); }
+void fun_kv(void) { NotInHost(); }
+void fun_mmOW(void) { NotInHost(); }
+void fun_mmhpos(void) { NotInHost(); }
+void fun_mmhres(void) { NotInHost(); }
+void fun_mmi2c(void) { NotInHost(); }
+void fun_mmvpos(void) { NotInHost(); }
+void fun_mmvres(void) { NotInHost(); }
+void fun_msgbox(void) { NotInHost(); }
+void fun_pin(void) { NotInHost(); }
+void fun_pixel(void) { NotInHost(); }
+void fun_port(void) { NotInHost(); }
+void fun_pulsin(void) { NotInHost(); }
+void fun_rgb(void) { NotInHost(); }
+void fun_spi(void) { NotInHost(); }
+void fun_spi2(void) { NotInHost(); }
+void fun_touch(void) { NotInHost(); }
+
+
+/***********************************************************************************************************************
+ HAL and USB device library
+***********************************************************************************************************************/
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef *hcan) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_ConfigChannel(DAC_HandleTypeDef* hdac, DAC_ChannelConfTypeDef* sConfig, uint32_t Channel) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_Init(DAC_HandleTypeDef* hdac) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_SetValue(DAC_HandleTypeDef* hdac, uint32_t Channel, uint32_t Alignment, uint32_t Data) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_Start(DAC_HandleTypeDef* hdac, uint32_t Channel) {
+    return HAL_OK;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin) {
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin) {
+    return GPIO_PIN_SET;                                            // the pins are pulled up
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_Init(void) {
+    return HAL_OK;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+}
+
+HAL_StatusTypeDef HAL_PWREx_EnableBkUpReg(void) {
+    return HAL_OK;
+}
+
+void HAL_PWR_EnableBkUpAccess(void) {
+}
+
+void HAL_PWR_EnterSTOPMode(uint32_t Regulator, uint8_t STOPEntry) {
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency) {
+    return HAL_OK;
+}
+
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t *pFLatency) {
+}
+
+void HAL_RCC_GetOscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) {
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RNG_Init(RNG_HandleTypeDef *hrng) {
+    return HAL_OK;
+}
+
+uint32_t HAL_RTCEx_DeactivateWakeUpTimer(RTC_HandleTypeDef *hrtc) {
+    return 0;
+}
+
+HAL_StatusTypeDef HAL_RTCEx_SetSmoothCalib(RTC_HandleTypeDef *hrtc, uint32_t SmoothCalibPeriod, uint32_t SmoothCalibPlusPulses, uint32_t SmouthCalibMinusPulsesValue) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTCEx_SetWakeUpTimer_IT(RTC_HandleTypeDef *hrtc, uint32_t WakeUpCounter, uint32_t WakeUpClock) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format) {
+    return HAL_OK;
+}
+
+void HAL_ResumeTick(void) {
+}
+
+HAL_StatusTypeDef HAL_SPI_DeInit(SPI_HandleTypeDef *hspi) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size, uint32_t Timeout) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SRAM_DeInit(SRAM_HandleTypeDef *hsram) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SRAM_Init(SRAM_HandleTypeDef *hsram, FMC_NORSRAM_TimingTypeDef *Timing, FMC_NORSRAM_TimingTypeDef *ExtTiming) {
+    return HAL_OK;
+}
+
+void HAL_SuspendTick(void) {
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(TIM_HandleTypeDef *htim, TIM_BreakDeadTimeConfigTypeDef *sBreakDeadTimeConfig) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+    return HAL_OK;
+}
+
+USBD_StatusTypeDef USBD_DeInit(USBD_HandleTypeDef *pdev) {
+    return USBD_OK;
+}
+
+USBD_StatusTypeDef USBD_Stop(USBD_HandleTypeDef *pdev) {
+    return USBD_OK;
+}
+
+HAL_StatusTypeDef USB_DevConnect(USB_OTG_GlobalTypeDef *USBx) {
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef USB_DevDisconnect(USB_OTG_GlobalTypeDef *USBx) {
+    return HAL_OK;
+}
+
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef *htim) {
+}
+
+
+/***********************************************************************************************************************
+ variables and functions that belong to modules that are not built
+***********************************************************************************************************************/
+
+// Timers.c (the 1mS tick is in host.c)
+volatile unsigned int PauseTimer, IntPauseTimer, InkeyTimer, WDTimer, ScrewUpTimer, SecondsTimer;
+volatile unsigned int SDtimer = 1000, checkSD;
+volatile long long int mSecTimer;
+volatile int second, minute, hour, day = 1, month = 1, year = 2000, milliseconds, day_of_week = 1;
+void mT4IntEnable(int a) {}
+
+// stm32f4xx_it.c and system_stm32f4xx.c
+volatile uint64_t TIM12count;
+uint32_t SystemCoreClock = 168000000;
+
+// usb_device.c
+USBD_HandleTypeDef hUsbDeviceFS;
+void MX_USB_DEVICE_Init(void) {}
+
+// Draw.c, SSD1963.c, SPI-LCD.c, Touch.c and GUI.c
+int CurrentX, CurrentY, HRes, VRes, DisplayHRes, DisplayVRes, gui_font_width = 8, gui_font_height = 12;
+unsigned char *FontTable[16];
+int CurrentSPISpeed = NONE_SPI_SPEED;
+int CheckGuiFlag, DelayedDrawFmtBox, DelayedDrawKeyboard, gui_int_down, gui_int_up;
+char *GuiIntDownVector, *GuiIntUpVector;
+struct s_ctrl *Ctrl;
+int StartEditChar;
+char *StartEditPoint;
+static void NoRectangle(int x1, int y1, int x2, int y2, int c) {}
+static void NoBitmap(int x1, int y1, int width, int height, int scale, int fc, int bc, unsigned char *bitmap) {}
+static void NoBuffer(int x1, int y1, int x2, int y2, char *c) {}
+static void NoScroll(int lines) {}
+void (*DrawRectangle)(int x1, int y1, int x2, int y2, int c) = NoRectangle;
+void (*DrawBitmap)(int x1, int y1, int width, int height, int scale, int fc, int bc, unsigned char *bitmap) = NoBitmap;
+void (*DrawBuffer)(int x1, int y1, int x2, int y2, char *c) = NoBuffer;
+void (*ReadBuffer)(int x1, int y1, int x2, int y2, char *c) = NoBuffer;
+void (*ScrollLCD)(int lines) = NoScroll;
+void DisplayPutC(char c) {}
+void DisplayPutS(char *s) {}
+void ClearScreen(int c) {}
+void SetFont(int fnt) {}
+void ShowCursor(int show) {}
+void SetBacklight(int intensity) {}
+void DisplayNotSet(void) { error("Display not configured"); }
+void Display_Refresh(void) {}
+void MX470Display(int fn) {}
+void DrawRectangleUser(int x1, int y1, int x2, int y2, int c) {}
+void DrawBitmapUser(int x1, int y1, int width, int height, int scale, int fc, int bc, unsigned char *bitmap) {}
+void DrawKeyboard(int a) {}
+void DrawFmtBox(int a) {}
+void InitDisplaySSD(int fullinit) {}
+void ConfigDisplaySSD(char *p) { NotInHost(); }
+void InitDisplaySPI(int InitOnly) {}
+void ConfigDisplaySPI(char *p) { NotInHost(); }
+void WriteSSD1963Command(int cmd) {}
+void WriteDataSSD1963(int data) {}
+void spi_write_command(unsigned char data) {}
+void spi_write_data(unsigned char data) {}
+void SPIClose(void) {}
+void InitTouch(void) {}
+void ConfigTouch(char *p) { NotInHost(); }
+void ProcessTouch(void) {}
+void CheckGui(void) {}
+int BMP_bDecode(int x, int y, int fnbr) { NotInHost(); return 0; }
+
+// External.c, Keyboard.c, Onewire.c and PWM.c
+int ExtCurrentConfig[NBR_PINS_MAXCHIP + 1];
+int InterruptUsed;
+char *IrInterrupt, *KeypadInterrupt;
+volatile char IrGotMsg;
+long long int *ds18b20Timers;
+void initExtIO(void) {}
+void ClearExternalIO(void) {}
+void ExtCfg(int pin, int cfg, int option) { NotInHost(); }
+int64_t ExtInp(int pin) { return 0; }
+void SetAndReserve(int pin, int inp, int init, int type) {}
+void PinSetBit(int pin, unsigned int offset) {}
+int IsInvalidPin(int pin) { return true; }
+int codecheck(char *line) { return 0; }
+int codemap(char code, int pin) { NotInHost(); return 0; }
+int KeypadCheck(void) { return 0; }
+void initKeyboard(void) {}
+
+// Serial.c (the console is in main.c)
+char *com1_interrupt, *com1_TX_interrupt, *com2_interrupt, *com2_TX_interrupt;
+char *com3_interrupt, *com3_TX_interrupt, *com4_interrupt, *com4_TX_interrupt;
+int com1_ilevel, com2_ilevel, com3_ilevel, com4_ilevel;
+int com1_TX_complete, com2_TX_complete, com3_TX_complete, com4_TX_complete;
+void SerialOpen(char *spec) { NotInHost(); }
+void SerialClose(int comnbr) {}
+unsigned char SerialPutchar(int comnbr, unsigned char c) { return c; }
+int SerialGetchar(int comnbr) { return -1; }
+int SerialRxStatus(int comnbr) { return 0; }
+int SerialTxStatus(int comnbr) { return 0; }
+
+// Audio.c
+volatile e_CurrentlyPlaying CurrentlyPlaying = P_NOTHING;
+char *WAVInterrupt;
+int WAVcomplete;
+volatile int vol_left = 100, vol_right = 100;
+void CloseAudio(void) {}
+void checkWAVinput(void) {}
+
+// GPS.c
+volatile char gpsbuf1[128];
+volatile char *gpsbuf;
+volatile char gpscount;
+volatile int gpscurrent, gpsmonitor;
+MMFLOAT GPSlatitude, GPSlongitude, GPSspeed, GPStrack, GPSdop, GPSaltitude;
+int GPSvalid, GPSfix, GPSadjust, GPSsatellites, GPSchannel;
+char GPStime[9], GPSdate[11];
+void processgps(void) {}
+
+// MM_Custom.c (ADC and DAC)
+MMFLOAT PI;
+MMFLOAT ADCscale[3], ADCbottom[3];
+int ADCmax;
+volatile int ADCchannelB, ADCchannelC, ADCcomplete, ADCstreaming;
+char *ADCInterrupt;
+int64_t *a1point, *a2point, *a3point;
+MMFLOAT *a1float, *a2float, *a3float;
+void ADCStreamService(void) {}
+void ADCStreamVarFreed(void *p) {}
+void ADCclose(void) {}
+void dacclose(void) {}
+
+// CAN.c, KV.c and CFunctions.c
+char *CanInterrupt;
+void CanClear(void) {}
+void KvService(void) {}
+int KvErasing(void) { return 0; }
+long long int CallCFunction(char *CmdPtr, char *ArgList, char *DefP, char *CallersLinePtr) { NotInHost(); return 0; }
+
+// main.c RTC setup
+void RtcGetTime(void) {}
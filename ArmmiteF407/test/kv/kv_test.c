@@ -0,0 +1,253 @@
+/*
+ * Host test of the KV store log in Src/KvLog.c against a simulated W25Q
+ *
+ * The flash is a RAM image that behaves like NOR flash: a program can only clear bits and must not cross a page,
+ * an erase sets a 4K sector to 0xFF and then the flash stays busy for a few polls of KvBusy().  Any other access
+ * while it is busy is a failure, as is the flash being busy when KvErasing() says that it cannot be (SPIOpen()
+ * relies on that).  A power failure can be injected part way through a program or an erase, then the store is
+ * opened again as it would be at power up and every key must have its old or its new value.
+ *
+ * Random puts and deletes are checked against a model of what the store should hold, with the background
+ * compaction (KvService() on the F407) run between them.  A background step must not wait for the flash (at most
+ * one poll of KvBusy()) and must not read more than a page or a record, so it cannot hold up BASIC.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include "KV.h"
+
+#define SECTORS     15                              // the same as WBKvSectors
+#define BASE        0x10000
+#define KEYS        120
+#define BGREAD      1024                            // the most a background step may read
+
+// the store is left in no state to carry on so stop at the first failure
+#define CHECK(c) do { if(!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); exit(1); } } while(0)
+
+// the same as crc32() in MATHS.c
+uint32_t crc32(const uint8_t *array, uint16_t length, const uint32_t polynome, const uint32_t startmask, const uint32_t endmask, const uint8_t reverseIn, const uint8_t reverseOut) {
+    uint32_t crc = startmask;
+    int i;
+    (void)reverseIn; (void)reverseOut;              // the store does not use them
+    while(length--) {
+        crc ^= (uint32_t)*array++ << 24;
+        for(i = 0; i < 8; i++) crc = (crc & 0x80000000) ? (crc << 1) ^ polynome : crc << 1;
+    }
+    return crc ^ endmask;
+}
+
+
+/****** the simulated flash *****************************************************************************/
+static uint8_t flash[SECTORS * KV_SECTOR];
+static int busy;                                    // polls of KvBusy() left before an erase is finished
+static long budget = -1;                            // bytes that can be programmed before the power fails, -1 for never
+static jmp_buf powerfail;
+static int background, polls, bgread;               // counts for the step being run in the background
+static unsigned int erases, programs;
+
+static void SimRead(uint32_t addr, void *p, int n) {
+    CHECK(addr >= BASE && addr + n <= BASE + sizeof(flash) && !busy);
+    memcpy(p, flash + addr - BASE, n);
+    bgread += n;
+}
+
+static void SimProgram(uint32_t addr, const void *p, int n) {
+    const uint8_t *q = p;
+    CHECK(addr >= BASE && addr + n <= BASE + sizeof(flash) && !busy);
+    CHECK(addr / KV_PAGE == (addr + n - 1) / KV_PAGE);
+    while(n--) {
+        if(budget == 0) longjmp(powerfail, 1);
+        if(budget > 0) budget--;
+        flash[addr++ - BASE] &= *q++;               // NOR flash can only clear bits
+    }
+    programs++;
+}
+
+static void SimErase(uint32_t addr) {
+    uint8_t *s = flash + addr - BASE;
+    CHECK(addr >= BASE && addr < BASE + sizeof(flash) && (addr - BASE) % KV_SECTOR == 0 && !busy);
+    if(budget >= 0 && budget < 40) {                // the power fails part way through, leave some of it erased
+        memset(s + rand() % KV_SECTOR, 0xFF, rand() % 64);
+        longjmp(powerfail, 1);
+    }
+    memset(s, 0xFF, KV_SECTOR);
+    busy = 3;
+    erases++;
+}
+
+static int SimBusy(void) {
+    polls++;
+    if(busy) {
+        busy--;
+        return 1;
+    }
+    return 0;
+}
+
+// KV.c points these at the W25Q
+void (*KvRead)(uint32_t addr, void *p, int n) = SimRead;
+void (*KvProgram)(uint32_t addr, const void *p, int n) = SimProgram;
+void (*KvErase)(uint32_t addr) = SimErase;
+int (*KvBusy)(void) = SimBusy;
+
+// one call of the housekeeping
+static void Background(void) {
+    background = 1;
+    polls = bgread = 0;
+    KvCompactStep();
+    CHECK(polls <= 1);                              // it polled rather than waited
+    CHECK(bgread <= BGREAD);
+    CHECK(!busy || KvErasing());
+    background = 0;
+}
+
+
+/****** the model of what the store should hold *********************************************************/
+struct value {
+    int type;                                       // zero if the key is not there
+    int len;
+    char v[KV_MAXVALUE];
+};
+static struct value model[KEYS], next;               // next is the value being saved
+
+static void KeyName(int k, char *s) {
+    sprintf(s, "key%03d", k);
+}
+
+static int Same(struct value *m, int r, int type, char *v, int len) {
+    if(m->type == 0) return r == KV_NOTFOUND;
+    return r == KV_OK && type == m->type && len == m->len && memcmp(v, m->v, len) == 0;
+}
+
+// check every key, the key that was being changed when the power failed can have its old or new value
+static void Verify(int changing) {
+    char ks[16], v[KV_MAXVALUE];
+    int k, r, type = 0, len = 0;
+    for(k = 0; k < KEYS; k++) {
+        KeyName(k, ks);
+        r = KvGet(ks, strlen(ks), &type, v, &len);
+        if(Same(&model[k], r, type, v, len)) continue;
+        CHECK(k == changing && Same(&next, r, type, v, len));
+        model[k] = next;
+    }
+}
+
+// a random value for key k
+static void RandomValue(int k, struct value *m) {
+    int i, what = rand() % 20;
+    long long n;
+    double d;
+    if(what == 0) {
+        m->type = 0;
+    } else if(what < 12) {
+        m->type = KV_INT;
+        n = rand() % 50;
+        memcpy(m->v, &n, 8);
+        m->len = 8;
+    } else if(what < 16) {
+        m->type = KV_NBR;
+        d = rand() / 3.0;
+        memcpy(m->v, &d, 8);
+        m->len = 8;
+    } else {
+        m->type = KV_STR;
+        m->len = rand() % (k % 7 == 0 ? KV_MAXVALUE + 1 : 20);
+        for(i = 0; i < m->len; i++) m->v[i] = 'a' + rand() % 26;
+    }
+}
+
+
+/****** the tests ***************************************************************************************/
+// random puts and deletes with the background running and the power failing now and then
+static void TestRandom(int ops) {
+    char ks[16];
+    int i, k, r, keys, blank, used, live;
+    volatile int op, failures = 0;
+
+    // old data from whatever used the flash before, and sectors that look free but are not blank
+    for(i = 0; i < (int)sizeof(flash); i++) flash[i] = rand();
+    for(i = 0; i < SECTORS; i += 3) memset(flash + i * KV_SECTOR, 0xFF, 64);
+    CHECK(KvOpen(BASE, SECTORS) == KV_OK);
+    Verify(-1);
+
+    for(op = 0; op < ops; op++) {
+        k = rand() % KEYS;
+        KeyName(k, ks);
+        RandomValue(k, &next);
+        if(rand() % 300 == 0) budget = rand() % 400;
+        if(setjmp(powerfail)) {
+            budget = -1;
+            busy = 0;
+            failures++;
+            KvOpen(BASE, SECTORS);                  // as at power up
+            Verify(k);
+            continue;
+        }
+        for(i = rand() % 6; i > 0; i--) Background();
+        if(next.type)
+            r = KvPut(ks, strlen(ks), next.type, next.v, next.len);
+        else
+            r = KvDelete(ks, strlen(ks));
+        for(i = rand() % 6; i > 0; i--) Background();
+        budget = -1;
+        CHECK(r == KV_OK || (next.type == 0 && r == KV_NOTFOUND));
+        model[k] = next;
+        if(op % 5000 == 0) {
+            Verify(-1);
+            while(KvErasing()) Background();
+            KvOpen(BASE, SECTORS);
+            Verify(-1);
+        }
+    }
+    Verify(-1);
+    KvStatus(&keys, &blank, &used, &live);
+    printf("PASS random puts and deletes: %d ops, %d power failures, %u erases, %u programs, %d keys, %d blank sectors\n",
+           ops, failures, erases, programs, keys, blank);
+}
+
+// everything that can be recovered is, and nothing is lost
+static void TestCompact(void) {
+    int keys, blank, used, live;
+    while(KvCompact());
+    KvStatus(&keys, &blank, &used, &live);
+    CHECK(live <= used);
+    Verify(-1);
+    while(KvErasing()) Background();
+    KvOpen(BASE, SECTORS);
+    Verify(-1);
+    printf("PASS compact: %d keys, %d blank sectors, %d bytes used, %d live\n", keys, blank, used, live);
+}
+
+// the background alone keeps the store from filling up
+static void TestBackground(void) {
+    char ks[16];
+    int i, k, keys, blank, used, live;
+    long long n;
+    CHECK(KvFormat() == KV_OK);
+    memset(model, 0, sizeof(model));
+    for(i = 0; i < 20000; i++) {
+        k = i % 10;
+        n = i;
+        KeyName(k, ks);
+        CHECK(KvPut(ks, strlen(ks), KV_INT, &n, 8) == KV_OK);
+        model[k].type = KV_INT;
+        model[k].len = 8;
+        memcpy(model[k].v, &n, 8);
+        Background();                               // one step for each put is enough to keep up
+        KvStatus(&keys, &blank, &used, &live);
+        CHECK(blank >= 1);
+    }
+    Verify(-1);
+    printf("PASS background compaction keeps up: %u erases\n", erases);
+}
+
+
+int main(void) {
+    srand(407);
+    TestRandom(200000);
+    TestCompact();
+    TestBackground();
+    return 0;
+}
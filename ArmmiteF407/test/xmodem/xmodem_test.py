@@ -0,0 +1,295 @@
+#!/usr/bin/env python3
+"""
+XMODEM and YMODEM transfers with the host build of MMBasic over a pty
+
+The interpreter (test/host/build/mmbasic) runs a program that receives a YMODEM batch, sends it back, sends a
+file with XMODEM-1K and receives one from a sender that only knows checksums (so the CRC16 fallback is used).
+The other end is a small XMODEM/YMODEM peer written here so that the test runs anywhere.  If lrzsz is installed
+(sz/rz or lsz/lrz) the YMODEM batch is also sent and received with it, otherwise that part is skipped.
+
+    python3 xmodem_test.py [path/to/mmbasic]
+
+The exit status is non zero if a transfer fails.
+"""
+
+import os, pty, random, select, shutil, subprocess, sys, tempfile, time, tty
+
+SOH, STX, EOT, ACK, NAK, CAN, PAD, CRC = 0x01, 0x02, 0x04, 0x06, 0x15, 0x18, 0x1a, ord('C')
+
+PROGRAM = """XMODEM YRECEIVE
+XMODEM YSEND "*.dat"
+XMODEM SEND "big.dat"
+XMODEM RECEIVE "x.dat"
+OPEN "x.dat" FOR INPUT AS #1
+PRINT "size"; LOF(#1)
+CLOSE #1
+"""
+
+ERROR_PROGRAM = """ON ERROR SKIP: XMODEM RECEIVE "c.dat"
+e1$ = MM.ERRMSG$
+ON ERROR SKIP: XMODEM YRECEIVE
+e2$ = MM.ERRMSG$
+ON ERROR CLEAR
+PRINT "<"; e1$; "><"; e2$; ">"
+"""
+
+LRZSZ_PROGRAM = """XMODEM YRECEIVE
+XMODEM YSEND "*.dat"
+"""
+
+
+def crc16(data):
+    crc = 0
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xffff
+    return crc
+
+
+def test_files():
+    r = random.Random(407)
+    # binary data with every byte value, including ^C, CR, LF, NUL and the padding char
+    return {
+        "empty.dat": b"",
+        "small.dat": bytes(range(256)) + b"\r\n\x03\x00\x1a",
+        "big.dat": bytes(r.randrange(256) for _ in range(5000)),
+    }
+
+
+class Link:
+    """one end of the pty, the other end is the interpreter's console"""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.pending = bytearray()
+
+    def send(self, data):
+        os.write(self.fd, bytes(data))
+
+    def read(self, n, timeout):
+        end = time.time() + timeout
+        while len(self.pending) < n:
+            left = end - time.time()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None
+            try:
+                self.pending += os.read(self.fd, 4096)
+            except OSError:                                         # the interpreter has exited
+                return None
+        data, self.pending = bytes(self.pending[:n]), self.pending[n:]
+        return data
+
+    def byte(self, timeout=10):
+        b = self.read(1, timeout)
+        return None if b is None else b[0]
+
+    def wait_for(self, wanted, timeout=20):
+        end = time.time() + timeout
+        while time.time() < end:
+            b = self.byte(end - time.time())
+            if b in wanted:
+                return b
+        raise RuntimeError("timeout waiting for %s" % [hex(w) for w in wanted])
+
+    # send one packet and wait for it to be acknowledged
+    def packet(self, n, data, crc=True, pad=PAD):
+        size = 1024 if len(data) > 128 else 128
+        body = bytes(data) + bytes([pad]) * (size - len(data))
+        pkt = bytes([STX if size == 1024 else SOH, n & 0xff, ~n & 0xff]) + body
+        pkt += crc16(body).to_bytes(2, "big") if crc else bytes([sum(body) & 0xff])
+        for _ in range(10):
+            self.send(pkt)
+            if self.wait_for((ACK, NAK)) == ACK:
+                return
+        raise RuntimeError("packet %d not acknowledged" % n)
+
+    def eot(self):
+        for _ in range(10):
+            self.send([EOT])
+            if self.wait_for((ACK, NAK)) == ACK:
+                return
+        raise RuntimeError("EOT not acknowledged")
+
+    def send_file(self, data, crc=True):
+        for n, i in enumerate(range(0, len(data), 1024 if crc else 128), 1):
+            self.packet(n, data[i:i + (1024 if crc else 128)], crc)
+        self.eot()
+
+    # ask for a packet with 'C' (or NAK) and return (header, number, data) for the next one
+    def get_packet(self, ask=None):
+        for _ in range(20):
+            if ask is not None:
+                self.send([ask])
+            c = self.byte(3)
+            if c in (SOH, STX):
+                size = 1024 if c == STX else 128
+                rest = self.read(size + 4, 10)
+                if rest is None:
+                    raise RuntimeError("short packet")
+                body = rest[2:size + 2]
+                if rest[0] == (~rest[1] & 0xff) and crc16(body) == int.from_bytes(rest[size + 2:], "big"):
+                    return c, rest[0], body
+                self.send([NAK])
+                ask = None
+            elif c == EOT:
+                return c, None, None
+            elif c is None and ask is None:
+                ask = NAK
+        raise RuntimeError("no packet received")
+
+    def recv_file(self, first):
+        c, n, body = first
+        data, expect = bytearray(), 1
+        while c != EOT:
+            if n == expect:
+                data += body
+                expect = (expect + 1) & 0xff
+            self.send([ACK])
+            c, n, body = self.get_packet()
+        self.send([ACK])
+        return bytes(data)
+
+    def ysend(self, files):
+        for name, data in files.items():
+            self.wait_for((CRC,))
+            self.packet(0, name.encode() + b"\0" + str(len(data)).encode(), pad=0)
+            self.wait_for((CRC,))
+            self.send_file(data)
+        self.wait_for((CRC,))
+        self.packet(0, b"", pad=0)                                  # an empty name ends the batch
+
+    def yrecv(self):
+        files = {}
+        while True:
+            c, n, body = self.get_packet(CRC)
+            if c == EOT or n != 0:
+                raise RuntimeError("expected a YMODEM header")
+            self.send([ACK])
+            name, _, rest = body.partition(b"\0")
+            if not name:
+                return files
+            size = int(rest.split(b"\0")[0].split()[0])
+            files[name.decode()] = self.recv_file(self.get_packet(CRC))[:size]
+
+    def xrecv(self):
+        return self.recv_file(self.get_packet(CRC))
+
+    def xsend_checksum(self, data):
+        self.wait_for((NAK,), 30)                                   # ignore the requests for CRC16
+        self.send_file(data, crc=False)
+
+
+def run(mmbasic, program, peer, label):
+    """run program in the interpreter with its console on a pty and talk to it with peer(link)"""
+    work = tempfile.mkdtemp()
+    prog = os.path.join(work, "prog.bas")
+    with open(prog, "w") as f:
+        f.write(program)
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    proc = subprocess.Popen([mmbasic, prog], stdin=slave, stdout=slave, stderr=subprocess.PIPE)
+    os.close(slave)
+    link = Link(master)
+    try:
+        start = time.time()
+        result = peer(link)
+        tail = b""
+        while (b := link.read(1, 5)) is not None:
+            tail += b
+        proc.wait(10)
+        err = proc.stderr.read().decode()
+        if proc.returncode != 0 or err:
+            raise RuntimeError("mmbasic exited with %d %s %r" % (proc.returncode, err, tail))
+        print("PASS %s (%.1f sec)" % (label, time.time() - start))
+        return result, tail.decode(errors="replace")
+    finally:
+        if proc.poll() is None:
+            proc.kill()
+        os.close(master)
+        shutil.rmtree(work)
+
+
+def check(ok, what):
+    if not ok:
+        raise RuntimeError(what)
+
+
+def builtin_peer(mmbasic):
+    files = test_files()
+    small = bytes(random.Random(1).randrange(256) for _ in range(300))
+
+    def peer(link):
+        link.ysend(files)
+        back = link.yrecv()
+        check(back == files, "YSEND returned %s" % {k: len(v) for k, v in back.items()})
+        big = link.xrecv()
+        check(big[:5000] == files["big.dat"] and set(big[5000:]) <= {0} and len(big) % 128 == 0,
+              "XMODEM SEND gave %d bytes" % len(big))             # the firmware pads the last block with zeros
+        link.xsend_checksum(small)
+
+    _, out = run(mmbasic, PROGRAM, peer, "YMODEM batch, XMODEM-1K send and checksum receive")
+    check("size 384" in out, "XMODEM RECEIVE saved the wrong size: %r" % out)
+
+
+def error_peer(mmbasic):
+    def peer(link):
+        link.wait_for((CRC,))
+        body = bytes(128)
+        bad = bytes([SOH, 1, 0xfe]) + body + ((crc16(body) + 1) & 0xffff).to_bytes(2, "big")
+        for naks in range(40):                                      # keep sending a packet with a bad CRC
+            link.send(bad)
+            if link.wait_for((NAK, CAN)) == CAN:
+                break
+        check(naks == 24, "XMODEM RECEIVE cancelled after %d corrupt packets" % (naks + 1))
+        link.wait_for((CRC,))
+        link.packet(0, b"bad*name.dat\0" + b"5", pad=0)              # a name that cannot be created
+        link.wait_for((CAN,))
+
+    _, out = run(mmbasic, ERROR_PROGRAM, peer, "XMODEM corrupt packets and YMODEM bad file name")
+    check("<Too many errors><Cannot create bad*name.dat>" in out, "wrong errors: %r" % out)
+
+
+def lrzsz_peer(mmbasic):
+    sz = shutil.which("sz") or shutil.which("lsz")
+    rz = shutil.which("rz") or shutil.which("lrz")
+    if not sz or not rz:
+        print("SKIP YMODEM with lrzsz (sz/rz are not installed)")
+        return
+    files = test_files()
+    src, dst = tempfile.mkdtemp(), tempfile.mkdtemp()
+    for name, data in files.items():
+        with open(os.path.join(src, name), "wb") as f:
+            f.write(data)
+
+    def peer(link):
+        io = dict(stdin=link.fd, stdout=link.fd, stderr=subprocess.DEVNULL)
+        subprocess.run([sz, "--ymodem", "-q"] + sorted(files), cwd=src, check=True, timeout=60, **io)
+        subprocess.run([rz, "--ymodem", "-q", "-y"], cwd=dst, check=True, timeout=60, **io)
+
+    try:
+        run(mmbasic, LRZSZ_PROGRAM, peer, "YMODEM batch with lrzsz")
+        for name, data in files.items():
+            with open(os.path.join(dst, name), "rb") as f:
+                check(f.read() == data, "%s differs after the round trip through lrzsz" % name)
+    finally:
+        shutil.rmtree(src)
+        shutil.rmtree(dst)
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    mmbasic = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "../host/build/mmbasic")
+    try:
+        builtin_peer(mmbasic)
+        error_peer(mmbasic)
+        lrzsz_peer(mmbasic)
+    except (RuntimeError, subprocess.SubprocessError) as e:
+        print("FAIL %s" % e)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())